@@ -107,7 +107,8 @@ struct aircraft *aircraftGet(uint32_t addr) {
     while (a && a->addr != addr) {
         a = a->next;
     }
-    if (a) {
+    // tracker shards only read the quick lookup table, trackShardFlush() fills it
+    if (a && !trackShardCurrent) {
         quickAdd(a);
     }
     return a;
@@ -143,9 +144,11 @@ struct aircraft *aircraftCreate(uint32_t addr) {
         a->globe_index = -5;
     }
 
+    a->dirtyEpoch = Modes.apiEpoch;
+
     // initialize data validity ages
     //adjustExpire(a, 58);
-    Modes.stats_current.unique_aircraft++;
+    trackStats()->unique_aircraft++;
 
     updateTypeReg(a);
 
@@ -156,11 +159,20 @@ struct aircraft *aircraftCreate(uint32_t addr) {
     return a;
 }
 
+// the values that change with time alone, the rest of the binCraft
+// only changes with the aircraft or when its data expires
+void binCraftSeen(struct aircraft *a, struct binCraft *new, int64_t now) {
+    new->seen = (now - a->seen) / 100.0;
+    if (new->position_valid)
+        new->seen_pos = (now - a->seen_pos) / 100.0;
+    else if (now < a->seenPosReliable + 14 * 24 * HOURS)
+        new->seen_pos = (now - a->seenPosReliable) / 100.0;
+}
+
 void toBinCraft(struct aircraft *a, struct binCraft *new, int64_t now) {
 
     memset(new, 0, sizeof(struct binCraft));
     new->hex = a->addr;
-    new->seen = (now - a->seen) / 100.0;
 
     new->callsign_valid = trackDataValid(&a->callsign_valid);
     for (unsigned i = 0; i < sizeof(new->callsign); i++)
@@ -178,13 +190,11 @@ void toBinCraft(struct aircraft *a, struct binCraft *new, int64_t now) {
     new->position_valid = posReliable(a);
 
     if (new->position_valid) {
-        new->seen_pos = (now - a->seen_pos) / 100.0;
         new->lat = (int32_t) nearbyint(a->lat * 1E6);
         new->lon = (int32_t) nearbyint(a->lon * 1E6);
         new->pos_nic = a->pos_nic;
         new->pos_rc = a->pos_rc;
     } else if (now < a->seenPosReliable + 14 * 24 * HOURS) {
-        new->seen_pos = (now - a->seenPosReliable) / 100.0;
         new->lat = (int32_t) nearbyint(a->latReliable * 1E6);
         new->lon = (int32_t) nearbyint(a->lonReliable * 1E6);
         new->pos_nic = a->pos_nic_reliable;
@@ -267,6 +277,8 @@ void toBinCraft(struct aircraft *a, struct binCraft *new, int64_t now) {
 
     new->signal = get8bitSignal(a);
 
+    binCraftSeen(a, new, now);
+
 #if defined(TRACKS_UUID)
     new->receiverId = (uint32_t) a->receiverId;
 #endif
@@ -597,6 +609,7 @@ void dbPut(uint32_t addr, dbEntry **index, dbEntry *d) {
 
 void updateTypeReg(struct aircraft *a) {
     dbEntry *d = dbGet(a->addr, Modes.dbIndex);
+    a->dirtyEpoch = Modes.apiEpoch;
     if (d) {
         memcpy(a->registration, d->registration, sizeof(a->registration));
         memcpy(a->typeCode, d->typeCode, sizeof(a->typeCode));
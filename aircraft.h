@@ -178,6 +178,7 @@ struct binCraft {
 } __attribute__ ((__packed__));
 
 void toBinCraft(struct aircraft *a, struct binCraft *new, int64_t now);
+void binCraftSeen(struct aircraft *a, struct binCraft *new, int64_t now);
 int dbUpdate();
 int dbFinishUpdate();
 
@@ -147,11 +147,11 @@ static inline void emfileError() {
     fprintf(stderr, "<3>EMFILE: Out of file descriptors (either there is a leak that needs fixing or you need to increase ulimit if you need more than %d connections)!\n", (int) limits.rlim_cur);
 }
 
-int anetCreateSocket(char *err, int domain, int typeFlags)
+static int anetCreateTypedSocket(char *err, int domain, int type)
 {
     int s, on = 1;
 
-    if ((s = socket(domain, SOCK_STREAM | typeFlags, 0)) == -1) {
+    if ((s = socket(domain, type, 0)) == -1) {
         if (errno == EMFILE) {
             emfileError();
         }
@@ -169,6 +169,11 @@ int anetCreateSocket(char *err, int domain, int typeFlags)
     return s;
 }
 
+int anetCreateSocket(char *err, int domain, int typeFlags)
+{
+    return anetCreateTypedSocket(err, domain, SOCK_STREAM | typeFlags);
+}
+
 #define ANET_CONNECT_NONE 0
 #define ANET_CONNECT_NONBLOCK 1
 static int anetTcpGenericConnect(char *err, char *addr, char *service, int flags, struct sockaddr_storage *ss)
@@ -367,6 +372,127 @@ int anetTcpServer(char *err, char *service, char *bindaddr, int *fds, int nfds,
     }
     return (i > 0 ? i : ANET_ERR);
 }
+
+/* Listen on an already resolved address with SO_REUSEPORT set, several such
+ * sockets can share one port and the kernel spreads new connections over them */
+int anetTcpReusePortServer(char *err, struct sockaddr *sa, socklen_t len, int flags)
+{
+    int s;
+    int on = 1;
+
+    if ((s = anetCreateSocket(err, sa->sa_family, flags)) == ANET_ERR)
+        return ANET_ERR;
+
+    if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == -1) {
+        anetSetError(err, "setsockopt SO_REUSEPORT: %s", strerror(errno));
+        anetCloseSocket(s);
+        return ANET_ERR;
+    }
+
+    if (anetListen(err, s, sa, len) == ANET_ERR)
+        return ANET_ERR;
+
+    return s;
+}
+/* UDP socket bound to the given address. For a multicast group address the
+ * socket joins the group on the default interface and only gets its datagrams. */
+int anetUdpBind(char *err, struct sockaddr *sa, socklen_t len, int flags)
+{
+    int s, on = 1;
+
+    if ((s = anetCreateTypedSocket(err, sa->sa_family, SOCK_DGRAM | flags)) == ANET_ERR)
+        return ANET_ERR;
+
+    if (sa->sa_family == AF_INET6)
+        setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on));
+
+    if (bind(s, sa, len) == -1) {
+        anetSetError(err, "bind: %s", strerror(errno));
+        anetCloseSocket(s);
+        return ANET_ERR;
+    }
+
+    int res = 0;
+    if (sa->sa_family == AF_INET && IN_MULTICAST(ntohl(((struct sockaddr_in *) sa)->sin_addr.s_addr))) {
+        struct ip_mreqn mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_multiaddr = ((struct sockaddr_in *) sa)->sin_addr;
+        mreq.imr_address.s_addr = htonl(INADDR_ANY);
+        res = setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    } else if (sa->sa_family == AF_INET6 && IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *) sa)->sin6_addr)) {
+        struct ipv6_mreq mreq;
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.ipv6mr_multiaddr = ((struct sockaddr_in6 *) sa)->sin6_addr;
+        res = setsockopt(s, IPPROTO_IPV6, IPV6_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+    if (res == -1) {
+        anetSetError(err, "joining multicast group: %s", strerror(errno));
+        anetCloseSocket(s);
+        return ANET_ERR;
+    }
+    return s;
+}
+
+/* UDP socket sending to the given address. ttl > 0 sets the TTL / hop limit
+ * of multicast datagrams. */
+int anetUdpConnect(char *err, struct sockaddr *sa, socklen_t len, int ttl, int flags)
+{
+    int s;
+
+    if ((s = anetCreateTypedSocket(err, sa->sa_family, SOCK_DGRAM | flags)) == ANET_ERR)
+        return ANET_ERR;
+
+    if (ttl > 0) {
+        int res;
+        if (sa->sa_family == AF_INET6)
+            res = setsockopt(s, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl));
+        else
+            res = setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        if (res == -1) {
+            anetSetError(err, "setsockopt multicast TTL: %s", strerror(errno));
+            anetCloseSocket(s);
+            return ANET_ERR;
+        }
+    }
+
+    if (connect(s, sa, len) == -1) {
+        anetSetError(err, "connect: %s", strerror(errno));
+        anetCloseSocket(s);
+        return ANET_ERR;
+    }
+    return s;
+}
+
+/* UDP sockets bound to the port on all addresses bindaddr resolves to, like anetTcpServer */
+int anetUdpServer(char *err, char *service, char *bindaddr, int *fds, int nfds, int flags)
+{
+    int s;
+    int i = 0;
+    struct addrinfo gai_hints;
+    struct addrinfo *gai_result, *p;
+    int gai_error;
+
+    memset(&gai_hints, 0, sizeof(gai_hints));
+    gai_hints.ai_family = AF_UNSPEC;
+    gai_hints.ai_socktype = SOCK_DGRAM;
+    gai_hints.ai_flags = AI_PASSIVE;
+
+    gai_error = getaddrinfo(bindaddr, service, &gai_hints, &gai_result);
+    if (gai_error != 0) {
+        anetSetError(err, "can't resolve %s: %s", bindaddr, gai_strerror(gai_error));
+        return ANET_ERR;
+    }
+
+    for (p = gai_result; p != NULL && i < nfds; p = p->ai_next) {
+        if ((s = anetUdpBind(err, p->ai_addr, p->ai_addrlen, flags)) == ANET_ERR)
+            continue;
+        fds[i++] = s;
+    }
+
+    freeaddrinfo(gai_result);
+    return (i > 0 ? i : ANET_ERR);
+}
+
 int anetUnixSocket(char *err, char *path, int flags)
 {
     int s;
@@ -72,6 +72,10 @@ int anetTcpNonBlockConnectAddr(char *err, struct addrinfo *p);
 int anetGetaddrinfo(char *err, char *addr, char *service, struct addrinfo **gai_result);
 int anetRead(int fd, char *buf, int count);
 int anetTcpServer(char *err, char *service, char *bindaddr, int *fds, int nfds, int flags);
+int anetTcpReusePortServer(char *err, struct sockaddr *sa, socklen_t len, int flags);
+int anetUdpBind(char *err, struct sockaddr *sa, socklen_t len, int flags);
+int anetUdpConnect(char *err, struct sockaddr *sa, socklen_t len, int ttl, int flags);
+int anetUdpServer(char *err, char *service, char *bindaddr, int *fds, int nfds, int flags);
 int anetUnixSocket(char *err, char *path, int flags);
 int anetGenericAccept(char *err, int s, struct sockaddr *sa, socklen_t *len, int flags);
 int anetWrite(int fd, char *buf, int count);
@@ -1,10 +1,22 @@
 #include "readsb.h"
 
+// minimum, the hash grows with the list to about one bucket per entry
 #define API_HASH_BITS (16)
-#define API_BUCKETS (1 << API_HASH_BITS)
 
-static inline uint32_t apiHash(uint32_t addr) {
-    return addrHash(addr, API_HASH_BITS);
+// keep-alive connections without a request or send progress for this long are closed
+#define API_IDLE_TIMEOUT (15 * SECONDS)
+// with more open connections per api thread, responses close the connection
+#define API_KEEPALIVE_MAX_FDS (256)
+#define API_REQUEST_MAX (60000)
+
+#define API_EVENTS_READ (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)
+#define API_EVENTS_WRITE (EPOLLOUT | EPOLLERR | EPOLLHUP)
+
+// same as aircraft.json.gz
+#define API_GZIP_LEVEL (3)
+
+static inline uint32_t apiHash(struct apiBuffer *buffer, uint32_t addr) {
+    return addrHash(addr, buffer->hashBits);
 }
 
 static int compareLon(const void *p1, const void *p2) {
@@ -17,95 +29,18 @@ static void apiSort(struct apiBuffer *buffer) {
     qsort(buffer->list, buffer->len, sizeof(struct apiEntry), compareLon);
 }
 
-static struct range findLonRange(int32_t ref_from, int32_t ref_to, struct apiEntry *list, int len) {
-    struct range res;
-    memset(&res, 0, sizeof(res));
-    if (len == 0 || ref_from > ref_to)
-        return res;
-
-    // get lower bound
-    int i = 0;
-    int j = len - 1;
-    while (j > i + 1) {
-
-        int pivot = (i + j) / 2;
-
-        if (list[pivot].lon < ref_from)
-            i = pivot;
-        else
-            j = pivot;
-    }
-
-    if (list[j].lon < ref_from) {
-        res.from = j + 1;
-    } else if (list[i].lon < ref_from) {
-        res.from = i + 1;
-    } else {
-        res.from = i;
-    }
-
-
-    // get upper bound (exclusive)
-    i = imin(res.from, len - 1);
-    j = len - 1;
-    while (j > i + 1) {
-
-        int pivot = (i + j) / 2;
-        if (list[pivot].lon <= ref_to)
-            i = pivot;
-        else
-            j = pivot;
-    }
-
-    if (list[j].lon <= ref_to) {
-        res.to = j + 1;
-    } else if (list[i].lon <= ref_to) {
-        res.to = i + 1;
-    } else {
-        res.to = i;
-    }
-
-    return res;
-}
-
-static int findInBox(struct apiBuffer *buffer, double *box, struct apiEntry *matches, size_t *alloc) {
-    struct range r[2];
-    memset(r, 0, sizeof(r));
-    int count = 0;
-
-    int32_t lat1 = (int32_t) (box[0] * 1E6);
-    int32_t lat2 = (int32_t) (box[1] * 1E6);
-    int32_t lon1 = (int32_t) (box[2] * 1E6);
-    int32_t lon2 = (int32_t) (box[3] * 1E6);
-
-    if (lon1 <= lon2) {
-        r[0] = findLonRange(lon1, lon2, buffer->list, buffer->len);
-    } else if (lon1 > lon2) {
-        r[0] = findLonRange(lon1, 180E6, buffer->list, buffer->len);
-        r[1] = findLonRange(-180E6, lon2, buffer->list, buffer->len);
-        //fprintf(stderr, "%.1f to 180 and -180 to %1.f\n", lon1 / 1E6, lon2 / 1E6);
-    }
-    for (int k = 0; k < 2; k++) {
-        for (int j = r[k].from; j < r[k].to; j++) {
-            struct apiEntry *e = &buffer->list[j];
-            if (e->lat >= lat1 && e->lat <= lat2) {
-                matches[count++] = *e;
-                *alloc += e->jsonOffset.len;
-            }
-        }
-    }
-    return count;
-}
-static int findHexList(struct apiBuffer *buffer, uint32_t *hexList, int hexCount, struct apiEntry *matches, size_t *alloc) {
+static int findHexList(struct apiBuffer *buffer, uint32_t *hexList, int hexCount, struct apiFilter *filter, struct apiEntry *matches, size_t *alloc) {
     int count = 0;
     for (int k = 0; k < hexCount; k++) {
         uint32_t addr = hexList[k];
-        uint32_t hash = apiHash(addr);
+        uint32_t hash = apiHash(buffer, addr);
         struct apiEntry *e = buffer->hashList[hash];
         while (e) {
             if (e->addr == addr) {
-                matches[count++] = *e;
-                *alloc += e->jsonOffset.len;
+                if (apiFilterEntry(filter, e)) {
+                    matches[count++] = *e;
+                    *alloc += e->jsonOffset.len;
+                }
                 break;
             }
             e = e->next;
@@ -113,101 +48,67 @@ static int findHexList(struct apiBuffer *buffer, uint32_t *hexList, int hexCount
     }
     return count;
 }
-static int findInCircle(struct apiBuffer *buffer, struct apiCircle *circle, struct apiEntry *matches, size_t *alloc) {
-    struct range r[2];
-    memset(r, 0, sizeof(r));
-    int count = 0;
-    double lat = circle->lat;
-    double lon = circle->lon;
-    double radius = circle->radius; // in meters
-    bool onlyClosest = circle->onlyClosest;
-
-    double circum = 40075e3; // earth circumference is 40075km
-    double fudge = 1.002; // make the box we check a little bigger
-
-    double latdiff = fudge * radius / (circum / 2) * 180.0;
-    double a1 = fmax(-90, lat - latdiff);
-    double a2 = fmin(90, lat + latdiff);
-    int32_t lat1 = (int32_t) (a1 * 1E6);
-    int32_t lat2 = (int32_t) (a2 * 1E6);
-
-    double londiff = fudge * radius / (cos(lat * M_PI / 180.0) * circum + 1) * 360;
-    londiff = fmin(londiff, 179.9999);
-    double o1 = lon - londiff;
-    double o2 = lon + londiff;
-    o1 = o1 < -180 ? o1 + 360: o1;
-    o2 = o2 > 180 ? o2 - 360 : o2;
-    int32_t lon1 = (int32_t) (o1 * 1E6);
-    int32_t lon2 = (int32_t) (o2 * 1E6);
-
-    //fprintf(stderr, "radius:%8.0f latdiff: %8.0f londiff: %8.0f\n", radius, greatcircle(a1, lon, lat, lon), greatcircle(lat, o1, lat, lon, 0));
-    if (lon1 <= lon2) {
-        r[0] = findLonRange(lon1, lon2, buffer->list, buffer->len);
-    } else if (lon1 > lon2) {
-        r[0] = findLonRange(lon1, 180E6, buffer->list, buffer->len);
-        r[1] = findLonRange(-180E6, lon2, buffer->list, buffer->len);
-        //fprintf(stderr, "%.1f to 180 and -180 to %1.f\n", lon1 / 1E6, lon2 / 1E6);
-    }
-    if (onlyClosest) {
-        bool found = false;
-        double minDistance = 300E6; // larger than any distances we encounter, also how far light travels in a second
-        for (int k = 0; k < 2; k++) {
-            for (int j = r[k].from; j < r[k].to; j++) {
-                struct apiEntry *e = &buffer->list[j];
-                if (e->lat >= lat1 && e->lat <= lat2) {
-                    double dist = greatcircle(lat, lon, e->lat / 1E6, e->lon / 1E6, 0);
-                    if (dist < radius && dist < minDistance) {
-                        // first match is overwritten repeatedly
-                        matches[count] = *e;
-                        *alloc += e->jsonOffset.len;
-                        matches[count].distance = (float) dist;
-                        minDistance = dist;
-                        found = true;
-                    }
-                }
-            }
-        }
-        if (found)
-            count = 1;
-    }
-    if (!onlyClosest) {
-        for (int k = 0; k < 2; k++) {
-            for (int j = r[k].from; j < r[k].to; j++) {
-                struct apiEntry *e = &buffer->list[j];
-                if (e->lat >= lat1 && e->lat <= lat2) {
-                    double dist = greatcircle(lat, lon, e->lat / 1E6, e->lon / 1E6, 0);
-                    if (dist < radius) {
-                        matches[count] = *e;
-                        matches[count].distance = (float) dist;
-                        *alloc += e->jsonOffset.len;
-                        count++;
-                    }
-                }
-            }
-        }
+// same layout as aircraft.binCraft: a header padded to the element size, then one binCraft per aircraft
+static struct char_buffer apiReqBinCraft(struct apiBuffer *buffer, struct apiEntry *matches, int count, double *box) {
+    struct char_buffer cb = { 0 };
+    uint32_t elementSize = sizeof(struct binCraft);
+    size_t alloc = API_REQ_PADSTART + (count + 1) * elementSize;
+
+    cb.buffer = aligned_malloc(alloc);
+    if (!cb.buffer)
+        return cb;
+
+    int16_t south = box ? floor(box[0]) : -90;
+    int16_t north = box ? ceil(box[1]) : 90;
+    int16_t west = box ? floor(box[2]) : -180;
+    int16_t east = box ? ceil(box[3]) : 180;
+
+    uint32_t index = 314159; // unnecessary
+    char *p = writeBinCraftHeader(cb.buffer + API_REQ_PADSTART, buffer->timestamp, index, south, west, north, east);
+    for (int i = 0; i < count; i++) {
+        memcpy(p, &buffer->bin[matches[i].binIndex], elementSize);
+        p += elementSize;
     }
-    return count;
+
+    cb.len = p - cb.buffer;
+    return cb;
 }
 
-static struct char_buffer apiReq(struct apiThread *thread, double *box, uint32_t *hexList, int hexCount, struct apiCircle *circle) {
+static struct apiBuffer *apiCurrentBuffer(struct apiThread *thread) {
     pthread_mutex_lock(&thread->mutex);
     int flip = Modes.apiFlip;
     pthread_mutex_unlock(&thread->mutex);
-    struct apiBuffer *buffer = &Modes.apiBuffer[flip];
+    return &Modes.apiBuffer[flip];
+}
+
+static int apiFind(struct apiBuffer *buffer, double *box, uint32_t *hexList, int hexCount, struct apiCircle *circle,
+        struct apiFilter *filter, struct apiEntry *matches, size_t *alloc) {
+    int count = 0;
+    if (box) {
+        count = apiFindInBox(buffer, box, filter, matches, alloc);
+    } else if (hexList) {
+        count = findHexList(buffer, hexList, hexCount, filter, matches, alloc);
+    } else if (circle) {
+        count = apiFindInCircle(buffer, circle, filter, matches, alloc);
+        *alloc += count * 20; // adding 15 characters per entry: ,"dst":1000.000
+    }
+    return count;
+}
+
+static struct char_buffer apiReq(struct apiThread *thread, double *box, uint32_t *hexList, int hexCount, struct apiCircle *circle,
+        struct apiFilter *filter, int binCraft) {
+    struct apiBuffer *buffer = apiCurrentBuffer(thread);
 
     struct char_buffer cb = { 0 };
     struct apiEntry *matches = aligned_malloc(buffer->len * sizeof(struct apiEntry));
 
     size_t alloc = API_REQ_PADSTART + 1024;
-    int count = 0;
+    int count = apiFind(buffer, box, hexList, hexCount, circle, filter, matches, &alloc);
 
-    if (box) {
-        count = findInBox(buffer, box, matches, &alloc);
-    } else if (hexList) {
-        count = findHexList(buffer, hexList, hexCount, matches, &alloc);
-    } else if (circle) {
-        count = findInCircle(buffer, circle, matches, &alloc);
-        alloc += count * 20; // adding 15 characters per entry: ,"dst":1000.000
+    if (binCraft) {
+        cb = apiReqBinCraft(buffer, matches, count, box);
+        sfree(matches);
+        return cb;
     }
 
     // add for comma and new line for each entry
@@ -257,9 +158,9 @@ static struct char_buffer apiReq(struct apiThread *thread, double *box, uint32_t
     return cb;
 }
 
-static inline void apiAdd(struct apiBuffer *buffer, struct aircraft *a, int64_t now) {
+static inline struct apiEntry *apiAdd(struct apiBuffer *buffer, struct aircraft *a, int64_t now) {
     if (!(now < a->seen + 5 * MINUTES || a->position_valid.source == SOURCE_JAERO))
-        return;
+        return NULL;
 
     struct apiEntry *entry = &(buffer->list[buffer->len]);
     memset(entry, 0, sizeof(struct apiEntry));
@@ -272,7 +173,7 @@ static inline void apiAdd(struct apiBuffer *buffer, struct aircraft *a, int64_t
         entry->lat = INT32_MAX;
         entry->lon = INT32_MAX;
     }
-    if (trackDataValid(&a->baro_alt_valid)) {
+    if (altBaroReliable(a)) {
         entry->alt = a->baro_alt;
     } else if (trackDataValid(&a->geom_alt_valid)) {
         entry->alt = a->geom_alt;
@@ -294,51 +195,284 @@ static inline void apiAdd(struct apiBuffer *buffer, struct aircraft *a, int64_t
     }
 
     buffer->len++;
+    return entry;
 }
 
-static inline void apiGenerateJson(struct apiBuffer *buffer, int64_t now) {
-    sfree(buffer->json);
-    buffer->json = NULL;
+static struct apiEntry *apiFindAddr(struct apiBuffer *buffer, uint32_t addr) {
+    struct apiEntry *e = buffer->hashList[apiHash(buffer, addr)];
+    while (e && e->addr != addr)
+        e = e->next;
+    return e;
+}
 
-    size_t alloc = buffer->len * 1024 + 4096; // The initial buffer is resized as needed
-    buffer->json = (char *) aligned_malloc(alloc);
-    char *p = buffer->json;
-    char *end = buffer->json + alloc;
+// print the seconds since t like sprintAircraftObject does
+static inline char *sprintSeen(char *p, char *end, int64_t t, int64_t now) {
+    return safe_snprintf(p, end, "%.1f", (now < t) ? 0 : ((now - t) / 1000.0));
+}
 
-    for (int i = 0; i < buffer->len; i++) {
-        if ((p + 2000) >= end) {
-            int used = p - buffer->json;
-            alloc *= 2;
-            buffer->json = (char *) realloc(buffer->json, alloc);
-            p = buffer->json + used;
-            end = buffer->json + alloc;
-        }
+// offset of the value after key in the JSON of an aircraft, 0 if key is missing
+static uint16_t valueOffset(char *start, char *p, const char *key) {
+    size_t keyLen = strlen(key);
+    char *found = memmem(start, p - start, key, keyLen);
+    if (!found)
+        return 0;
+    return found + keyLen - start;
+}
 
-        struct apiEntry *entry = &buffer->list[i];
-        struct aircraft *a = aircraftGet(entry->addr);
-        if (!a) {
-            fprintf(stderr, "apiGenerateJson: aircraft missing, this shouldn't happen.");
-            entry->jsonOffset.offset = 0;
-            entry->jsonOffset.len = 0;
+// copy the JSON of an unchanged aircraft from the previous buffer, only the
+// seen and seen_pos values change with time and are printed again
+static char *apiCopyJson(char *p, char *end, struct apiEntry *entry, struct apiEntry *old, char *oldJson, struct aircraft *a, int64_t now) {
+    char *from = oldJson + old->jsonOffset.offset;
+    char *oldEnd = from + old->jsonOffset.len;
+    char *start = p;
+
+    // seen_pos comes first
+    uint16_t offsets[2] = { old->seenPosOffset, old->seenOffset };
+    int64_t times[2] = { a->seenPosReliable, a->seen };
+    for (int k = 0; k < 2; k++) {
+        if (!offsets[k])
             continue;
+        char *value = oldJson + old->jsonOffset.offset + offsets[k];
+        memcpy(p, from, value - from);
+        p += value - from;
+        offsets[k] = p - start;
+        p = sprintSeen(p, end, times[k], now);
+        from = value;
+        while (from < oldEnd && *from != ',' && *from != '}')
+            from++;
+    }
+    memcpy(p, from, oldEnd - from);
+    p += oldEnd - from;
+
+    entry->seenPosOffset = offsets[0];
+    entry->seenOffset = offsets[1];
+    return p;
+}
+
+// the JSON buffer is kept for the next update, it grows as needed
+static void apiJsonReserve(struct apiBuffer *buffer, int count) {
+    size_t alloc = count * 1024 + 4096;
+    if (buffer->jsonAlloc < alloc) {
+        sfree(buffer->json);
+        buffer->json = (char *) aligned_malloc(alloc);
+        if (!buffer->json) {
+            fprintf(stderr, "apiJsonReserve alloc: out of memory!\n");
+            exit(1);
         }
+        buffer->jsonAlloc = alloc;
+    }
+    buffer->jsonLen = 0;
+}
 
-        uint32_t hash = apiHash(entry->addr);
+// JSON and binCraft of an entry right after apiAdd, while the aircraft is still in cache
+static inline void apiEntryJson(struct apiBuffer *buffer, struct apiBuffer *prev, struct apiEntry *entry, struct aircraft *a, int64_t now) {
+    if (buffer->jsonLen + 2000 >= buffer->jsonAlloc) {
+        buffer->jsonAlloc *= 2;
+        buffer->json = (char *) realloc(buffer->json, buffer->jsonAlloc);
+        if (!buffer->json) {
+            fprintf(stderr, "apiEntryJson alloc: out of memory!\n");
+            exit(1);
+        }
+    }
+    char *start = buffer->json + buffer->jsonLen;
+    char *end = buffer->json + buffer->jsonAlloc;
+    char *p = start;
+
+    // the list is sorted later, the binCraft stays in this order
+    entry->binIndex = entry - buffer->list;
+    struct binCraft *bin = &buffer->bin[entry->binIndex];
+
+    // the aircraft hasn't changed since the previous buffer was generated
+    struct apiEntry *old = prev ? apiFindAddr(prev, entry->addr) : NULL;
+    if (old && a->dirtyEpoch < prev->epoch && now < old->jsonExpires) {
+        p = apiCopyJson(p, end, entry, old, prev->json, a, now);
+        entry->jsonExpires = old->jsonExpires;
+        entry->jsonEpoch = old->jsonEpoch;
+        *bin = prev->bin[old->binIndex];
+        binCraftSeen(a, bin, now);
+    } else {
+        toBinCraft(a, bin, now);
+        p = sprintAircraftObject(p, end, a, now, 0, NULL);
+        entry->jsonExpires = aircraftJsonExpires(a, now);
+        entry->jsonEpoch = buffer->epoch;
+        entry->seenPosOffset = valueOffset(start, p, "\"seen_pos\":");
+        entry->seenOffset = valueOffset(start, p, ",\"seen\":");
+    }
+    if (p >= end) {
+        fprintf(stderr, "buffer full apiAdd\n");
+    }
+
+    entry->jsonOffset.offset = start - buffer->json;
+    entry->jsonOffset.len = p - start;
+    buffer->jsonLen = p - buffer->json;
+}
+
+// after the grid reordered the list
+static void apiHashBuild(struct apiBuffer *buffer) {
+    for (int i = 0; i < buffer->len; i++) {
+        struct apiEntry *entry = &buffer->list[i];
+        uint32_t hash = apiHash(buffer, entry->addr);
         entry->next = buffer->hashList[hash];
         buffer->hashList[hash] = entry;
+    }
+}
 
-        char *start = p;
-        p = sprintAircraftObject(p, end, a, now, 0, NULL);
 
-        entry->jsonOffset.offset = start - buffer->json;
-        entry->jsonOffset.len = p - start;
+static int compareAddr(const void *p1, const void *p2) {
+    struct apiEntry *a1 = (struct apiEntry*) p1;
+    struct apiEntry *a2 = (struct apiEntry*) p2;
+    return (a1->addr > a2->addr) - (a1->addr < a2->addr);
+}
+
+// server-sent event with the changes since the previous one: aircraft that
+// were added or printed again and the hex ids of the ones that are gone
+static struct char_buffer apiStreamEvent(struct apiThread *thread, struct apiStream *stream) {
+    struct apiBuffer *buffer = apiCurrentBuffer(thread);
+    struct char_buffer cb = { 0 };
+
+    size_t alloc = API_REQ_PADSTART + 1024;
+    struct apiEntry *matches = aligned_malloc((buffer->len + 1) * sizeof(struct apiEntry));
+    if (!matches)
+        return cb;
+    struct apiCircle *circle = stream->hasCircle ? &stream->circle : NULL;
+    int count = apiFind(buffer, stream->hasBox ? stream->box : NULL, stream->hexList, stream->hexCount, circle,
+            &stream->filter, matches, &alloc);
+    qsort(matches, count, sizeof(struct apiEntry), compareAddr);
+
+    // separators for each entry, hex ids of the removed ones
+    alloc += count * 2 + stream->addrCount * 12;
+
+    uint32_t *addrs = aligned_malloc((count + 1) * sizeof(uint32_t));
+    cb.buffer = aligned_malloc(alloc);
+    if (!addrs || !cb.buffer) {
+        sfree(matches);
+        sfree(addrs);
+        sfree(cb.buffer);
+        return cb;
     }
 
-    if (p >= end) {
-        fprintf(stderr, "buffer full apiAdd\n");
+    char *p = cb.buffer + API_REQ_PADSTART;
+    char *end = cb.buffer + alloc;
+
+    p = safe_snprintf(p, end, "data: {\"now\":%.1f,\"aircraft\":[", buffer->timestamp / 1000.0);
+
+    uint32_t *prev = stream->addrs;
+    int prevCount = stream->addrCount;
+    int n = 0;
+    int k = 0;
+    for (int i = 0; i < count; i++) {
+        struct apiEntry *e = &matches[i];
+        // a hexlist can name an aircraft twice
+        if (n > 0 && addrs[n - 1] == e->addr)
+            continue;
+        addrs[n++] = e->addr;
+
+        while (k < prevCount && prev[k] < e->addr)
+            k++;
+        if (k < prevCount && prev[k] == e->addr && e->jsonEpoch <= stream->epoch)
+            continue; // unchanged
+
+        struct offset off = e->jsonOffset;
+        if (off.len == 0)
+            continue;
+        if (p + off.len + 100 >= end) {
+            fprintf(stderr, "apiStreamEvent: need: %d alloc: %d\n", (int) ((p + off.len + 100) - cb.buffer), (int) alloc);
+            break;
+        }
+        memcpy(p, buffer->json + off.offset, off.len);
+        p += off.len;
+        if (circle) {
+            p--;
+            p = safe_snprintf(p, end, ",\"dst\":%.3f}", e->distance / 1852.0);
+        }
+        *p++ = ',';
     }
+    if (*(p - 1) == ',')
+        p--;
+    p = safe_snprintf(p, end, "],\"removed\":[");
+
+    int i = 0;
+    for (k = 0; k < prevCount; k++) {
+        while (i < n && addrs[i] < prev[k])
+            i++;
+        if (i < n && addrs[i] == prev[k])
+            continue;
+        p = safe_snprintf(p, end, "\"%s%06x\",", (prev[k] & MODES_NON_ICAO_ADDRESS) ? "~" : "", prev[k] & 0xFFFFFF);
+    }
+    if (*(p - 1) == ',')
+        p--;
+    p = safe_snprintf(p, end, "]}\n\n");
+
+    cb.len = p - cb.buffer;
+    if (cb.len >= alloc)
+        fprintf(stderr, "apiStreamEvent buffer insufficient\n");
+
+    sfree(matches);
+    sfree(stream->addrs);
+    stream->addrs = addrs;
+    stream->addrCount = n;
+    stream->epoch = buffer->epoch;
+    return cb;
+}
+
+// remember the query, the first event has all aircraft it matches
+static struct char_buffer apiSubscribe(struct apiThread *thread, struct apiStream *stream, double *box, uint32_t *hexList, int hexCount,
+        struct apiCircle *circle, struct apiFilter *filter) {
+    stream->filter = *filter;
+    if (box) {
+        memcpy(stream->box, box, sizeof(stream->box));
+        stream->hasBox = true;
+    } else if (hexList) {
+        stream->hexList = aligned_malloc(hexCount * sizeof(uint32_t));
+        if (!stream->hexList) {
+            struct char_buffer invalid = { 0 };
+            return invalid;
+        }
+        memcpy(stream->hexList, hexList, hexCount * sizeof(uint32_t));
+        stream->hexCount = hexCount;
+    } else if (circle) {
+        stream->circle = *circle;
+        stream->hasCircle = true;
+    }
+    return apiStreamEvent(thread, stream);
 }
 
+static void apiStreamFree(struct apiStream *stream) {
+    if (!stream)
+        return;
+    sfree(stream->hexList);
+    sfree(stream->addrs);
+    sfree(stream);
+}
+
+// make room for count entries, the allocations are reused by later updates
+static void apiBufferGrow(struct apiBuffer *buffer, int count) {
+    if (buffer->hashList && buffer->alloc >= count)
+        return;
+
+    // some headroom so a slowly growing aircraft count doesn't reallocate every update
+    buffer->alloc = count + count / 4 + 128;
+    sfree(buffer->list);
+    sfree(buffer->bin);
+    buffer->list = aligned_malloc(buffer->alloc * sizeof(struct apiEntry));
+    buffer->bin = aligned_malloc(buffer->alloc * sizeof(struct binCraft));
+
+    int hashBits = API_HASH_BITS;
+    while ((1 << hashBits) < buffer->alloc)
+        hashBits++;
+    if (!buffer->hashList || hashBits != buffer->hashBits) {
+        sfree(buffer->hashList);
+        buffer->hashBits = hashBits;
+        buffer->hashList = aligned_malloc((1 << hashBits) * sizeof(struct apiEntry*));
+        if (buffer->hashList)
+            memset(buffer->hashList, 0x0, (1 << hashBits) * sizeof(struct apiEntry*));
+    }
+
+    if (!buffer->list || !buffer->bin || !buffer->hashList) {
+        fprintf(stderr, "apiList alloc: out of memory!\n");
+        exit(1);
+    }
+}
 
 int apiUpdate(struct craftArray *ca) {
 
@@ -346,30 +480,26 @@ int apiUpdate(struct craftArray *ca) {
     int flip = (Modes.apiFlip + 1) % 2;
     struct apiBuffer *buffer = &Modes.apiBuffer[flip];
 
-    int acCount = ca->len;
-    buffer->len = 0;
-    if (buffer->len < acCount) {
-        if (acCount > 50000) {
-            fprintf(stderr, "api bailing, too many aircraft!\n");
-            buffer->len = 0;
-            return buffer->len;
-        }
-        buffer->alloc = acCount + 128;
-        sfree(buffer->list);
-        buffer->list = aligned_malloc(buffer->alloc * sizeof(struct apiEntry));
-        if (!buffer->list) {
-            fprintf(stderr, "apiList alloc: out of memory!\n");
-            exit(1);
+    // reset hashList to NULL, only the buckets of the previous entries can be set
+    if (buffer->hashList) {
+        for (int i = 0; i < buffer->len; i++) {
+            buffer->hashList[apiHash(buffer, buffer->list[i].addr)] = NULL;
         }
     }
 
-    // reset hashList to NULL
-    memset(buffer->hashList, 0x0, API_BUCKETS * sizeof(struct apiEntry*));
+    buffer->len = 0;
+    apiBufferGrow(buffer, ca->len);
 
-    // reset api list, just in case we don't set the entries completely due to oversight
-    memset(buffer->list, 0x0, buffer->alloc * sizeof(struct apiEntry));
+    // aircraft changed after this can't reuse their JSON from this buffer
+    buffer->epoch = ++Modes.apiEpoch;
 
     buffer->aircraftJsonCount = 0;
+    apiJsonReserve(buffer, ca->len);
+
+    // the other buffer, unless it was never filled
+    struct apiBuffer *prev = &Modes.apiBuffer[Modes.apiFlip];
+    if (!prev->epoch)
+        prev = NULL;
 
     int64_t now = mstime();
     for (int i = 0; i < ca->len; i++) {
@@ -378,12 +508,14 @@ int apiUpdate(struct craftArray *ca) {
         if (a == NULL)
             continue;
 
-        apiAdd(buffer, a, now);
+        struct apiEntry *entry = apiAdd(buffer, a, now);
+        if (entry)
+            apiEntryJson(buffer, prev, entry, a, now);
     }
 
     apiSort(buffer);
-
-    apiGenerateJson(buffer, now);
+    apiGridBuild(buffer);
+    apiHashBuild(buffer);
 
     buffer->timestamp = now;
 
@@ -396,6 +528,15 @@ int apiUpdate(struct craftArray *ca) {
     pthread_mutex_unlock(&Modes.apiFlipMutex);
     apiUnlockMutex();
 
+    // api threads send the stream events
+    uint64_t one = 1;
+    for (int i = 0; i < API_THREADS; i++) {
+        if (Modes.apiThread[i].eventfd > 0) {
+            ssize_t res = write(Modes.apiThread[i].eventfd, &one, sizeof(one));
+            MODES_NOTUSED(res);
+        }
+    }
+
     pthread_cond_signal(&Threads.json.cond);
     pthread_cond_signal(&Threads.globeJson.cond);
 
@@ -428,10 +569,32 @@ static void apiCloseConn(struct apiCon *con, struct apiThread *thread) {
 
     if (Modes.debug_api)
         fprintf(stderr, "%d: clo c: %d\n", thread->index, fd);
+
+    if (con->prev)
+        con->prev->next = con->next;
+    else
+        thread->cons = con->next;
+    if (con->next)
+        con->next->prev = con->prev;
+    thread->openFDs--;
+
+    sfree(con->cb.buffer);
     sfree(con->request.buffer);
+    apiStreamFree(con->stream);
     sfree(con);
 }
 
+static void apiSetEvents(struct apiCon *con, struct apiThread *thread, uint32_t events) {
+    if (con->events == events)
+        return;
+    con->events = events;
+    struct epoll_event epollEvent = { .events = con->events };
+    epollEvent.data.ptr = con;
+
+    if (epoll_ctl(thread->epfd, EPOLL_CTL_MOD, con->fd, &epollEvent))
+        perror("epoll_ctl MOD fail:");
+}
+
 static void send400(int fd) {
     char buf[256];
     char *p = buf;
@@ -447,6 +610,24 @@ static void send400(int fd) {
     MODES_NOTUSED(res);
 }
 
+static void apiCloseIdle(struct apiThread *thread, int64_t now) {
+    struct apiCon *next;
+    for (struct apiCon *con = thread->cons; con; con = next) {
+        next = con->next;
+        // streams waiting for the next api update aren't idle
+        if (con->stream && !con->cb.buffer)
+            continue;
+        if (now - con->lastActivity > API_IDLE_TIMEOUT) {
+            if (Modes.debug_api)
+                fprintf(stderr, "%d: idle c: %d\n", thread->index, con->fd);
+            // an incomplete request doesn't go unanswered
+            if (con->request.len && !con->cb.buffer)
+                send400(con->fd);
+            apiCloseConn(con, thread);
+        }
+    }
+}
+
 static int parseDoubles(char *p, double *results, int max) {
     char *saveptr = NULL;
     char *endptr = NULL;
@@ -461,9 +642,109 @@ static int parseDoubles(char *p, double *results, int max) {
     return count;
 }
 
-static struct char_buffer parseFetch(struct char_buffer *request, struct apiThread *thread) {
+// the query parameter name or name= in the request line, NULL if it's not there.
+// Returns the value and its length, the value of name without = is empty.
+// Only whole parameter names of the query match.
+static char *queryArg(char *req, char *name, int *len) {
+    char *p = strchr(req, '?');
+    if (!p)
+        return NULL;
+    char *end = p + strcspn(p, " \r\n");
+    int nameLen = strlen(name);
+    while (p < end) {
+        p++; // skip the ? or &
+        char *next = memchr(p, '&', end - p);
+        if (!next)
+            next = end;
+        if (next - p >= nameLen && !strncasecmp(p, name, nameLen)) {
+            char *value = p + nameLen;
+            if (value == next || *value == '=') {
+                if (value < next)
+                    value++;
+                if (len)
+                    *len = next - value;
+                return value;
+            }
+        }
+        p = next;
+    }
+    return NULL;
+}
+
+// the value of the query parameter name= in the request line and its length,
+// NULL if it's not there or has no =
+static char *queryParam(char *req, char *name, int *len) {
+    int valueLen;
+    char *value = queryArg(req, name, &valueLen);
+    if (!value || value[-1] != '=')
+        return NULL;
+    if (len)
+        *len = valueLen;
+    return value;
+}
+
+// &minAlt= &maxAlt= &type= and the database flags, returns false on invalid values
+static bool parseFilter(char *req, struct apiFilter *filter) {
+    memset(filter, 0, sizeof(struct apiFilter));
+    filter->minAlt = INT32_MIN;
+    // unknown altitudes are INT32_MAX, they don't pass an altitude filter
+    filter->maxAlt = INT32_MAX - 1;
+
+    char *names[2] = { "minAlt", "maxAlt" };
+    int32_t *bounds[2] = { &filter->minAlt, &filter->maxAlt };
+    for (int i = 0; i < 2; i++) {
+        char *p = queryParam(req, names[i], NULL);
+        if (!p)
+            continue;
+        char *endptr = NULL;
+        long value = strtol(p, &endptr, 10);
+        if (p == endptr || value <= INT32_MIN || value >= INT32_MAX - 1)
+            return false;
+        *bounds[i] = (int32_t) value;
+        filter->hasAlt = true;
+    }
+
+    char *p = queryParam(req, "type", NULL);
+    if (p) {
+        char types[API_FILTER_TYPES * 5 + 1];
+        int len = imin(strcspn(p, "& "), sizeof(types) - 1);
+        memcpy(types, p, len);
+        types[len] = '\0';
+
+        char *saveptr = NULL;
+        char *tok = strtok_r(types, ",", &saveptr);
+        while (tok && filter->typeCount < API_FILTER_TYPES) {
+            // same layout as typeCode: up to 4 characters, zero padded
+            char code[4] = { 0 };
+            if (strlen(tok) > sizeof(code))
+                return false;
+            for (int k = 0; tok[k]; k++)
+                code[k] = toupper(tok[k]);
+            memcpy(&filter->types[filter->typeCount++], code, sizeof(uint32_t));
+            tok = strtok_r(NULL, ",", &saveptr);
+        }
+        if (filter->typeCount == 0)
+            return false;
+    }
+
+    // dbFlags bits, 1 requires the flag, 0 requires it to be absent
+    char *flags[4] = { "mil", "interesting", "pia", "ladd" };
+    for (int i = 0; i < 4; i++) {
+        p = queryParam(req, flags[i], NULL);
+        if (!p)
+            continue;
+        if (*p != '0' && *p != '1')
+            return false;
+        filter->dbFlagsMask |= 1 << i;
+        if (*p == '1')
+            filter->dbFlagsWant |= 1 << i;
+    }
+    return true;
+}
+
+static struct char_buffer parseFetch(struct char_buffer *request, struct apiThread *thread, int binCraft, struct apiStream *stream) {
     struct char_buffer invalid = { 0 };
-    char *p, *needle, *eot;
+    char *p, *eot;
     char *saveptr;
 
     char *req = request->buffer;
@@ -473,11 +754,13 @@ static struct char_buffer parseFetch(struct char_buffer *request, struct apiThre
     // we only want the first line
     *eol = '\0';
 
-    needle = "?box=";
-    p = strcasestr(req, needle);
-    if (p) {
-        p += strlen(needle);
+    // before the query parsing below cuts the line after its value
+    struct apiFilter filter;
+    if (!parseFilter(req, &filter))
+        return invalid;
 
+    p = queryParam(req, "box", NULL);
+    if (p) {
         eot = strchr(p, '&');
         if (eot) *eot = '\0';
 
@@ -493,13 +776,12 @@ static struct char_buffer parseFetch(struct char_buffer *request, struct apiThre
         if (box[0] > box[1])
             return invalid;
 
-        return apiReq(thread, box, NULL, 0, NULL);
+        if (stream)
+            return apiSubscribe(thread, stream, box, NULL, 0, NULL, &filter);
+        return apiReq(thread, box, NULL, 0, NULL, &filter, binCraft);
     }
-    needle = "?hexlist=";
-    p = strcasestr(req, needle);
+    p = queryParam(req, "hexlist", NULL);
     if (p) {
-        p += strlen(needle);
-
         eot = strchr(p, '&');
         if (eot) *eot = '\0';
 
@@ -518,20 +800,18 @@ static struct char_buffer parseFetch(struct char_buffer *request, struct apiThre
         }
         if (hexCount == 0)
             return invalid;
-        return apiReq(thread, NULL, hexList, hexCount, NULL);
+        if (stream)
+            return apiSubscribe(thread, stream, NULL, hexList, hexCount, NULL, &filter);
+        return apiReq(thread, NULL, hexList, hexCount, NULL, &filter, binCraft);
     }
-    needle = "?circle=";
-    p = strcasestr(req, needle);
+    p = queryParam(req, "circle", NULL);
     bool onlyClosest = false;
     if (!p) {
-        needle = "?closest=";
-        p = strcasestr(req, needle);
+        p = queryParam(req, "closest", NULL);
         if (p)
             onlyClosest = true;
     }
     if (p) {
-        p += strlen(needle);
-
         eot = strchr(p, '&');
         if (eot) *eot = '\0';
 
@@ -553,12 +833,16 @@ static struct char_buffer parseFetch(struct char_buffer *request, struct apiThre
 
         circle.onlyClosest = onlyClosest;
 
-        return apiReq(thread, NULL, NULL, 0, &circle);
+        if (stream)
+            return apiSubscribe(thread, stream, NULL, NULL, 0, &circle, &filter);
+        return apiReq(thread, NULL, NULL, 0, &circle, &filter, binCraft);
     }
     return invalid;
 }
 
-static void apiSendData(struct apiCon *con, struct apiThread *thread) {
+// returns 1 when the response is sent and the connection stays open,
+// 0 while it's still being sent and -1 when the connection was closed
+static int apiSendData(struct apiCon *con, struct apiThread *thread) {
     struct char_buffer *cb = &con->cb;
     int len = cb->len - con->cbOffset;
     char *dataStart = cb->buffer + con->cbOffset;
@@ -569,19 +853,16 @@ static void apiSendData(struct apiCon *con, struct apiThread *thread) {
     if ((nwritten >= 0 && nwritten < len) || (nwritten < 0 && (err == EAGAIN || err == EWOULDBLOCK))) {
         //fprintf(stderr, "wrote only %d of %d\n", nwritten, len);
 
-        con->cbOffset += nwritten;
-
-        if (!(con->events & EPOLLOUT)) {
-            // notify if fd is available for writing
-            con->events ^= EPOLLOUT; // toggle xor
-            struct epoll_event epollEvent = { .events = con->events };
-            epollEvent.data.ptr = con;
-
-            if (epoll_ctl(thread->epfd, EPOLL_CTL_MOD, con->fd, &epollEvent))
-                perror("epoll_ctl MOD fail:");
+        if (nwritten > 0) {
+            con->cbOffset += nwritten;
+            con->lastActivity = mstime();
         }
 
-        return;
+        // notify if fd is available for writing, pipelined requests wait
+        // in the socket until this response is out
+        apiSetEvents(con, thread, API_EVENTS_WRITE);
+
+        return 0;
         // free stuff some other time
     }
 
@@ -592,40 +873,370 @@ static void apiSendData(struct apiCon *con, struct apiThread *thread) {
     if (nwritten < 0) {
         fprintf(stderr, "apiSendData fail: %s (was trying to send %d bytes)\n", strerror(err), len);
         apiCloseConn(con, thread);
-        return;
+        return -1;
     }
 
-    apiCloseConn(con, thread);
-    return;
+    if (!con->keepAlive) {
+        apiCloseConn(con, thread);
+        return -1;
+    }
 
-    // doing one request per connection for the moment, keep-alive maybe later
-    if (con->events & EPOLLOUT) {
-        // no more writing necessary for the moment, no longer get notified for EPOLLOUT
-        con->events ^= EPOLLOUT; // toggle xor
-        struct epoll_event epollEvent = { .events = con->events };
-        epollEvent.data.ptr = con;
+    con->lastActivity = mstime();
+    apiSetEvents(con, thread, API_EVENTS_READ);
+    return 1;
+}
 
-        if (epoll_ctl(thread->epfd, EPOLL_CTL_MOD, con->fd, &epollEvent))
-            perror("epoll_ctl MOD fail:");
+// length of the request line and headers including the empty line ending them, 0 if incomplete
+static int requestHeadLen(char *buf, int len) {
+    char *p = buf;
+    char *end = buf + len;
+    char *eol;
+    while ((eol = memchr(p, '\n', end - p))) {
+        if (eol == p || (eol == p + 1 && *p == '\r'))
+            return eol + 1 - buf;
+        p = eol + 1;
     }
+    return 0;
+}
 
-    return;
+// value of a request header, NULL if it's not there, head must be NUL terminated
+static char *findHeader(char *head, const char *name) {
+    int len = strlen(name);
+    for (char *p = strchr(head, '\n'); p; p = strchr(p + 1, '\n')) {
+        if (strncasecmp(p + 1, name, len) == 0 && p[1 + len] == ':') {
+            p += 2 + len;
+            while (*p == ' ' || *p == '\t')
+                p++;
+            return p;
+        }
+    }
+    return NULL;
 }
 
-static void apiReadRequest(struct apiCon *con, struct apiThread *thread) {
-    int nread, err, toRead;
-    int fd = con->fd;
+static int wantsKeepAlive(char *head) {
+    char *eol = strchr(head, '\n');
+    // persistent by default with HTTP/1.1, HTTP/1.0 clients have to ask
+    int keepAlive = eol && memmem(head, eol - head, " HTTP/1.1", 9) != NULL;
+    char *value = findHeader(head, "Connection");
+    if (value) {
+        if (strncasecmp(value, "close", 5) == 0)
+            keepAlive = 0;
+        else if (strncasecmp(value, "keep-alive", 10) == 0)
+            keepAlive = 1;
+    }
+    return keepAlive;
+}
+
+// &stream in the request line: subscribe to the changes of the query
+static int wantsStream(char *head) {
+    return queryArg(head, "stream", NULL) != NULL;
+}
+
+// &format=binCraft in the request line
+static int wantsBinCraft(char *head) {
+    int len;
+    char *format = queryParam(head, "format", &len);
+    return format && len == 8 && !strncasecmp(format, "binCraft", len);
+}
+
+// the encoding to use for the response, gzip is preferred
+static enum apiEncoding acceptedEncoding(char *head) {
+    enum apiEncoding encoding = API_ENCODING_IDENTITY;
+    char *value = findHeader(head, "Accept-Encoding");
+    if (!value)
+        return encoding;
+    char *eol = value + strcspn(value, "\r\n");
+    for (char *p = value; p < eol; p++) {
+        char *next = memchr(p, ',', eol - p);
+        if (!next)
+            next = eol;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        int len = strcspn(p, " \t;,\r\n");
+        // q=0 means not acceptable
+        char *q = memmem(p, next - p, "q=", 2);
+        if (!q || strtod(q + 2, NULL) > 0) {
+            if (len == 4 && strncasecmp(p, "gzip", 4) == 0)
+                return API_ENCODING_GZIP;
+            if (len == 7 && strncasecmp(p, "deflate", 7) == 0)
+                encoding = API_ENCODING_DEFLATE;
+        }
+        p = next;
+    }
+    return encoding;
+}
+
+// compress the response after API_REQ_PADSTART, keeps it uncompressed and returns 0 on failure
+static int apiCompress(struct char_buffer *cb, enum apiEncoding encoding) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // 16 added to the window bits writes a gzip header and trailer instead of the zlib ones
+    int windowBits = (encoding == API_ENCODING_GZIP) ? 15 + 16 : 15;
+    if (deflateInit2(&zs, API_GZIP_LEVEL, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+
+    size_t plen = cb->len - API_REQ_PADSTART;
+    size_t alloc = API_REQ_PADSTART + deflateBound(&zs, plen);
+    char *out = aligned_malloc(alloc);
+    if (!out) {
+        deflateEnd(&zs);
+        return 0;
+    }
+
+    zs.next_in = (Bytef *) cb->buffer + API_REQ_PADSTART;
+    zs.avail_in = plen;
+    zs.next_out = (Bytef *) out + API_REQ_PADSTART;
+    zs.avail_out = alloc - API_REQ_PADSTART;
+    int res = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    if (res != Z_STREAM_END) {
+        sfree(out);
+        return 0;
+    }
+
+    sfree(cb->buffer);
+    cb->buffer = out;
+    cb->len = API_REQ_PADSTART + zs.total_out;
+    cb->alloc = alloc;
+    return 1;
+}
+
+// epoch of the apiBuffer requests are currently answered from
+static uint32_t apiCurrentEpoch(struct apiThread *thread) {
+    return apiCurrentBuffer(thread)->epoch;
+}
+
+// copy of a cached response, cb.len is 0 if there is none
+static struct char_buffer apiCacheGet(struct apiThread *thread, char *key, int keyLen, enum apiEncoding encoding, uint32_t epoch) {
+    struct char_buffer cb = { 0 };
+    for (int i = 0; i < API_CACHE_ENTRIES; i++) {
+        struct apiCacheEntry *entry = &thread->cache[i];
+        if (entry->epoch != epoch || entry->encoding != encoding
+                || entry->keyLen != keyLen || memcmp(entry->key, key, keyLen) != 0) {
+            continue;
+        }
+        cb.buffer = aligned_malloc(entry->cb.len);
+        if (!cb.buffer)
+            return cb;
+        memcpy(cb.buffer, entry->cb.buffer, entry->cb.len);
+        cb.len = entry->cb.len;
+        cb.alloc = entry->cb.len;
+        return cb;
+    }
+    return cb;
+}
+
+static void apiCachePut(struct apiThread *thread, char *key, int keyLen, enum apiEncoding encoding, uint32_t epoch, struct char_buffer *cb) {
+    // responses of an older apiBuffer are dropped, their slots are used first
+    struct apiCacheEntry *slot = NULL;
+    for (int i = 0; i < API_CACHE_ENTRIES; i++) {
+        struct apiCacheEntry *entry = &thread->cache[i];
+        if (entry->epoch != epoch) {
+            sfree(entry->cb.buffer);
+            entry->epoch = 0;
+            if (!slot)
+                slot = entry;
+        }
+    }
+    if (!slot) {
+        slot = &thread->cache[thread->cacheNext];
+        thread->cacheNext = (thread->cacheNext + 1) % API_CACHE_ENTRIES;
+        sfree(slot->cb.buffer);
+    }
+
+    slot->cb.buffer = aligned_malloc(cb->len);
+    if (!slot->cb.buffer) {
+        slot->epoch = 0;
+        return;
+    }
+    memcpy(slot->cb.buffer, cb->buffer, cb->len);
+    slot->cb.len = cb->len;
+    slot->epoch = epoch;
+    slot->encoding = encoding;
+    slot->keyLen = keyLen;
+    memcpy(slot->key, key, keyLen);
+}
+
+static void apiCacheFree(struct apiThread *thread) {
+    for (int i = 0; i < API_CACHE_ENTRIES; i++) {
+        sfree(thread->cache[i].cb.buffer);
+    }
+    sfree(thread->cache);
+}
 
+// answer the complete requests in the buffer in order, a pipelined request
+// is only parsed once the response before it has been sent
+static void apiProcessRequests(struct apiCon *con, struct apiThread *thread) {
     struct char_buffer *request = &con->request;
-    do {
-        if (request->len > 60000) {
+    int fd = con->fd;
+
+    while (!con->cb.buffer) {
+        if (con->stream) {
+            // a subscribed client has nothing more to ask
+            request->len = 0;
+            if (con->eof)
+                apiCloseConn(con, thread);
+            return;
+        }
+
+        // empty lines between requests are allowed
+        size_t skip = 0;
+        while (skip < request->len && (request->buffer[skip] == '\r' || request->buffer[skip] == '\n'))
+            skip++;
+        if (skip) {
+            request->len -= skip;
+            memmove(request->buffer, request->buffer + skip, request->len + 1);
+        }
+
+        int headLen = requestHeadLen(request->buffer, request->len);
+        if (!headLen && con->eof && request->len) {
+            // the client is done without the empty line ending the head,
+            // answer a complete request line, a partial one gets a 400
+            if (!memchr(request->buffer, '\n', request->len)) {
+                send400(fd);
+                apiCloseConn(con, thread);
+                return;
+            }
+            headLen = request->len;
+        }
+        if (!headLen) {
+            if (request->len > API_REQUEST_MAX) {
+                send400(fd);
+                apiCloseConn(con, thread);
+            } else if (con->eof) {
+                apiCloseConn(con, thread);
+            }
+            // otherwise wait for more data
+            return;
+        }
+
+        char *head = request->buffer;
+        char saved = head[headLen];
+        head[headLen] = '\0';
+
+        // request bodies aren't used, they still need to be skipped to find the next request
+        char *value = findHeader(head, "Content-Length");
+        int bodyLen = value ? atoi(value) : 0;
+        if (bodyLen < 0 || bodyLen > API_REQUEST_MAX) {
             send400(fd);
             apiCloseConn(con, thread);
             return;
         }
+        if ((size_t) (headLen + bodyLen) > request->len) {
+            head[headLen] = saved;
+            if (con->eof)
+                apiCloseConn(con, thread);
+            return;
+        }
+
+        int keepAlive = wantsKeepAlive(head) && thread->openFDs <= API_KEEPALIVE_MAX_FDS;
+        enum apiEncoding encoding = acceptedEncoding(head);
+        int binCraft = wantsBinCraft(head);
+        struct apiStream *stream = NULL;
+        if (keepAlive && wantsStream(head)) {
+            stream = aligned_malloc(sizeof(struct apiStream));
+            if (!stream) {
+                fprintf(stderr, "apiStream alloc: out of memory!\n");
+                exit(1);
+            }
+            memset(stream, 0, sizeof(struct apiStream));
+        }
+
+        //fprintf(stderr, "%s\n", head);
+
+        // the request line is the cache key, parseFetch modifies it
+        char key[API_CACHE_KEY_MAX];
+        int keyLen = strcspn(head, "\r\n");
+        uint32_t epoch = apiCurrentEpoch(thread);
+        int cacheable = keyLen <= API_CACHE_KEY_MAX && epoch != 0 && !stream;
+        struct char_buffer cb = { 0 };
+        if (cacheable) {
+            memcpy(key, head, keyLen);
+            cb = apiCacheGet(thread, key, keyLen, encoding, epoch);
+        }
+        if (stream) {
+            struct char_buffer line = { .buffer = head, .len = headLen };
+            cb = parseFetch(&line, thread, 0, stream);
+        } else if (!cb.len) {
+            struct char_buffer line = { .buffer = head, .len = headLen };
+            cb = parseFetch(&line, thread, binCraft, NULL);
+            if (cb.len && encoding != API_ENCODING_IDENTITY && !apiCompress(&cb, encoding))
+                encoding = API_ENCODING_IDENTITY;
+            if (cb.len && cacheable)
+                apiCachePut(thread, key, keyLen, encoding, epoch, &cb);
+        }
+        head[headLen] = saved;
+
+        // drop the request, keep what was pipelined after it
+        int used = headLen + bodyLen;
+        request->len -= used;
+        memmove(request->buffer, request->buffer + used, request->len);
+        request->buffer[request->len] = '\0';
+
+        if (cb.len == 0) {
+            apiStreamFree(stream);
+            send400(fd);
+            apiCloseConn(con, thread);
+            return;
+        }
+
+        // at header before payload
+        char header[API_REQ_PADSTART];
+        char *p = header;
+        char *end = header + API_REQ_PADSTART;
+
+        int plen = cb.len - API_REQ_PADSTART;
+
+        if (stream) {
+            // events follow until the client disconnects, no length
+            p = safe_snprintf(p, end,
+                    "HTTP/1.1 200 OK\r\n"
+                    "Server: readsb/3.1442\r\n"
+                    "Connection: keep-alive\r\n"
+                    "Content-Type: text/event-stream\r\n"
+                    "Cache-Control: no-cache\r\n\r\n");
+            con->stream = stream;
+        } else {
+            p = safe_snprintf(p, end,
+                    "HTTP/1.1 200 OK\r\n"
+                    "Server: readsb/3.1442\r\n"
+                    "Connection: %s\r\n"
+                    "Content-Type: %s\r\n"
+                    "Vary: Accept-Encoding\r\n",
+                    keepAlive ? "keep-alive" : "close",
+                    binCraft ? "application/octet-stream" : "application/json");
+            if (encoding != API_ENCODING_IDENTITY)
+                p = safe_snprintf(p, end, "Content-Encoding: %s\r\n", encoding == API_ENCODING_GZIP ? "gzip" : "deflate");
+            p = safe_snprintf(p, end, "Content-Length: %d\r\n\r\n", plen);
+        }
+
+        int hlen = p - header;
+        if (hlen == API_REQ_PADSTART)
+            fprintf(stderr, "API_REQ_PADSTART insufficient\n");
+
+        con->cbOffset = API_REQ_PADSTART - hlen;
+        memcpy(cb.buffer + con->cbOffset, header, hlen);
+
+        con->cb = cb;
+        con->keepAlive = keepAlive;
+        if (apiSendData(con, thread) < 0)
+            return;
+    }
+}
+
+static void apiReadRequest(struct apiCon *con, struct apiThread *thread) {
+    int nread, err, toRead;
+    int fd = con->fd;
+
+    struct char_buffer *request = &con->request;
+    do {
         if (request->len + 2048 > request->alloc) {
             request->alloc += 4096;
             request->buffer = realloc(request->buffer, request->alloc);
+            if (!request->buffer) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
         }
         toRead = request->alloc - request->len - 1; // leave an extra byte we can set \0
         nread = recv(fd, request->buffer + request->len, toRead, 0);
@@ -636,56 +1247,21 @@ static void apiReadRequest(struct apiCon *con, struct apiThread *thread) {
             // terminate string
             request->buffer[request->len] = '\0';
         }
-    } while (nread == toRead);
-
-    if (nread == 0 || (nread < 0 && (err != EAGAIN && err != EWOULDBLOCK))) {
-        apiCloseConn(con, thread);
-        return;
-    }
-
-    // we already have a response that hasn't been sent yet, discard request.
-    if (con->cb.buffer)
-        return;
-
-    if (!memchr(request->buffer, '\n', request->len)) {
-        // no newline, wait for more data
-        return;
-    }
-
-    //fprintf(stderr, "%s\n", req);
+        // anything beyond the limit stays in the socket until the buffered requests are answered
+    } while (nread == toRead && request->len <= API_REQUEST_MAX);
 
-    struct char_buffer cb = parseFetch(request, thread);
-    if (cb.len == 0) {
-        send400(fd);
+    if (nread == 0) {
+        // the client is done sending, answer what it pipelined before closing
+        con->eof = 1;
+    } else if (nread < 0 && (err != EAGAIN && err != EWOULDBLOCK)) {
         apiCloseConn(con, thread);
         return;
     }
 
-    // at header before payload
-    char header[API_REQ_PADSTART];
-    char *p = header;
-    char *end = header + API_REQ_PADSTART;
-
-    int plen = cb.len - API_REQ_PADSTART;
-
-    p = safe_snprintf(p, end,
-            "HTTP/1.1 200 OK\r\n"
-            "Server: readsb/3.1442\r\n"
-            "Connection: close\r\n"
-            "Content-Type: application/json\r\n"
-            "Content-Length: %d\r\n\r\n",
-            plen);
-
-    int hlen = p - header;
-    if (hlen == API_REQ_PADSTART)
-        fprintf(stderr, "API_REQ_PADSTART insufficient\n");
-
-    con->cbOffset = API_REQ_PADSTART - hlen;
-    memcpy(cb.buffer + con->cbOffset, header, hlen);
-
-    con->cb = cb;
-    apiSendData(con, thread);
+    con->lastActivity = mstime();
+    apiProcessRequests(con, thread);
 }
+
 static void acceptConn(struct apiCon *con, struct apiThread *thread) {
     int listen_fd = con->fd;
     struct sockaddr_storage storage;
@@ -701,10 +1277,17 @@ static void acceptConn(struct apiCon *con, struct apiThread *thread) {
         if (!con) fprintf(stderr, "EMEM, how much is the fish?\n"), exit(1);
 
         con->fd = fd;
-        con->events = EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP;
+        con->events = API_EVENTS_READ;
+        con->lastActivity = mstime();
         struct epoll_event epollEvent = { .events = con->events };
         epollEvent.data.ptr = con;
 
+        con->next = thread->cons;
+        if (con->next)
+            con->next->prev = con;
+        thread->cons = con;
+        thread->openFDs++;
+
 
         if (Modes.debug_api)
             fprintf(stderr, "%d: new c: %d\n", thread->index, fd);
@@ -722,12 +1305,41 @@ static void acceptConn(struct apiCon *con, struct apiThread *thread) {
     }
 }
 
+// next event for every stream that isn't still sending the previous one
+static void apiStreamUpdate(struct apiThread *thread) {
+    struct apiCon *next;
+    for (struct apiCon *con = thread->cons; con; con = next) {
+        next = con->next;
+        if (!con->stream || con->cb.buffer)
+            continue;
+        struct char_buffer cb = apiStreamEvent(thread, con->stream);
+        if (!cb.len)
+            continue;
+        con->cb = cb;
+        con->cbOffset = API_REQ_PADSTART;
+        apiSendData(con, thread);
+    }
+}
+
 static void *apiThreadEntryPoint(void *arg) {
     struct apiThread *thread = (struct apiThread *) arg;
     srandom(get_seed());
 
     thread->epfd = my_epoll_create();
 
+    // apiUpdate signals new buffers for the streams
+    struct epoll_event wakeEvent = { .events = EPOLLIN };
+    wakeEvent.data.ptr = &thread->eventfd;
+    if (epoll_ctl(thread->epfd, EPOLL_CTL_ADD, thread->eventfd, &wakeEvent))
+        perror("epoll_ctl fail:");
+
+    thread->cache = aligned_malloc(API_CACHE_ENTRIES * sizeof(struct apiCacheEntry));
+    if (!thread->cache) {
+        fprintf(stderr, "apiCache alloc: out of memory!\n");
+        exit(1);
+    }
+    memset(thread->cache, 0, API_CACHE_ENTRIES * sizeof(struct apiCacheEntry));
+
     for (int i = 0; i < Modes.apiService.listener_count; ++i) {
         struct apiCon *con = Modes.apiListeners[i];
         struct epoll_event epollEvent = { .events = con->events };
@@ -744,6 +1356,7 @@ static void *apiThreadEntryPoint(void *arg) {
     struct timespec cpu_timer;
     start_cpu_timing(&cpu_timer);
     uint32_t loop = 0;
+    int64_t nextIdleCheck = 0;
     while (!Modes.exit) {
         if (count == maxEvents) {
             epollAllocEvents(&events, &maxEvents);
@@ -762,27 +1375,51 @@ static void *apiThreadEntryPoint(void *arg) {
             if (event.data.ptr == &Modes.exitEventfd)
                 break;
 
+            if (event.data.ptr == &thread->eventfd) {
+                uint64_t value;
+                ssize_t res = read(thread->eventfd, &value, sizeof(value));
+                MODES_NOTUSED(res);
+                continue;
+            }
+
             struct apiCon *con = event.data.ptr;
             if (con->accept) {
                 acceptConn(con, thread);
             } else {
-                if (event.events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
-                    apiReadRequest(con, thread);
+                if (event.events & (EPOLLERR | EPOLLHUP)) {
+                    apiCloseConn(con, thread);
                 } else if (event.events & EPOLLOUT) {
-                    apiSendData(con, thread);
+                    if (apiSendData(con, thread) > 0)
+                        apiProcessRequests(con, thread);
                 } else {
                     apiReadRequest(con, thread);
                 }
             }
         }
+
+        uint32_t epoch = apiCurrentEpoch(thread);
+        if (epoch != thread->streamEpoch) {
+            thread->streamEpoch = epoch;
+            apiStreamUpdate(thread);
+        }
+
+        int64_t now = mstime();
+        if (now > nextIdleCheck) {
+            apiCloseIdle(thread, now);
+            nextIdleCheck = now + SECONDS;
+        }
     }
 
+    while (thread->cons)
+        apiCloseConn(thread->cons, thread);
+
     pthread_mutex_lock(&thread->mutex);
     end_cpu_timing(&cpu_timer, &Modes.stats_current.api_worker_cpu);
     pthread_mutex_unlock(&thread->mutex);
 
     close(thread->epfd);
     sfree(events);
+    apiCacheFree(thread);
     return NULL;
 }
 
@@ -815,9 +1452,6 @@ static void *apiUpdateEntryPoint(void *arg) {
 }
 
 void apiBufferInit() {
-    for (int i = 0; i < 2; i++) {
-        Modes.apiBuffer[i].hashList = aligned_malloc(API_BUCKETS * sizeof(struct apiEntry*));
-    }
     for (int i = 0; i < API_THREADS; i++) {
         pthread_mutex_init(&Modes.apiThread[i].mutex, NULL);
     }
@@ -829,10 +1463,20 @@ void apiBufferCleanup() {
 
     threadSignalJoin(&Threads.apiUpdate);
 
+    // apiUpdate is done waking the api threads
+    for (int i = 0; i < API_THREADS; i++) {
+        if (Modes.apiThread[i].eventfd > 0) {
+            close(Modes.apiThread[i].eventfd);
+            Modes.apiThread[i].eventfd = 0;
+        }
+    }
+
     for (int i = 0; i < 2; i++) {
         sfree(Modes.apiBuffer[i].list);
+        sfree(Modes.apiBuffer[i].bin);
         sfree(Modes.apiBuffer[i].json);
         sfree(Modes.apiBuffer[i].hashList);
+        apiGridFree(&Modes.apiBuffer[i]);
     }
 
     for (int i = 0; i < API_THREADS; i++) {
@@ -865,6 +1509,11 @@ void apiInit() {
 
     for (int i = 0; i < API_THREADS; i++) {
         Modes.apiThread[i].index = i;
+        Modes.apiThread[i].eventfd = eventfd(0, EFD_NONBLOCK);
+        if (Modes.apiThread[i].eventfd < 0) {
+            perror("eventfd");
+            exit(1);
+        }
         pthread_create(&Modes.apiThread[i].thread, NULL, apiThreadEntryPoint, &Modes.apiThread[i]);
     }
 }
@@ -1,7 +1,52 @@
 #ifndef API_H
 #define API_H
 
-#define API_REQ_PADSTART (192)
+#define API_REQ_PADSTART (256)
+
+// responses per api thread cached until the next api update
+#define API_CACHE_ENTRIES (16)
+#define API_CACHE_KEY_MAX (512)
+
+enum apiEncoding {
+    API_ENCODING_IDENTITY = 0,
+    API_ENCODING_GZIP,
+    API_ENCODING_DEFLATE,
+};
+
+struct apiCircle {
+    double lat;
+    double lon;
+    double radius; // in meters
+    bool onlyClosest;
+};
+
+#define API_FILTER_TYPES (32)
+
+// attribute filters combined with the box, circle or hexlist of a query
+struct apiFilter {
+    // alt is INT32_MAX when unknown, those only pass without altitude filter
+    int32_t minAlt;
+    int32_t maxAlt;
+    bool hasAlt;
+    uint32_t types[API_FILTER_TYPES]; // typeCode compared as one 32 bit value
+    int typeCount;
+    uint32_t dbFlagsMask; // dbFlags bits that are checked
+    uint32_t dbFlagsWant; // and the values they need to have
+};
+
+// a connection subscribed with &stream, it gets the changes of its query after every api update
+struct apiStream {
+    double box[4];
+    bool hasBox;
+    struct apiCircle circle;
+    bool hasCircle;
+    uint32_t *hexList;
+    int hexCount;
+    struct apiFilter filter;
+    uint32_t epoch; // apiBuffer epoch of the last event
+    uint32_t *addrs; // aircraft of the last event, sorted
+    int addrCount;
+};
 
 struct apiCon {
     int fd;
@@ -10,6 +55,13 @@ struct apiCon {
     int cbOffset;
     uint32_t events;
     struct char_buffer request;
+    // connections of an api thread, checked for idle timeouts
+    struct apiCon *next;
+    struct apiCon *prev;
+    int64_t lastActivity;
+    int keepAlive; // keep the connection open after the response being sent
+    int eof; // client closed its side, answer the buffered requests then close
+    struct apiStream *stream;
 };
 
 struct offset {
@@ -35,15 +87,13 @@ struct apiEntry {
     unsigned padding:15;
     int32_t globe_index;
 
-    uint64_t pad3;
+    int64_t jsonExpires; // the JSON can be reused until then if the aircraft doesn't change
+    uint16_t seenPosOffset; // offsets of the seen_pos and seen values in the JSON, 0 if absent
+    uint16_t seenOffset;
+    uint32_t binIndex; // in apiBuffer.bin
+    uint32_t jsonEpoch; // epoch of the apiBuffer the JSON was printed for, older if it was copied
 } __attribute__ ((__packed__));
 
-struct apiCircle {
-    double lat;
-    double lon;
-    double radius; // in meters
-    bool onlyClosest;
-};
 
 struct apiBuffer {
     int len;
@@ -51,9 +101,32 @@ struct apiBuffer {
     struct apiEntry *list;
     uint64_t timestamp;
     char *json;
+    size_t jsonLen;
+    size_t jsonAlloc;
+    struct binCraft *bin; // same order as the list
     struct apiEntry **hashList;
+    int hashBits;
     uint32_t focus;
     int aircraftJsonCount;
+    uint32_t epoch; // Modes.apiEpoch of the update that filled this buffer
+    struct apiEntry *gridSpare; // the list is sorted by grid cell into this, then they swap
+    int gridSpareAlloc; // entries gridSpare has room for, kept equal to alloc
+    int32_t *gridStart; // start of each grid cell in list
+    int gridAlloc; // entries the column arrays have room for
+    // the list fields queries filter on as columns, for vectorized scans
+    int32_t *colLat;
+    int32_t *colLon;
+    int32_t *colAlt;
+    uint32_t *colType;
+    uint32_t *colDbFlags;
+};
+
+struct apiCacheEntry {
+    uint32_t epoch; // apiBuffer epoch the response was generated from, 0 if unused
+    enum apiEncoding encoding;
+    int keyLen;
+    char key[API_CACHE_KEY_MAX]; // request line
+    struct char_buffer cb; // response like parseFetch returns it, possibly compressed
 };
 
 struct apiThread {
@@ -63,6 +136,10 @@ struct apiThread {
     int epfd;
     int eventfd;
     int openFDs;
+    struct apiCon *cons;
+    struct apiCacheEntry *cache;
+    int cacheNext; // entry replaced next when none is stale
+    uint32_t streamEpoch; // apiBuffer epoch the streams were last updated for
 };
 
 struct range {
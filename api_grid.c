@@ -0,0 +1,303 @@
+#include "readsb.h"
+
+static inline int latRow(int32_t lat) {
+    return imin(imax(((int64_t) lat + 90000000) / API_GRID_SIZE, 0), API_GRID_ROWS - 1);
+}
+
+static inline int lonCol(int32_t lon) {
+    return imin(imax(((int64_t) lon + 180000000) / API_GRID_SIZE, 0), API_GRID_COLS - 1);
+}
+
+// lon1 > lon2 wraps around the antimeridian
+static inline bool lonInRange(int32_t lon, int32_t lon1, int32_t lon2) {
+    if (lon1 <= lon2)
+        return lon >= lon1 && lon <= lon2;
+    else
+        return lon >= lon1 || lon <= lon2;
+}
+
+static inline int gridCell(struct apiEntry *e) {
+    if (e->lat == INT32_MAX)
+        return API_GRID_CELLS;
+    return latRow(e->lat) * API_GRID_COLS + lonCol(e->lon);
+}
+
+void apiGridBuild(struct apiBuffer *buffer) {
+    if (!buffer->gridStart) {
+        buffer->gridStart = aligned_malloc((API_GRID_CELLS + 3) * sizeof(int32_t));
+        if (!buffer->gridStart) {
+            fprintf(stderr, "apiGrid alloc: out of memory!\n");
+            exit(1);
+        }
+    }
+    // after a swap the spare is the previous list, when that was allocated
+    // for a different aircraft count it has to follow the current one
+    if (buffer->gridSpareAlloc != buffer->alloc) {
+        sfree(buffer->gridSpare);
+        buffer->gridSpareAlloc = buffer->alloc;
+        buffer->gridSpare = aligned_malloc(buffer->gridSpareAlloc * sizeof(struct apiEntry));
+        if (!buffer->gridSpare) {
+            fprintf(stderr, "apiGrid alloc: out of memory!\n");
+            exit(1);
+        }
+    }
+    if (buffer->gridAlloc < buffer->alloc) {
+        sfree(buffer->colLat);
+        sfree(buffer->colLon);
+        sfree(buffer->colAlt);
+        sfree(buffer->colType);
+        sfree(buffer->colDbFlags);
+        buffer->gridAlloc = buffer->alloc;
+        buffer->colLat = aligned_malloc(buffer->gridAlloc * sizeof(int32_t));
+        buffer->colLon = aligned_malloc(buffer->gridAlloc * sizeof(int32_t));
+        buffer->colAlt = aligned_malloc(buffer->gridAlloc * sizeof(int32_t));
+        buffer->colType = aligned_malloc(buffer->gridAlloc * sizeof(uint32_t));
+        buffer->colDbFlags = aligned_malloc(buffer->gridAlloc * sizeof(uint32_t));
+        if (!buffer->colLat || !buffer->colLon || !buffer->colAlt || !buffer->colType || !buffer->colDbFlags) {
+            fprintf(stderr, "apiGrid alloc: out of memory!\n");
+            exit(1);
+        }
+    }
+
+    // counting sort by cell, it's stable so each cell stays sorted by longitude
+    // counts go 2 ahead, copying moves gridStart[cell + 1] from the start of cell to its end
+    int32_t *start = buffer->gridStart;
+    memset(start, 0, (API_GRID_CELLS + 3) * sizeof(int32_t));
+
+    for (int i = 0; i < buffer->len; i++) {
+        start[gridCell(&buffer->list[i]) + 2]++;
+    }
+    for (int c = 2; c < API_GRID_CELLS + 3; c++) {
+        start[c] += start[c - 1];
+    }
+    struct apiEntry *sorted = buffer->gridSpare;
+    for (int i = 0; i < buffer->len; i++) {
+        struct apiEntry *e = &buffer->list[i];
+        sorted[start[gridCell(e) + 1]++] = *e;
+    }
+
+    buffer->gridSpare = buffer->list;
+    buffer->list = sorted;
+
+    for (int i = 0; i < buffer->len; i++) {
+        struct apiEntry *e = &sorted[i];
+        buffer->colLat[i] = e->lat;
+        buffer->colLon[i] = e->lon;
+        buffer->colAlt[i] = e->alt;
+        memcpy(&buffer->colType[i], e->typeCode, sizeof(uint32_t));
+        buffer->colDbFlags[i] = e->dbFlags;
+    }
+}
+
+void apiGridFree(struct apiBuffer *buffer) {
+    sfree(buffer->gridSpare);
+    sfree(buffer->gridStart);
+    sfree(buffer->colLat);
+    sfree(buffer->colLon);
+    sfree(buffer->colAlt);
+    sfree(buffer->colType);
+    sfree(buffer->colDbFlags);
+    buffer->gridSpareAlloc = 0;
+    buffer->gridAlloc = 0;
+}
+
+static inline bool filterValues(struct apiFilter *filter, int32_t alt, uint32_t type, uint32_t dbFlags) {
+    if (!filter)
+        return true;
+    if (filter->hasAlt && (alt < filter->minAlt || alt > filter->maxAlt))
+        return false;
+    if (filter->typeCount) {
+        bool found = false;
+        for (int k = 0; k < filter->typeCount; k++)
+            found |= (type == filter->types[k]);
+        if (!found)
+            return false;
+    }
+    return (dbFlags & filter->dbFlagsMask) == filter->dbFlagsWant;
+}
+
+bool apiFilterEntry(struct apiFilter *filter, struct apiEntry *e) {
+    uint32_t type;
+    memcpy(&type, e->typeCode, sizeof(type));
+    return filterValues(filter, e->alt, type, e->dbFlags);
+}
+
+// copies the entries of list[from, to) inside the bounds that pass the filter to matches[count...]
+// returns the new count, lon1 > lon2 wraps around the antimeridian
+static int scanSlice(struct apiBuffer *buffer, int from, int to, int32_t lat1, int32_t lat2, int32_t lon1, int32_t lon2,
+        struct apiFilter *filter, struct apiEntry *matches, int count) {
+    int i = from;
+#if defined(__SSE2__)
+    // one compare per predicate for 4 entries, lanes failing any of them are set in bad
+    const __m128i ones = _mm_set1_epi32(-1);
+    const __m128i vLat1 = _mm_set1_epi32(lat1);
+    const __m128i vLat2 = _mm_set1_epi32(lat2);
+    const __m128i vLon1 = _mm_set1_epi32(lon1);
+    const __m128i vLon2 = _mm_set1_epi32(lon2);
+    const bool wrap = lon1 > lon2;
+    const bool hasAlt = filter && filter->hasAlt;
+    const int typeCount = filter ? filter->typeCount : 0;
+    const bool hasFlags = filter && filter->dbFlagsMask;
+    __m128i vMinAlt = _mm_setzero_si128();
+    __m128i vMaxAlt = _mm_setzero_si128();
+    __m128i vFlagsMask = _mm_setzero_si128();
+    __m128i vFlagsWant = _mm_setzero_si128();
+    __m128i vTypes[API_FILTER_TYPES];
+    if (filter) {
+        vMinAlt = _mm_set1_epi32(filter->minAlt);
+        vMaxAlt = _mm_set1_epi32(filter->maxAlt);
+        vFlagsMask = _mm_set1_epi32(filter->dbFlagsMask);
+        vFlagsWant = _mm_set1_epi32(filter->dbFlagsWant);
+        for (int k = 0; k < typeCount; k++)
+            vTypes[k] = _mm_set1_epi32(filter->types[k]);
+    }
+
+    for (; i + 4 <= to; i += 4) {
+        __m128i lat = _mm_loadu_si128((const __m128i *) &buffer->colLat[i]);
+        __m128i lon = _mm_loadu_si128((const __m128i *) &buffer->colLon[i]);
+        __m128i bad = _mm_or_si128(_mm_cmplt_epi32(lat, vLat1), _mm_cmpgt_epi32(lat, vLat2));
+        __m128i lonLow = _mm_cmplt_epi32(lon, vLon1);
+        __m128i lonHigh = _mm_cmpgt_epi32(lon, vLon2);
+        bad = _mm_or_si128(bad, wrap ? _mm_and_si128(lonLow, lonHigh) : _mm_or_si128(lonLow, lonHigh));
+        if (hasAlt) {
+            __m128i alt = _mm_loadu_si128((const __m128i *) &buffer->colAlt[i]);
+            bad = _mm_or_si128(bad, _mm_or_si128(_mm_cmplt_epi32(alt, vMinAlt), _mm_cmpgt_epi32(alt, vMaxAlt)));
+        }
+        if (typeCount) {
+            __m128i type = _mm_loadu_si128((const __m128i *) &buffer->colType[i]);
+            __m128i found = _mm_setzero_si128();
+            for (int k = 0; k < typeCount; k++)
+                found = _mm_or_si128(found, _mm_cmpeq_epi32(type, vTypes[k]));
+            bad = _mm_or_si128(bad, _mm_xor_si128(found, ones));
+        }
+        if (hasFlags) {
+            __m128i flags = _mm_and_si128(_mm_loadu_si128((const __m128i *) &buffer->colDbFlags[i]), vFlagsMask);
+            bad = _mm_or_si128(bad, _mm_xor_si128(_mm_cmpeq_epi32(flags, vFlagsWant), ones));
+        }
+        unsigned mask = ~_mm_movemask_ps(_mm_castsi128_ps(bad)) & 0xF;
+        while (mask) {
+            matches[count++] = buffer->list[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < to; i++) {
+        int32_t lat = buffer->colLat[i];
+        if (lat < lat1 || lat > lat2 || !lonInRange(buffer->colLon[i], lon1, lon2))
+            continue;
+        if (filterValues(filter, buffer->colAlt[i], buffer->colType[i], buffer->colDbFlags[i]))
+            matches[count++] = buffer->list[i];
+    }
+    return count;
+}
+
+// slices of the grid with the candidates for a box, returns the number of slices
+static int gridRanges(struct apiBuffer *buffer, int32_t lat1, int32_t lat2, int32_t lon1, int32_t lon2, struct range *r) {
+    struct range cols[2];
+    int colRanges = 1;
+    if (lon1 <= lon2) {
+        cols[0].from = lonCol(lon1);
+        cols[0].to = lonCol(lon2) + 1;
+    } else {
+        cols[0].from = lonCol(lon1);
+        cols[0].to = API_GRID_COLS;
+        cols[1].from = 0;
+        cols[1].to = lonCol(lon2) + 1;
+        colRanges = 2;
+    }
+
+    int count = 0;
+    int32_t *start = buffer->gridStart;
+    if (!start)
+        return 0;
+    for (int row = latRow(lat1); row <= latRow(lat2) && lat1 <= lat2; row++) {
+        for (int k = 0; k < colRanges; k++) {
+            int base = row * API_GRID_COLS;
+            r[count].from = start[base + cols[k].from];
+            r[count].to = start[base + cols[k].to];
+            if (r[count].from < r[count].to)
+                count++;
+        }
+    }
+    return count;
+}
+
+int apiFindInBox(struct apiBuffer *buffer, double *box, struct apiFilter *filter, struct apiEntry *matches, size_t *alloc) {
+    struct range r[2 * API_GRID_ROWS];
+    int count = 0;
+
+    int32_t lat1 = (int32_t) (box[0] * 1E6);
+    int32_t lat2 = (int32_t) (box[1] * 1E6);
+    int32_t lon1 = (int32_t) (box[2] * 1E6);
+    int32_t lon2 = (int32_t) (box[3] * 1E6);
+
+    int slices = gridRanges(buffer, lat1, lat2, lon1, lon2, r);
+    for (int k = 0; k < slices; k++) {
+        count = scanSlice(buffer, r[k].from, r[k].to, lat1, lat2, lon1, lon2, filter, matches, count);
+    }
+    for (int i = 0; i < count; i++) {
+        *alloc += matches[i].jsonOffset.len;
+    }
+    return count;
+}
+
+int apiFindInCircle(struct apiBuffer *buffer, struct apiCircle *circle, struct apiFilter *filter, struct apiEntry *matches, size_t *alloc) {
+    struct range r[2 * API_GRID_ROWS];
+    int count = 0;
+    double lat = circle->lat;
+    double lon = circle->lon;
+    double radius = circle->radius; // in meters
+    bool onlyClosest = circle->onlyClosest;
+
+    double circum = 40075e3; // earth circumference is 40075km
+    double fudge = 1.002; // make the box we check a little bigger
+
+    double latdiff = fudge * radius / (circum / 2) * 180.0;
+    double a1 = fmax(-90, lat - latdiff);
+    double a2 = fmin(90, lat + latdiff);
+    int32_t lat1 = (int32_t) (a1 * 1E6);
+    int32_t lat2 = (int32_t) (a2 * 1E6);
+
+    double londiff = fudge * radius / (cos(lat * M_PI / 180.0) * circum + 1) * 360;
+    londiff = fmin(londiff, 179.9999);
+    double o1 = lon - londiff;
+    double o2 = lon + londiff;
+    o1 = o1 < -180 ? o1 + 360: o1;
+    o2 = o2 > 180 ? o2 - 360 : o2;
+    int32_t lon1 = (int32_t) (o1 * 1E6);
+    int32_t lon2 = (int32_t) (o2 * 1E6);
+
+    //fprintf(stderr, "radius:%8.0f latdiff: %8.0f londiff: %8.0f\n", radius, greatcircle(a1, lon, lat, lon), greatcircle(lat, o1, lat, lon, 0));
+    int slices = gridRanges(buffer, lat1, lat2, lon1, lon2, r);
+
+    // candidates from the bounding box, then the distance check compacts them in place
+    int candidates = 0;
+    for (int k = 0; k < slices; k++) {
+        candidates = scanSlice(buffer, r[k].from, r[k].to, lat1, lat2, lon1, lon2, filter, matches, candidates);
+    }
+
+    double minDistance = 300E6; // larger than any distances we encounter, also how far light travels in a second
+    for (int j = 0; j < candidates; j++) {
+        struct apiEntry *e = &matches[j];
+        double dist = greatcircle(lat, lon, e->lat / 1E6, e->lon / 1E6, 0);
+        if (dist >= radius)
+            continue;
+        if (onlyClosest) {
+            if (dist < minDistance) {
+                // first match is overwritten repeatedly
+                matches[0] = *e;
+                matches[0].distance = (float) dist;
+                minDistance = dist;
+                count = 1;
+            }
+        } else {
+            matches[count] = *e;
+            matches[count].distance = (float) dist;
+            count++;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        *alloc += matches[i].jsonOffset.len;
+    }
+    return count;
+}
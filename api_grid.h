@@ -0,0 +1,24 @@
+#ifndef API_GRID_H
+#define API_GRID_H
+
+// Uniform lat / lon grid over the api entries, rebuilt with every apiUpdate.
+// Box and circle queries only look at the cells overlapping their bounding box,
+// scanning column copies of the list fields 4 entries at a time with SSE2.
+// The list is ordered by row, column and longitude, entries without position
+// go last: one latitude row of a query is a single slice of the list.
+
+#define API_GRID_SIZE (1000000) // cell size in degrees * 1E6
+#define API_GRID_ROWS (180)
+#define API_GRID_COLS (360)
+#define API_GRID_CELLS (API_GRID_ROWS * API_GRID_COLS)
+
+// reorders the list, call after sorting it by longitude
+void apiGridBuild(struct apiBuffer *buffer);
+void apiGridFree(struct apiBuffer *buffer);
+
+// filter can be NULL
+int apiFindInBox(struct apiBuffer *buffer, double *box, struct apiFilter *filter, struct apiEntry *matches, size_t *alloc);
+int apiFindInCircle(struct apiBuffer *buffer, struct apiCircle *circle, struct apiFilter *filter, struct apiEntry *matches, size_t *alloc);
+bool apiFilterEntry(struct apiFilter *filter, struct apiEntry *e);
+
+#endif
@@ -0,0 +1,190 @@
+// Part of readsb, a Mode-S/ADSB/TIS message decoder.
+//
+// apitests.c - request handling tests for the API server
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "readsb.h"
+
+#include <poll.h>
+#include <sys/un.h>
+
+// The api threads are started on a unix socket with a few aircraft in the
+// api buffer, then each request is sent on a new connection and the response
+// is checked for the strings it has to contain and the ones it must not.
+
+struct _Modes Modes;
+struct _Threads Threads;
+
+void setExit(int arg) {
+    MODES_NOTUSED(arg);
+}
+
+void receiverPositionChanged(float lat, float lon, float alt) {
+    MODES_NOTUSED(lat);
+    MODES_NOTUSED(lon);
+    MODES_NOTUSED(alt);
+}
+
+static const struct {
+    const char *request; // input: sent as is
+    int halfClose; // input: shut down the sending side after the request
+    const char *expect; // verify: the response contains this
+    const char *reject; // verify: the response doesn't contain this, NULL for no check
+} apiRequestTests[] = {
+    { "GET /?box=40,60,0,20 HTTP/1.1\r\n\r\n", 0,
+        "Content-Type: application/json", NULL },
+    // the client shuts down its side without the empty line ending the head
+    { "GET /?box=40,60,0,20 HTTP/1.0\n", 1,
+        "Content-Type: application/json", NULL },
+    { "GET /?box=40,60,0,20 HTTP/1.1\r\nAccept: */*\r\n", 1,
+        "Content-Type: application/json", NULL },
+    { "GET /?box=40,60,0,20 HTTP/1.1", 1,
+        "HTTP/1.1 400 Bad Request", NULL },
+    { "GET /?hexlist=100003 HTTP/1.1\r\n\r\n", 0,
+        "\"hex\":\"100003\"", "\"hex\":\"100004\"" },
+    { "GET /?closest=50,10,100 HTTP/1.1\r\n\r\n", 0,
+        "\"hex\":\"100000\"", "\"hex\":\"100001\"" },
+    { "GET /?box=40,60,0,20&stream HTTP/1.1\r\n\r\n", 0,
+        "Content-Type: text/event-stream", "Content-Length" },
+    // only the whole parameter name subscribes
+    { "GET /?box=40,60,0,20&streamx HTTP/1.1\r\n\r\n", 0,
+        "Content-Type: application/json", "text/event-stream" },
+    { "GET /?box=40,60,0,20&streams=1 HTTP/1.1\r\n\r\n", 0,
+        "Content-Type: application/json", "text/event-stream" },
+    { "GET /?stream&box=40,60,0,20 HTTP/1.1\r\n\r\n", 0,
+        "Content-Type: text/event-stream", "Content-Length" },
+    { "GET /?box=40,60,0,20&format=binCraftX HTTP/1.1\r\n\r\n", 0,
+        "Content-Type: application/json", NULL },
+};
+
+static int apiConnect(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("apitests connect");
+        exit(1);
+    }
+    return fd;
+}
+
+// everything that arrives until the server closes or stays quiet for a while
+static int apiResponse(int fd, char *buf, int size) {
+    int len = 0;
+    int timeout = 2000; // for the first byte
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    while (len < size - 1 && poll(&pfd, 1, timeout) > 0) {
+        int nread = recv(fd, buf + len, size - 1 - len, 0);
+        if (nread <= 0)
+            break;
+        len += nread;
+        timeout = 200;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static int testApiRequests(const char *path) {
+    int ok = 1;
+    static char response[1024 * 1024];
+    for (unsigned i = 0; i < sizeof(apiRequestTests) / sizeof(apiRequestTests[0]); i++) {
+        int fd = apiConnect(path);
+        const char *request = apiRequestTests[i].request;
+        if (send(fd, request, strlen(request), 0) != (ssize_t) strlen(request)) {
+            perror("apitests send");
+            exit(1);
+        }
+        if (apiRequestTests[i].halfClose)
+            shutdown(fd, SHUT_WR);
+        apiResponse(fd, response, sizeof(response));
+        close(fd);
+
+        const char *expect = apiRequestTests[i].expect;
+        const char *reject = apiRequestTests[i].reject;
+        if (!strstr(response, expect) || (reject && strstr(response, reject))) {
+            ok = 0;
+            int head = strcspn(response, "{");
+            fprintf(stderr,
+                    "testApiRequest[%u]: FAIL: %.*s\n"
+                    " response |%.*s|\n"
+                    " expected %s%s%s\n",
+                    i, (int) strcspn(request, "\r\n"), request,
+                    head, response,
+                    expect, reject ? ", without " : "", reject ? reject : "");
+        } else {
+            fprintf(stderr, "testApiRequest[%u]: PASS\n", i);
+        }
+    }
+    return ok;
+}
+
+static void validate(data_validity *v, int64_t now) {
+    v->source = SOURCE_ADSB;
+    v->updated = now;
+    v->next_reduce_forward = now;
+}
+
+static void addAircraft(int count, int64_t now) {
+    for (int i = 0; i < count; i++) {
+        struct aircraft *a = aircraftCreate(0x100000 + i);
+        a->addrtype = ADDR_ADSB_ICAO;
+        a->lat = 50 + i * 0.01;
+        a->lon = 10 + i * 0.01;
+        a->baro_alt = 10000 + i * 100;
+        a->pos_reliable_odd = a->pos_reliable_even = 2;
+        a->alt_reliable = 2;
+        a->messages = 100;
+        a->seen = now;
+        a->seen_pos = now;
+        a->seenPosReliable = now;
+        validate(&a->position_valid, now);
+        validate(&a->baro_alt_valid, now);
+        a->dirtyEpoch = Modes.apiEpoch;
+        ca_add(&Modes.aircraftActive, a);
+    }
+}
+
+int main(int __attribute__ ((unused)) argc, char __attribute__ ((unused)) **argv) {
+    static char ports[64];
+    snprintf(ports, sizeof(ports), "unix:/tmp/readsb-apitests-%d", (int) getpid());
+    const char *path = ports + 5;
+    unlink(path);
+
+    // every epoll fd watches it
+    Modes.exitEventfd = eventfd(0, EFD_NONBLOCK);
+    Modes.json_interval = 1000;
+    Modes.json_reliable = 1;
+    Modes.net_output_api_ports = ports;
+    for (int i = 0; i < API_THREADS; i++)
+        pthread_mutex_init(&Modes.apiThread[i].mutex, NULL);
+    pthread_mutex_init(&Modes.apiFlipMutex, NULL);
+    ca_init(&Modes.aircraftActive);
+    quickInit();
+
+    addAircraft(10, mstime());
+    apiUpdate(&Modes.aircraftActive);
+    apiInit();
+    fprintf(stderr, "\n");
+    if (Modes.apiService.listener_count <= 0) {
+        fprintf(stderr, "apitests: can't listen on %s\n", path);
+        return 1;
+    }
+
+    int ok = 1;
+    ok = testApiRequests(path) && ok;
+
+    unlink(path);
+    return ok ? 0 : 1;
+}
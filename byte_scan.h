@@ -0,0 +1,64 @@
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+// Search for a single byte value, used to frame network input: the 0x1a
+// escapes of Beast and the line separator of the ASCII formats.
+//
+// Messages are short and mostly start right where the previous one ended, a
+// memchr call per message costs more than the search. byteFind is inlined and
+// checks 16 bytes per step with SSE2 (part of x86-64) or NEON. It loads whole
+// 16 byte blocks and can read up to 15 bytes past end, buffers searched with
+// it need BYTE_SCAN_PADDING bytes of slack. Matches past end are ignored.
+
+#define BYTE_SCAN_PADDING 16
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BYTE_SCAN_DESCRIPTION "SSE2"
+#elif defined(__ARM_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define BYTE_SCAN_DESCRIPTION "NEON"
+#else
+#define BYTE_SCAN_DESCRIPTION "memchr"
+#endif
+
+// first c in [p, end), NULL if there is none
+static inline char *byteFind(const char *p, const char *end, char c) {
+#if defined(__SSE2__)
+    const __m128i cv = _mm_set1_epi8(c);
+    for (; p < end; p += 16) {
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), cv));
+        if (mask) {
+            p += __builtin_ctz(mask);
+            return p < end ? (char *) p : NULL;
+        }
+    }
+    return NULL;
+#elif defined(__ARM_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // NEON has no movemask: a narrowing shift of the compare result leaves 4 bits per byte
+    const uint8x16_t cv = vdupq_n_u8((uint8_t) c);
+    for (; p < end; p += 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8((const uint8_t *) p), cv);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (mask) {
+            p += __builtin_ctzll(mask) / 4;
+            return p < end ? (char *) p : NULL;
+        }
+    }
+    return NULL;
+#else
+    return p < end ? memchr(p, c, end - p) : NULL;
+#endif
+}
+
+// first occurrence of the separator sep (sepLen bytes) in [p, end), NULL if there is none
+static inline char *sepFind(const char *p, const char *end, const char *sep, int sepLen) {
+    while ((p = byteFind(p, end, sep[0])) != NULL) {
+        if (sepLen == 1 || (end - p >= sepLen && !memcmp(p, sep, sepLen)))
+            return (char *) p;
+        p++;
+    }
+    return NULL;
+}
+
+#endif
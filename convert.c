@@ -23,11 +23,20 @@
 
 #include "readsb.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CONVERT_X86
+#elif defined(__ARM_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define CONVERT_NEON
+#endif
+
 struct converter_state {
     float dc_a;
     float dc_b;
     float z1_I;
     float z1_Q;
+    float dc_pow[8]; // dc_b^1 .. dc_b^8 for the vectorized DC block
 };
 
 static uint16_t *uc8_lookup;
@@ -419,6 +428,419 @@ static void convert_sc16q11_generic(void *iq_data,
     }
 }
 
+//
+// Vectorized converters
+//
+// These handle all input formats with and without DC filter.
+// The DC block is a first order IIR filter, z[n] = a * x[n] + b * z[n-1],
+// which is evaluated for a whole vector at once as a prefix scan using
+// the powers of b stored in the converter state.
+//
+
+// convert the samples the vectorized loop didn't handle, one at a time
+static inline void convert_tail(input_format_t format, int filter_dc,
+        void *iq_data,
+        uint16_t *mag_data,
+        unsigned from,
+        unsigned nsamples,
+        struct converter_state *state,
+        float *z1_I,
+        float *z1_Q,
+        double *sum_level,
+        double *sum_power) {
+    for (unsigned i = from; i < nsamples; ++i) {
+        float fI, fQ, magsq;
+
+        if (format == INPUT_UC8) {
+            uint8_t *in = iq_data;
+            fI = (in[2 * i] - 127.5f) / 127.5f;
+            fQ = (in[2 * i + 1] - 127.5f) / 127.5f;
+        } else {
+            uint16_t *in = iq_data;
+            float scale = (format == INPUT_SC16) ? 32768.0f : 2048.0f;
+            fI = (int16_t) le16toh(in[2 * i]) / scale;
+            fQ = (int16_t) le16toh(in[2 * i + 1]) / scale;
+        }
+
+        if (filter_dc) {
+            *z1_I = fI * state->dc_a + *z1_I * state->dc_b;
+            *z1_Q = fQ * state->dc_a + *z1_Q * state->dc_b;
+            fI -= *z1_I;
+            fQ -= *z1_Q;
+        }
+
+        magsq = fI * fI + fQ * fQ;
+        if (magsq > 1)
+            magsq = 1;
+
+        float mag = sqrtf(magsq);
+        *sum_power += magsq;
+        *sum_level += mag;
+        mag_data[i] = (uint16_t) (mag * 65535.0f + 0.5f);
+    }
+}
+
+#if defined(CONVERT_X86)
+
+static bool cpu_has_sse2() {
+    return __builtin_cpu_supports("sse2");
+}
+
+static bool cpu_has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128 dc_block_sse2(__m128 x, __m128 *z1, __m128 dc_a, __m128 b1, __m128 b2, __m128 bpow) {
+    __m128 y = _mm_mul_ps(x, dc_a);
+    y = _mm_add_ps(y, _mm_mul_ps(b1, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y), 4))));
+    y = _mm_add_ps(y, _mm_mul_ps(b2, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y), 8))));
+    __m128 z = _mm_add_ps(y, _mm_mul_ps(bpow, *z1));
+    *z1 = _mm_shuffle_ps(z, z, 0xFF);
+    return _mm_sub_ps(x, z);
+}
+
+__attribute__ ((target ("sse2"), always_inline))
+static inline void convert_sse2(input_format_t format, int filter_dc,
+        void *iq_data,
+        uint16_t *mag_data,
+        unsigned nsamples,
+        struct converter_state *state,
+        double *out_mean_level,
+        double *out_mean_power) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 full_scale = _mm_set1_ps(65535.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 uc8_offset = _mm_set1_ps(127.5f);
+    const __m128 uc8_scale = _mm_set1_ps(1.0f / 127.5f);
+    const __m128 sc16_scale = _mm_set1_ps(format == INPUT_SC16 ? 1.0f / 32768.0f : 1.0f / 2048.0f);
+    const __m128 dc_a = _mm_set1_ps(state->dc_a);
+    const __m128 b1 = _mm_set1_ps(state->dc_pow[0]);
+    const __m128 b2 = _mm_set1_ps(state->dc_pow[1]);
+    const __m128 bpow = _mm_loadu_ps(state->dc_pow);
+    __m128 z1_I = _mm_set1_ps(state->z1_I);
+    __m128 z1_Q = _mm_set1_ps(state->z1_Q);
+    __m128 sum_level = _mm_setzero_ps();
+    __m128 sum_power = _mm_setzero_ps();
+
+    unsigned n = nsamples & ~3u;
+    for (unsigned i = 0; i < n; i += 4) {
+        __m128 fI, fQ;
+        if (format == INPUT_UC8) {
+            // I in the low, Q in the high 16 bits of each 32 bit lane
+            __m128i v = _mm_loadl_epi64((const __m128i *) ((uint8_t *) iq_data + 2 * i));
+            v = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+            fI = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)));
+            fQ = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+            fI = _mm_mul_ps(_mm_sub_ps(fI, uc8_offset), uc8_scale);
+            fQ = _mm_mul_ps(_mm_sub_ps(fQ, uc8_offset), uc8_scale);
+        } else {
+            __m128i v = _mm_loadu_si128((const __m128i *) ((uint16_t *) iq_data + 2 * i));
+            fI = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+            fQ = _mm_cvtepi32_ps(_mm_srai_epi32(v, 16));
+            fI = _mm_mul_ps(fI, sc16_scale);
+            fQ = _mm_mul_ps(fQ, sc16_scale);
+        }
+
+        if (filter_dc) {
+            fI = dc_block_sse2(fI, &z1_I, dc_a, b1, b2, bpow);
+            fQ = dc_block_sse2(fQ, &z1_Q, dc_a, b1, b2, bpow);
+        }
+
+        __m128 magsq = _mm_min_ps(_mm_add_ps(_mm_mul_ps(fI, fI), _mm_mul_ps(fQ, fQ)), one);
+        __m128 mag = _mm_sqrt_ps(magsq);
+        sum_power = _mm_add_ps(sum_power, magsq);
+        sum_level = _mm_add_ps(sum_level, mag);
+
+        // SSE2 only has a signed pack, shift the range before and after
+        __m128i out = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(mag, full_scale), half));
+        out = _mm_packs_epi32(_mm_sub_epi32(out, _mm_set1_epi32(32768)), _mm_setzero_si128());
+        out = _mm_xor_si128(out, _mm_set1_epi16((short) 0x8000));
+        _mm_storel_epi64((__m128i *) (mag_data + i), out);
+    }
+
+    float lanes[4];
+    double total_level = 0, total_power = 0;
+    _mm_storeu_ps(lanes, sum_level);
+    total_level = (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_ps(lanes, sum_power);
+    total_power = (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    float z1_I_tail = _mm_cvtss_f32(z1_I);
+    float z1_Q_tail = _mm_cvtss_f32(z1_Q);
+    convert_tail(format, filter_dc, iq_data, mag_data, n, nsamples, state, &z1_I_tail, &z1_Q_tail, &total_level, &total_power);
+    state->z1_I = z1_I_tail;
+    state->z1_Q = z1_Q_tail;
+
+    if (out_mean_level) {
+        *out_mean_level = total_level / nsamples;
+    }
+
+    if (out_mean_power) {
+        *out_mean_power = total_power / nsamples;
+    }
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256 dc_block_avx2(__m256 x, __m256 *z1, __m256 dc_a, __m256 b1, __m256 b2, __m256 b4, __m256 bpow) {
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 y = _mm256_mul_ps(x, dc_a);
+    __m256 shifted;
+    shifted = _mm256_blend_ps(_mm256_permutevar8x32_ps(y, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), zero, 0x01);
+    y = _mm256_add_ps(y, _mm256_mul_ps(b1, shifted));
+    shifted = _mm256_blend_ps(_mm256_permutevar8x32_ps(y, _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5)), zero, 0x03);
+    y = _mm256_add_ps(y, _mm256_mul_ps(b2, shifted));
+    shifted = _mm256_blend_ps(_mm256_permutevar8x32_ps(y, _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3)), zero, 0x0F);
+    y = _mm256_add_ps(y, _mm256_mul_ps(b4, shifted));
+    __m256 z = _mm256_add_ps(y, _mm256_mul_ps(bpow, *z1));
+    *z1 = _mm256_permutevar8x32_ps(z, _mm256_set1_epi32(7));
+    return _mm256_sub_ps(x, z);
+}
+
+__attribute__ ((target ("avx2"), always_inline))
+static inline void convert_avx2(input_format_t format, int filter_dc,
+        void *iq_data,
+        uint16_t *mag_data,
+        unsigned nsamples,
+        struct converter_state *state,
+        double *out_mean_level,
+        double *out_mean_power) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 full_scale = _mm256_set1_ps(65535.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 uc8_offset = _mm256_set1_ps(127.5f);
+    const __m256 uc8_scale = _mm256_set1_ps(1.0f / 127.5f);
+    const __m256 sc16_scale = _mm256_set1_ps(format == INPUT_SC16 ? 1.0f / 32768.0f : 1.0f / 2048.0f);
+    const __m256 dc_a = _mm256_set1_ps(state->dc_a);
+    const __m256 b1 = _mm256_set1_ps(state->dc_pow[0]);
+    const __m256 b2 = _mm256_set1_ps(state->dc_pow[1]);
+    const __m256 b4 = _mm256_set1_ps(state->dc_pow[3]);
+    const __m256 bpow = _mm256_loadu_ps(state->dc_pow);
+    __m256 z1_I = _mm256_set1_ps(state->z1_I);
+    __m256 z1_Q = _mm256_set1_ps(state->z1_Q);
+    __m256 sum_level = _mm256_setzero_ps();
+    __m256 sum_power = _mm256_setzero_ps();
+
+    unsigned n = nsamples & ~7u;
+    for (unsigned i = 0; i < n; i += 8) {
+        __m256 fI, fQ;
+        if (format == INPUT_UC8) {
+            // I in the low, Q in the high 16 bits of each 32 bit lane
+            __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) ((uint8_t *) iq_data + 2 * i)));
+            fI = _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0xFFFF)));
+            fQ = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+            fI = _mm256_mul_ps(_mm256_sub_ps(fI, uc8_offset), uc8_scale);
+            fQ = _mm256_mul_ps(_mm256_sub_ps(fQ, uc8_offset), uc8_scale);
+        } else {
+            __m256i v = _mm256_loadu_si256((const __m256i *) ((uint16_t *) iq_data + 2 * i));
+            fI = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16));
+            fQ = _mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16));
+            fI = _mm256_mul_ps(fI, sc16_scale);
+            fQ = _mm256_mul_ps(fQ, sc16_scale);
+        }
+
+        if (filter_dc) {
+            fI = dc_block_avx2(fI, &z1_I, dc_a, b1, b2, b4, bpow);
+            fQ = dc_block_avx2(fQ, &z1_Q, dc_a, b1, b2, b4, bpow);
+        }
+
+        __m256 magsq = _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(fI, fI), _mm256_mul_ps(fQ, fQ)), one);
+        __m256 mag = _mm256_sqrt_ps(magsq);
+        sum_power = _mm256_add_ps(sum_power, magsq);
+        sum_level = _mm256_add_ps(sum_level, mag);
+
+        __m256i out = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(mag, full_scale), half));
+        __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(out), _mm256_extracti128_si256(out, 1));
+        _mm_storeu_si128((__m128i *) (mag_data + i), packed);
+    }
+
+    float lanes[8];
+    double total_level = 0, total_power = 0;
+    _mm256_storeu_ps(lanes, sum_level);
+    for (int k = 0; k < 8; k++)
+        total_level += lanes[k];
+    _mm256_storeu_ps(lanes, sum_power);
+    for (int k = 0; k < 8; k++)
+        total_power += lanes[k];
+
+    float z1_I_tail = _mm256_cvtss_f32(z1_I);
+    float z1_Q_tail = _mm256_cvtss_f32(z1_Q);
+    convert_tail(format, filter_dc, iq_data, mag_data, n, nsamples, state, &z1_I_tail, &z1_Q_tail, &total_level, &total_power);
+    state->z1_I = z1_I_tail;
+    state->z1_Q = z1_Q_tail;
+
+    if (out_mean_level) {
+        *out_mean_level = total_level / nsamples;
+    }
+
+    if (out_mean_power) {
+        *out_mean_power = total_power / nsamples;
+    }
+}
+
+#define X86_CONVERTER(name, isa, body, format, filter_dc) \
+    __attribute__ ((target (isa))) \
+    static void name(void *iq_data, uint16_t *mag_data, unsigned nsamples, struct converter_state *state, \
+            double *out_mean_level, double *out_mean_power) { \
+        body(format, filter_dc, iq_data, mag_data, nsamples, state, out_mean_level, out_mean_power); \
+    }
+
+X86_CONVERTER(convert_uc8_nodc_avx2, "avx2", convert_avx2, INPUT_UC8, 0)
+X86_CONVERTER(convert_uc8_dc_avx2, "avx2", convert_avx2, INPUT_UC8, 1)
+X86_CONVERTER(convert_sc16_nodc_avx2, "avx2", convert_avx2, INPUT_SC16, 0)
+X86_CONVERTER(convert_sc16_dc_avx2, "avx2", convert_avx2, INPUT_SC16, 1)
+X86_CONVERTER(convert_sc16q11_nodc_avx2, "avx2", convert_avx2, INPUT_SC16Q11, 0)
+X86_CONVERTER(convert_sc16q11_dc_avx2, "avx2", convert_avx2, INPUT_SC16Q11, 1)
+
+X86_CONVERTER(convert_uc8_nodc_sse2, "sse2", convert_sse2, INPUT_UC8, 0)
+X86_CONVERTER(convert_uc8_dc_sse2, "sse2", convert_sse2, INPUT_UC8, 1)
+X86_CONVERTER(convert_sc16_nodc_sse2, "sse2", convert_sse2, INPUT_SC16, 0)
+X86_CONVERTER(convert_sc16_dc_sse2, "sse2", convert_sse2, INPUT_SC16, 1)
+X86_CONVERTER(convert_sc16q11_nodc_sse2, "sse2", convert_sse2, INPUT_SC16Q11, 0)
+X86_CONVERTER(convert_sc16q11_dc_sse2, "sse2", convert_sse2, INPUT_SC16Q11, 1)
+
+#undef X86_CONVERTER
+
+#endif /* defined(CONVERT_X86) */
+
+#if defined(CONVERT_NEON)
+
+static inline float32x4_t sqrt_neon(float32x4_t x) {
+#if defined(__aarch64__)
+    return vsqrtq_f32(x);
+#else
+    // 32 bit ARM has no vector sqrt: x * 1/sqrt(x), refined with two newton-raphson steps
+    float32x4_t e = vrsqrteq_f32(x);
+    e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+    e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+    // 1/sqrt(0) is inf, keep 0 for 0
+    return vbslq_f32(vceqq_f32(x, vdupq_n_f32(0)), x, vmulq_f32(x, e));
+#endif
+}
+
+static inline float32x4_t dc_block_neon(float32x4_t x, float32x4_t *z1, float32x4_t dc_a, float32x4_t b1, float32x4_t b2, float32x4_t bpow) {
+    const float32x4_t zero = vdupq_n_f32(0);
+    float32x4_t y = vmulq_f32(x, dc_a);
+    y = vmlaq_f32(y, b1, vextq_f32(zero, y, 3));
+    y = vmlaq_f32(y, b2, vextq_f32(zero, y, 2));
+    float32x4_t z = vmlaq_f32(y, bpow, *z1);
+    *z1 = vdupq_n_f32(vgetq_lane_f32(z, 3));
+    return vsubq_f32(x, z);
+}
+
+struct neon_consts {
+    float32x4_t dc_a;
+    float32x4_t b1;
+    float32x4_t b2;
+    float32x4_t bpow;
+};
+
+// magnitude of 4 samples, with optional DC block
+static inline void convert4_neon(int filter_dc, float32x4_t fI, float32x4_t fQ, const struct neon_consts *c,
+        float32x4_t *z1_I, float32x4_t *z1_Q, float32x4_t *sum_level, float32x4_t *sum_power, uint16_t *out) {
+    if (filter_dc) {
+        fI = dc_block_neon(fI, z1_I, c->dc_a, c->b1, c->b2, c->bpow);
+        fQ = dc_block_neon(fQ, z1_Q, c->dc_a, c->b1, c->b2, c->bpow);
+    }
+
+    float32x4_t magsq = vminq_f32(vmlaq_f32(vmulq_f32(fI, fI), fQ, fQ), vdupq_n_f32(1.0f));
+    float32x4_t mag = sqrt_neon(magsq);
+    *sum_power = vaddq_f32(*sum_power, magsq);
+    *sum_level = vaddq_f32(*sum_level, mag);
+
+    uint32x4_t scaled = vcvtq_u32_f32(vmlaq_f32(vdupq_n_f32(0.5f), mag, vdupq_n_f32(65535.0f)));
+    vst1_u16(out, vqmovn_u32(scaled));
+}
+
+__attribute__ ((always_inline))
+static inline void convert_neon(input_format_t format, int filter_dc,
+        void *iq_data,
+        uint16_t *mag_data,
+        unsigned nsamples,
+        struct converter_state *state,
+        double *out_mean_level,
+        double *out_mean_power) {
+    struct neon_consts c;
+    c.dc_a = vdupq_n_f32(state->dc_a);
+    c.b1 = vdupq_n_f32(state->dc_pow[0]);
+    c.b2 = vdupq_n_f32(state->dc_pow[1]);
+    c.bpow = vld1q_f32(state->dc_pow);
+    const float32x4_t uc8_offset = vdupq_n_f32(127.5f);
+    const float32x4_t uc8_scale = vdupq_n_f32(1.0f / 127.5f);
+    const float32x4_t sc16_scale = vdupq_n_f32(format == INPUT_SC16 ? 1.0f / 32768.0f : 1.0f / 2048.0f);
+    float32x4_t z1_I = vdupq_n_f32(state->z1_I);
+    float32x4_t z1_Q = vdupq_n_f32(state->z1_Q);
+    float32x4_t sum_level = vdupq_n_f32(0);
+    float32x4_t sum_power = vdupq_n_f32(0);
+
+    unsigned n = nsamples & ~7u;
+    for (unsigned i = 0; i < n; i += 8) {
+        float32x4_t fI[2], fQ[2];
+        if (format == INPUT_UC8) {
+            uint8x8x2_t v = vld2_u8((uint8_t *) iq_data + 2 * i);
+            uint16x8_t I = vmovl_u8(v.val[0]);
+            uint16x8_t Q = vmovl_u8(v.val[1]);
+            fI[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(I)));
+            fI[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(I)));
+            fQ[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(Q)));
+            fQ[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(Q)));
+            for (int k = 0; k < 2; k++) {
+                fI[k] = vmulq_f32(vsubq_f32(fI[k], uc8_offset), uc8_scale);
+                fQ[k] = vmulq_f32(vsubq_f32(fQ[k], uc8_offset), uc8_scale);
+            }
+        } else {
+            int16x8x2_t v = vld2q_s16((int16_t *) iq_data + 2 * i);
+            fI[0] = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[0])));
+            fI[1] = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[0])));
+            fQ[0] = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[1])));
+            fQ[1] = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[1])));
+            for (int k = 0; k < 2; k++) {
+                fI[k] = vmulq_f32(fI[k], sc16_scale);
+                fQ[k] = vmulq_f32(fQ[k], sc16_scale);
+            }
+        }
+
+        convert4_neon(filter_dc, fI[0], fQ[0], &c, &z1_I, &z1_Q, &sum_level, &sum_power, mag_data + i);
+        convert4_neon(filter_dc, fI[1], fQ[1], &c, &z1_I, &z1_Q, &sum_level, &sum_power, mag_data + i + 4);
+    }
+
+    double total_level = (double) vgetq_lane_f32(sum_level, 0) + vgetq_lane_f32(sum_level, 1)
+        + vgetq_lane_f32(sum_level, 2) + vgetq_lane_f32(sum_level, 3);
+    double total_power = (double) vgetq_lane_f32(sum_power, 0) + vgetq_lane_f32(sum_power, 1)
+        + vgetq_lane_f32(sum_power, 2) + vgetq_lane_f32(sum_power, 3);
+
+    float z1_I_tail = vgetq_lane_f32(z1_I, 0);
+    float z1_Q_tail = vgetq_lane_f32(z1_Q, 0);
+    convert_tail(format, filter_dc, iq_data, mag_data, n, nsamples, state, &z1_I_tail, &z1_Q_tail, &total_level, &total_power);
+    state->z1_I = z1_I_tail;
+    state->z1_Q = z1_Q_tail;
+
+    if (out_mean_level) {
+        *out_mean_level = total_level / nsamples;
+    }
+
+    if (out_mean_power) {
+        *out_mean_power = total_power / nsamples;
+    }
+}
+
+#define NEON_CONVERTER(name, format, filter_dc) \
+    static void name(void *iq_data, uint16_t *mag_data, unsigned nsamples, struct converter_state *state, \
+            double *out_mean_level, double *out_mean_power) { \
+        convert_neon(format, filter_dc, iq_data, mag_data, nsamples, state, out_mean_level, out_mean_power); \
+    }
+
+NEON_CONVERTER(convert_uc8_nodc_neon, INPUT_UC8, 0)
+NEON_CONVERTER(convert_uc8_dc_neon, INPUT_UC8, 1)
+NEON_CONVERTER(convert_sc16_nodc_neon, INPUT_SC16, 0)
+NEON_CONVERTER(convert_sc16_dc_neon, INPUT_SC16, 1)
+NEON_CONVERTER(convert_sc16q11_nodc_neon, INPUT_SC16Q11, 0)
+NEON_CONVERTER(convert_sc16q11_dc_neon, INPUT_SC16Q11, 1)
+
+#undef NEON_CONVERTER
+
+#endif /* defined(CONVERT_NEON) */
+
 static struct {
     input_format_t format;
     int can_filter_dc;
@@ -427,7 +849,32 @@ static struct {
     bool(*init)();
 } converters_table[] = {
     // In order of preference
+#if defined(CONVERT_X86)
+    { INPUT_UC8, 0, convert_uc8_nodc_avx2, "UC8, AVX2, no DC", cpu_has_avx2},
+#endif
+    // the lookup table beats SSE2 / NEON for UC8 without DC filter
     { INPUT_UC8, 0, convert_uc8_nodc, "UC8, integer/table path", init_uc8_lookup},
+#if defined(CONVERT_X86)
+    { INPUT_UC8, 0, convert_uc8_nodc_sse2, "UC8, SSE2, no DC", cpu_has_sse2},
+    { INPUT_UC8, 1, convert_uc8_dc_avx2, "UC8, AVX2", cpu_has_avx2},
+    { INPUT_SC16, 0, convert_sc16_nodc_avx2, "SC16, AVX2, no DC", cpu_has_avx2},
+    { INPUT_SC16, 1, convert_sc16_dc_avx2, "SC16, AVX2", cpu_has_avx2},
+    { INPUT_SC16Q11, 0, convert_sc16q11_nodc_avx2, "SC16Q11, AVX2, no DC", cpu_has_avx2},
+    { INPUT_SC16Q11, 1, convert_sc16q11_dc_avx2, "SC16Q11, AVX2", cpu_has_avx2},
+    { INPUT_UC8, 1, convert_uc8_dc_sse2, "UC8, SSE2", cpu_has_sse2},
+    { INPUT_SC16, 0, convert_sc16_nodc_sse2, "SC16, SSE2, no DC", cpu_has_sse2},
+    { INPUT_SC16, 1, convert_sc16_dc_sse2, "SC16, SSE2", cpu_has_sse2},
+    { INPUT_SC16Q11, 0, convert_sc16q11_nodc_sse2, "SC16Q11, SSE2, no DC", cpu_has_sse2},
+    { INPUT_SC16Q11, 1, convert_sc16q11_dc_sse2, "SC16Q11, SSE2", cpu_has_sse2},
+#endif
+#if defined(CONVERT_NEON)
+    { INPUT_UC8, 0, convert_uc8_nodc_neon, "UC8, NEON, no DC", NULL},
+    { INPUT_UC8, 1, convert_uc8_dc_neon, "UC8, NEON", NULL},
+    { INPUT_SC16, 0, convert_sc16_nodc_neon, "SC16, NEON, no DC", NULL},
+    { INPUT_SC16, 1, convert_sc16_dc_neon, "SC16, NEON", NULL},
+    { INPUT_SC16Q11, 0, convert_sc16q11_nodc_neon, "SC16Q11, NEON, no DC", NULL},
+    { INPUT_SC16Q11, 1, convert_sc16q11_dc_neon, "SC16Q11, NEON", NULL},
+#endif
     { INPUT_UC8, 1, convert_uc8_generic, "UC8, float path", NULL},
     { INPUT_SC16, 0, convert_sc16_nodc, "SC16, float path, no DC", NULL},
     { INPUT_SC16, 1, convert_sc16_generic, "SC16, float path", NULL},
@@ -440,28 +887,18 @@ static struct {
     { 0, 0, NULL, NULL, NULL}
 };
 
-iq_convert_fn init_converter(input_format_t format,
+iq_convert_fn init_converter_by_index(int index,
         double sample_rate,
         int filter_dc,
         struct converter_state **out_state) {
-    int i;
-
-    for (i = 0; converters_table[i].fn; ++i) {
-        if (converters_table[i].format != format)
-            continue;
-        if (filter_dc && !converters_table[i].can_filter_dc)
-            continue;
-        break;
-    }
+    if (index < 0 || index >= (int) (sizeof(converters_table) / sizeof(converters_table[0])) - 1)
+        return NULL;
 
-    if (!converters_table[i].fn) {
-        fprintf(stderr, "no suitable converter for format=%d dc=%d\n",
-                format, filter_dc);
+    if (filter_dc && !converters_table[index].can_filter_dc)
         return NULL;
-    }
 
-    if (converters_table[i].init) {
-        if (!converters_table[i].init())
+    if (converters_table[index].init) {
+        if (!converters_table[index].init())
             return NULL;
     }
 
@@ -484,11 +921,53 @@ iq_convert_fn init_converter(input_format_t format,
         (*out_state)->dc_a = 0.0;
     }
 
+    for (int k = 0; k < 8; k++) {
+        (*out_state)->dc_pow[k] = pow((*out_state)->dc_b, k + 1);
+    }
+
+    return converters_table[index].fn;
+}
+
+const char *converter_description(int index, input_format_t *out_format, int *out_can_filter_dc) {
+    if (index < 0 || index >= (int) (sizeof(converters_table) / sizeof(converters_table[0])) - 1)
+        return NULL;
+
+    if (out_format)
+        *out_format = converters_table[index].format;
+    if (out_can_filter_dc)
+        *out_can_filter_dc = converters_table[index].can_filter_dc;
+
+    return converters_table[index].description;
+}
+
+iq_convert_fn init_converter(input_format_t format,
+        double sample_rate,
+        int filter_dc,
+        struct converter_state **out_state) {
+    iq_convert_fn fn = NULL;
+    int i;
+
+    for (i = 0; converters_table[i].fn; ++i) {
+        if (converters_table[i].format != format)
+            continue;
+        if (filter_dc && !converters_table[i].can_filter_dc)
+            continue;
+        // skip converters this CPU doesn't support
+        if ((fn = init_converter_by_index(i, sample_rate, filter_dc, out_state)))
+            break;
+    }
+
+    if (!fn) {
+        fprintf(stderr, "no suitable converter for format=%d dc=%d\n",
+                format, filter_dc);
+        return NULL;
+    }
+
     if (Modes.sdr_type == SDR_IFILE) {
         fprintf(stderr, "init_converter: using %s\n", converters_table[i].description);
     }
 
-    return converters_table[i].fn;
+    return fn;
 }
 
 void cleanup_converter(struct converter_state *state) {
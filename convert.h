@@ -43,6 +43,18 @@ iq_convert_fn init_converter (input_format_t format,
                               int filter_dc,
                               struct converter_state **out_state);
 
+// initialize a specific entry of the converter table, for benchmarking
+// returns NULL if the index is out of range or the converter is unusable
+iq_convert_fn init_converter_by_index (int index,
+                                       double sample_rate,
+                                       int filter_dc,
+                                       struct converter_state **out_state);
+
+// description of a converter table entry, NULL if the index is out of range
+const char *converter_description (int index,
+                                   input_format_t *out_format,
+                                   int *out_can_filter_dc);
+
 void cleanup_converter (struct converter_state *state);
 
 #endif
@@ -32,7 +32,9 @@ static struct errorinfo NO_ERRORS;
 
 // CRC values for all single-byte messages;
 // used to speed up CRC calculation.
-ALIGNED static uint32_t crc_table[256];
+// crc_table[k][b] is the CRC of byte b followed by k zero bytes,
+// so 8 message bytes can be folded into the remainder at once (slicing-by-8)
+ALIGNED static uint32_t crc_table[8][256];
 
 // Syndrome values for all single-bit errors;
 // used to speed up construction of error-
@@ -53,7 +55,13 @@ static void initLookupTables() {
                 c = (c << 1);
         }
 
-        crc_table[i] = c & 0x00ffffff;
+        crc_table[0][i] = c & 0x00ffffff;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (i = 0; i < 256; ++i) {
+            uint32_t c = crc_table[k - 1][i];
+            crc_table[k][i] = ((c << 8) ^ crc_table[0][c >> 16]) & 0x00ffffff;
+        }
     }
 
     memset(msg, 0, sizeof (msg));
@@ -66,15 +74,36 @@ static void initLookupTables() {
 
 uint32_t modesChecksum(uint8_t *message, int bits) {
     uint32_t rem = 0;
-    int i;
     int n = bits / 8;
+    uint8_t *p = message;
+    uint8_t *end = message + n - 3;
 
     assert(bits % 8 == 0);
     assert(n >= 3);
 
-    for (i = 0; i < n - 3; ++i) {
-        rem = (rem << 8) ^ crc_table[message[i] ^ ((rem & 0xff0000) >> 16)];
-        rem = rem & 0xffffff;
+    // the first three bytes of each slice are combined with the 24 bit remainder
+    while (end - p >= 8) {
+        rem = crc_table[7][p[0] ^ (rem >> 16)]
+            ^ crc_table[6][p[1] ^ ((rem >> 8) & 0xff)]
+            ^ crc_table[5][p[2] ^ (rem & 0xff)]
+            ^ crc_table[4][p[3]]
+            ^ crc_table[3][p[4]]
+            ^ crc_table[2][p[5]]
+            ^ crc_table[1][p[6]]
+            ^ crc_table[0][p[7]];
+        p += 8;
+    }
+    // 56 bit messages: 4 bytes
+    while (end - p >= 4) {
+        rem = crc_table[3][p[0] ^ (rem >> 16)]
+            ^ crc_table[2][p[1] ^ ((rem >> 8) & 0xff)]
+            ^ crc_table[1][p[2] ^ (rem & 0xff)]
+            ^ crc_table[0][p[3]];
+        p += 4;
+    }
+    while (p < end) {
+        rem = ((rem << 8) ^ crc_table[0][*p ^ (rem >> 16)]) & 0xffffff;
+        p++;
     }
 
     rem = rem ^ (message[n - 3] << 16) ^ (message[n - 2] << 8) ^ (message[n - 1]);
@@ -87,6 +116,53 @@ static int bitErrorTableSize_short;
 static struct errorinfo *bitErrorTable_long;
 static int bitErrorTableSize_long;
 
+// The sorted error tables are hashed into an open addressing table for
+// lookups: at most 1/4 of the slots are used so the average probe is short,
+// empty slots have errors == 0.
+struct syndromeHash {
+    struct errorinfo *slots;
+    uint32_t mask;
+    int shift;
+};
+
+static struct syndromeHash syndromeHash_short;
+static struct syndromeHash syndromeHash_long;
+
+static inline uint32_t syndromeSlot(const struct syndromeHash *hash, uint32_t syndrome) {
+    return (syndrome * 0x9E3779B1U) >> hash->shift;
+}
+
+static void prepareSyndromeHash(struct syndromeHash *hash, struct errorinfo *table, int tablesize) {
+    int bits = 4;
+    while ((1 << bits) < 4 * tablesize)
+        ++bits;
+
+    hash->shift = 32 - bits;
+    hash->mask = (1U << bits) - 1;
+    hash->slots = aligned_malloc((1 << bits) * sizeof (struct errorinfo));
+    memset(hash->slots, 0, (1 << bits) * sizeof (struct errorinfo));
+
+    for (int i = 0; i < tablesize; ++i) {
+        // undetectable errors are never looked up
+        if (table[i].syndrome == 0)
+            continue;
+        uint32_t slot = syndromeSlot(hash, table[i].syndrome);
+        while (hash->slots[slot].errors)
+            slot = (slot + 1) & hash->mask;
+        hash->slots[slot] = table[i];
+    }
+}
+
+static struct errorinfo *syndromeLookup(const struct syndromeHash *hash, uint32_t syndrome) {
+    uint32_t slot = syndromeSlot(hash, syndrome);
+    while (hash->slots[slot].errors) {
+        if (hash->slots[slot].syndrome == syndrome)
+            return &hash->slots[slot];
+        slot = (slot + 1) & hash->mask;
+    }
+    return NULL;
+}
+
 // compare two errorinfo structures
 static int syndrome_compare(const void *x, const void *y) {
     struct errorinfo *ex = (struct errorinfo*) x;
@@ -350,14 +426,16 @@ static struct errorinfo *prepareErrorTable(int bits, int max_correct, int max_de
 }
 
 // Precompute syndrome tables for 56- and 112-bit messages.
+// Can be called again, the tables of the previous call are replaced.
 void modesChecksumInit(int fixBits) {
     initLookupTables();
 
+    crcCleanupTables();
+
     switch (fixBits) {
         case 0:
-            bitErrorTable_short = bitErrorTable_long = NULL;
-            bitErrorTableSize_short = bitErrorTableSize_long = 0;
-            break;
+            // no error correction, modesChecksumDiagnose only knows error free messages
+            return;
 
         case 1:
             // For 1 bit correction, we have 100% coverage up to 4 bit detection, so don't bother
@@ -375,34 +453,31 @@ void modesChecksumInit(int fixBits) {
             fprintf(stderr, "done.\n");
             break;
     }
+
+    prepareSyndromeHash(&syndromeHash_short, bitErrorTable_short, bitErrorTableSize_short);
+    prepareSyndromeHash(&syndromeHash_long, bitErrorTable_long, bitErrorTableSize_long);
 }
 
 // Given an error syndrome and message length, return
 // an error-correction descriptor, or NULL if the
 // syndrome is uncorrectable
 struct errorinfo *modesChecksumDiagnose(uint32_t syndrome, int bitlen) {
-    struct errorinfo *table;
-    int tablesize;
-
-    struct errorinfo ei;
+    struct syndromeHash *hash;
 
     if (syndrome == 0)
         return &NO_ERRORS;
 
     assert(bitlen == 56 || bitlen == 112);
     if (bitlen == 56) {
-        table = bitErrorTable_short;
-        tablesize = bitErrorTableSize_short;
+        hash = &syndromeHash_short;
     } else {
-        table = bitErrorTable_long;
-        tablesize = bitErrorTableSize_long;
+        hash = &syndromeHash_long;
     }
 
-    if (!table)
+    if (!hash->slots)
         return NULL;
 
-    ei.syndrome = syndrome;
-    return bsearch(&ei, table, tablesize, sizeof (struct errorinfo), syndrome_compare);
+    return syndromeLookup(hash, syndrome);
 }
 
 // Given a message and an error-correction descriptor,
@@ -422,22 +497,189 @@ void modesChecksumFix(uint8_t *msg, struct errorinfo *info) {
  *
  */
 void crcCleanupTables(void) {
-    if (bitErrorTable_short != NULL)
-        free(bitErrorTable_short);
-
-    if (bitErrorTable_long != NULL)
-        free(bitErrorTable_long);
+    sfree(bitErrorTable_short);
+    sfree(bitErrorTable_long);
+    bitErrorTableSize_short = bitErrorTableSize_long = 0;
+    sfree(syndromeHash_short.slots);
+    sfree(syndromeHash_long.slots);
+    syndromeHash_short = syndromeHash_long = (struct syndromeHash) { 0 };
 }
 
 #ifdef CRCDEBUG
 
+// byte at a time CRC and bsearch syndrome lookup, the reference for the benchmark
+static uint32_t referenceChecksum(uint8_t *message, int bits) {
+    uint32_t rem = 0;
+    int n = bits / 8;
+
+    for (int i = 0; i < n - 3; ++i) {
+        rem = (rem << 8) ^ crc_table[0][message[i] ^ ((rem & 0xff0000) >> 16)];
+        rem = rem & 0xffffff;
+    }
+
+    rem = rem ^ (message[n - 3] << 16) ^ (message[n - 2] << 8) ^ (message[n - 1]);
+    return rem;
+}
+
+static struct errorinfo *referenceDiagnose(uint32_t syndrome, int bitlen) {
+    struct errorinfo ei;
+
+    if (syndrome == 0)
+        return &NO_ERRORS;
+
+    ei.syndrome = syndrome;
+    if (bitlen == 56)
+        return bsearch(&ei, bitErrorTable_short, bitErrorTableSize_short, sizeof (struct errorinfo), syndrome_compare);
+    else
+        return bsearch(&ei, bitErrorTable_long, bitErrorTableSize_long, sizeof (struct errorinfo), syndrome_compare);
+}
+
+static uint64_t benchRandom(void) {
+    static uint64_t state = 0x2545F4914F6CDD1DULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static double benchElapsed(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+#define BENCH_MESSAGES 4096
+
+// checksum, diagnose and fix every message until the time is up, returns messages per second
+static double benchRun(uint8_t *msgs, int bits, double seconds, int reference, int *corrected) {
+    int bytes = bits / 8;
+    uint8_t scratch[MODES_LONG_MSG_BYTES];
+    uint64_t count = 0;
+    struct timespec start;
+
+    *corrected = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        for (int i = 0; i < BENCH_MESSAGES; i++) {
+            memcpy(scratch, msgs + i * bytes, bytes);
+            uint32_t crc;
+            struct errorinfo *ei;
+            if (reference) {
+                crc = referenceChecksum(scratch, bits);
+                ei = referenceDiagnose(crc, bits);
+            } else {
+                crc = modesChecksum(scratch, bits);
+                ei = modesChecksumDiagnose(crc, bits);
+            }
+            modesChecksumFix(scratch, ei);
+            if (count == 0)
+                *corrected += (ei != NULL);
+        }
+        count += BENCH_MESSAGES;
+    } while (benchElapsed(&start) < seconds);
+
+    return count / benchElapsed(&start);
+}
+
+// modesChecksumInit called again must replace the tables, 0 fix bits leaves none
+static int reinitCheck(void) {
+    uint8_t msg[MODES_LONG_MSG_BYTES] = { 0x8d };
+    uint32_t crc = modesChecksum(msg, MODES_LONG_MSG_BITS);
+    msg[MODES_LONG_MSG_BYTES - 3] = crc >> 16;
+    msg[MODES_LONG_MSG_BYTES - 2] = crc >> 8;
+    msg[MODES_LONG_MSG_BYTES - 1] = crc;
+    msg[MODES_LONG_MSG_BYTES / 2] ^= 0x10;
+    uint32_t syndrome = modesChecksum(msg, MODES_LONG_MSG_BITS);
+    int failures = 0;
+
+    int expected[] = { 1, 0, 2, 1 };
+    for (int i = 0; i < 4; i++) {
+        int fixBits = expected[i];
+        modesChecksumInit(fixBits);
+        struct errorinfo *ei = modesChecksumDiagnose(syndrome, MODES_LONG_MSG_BITS);
+        if ((ei != NULL) != (fixBits > 0) || (ei && ei->errors != 1)) {
+            fprintf(stderr, "REINIT MISMATCH: %d fix bits, 1 bit error %s\n", fixBits, ei ? "corrected" : "not corrected");
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// crctests bench [seconds]: messages per second with 0, 1 and 2 bit errors (--aggressive tables)
+static int benchmark(double seconds) {
+    static uint8_t msgs[BENCH_MESSAGES * MODES_LONG_MSG_BYTES];
+    int failures = 0;
+
+    modesChecksumInit(2);
+
+    fprintf(stderr, "\n%5s %6s %12s %12s %10s\n", "bits", "errors", "ref Mmsg/s", "new Mmsg/s", "corrected");
+    for (int bits = MODES_SHORT_MSG_BITS; bits <= MODES_LONG_MSG_BITS; bits += MODES_LONG_MSG_BITS - MODES_SHORT_MSG_BITS) {
+        int bytes = bits / 8;
+        for (int errors = 0; errors <= MODES_MAX_BITERRORS; errors++) {
+            for (int i = 0; i < BENCH_MESSAGES; i++) {
+                uint8_t *msg = msgs + i * bytes;
+                for (int j = 0; j < bytes - 3; j++)
+                    msg[j] = benchRandom();
+                msg[bytes - 3] = msg[bytes - 2] = msg[bytes - 1] = 0;
+                uint32_t crc = modesChecksum(msg, bits);
+                msg[bytes - 3] = crc >> 16;
+                msg[bytes - 2] = crc >> 8;
+                msg[bytes - 1] = crc;
+
+                // distinct error bits, leaving the DF alone
+                int flipped[MODES_MAX_BITERRORS];
+                for (int k = 0; k < errors; k++) {
+                    int bit;
+                    do {
+                        bit = 5 + benchRandom() % (bits - 5);
+                    } while (k == 1 && bit == flipped[0]);
+                    flipped[k] = bit;
+                    msg[bit >> 3] ^= 1 << (7 - (bit & 7));
+                }
+
+                // the fast paths must agree with the reference
+                uint32_t syndrome = modesChecksum(msg, bits);
+                struct errorinfo *ei = modesChecksumDiagnose(syndrome, bits);
+                struct errorinfo *ref = referenceDiagnose(referenceChecksum(msg, bits), bits);
+                if (syndrome != referenceChecksum(msg, bits)
+                        || (ei == NULL) != (ref == NULL)
+                        || (ei && (ei->errors != ref->errors || memcmp(ei->bit, ref->bit, sizeof(ei->bit))))) {
+                    fprintf(stderr, "MISMATCH: %d bits, %d errors, syndrome %06x reference %06x\n",
+                            bits, errors, syndrome, referenceChecksum(msg, bits));
+                    failures++;
+                }
+            }
+
+            int corrected, refCorrected;
+            double ref = benchRun(msgs, bits, seconds, 1, &refCorrected);
+            double now = benchRun(msgs, bits, seconds, 0, &corrected);
+            fprintf(stderr, "%5d %6d %12.2f %12.2f %9.1f%%\n", bits, errors, ref * 1e-6, now * 1e-6,
+                    100.0 * corrected / BENCH_MESSAGES);
+        }
+    }
+
+    failures += reinitCheck();
+    crcCleanupTables();
+
+    if (failures) {
+        fprintf(stderr, "%d mismatches against the reference implementation!\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv) {
     int shortlen, longlen;
     int i;
     struct errorinfo *shorttable, *longtable;
 
+    if (argc >= 2 && !strcmp(argv[1], "bench")) {
+        return benchmark(argc >= 3 ? atof(argv[2]) : 1.0);
+    }
+
     if (argc < 3) {
         fprintf(stderr, "syntax: crctests <ncorrect> <ndetect>\n");
+        fprintf(stderr, "        crctests bench [seconds]\n");
         return 1;
     }
 
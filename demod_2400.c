@@ -24,6 +24,16 @@
 #include "readsb.h"
 #include <assert.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PREAMBLE_SCAN_X86
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PREAMBLE_SCAN_NEON
+#endif
+
 #ifdef MODEAC_DEBUG
 #include <gd.h>
 #endif
@@ -127,6 +137,167 @@ static void init_bitsets()
     }
 }
 
+// Preamble candidate scanning
+//
+// Before doing any real work on a sample position we check 3 sample pairs
+// that must be ordered a certain way for a preamble to start there:
+//
+//     pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]
+//
+// This cheap check rejects most positions and is where most of the demodulator
+// CPU time goes. The scanners below evaluate it for a block of n positions
+// (n a multiple of 64) and set bit i of the bitmap if position i is a candidate.
+// The result must be exactly the same for all implementations.
+//
+// Reading up to m[n + 15 + vector width] is fine as the magnitude buffers
+// are a lot larger than that due to Modes.trailing_samples.
+
+typedef void (*preamble_scan_fn)(const uint16_t *m, unsigned n, uint64_t *bitmap);
+
+static void preamble_scan_scalar(const uint16_t *m, unsigned n, uint64_t *bitmap) {
+    for (unsigned w = 0; w < n / 64; w++) {
+        const uint16_t *pa = m + w * 64;
+        uint64_t bits = 0;
+        for (unsigned k = 0; k < 64; k++, pa++) {
+            uint64_t candidate = (pa[1] > pa[7]) & (pa[12] > pa[14]) & (pa[12] > pa[15]);
+            bits |= candidate << k;
+        }
+        bitmap[w] = bits;
+    }
+}
+
+#ifdef PREAMBLE_SCAN_X86
+
+// SSE2 / AVX2 only have signed 16 bit comparisons, flip the sign bit to compare unsigned
+
+__attribute__((target("sse2")))
+static inline __m128i cmpgt_epu16_sse2(__m128i a, __m128i b) {
+    const __m128i sign = _mm_set1_epi16((short) 0x8000);
+    return _mm_cmpgt_epi16(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i candidates_sse2(const uint16_t *pa) {
+    __m128i p1 = _mm_loadu_si128((const __m128i *) (pa + 1));
+    __m128i p7 = _mm_loadu_si128((const __m128i *) (pa + 7));
+    __m128i p12 = _mm_loadu_si128((const __m128i *) (pa + 12));
+    __m128i p14 = _mm_loadu_si128((const __m128i *) (pa + 14));
+    __m128i p15 = _mm_loadu_si128((const __m128i *) (pa + 15));
+    return _mm_and_si128(cmpgt_epu16_sse2(p1, p7),
+            _mm_and_si128(cmpgt_epu16_sse2(p12, p14), cmpgt_epu16_sse2(p12, p15)));
+}
+
+__attribute__((target("sse2")))
+static void preamble_scan_sse2(const uint16_t *m, unsigned n, uint64_t *bitmap) {
+    for (unsigned w = 0; w < n / 64; w++) {
+        const uint16_t *pa = m + w * 64;
+        uint64_t bits = 0;
+        for (unsigned k = 0; k < 64; k += 16, pa += 16) {
+            // 2 x 8 lanes of 0x0000 / 0xffff --> 16 lanes of 0x00 / 0xff --> 16 bits
+            __m128i packed = _mm_packs_epi16(candidates_sse2(pa), candidates_sse2(pa + 8));
+            bits |= (uint64_t) (uint16_t) _mm_movemask_epi8(packed) << k;
+        }
+        bitmap[w] = bits;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i cmpgt_epu16_avx2(__m256i a, __m256i b) {
+    const __m256i sign = _mm256_set1_epi16((short) 0x8000);
+    return _mm256_cmpgt_epi16(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i candidates_avx2(const uint16_t *pa) {
+    __m256i p1 = _mm256_loadu_si256((const __m256i *) (pa + 1));
+    __m256i p7 = _mm256_loadu_si256((const __m256i *) (pa + 7));
+    __m256i p12 = _mm256_loadu_si256((const __m256i *) (pa + 12));
+    __m256i p14 = _mm256_loadu_si256((const __m256i *) (pa + 14));
+    __m256i p15 = _mm256_loadu_si256((const __m256i *) (pa + 15));
+    return _mm256_and_si256(cmpgt_epu16_avx2(p1, p7),
+            _mm256_and_si256(cmpgt_epu16_avx2(p12, p14), cmpgt_epu16_avx2(p12, p15)));
+}
+
+__attribute__((target("avx2")))
+static void preamble_scan_avx2(const uint16_t *m, unsigned n, uint64_t *bitmap) {
+    for (unsigned w = 0; w < n / 64; w++) {
+        const uint16_t *pa = m + w * 64;
+        uint64_t bits = 0;
+        for (unsigned k = 0; k < 64; k += 32, pa += 32) {
+            // packs works per 128 bit lane, restore sample order with the permute
+            __m256i packed = _mm256_packs_epi16(candidates_avx2(pa), candidates_avx2(pa + 16));
+            packed = _mm256_permute4x64_epi64(packed, 0xD8);
+            bits |= (uint64_t) (uint32_t) _mm256_movemask_epi8(packed) << k;
+        }
+        bitmap[w] = bits;
+    }
+}
+
+static bool cpu_has_sse2() {
+    return __builtin_cpu_supports("sse2");
+}
+
+static bool cpu_has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif /* PREAMBLE_SCAN_X86 */
+
+#ifdef PREAMBLE_SCAN_NEON
+
+static void preamble_scan_neon(const uint16_t *m, unsigned n, uint64_t *bitmap) {
+    // NEON has no movemask, weight the lanes and add them up instead
+    static const uint16_t weights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint16x8_t w8 = vld1q_u16(weights);
+
+    for (unsigned w = 0; w < n / 64; w++) {
+        const uint16_t *pa = m + w * 64;
+        uint64_t bits = 0;
+        for (unsigned k = 0; k < 64; k += 8, pa += 8) {
+            uint16x8_t p12 = vld1q_u16(pa + 12);
+            uint16x8_t c = vandq_u16(vcgtq_u16(vld1q_u16(pa + 1), vld1q_u16(pa + 7)),
+                    vandq_u16(vcgtq_u16(p12, vld1q_u16(pa + 14)), vcgtq_u16(p12, vld1q_u16(pa + 15))));
+            uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vandq_u16(c, w8)));
+            bits |= (vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1)) << k;
+        }
+        bitmap[w] = bits;
+    }
+}
+
+#endif /* PREAMBLE_SCAN_NEON */
+
+static struct {
+    preamble_scan_fn fn;
+    const char *description;
+    bool (*supported)();
+} preamble_scanners[] = {
+    // In order of preference
+#ifdef PREAMBLE_SCAN_X86
+    { preamble_scan_avx2, "AVX2", cpu_has_avx2 },
+    { preamble_scan_sse2, "SSE2", cpu_has_sse2 },
+#endif
+#ifdef PREAMBLE_SCAN_NEON
+    { preamble_scan_neon, "NEON", NULL },
+#endif
+    { preamble_scan_scalar, "scalar", NULL },
+    { NULL, NULL, NULL }
+};
+
+static preamble_scan_fn preamble_scan;
+
+static void init_preamble_scan() {
+    int i;
+    for (i = 0; preamble_scanners[i].fn; i++) {
+        if (!preamble_scanners[i].supported || preamble_scanners[i].supported())
+            break;
+    }
+    preamble_scan = preamble_scanners[i].fn;
+
+    if (Modes.sdr_type == SDR_IFILE) {
+        fprintf(stderr, "demodulate2400: using %s preamble scanner\n", preamble_scanners[i].description);
+    }
+}
+
 
 // extract one byte from the mag buffers using slice_phase functions
 // advance pPtr and phase
@@ -212,8 +383,9 @@ static inline __attribute__((always_inline)) uint8_t slice_byte(uint16_t **pPtr,
     return theByte;
 }
 
-static void score_phase(int try_phase, uint16_t *pa, unsigned char **bestmsg, int *bestscore, int *bestphase, unsigned char **msg, unsigned char *msg1, unsigned char *msg2) {
-    Modes.stats_current.demod_preamblePhase[try_phase - 4]++;
+static void score_phase(int try_phase, uint16_t *pa, unsigned char **bestmsg, int *bestscore, int *bestphase, unsigned char **msg, unsigned char *msg1, unsigned char *msg2, uint32_t *tried, uint32_t *unknownAddr) {
+    *tried |= 1 << (try_phase - 4);
+    unknownAddr[try_phase - 4] = SCORE_ADDR_NONE;
     uint16_t *pPtr;
     int phase, score, bytelen;
 
@@ -243,7 +415,7 @@ static void score_phase(int try_phase, uint16_t *pa, unsigned char **bestmsg, in
     }
 
     // Score the mode S message and see if it's any good.
-    score = scoreModesMessage(*msg, bytelen * 8);
+    score = scoreModesMessage(*msg, bytelen * 8, &unknownAddr[try_phase - 4]);
     if (score > *bestscore) {
         // new high score!
         *bestmsg = *msg;
@@ -257,206 +429,326 @@ static void score_phase(int try_phase, uint16_t *pa, unsigned char **bestmsg, in
     }
 }
 
+#define PREAMBLE_SCAN_BLOCK 4096 // multiple of 64
+
+struct preamble_scan_state {
+    const uint16_t *m;
+    uint32_t end; // stop scanning here
+    uint32_t block; // start of the block covered by bitmap
+    uint32_t blockLen;
+    uint64_t bitmap[PREAMBLE_SCAN_BLOCK / 64];
+};
+
+// return the first preamble candidate at or after pos, end if there is none
+static inline uint32_t next_candidate(struct preamble_scan_state *scan, uint32_t pos) {
+    while (pos < scan->end) {
+        if (pos >= scan->block + scan->blockLen) {
+            // round up to a multiple of 64, candidates past end are discarded below
+            scan->block = pos;
+            scan->blockLen = imin(PREAMBLE_SCAN_BLOCK, (scan->end - pos + 63) & ~63u);
+            preamble_scan(scan->m + scan->block, scan->blockLen, scan->bitmap);
+        }
+        uint32_t offset = pos - scan->block;
+        uint64_t bits = scan->bitmap[offset / 64] >> (offset % 64);
+        if (bits) {
+            pos += __builtin_ctzll(bits);
+            return imin(pos, scan->end);
+        }
+        // nothing left in this word, continue with the next one
+        pos = scan->block + (offset / 64 + 1) * 64;
+    }
+    return scan->end;
+}
+
+// a preamble found by demodRange, not yet passed to decodeModesMessage
+struct demod_msg {
+    int64_t timestampMsg;
+    int64_t sysTimestampMsg;
+    double signalLevel;
+    uint64_t scaled_signal_power;
+    uint32_t pos; // sample offset of the preamble
+    uint32_t tried; // bit n set: phase n + 4 was scored
+    uint32_t unknownAddr[5]; // phase n + 4 scored lower because this address isn't in the icao filter
+    int score;
+    int bestphase;
+    int msglen;
+    int signal_len;
+    unsigned char msg[MODES_LONG_MSG_BYTES];
+};
+
+// one contiguous part of a mag_buf, demodulated by one thread
+struct demod_chunk {
+    struct mag_buf *mag;
+    uint32_t from;
+    uint32_t to;
+    int direct; // decode and use messages right away instead of collecting them
+
+    uint64_t sum_scaled_signal_power;
+    uint32_t preambles;
+    uint32_t rejected_bad;
+    uint32_t rejected_unknown_icao;
+    uint32_t preamblePhase[5];
+
+    struct demod_msg *msgs;
+    int msgCount;
+    int msgAlloc;
+};
+
+static struct demod_chunk *demodChunks;
+static threadpool_task_t *demodTasks;
+static int demodChunkCount;
+
 //
-// Given 'mlen' magnitude samples in 'm', sampled at 2.4MHz,
-// try to demodulate some Mode S messages.
+// Check for a preamble at pa and score the phases that pass.
+// Returns the best score, -42 if there is no preamble.
+// dm->msg and dm->bestphase are only set for a score >= 0.
 //
-void demodulate2400(struct mag_buf *mag) {
-    static struct modesMessage zeroMessage;
-    struct modesMessage mm;
+static inline int demodScore(uint16_t *pa, struct demod_msg *dm) {
     unsigned char msg1[MODES_LONG_MSG_BYTES], msg2[MODES_LONG_MSG_BYTES], *msg;
-
     unsigned char *bestmsg = NULL;
-    int bestscore;
+    int bestscore = -42;
     int bestphase = 0;
-
-    uint16_t *m = mag->data;
-    uint32_t mlen = mag->length;
-
-    uint64_t sum_scaled_signal_power = 0;
-
-    // initialize bitsets on first call
-    if (!valid_df_short_bitset)
-        init_bitsets();
+    int32_t pa_mag, base_noise, ref_level;
 
     msg = msg1;
+    dm->tried = 0;
+
+    // Look for a message starting at around sample 0 with phase offset 3..7
+
+    // Ideal sample values for preambles with different phase
+    // Xn is the first data symbol with phase offset N
+    //
+    // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
+    // phase 3: 2/4\0/5\1 0 0 0 0/5\1/3 3\0 0 0 0 0 0 X4
+    // phase 4: 1/5\0/4\2 0 0 0 0/4\2 2/4\0 0 0 0 0 0 0 X0
+    // phase 5: 0/5\1/3 3\0 0 0 0/3 3\1/5\0 0 0 0 0 0 0 X1
+    // phase 6: 0/4\2 2/4\0 0 0 0 2/4\0/5\1 0 0 0 0 0 0 X2
+    // phase 7: 0/3 3\1/5\0 0 0 0 1/5\0/4\2 0 0 0 0 0 0 X3
+
+    // pa is a position that passed the preamble pre-check (see preamble_scan)
+
+    // 5 noise samples
+    base_noise = pa[5] + pa[8] + pa[16] + pa[17] + pa[18];
+    // pa_mag is the sum of the 4 preamble high bits
+    // minus 2 low bits between each of high bit pairs
+
+    // reduce number of preamble detections if we recently dropped samples
+    if (Modes.stats_15min.samples_dropped)
+        ref_level = base_noise * imax(PREAMBLE_THRESHOLD_PIZERO, Modes.preambleThreshold);
+    else
+        ref_level = base_noise * Modes.preambleThreshold;
+
+    ref_level >>= 5; // divide by 32
+
+    int32_t diff_2_3 =  pa[2] - pa[3];
+    int32_t sum_1_4 = pa[1] + pa[4];
+    int32_t diff_10_11 = pa[10] - pa[11];
+    int32_t common3456 = sum_1_4 - diff_2_3 + pa[9] + pa[12];
+
+    // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
+    // phase 3: 2/4\0/5\1 0 0 0 0/5\1/3 3\0 0 0 0 0 0 X4
+    // phase 4: 1/5\0/4\2 0 0 0 0/4\2 2/4\0 0 0 0 0 0 0 X0
+    pa_mag = common3456 - diff_10_11;
+    if (pa_mag >= ref_level) {
+        // peaks at 1,3,9,11-12: phase 3
+        score_phase(4, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2, &dm->tried, dm->unknownAddr);
+
+        // peaks at 1,3,9,12: phase 4
+        score_phase(5, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2, &dm->tried, dm->unknownAddr);
+    }
 
-    // advance ifile artificial clock even if we don't receive anything
-    if (Modes.sdr_type == SDR_IFILE)
-        Modes.synthetic_now = mag->sysTimestamp;
-
-    uint16_t *pa = m;
-    uint16_t *stop = m + mlen;
-    // don't go all the way to mlen because we increment pa in the pre-check up to 3 times
-    for (; pa < stop; pa++) {
-        int32_t pa_mag, base_noise, ref_level;
-        int msglen;
-
-        // Look for a message starting at around sample 0 with phase offset 3..7
-
-        // Ideal sample values for preambles with different phase
-        // Xn is the first data symbol with phase offset N
-        //
-        // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
-        // phase 3: 2/4\0/5\1 0 0 0 0/5\1/3 3\0 0 0 0 0 0 X4
-        // phase 4: 1/5\0/4\2 0 0 0 0/4\2 2/4\0 0 0 0 0 0 0 X0
-        // phase 5: 0/5\1/3 3\0 0 0 0/3 3\1/5\0 0 0 0 0 0 0 X1
-        // phase 6: 0/4\2 2/4\0 0 0 0 2/4\0/5\1 0 0 0 0 0 0 X2
-        // phase 7: 0/3 3\1/5\0 0 0 0 1/5\0/4\2 0 0 0 0 0 0 X3
-
-        // do a pre-check to reduce CPU usage
-        // some silly unrolling that cuts CPU cycles
-        // due to plenty room in the message buffer for decoding
-        // we can with pa go beyond stop without a buffer overrun ...
-
-        if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-        pa++; if (pa[1] > pa[7] && pa[12] > pa[14] && pa[12] > pa[15]) { goto after_pre; }
-
-        continue;
-
-after_pre:
-        // ... but we must NOT decode if have ran past stop
-        if (!(pa < stop))
-            continue;
+    // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
+    // phase 5: 0/5\1/3 3\0 0 0 0/3 3\1/5\0 0 0 0 0 0 0 X1
+    // phase 6: 0/4\2 2/4\0 0 0 0 2/4\0/5\1 0 0 0 0 0 0 X2
+    pa_mag = common3456 + diff_10_11;
+    if (pa_mag >= ref_level) {
+        // peaks at 1,3-4,9-10,12: phase 5
+        score_phase(6, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2, &dm->tried, dm->unknownAddr);
 
-        // 5 noise samples
-        base_noise = pa[5] + pa[8] + pa[16] + pa[17] + pa[18];
-        // pa_mag is the sum of the 4 preamble high bits
-        // minus 2 low bits between each of high bit pairs
+        // peaks at 1,4,10,12: phase 6
+        score_phase(7, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2, &dm->tried, dm->unknownAddr);
+    }
 
-        // reduce number of preamble detections if we recently dropped samples
-        if (Modes.stats_15min.samples_dropped)
-            ref_level = base_noise * imax(PREAMBLE_THRESHOLD_PIZERO, Modes.preambleThreshold);
-        else
-            ref_level = base_noise * Modes.preambleThreshold;
+    // peaks at 1-2,4,10,12: phase 7
+    // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
+    // phase 7: 0/3 3\1/5\0 0 0 0 1/5\0/4\2 0 0 0 0 0 0 X3
+    pa_mag = sum_1_4 + 2 * diff_2_3 + diff_10_11 + pa[12];
+    if (pa_mag >= ref_level)
+        score_phase(8, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2, &dm->tried, dm->unknownAddr);
 
-        ref_level >>= 5; // divide by 32
+    if (bestscore >= 0) {
+        dm->bestphase = bestphase;
+        memcpy(dm->msg, bestmsg, MODES_LONG_MSG_BYTES);
+    }
+    return bestscore;
+}
 
-        bestscore = -42;
+// timestamps and signal power of a scored message at pa
+static inline void demodMeasure(struct mag_buf *mag, uint16_t *pa, struct demod_msg *dm) {
+    uint16_t *m = mag->data;
+    int msglen = modesMessageLenByType(getbits(dm->msg, 1, 5));
 
-        int32_t diff_2_3 =  pa[2] - pa[3];
-        int32_t sum_1_4 = pa[1] + pa[4];
-        int32_t diff_10_11 = pa[10] - pa[11];
-        int32_t common3456 = sum_1_4 - diff_2_3 + pa[9] + pa[12];
+    dm->pos = pa - m;
+    dm->msglen = msglen;
 
-        // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
-        // phase 3: 2/4\0/5\1 0 0 0 0/5\1/3 3\0 0 0 0 0 0 X4
-        // phase 4: 1/5\0/4\2 0 0 0 0/4\2 2/4\0 0 0 0 0 0 0 X0
-        pa_mag = common3456 - diff_10_11;
-        if (pa_mag >= ref_level) {
-            // peaks at 1,3,9,11-12: phase 3
-            score_phase(4, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2);
+    // For consistency with how the Beast / Radarcape does it,
+    // we report the timestamp at the end of bit 56 (even if
+    // the frame is a 112-bit frame)
+    dm->timestampMsg = mag->sampleTimestamp + (pa - m) * 5 + (8 + 56) * 12 + dm->bestphase;
 
-            // peaks at 1,3,9,12: phase 4
-            score_phase(5, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2);
-        }
+    // compute message receive time as block-start-time + difference in the 12MHz clock
+    dm->sysTimestampMsg = mag->sysTimestamp + receiveclock_ms_elapsed(mag->sampleTimestamp, dm->timestampMsg);
 
-        // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
-        // phase 5: 0/5\1/3 3\0 0 0 0/3 3\1/5\0 0 0 0 0 0 0 X1
-        // phase 6: 0/4\2 2/4\0 0 0 0 2/4\0/5\1 0 0 0 0 0 0 X2
-        pa_mag = common3456 + diff_10_11;
-        if (pa_mag >= ref_level) {
-            // peaks at 1,3-4,9-10,12: phase 5
-            score_phase(6, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2);
+    // measure signal power
+    uint64_t scaled_signal_power = 0;
+    int signal_len = msglen * 12 / 5;
 
-            // peaks at 1,4,10,12: phase 6
-            score_phase(7, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2);
-        }
+    for (int k = 0; k < signal_len; ++k) {
+        uint32_t mag = pa[19 + k];
+        scaled_signal_power += mag * mag;
+    }
 
-        // peaks at 1-2,4,10,12: phase 7
-        // sample#: 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0
-        // phase 7: 0/3 3\1/5\0 0 0 0 1/5\0/4\2 0 0 0 0 0 0 X3
-        pa_mag = sum_1_4 + 2 * diff_2_3 + diff_10_11 + pa[12];
-        if (pa_mag >= ref_level)
-            score_phase(8, pa, &bestmsg, &bestscore, &bestphase, &msg, msg1, msg2);
+    dm->scaled_signal_power = scaled_signal_power;
+    dm->signal_len = signal_len;
+    dm->signalLevel = scaled_signal_power / 65535.0 / 65535.0 / signal_len;
+}
 
+// whether the icao filter changed since dm was scored in a way that can change
+// its score: an address one of its phases didn't find was added or addresses
+// were dropped
+static inline int demodFilterChanged(struct demod_msg *dm, uint32_t removals) {
+    if (icaoFilterRemovals() != removals)
+        return 1;
+    for (int k = 0; k < 5; k++) {
+        if ((dm->tried & (1 << k)) && dm->unknownAddr[k] != SCORE_ADDR_NONE && icaoFilterTest(dm->unknownAddr[k]))
+            return 1;
+    }
+    return 0;
+}
 
-        // no preamble detected
-        if (bestscore == -42)
-            continue;
+// preamble statistics of a scored position
+static inline void demodCountPreamble(struct demod_chunk *chunk, struct demod_msg *dm) {
+    // we had at least one phase greater than the preamble threshold
+    // and used scoremodesmessage on those bytes
+    chunk->preambles++;
+    for (int k = 0; k < 5; k++) {
+        if (dm->tried & (1 << k))
+            chunk->preamblePhase[k]++;
+    }
+    if (dm->score == -1)
+        chunk->rejected_unknown_icao++;
+    else if (dm->score < 0)
+        chunk->rejected_bad++;
+}
 
-        // we had at least one phase greater than the preamble threshold
-        // and used scoremodesmessage on those bytes
-        Modes.stats_current.demod_preambles++;
+//
+// Decode a demodulated message and pass it to the next layer.
+// Returns 1 if the message was accepted.
+//
+static int demodUseMessage(struct demod_chunk *chunk, struct demod_msg *dm) {
+    static struct modesMessage zeroMessage;
+    struct modesMessage mm;
 
-        // Do we have a candidate?
-        if (bestscore < 0) {
+    // Set initial mm structure details
+    mm = zeroMessage;
+    mm.timestampMsg = dm->timestampMsg;
+    mm.sysTimestampMsg = dm->sysTimestampMsg;
 
-            if (bestscore == -1)
-                Modes.stats_current.demod_rejected_unknown_icao++;
-            else
-                Modes.stats_current.demod_rejected_bad++;
-            continue; // nope.
-        }
+    // advance ifile artifical clock for every message received
+    if (Modes.sdr_type == SDR_IFILE)
+        Modes.synthetic_now = mm.sysTimestampMsg;
 
-        msglen = modesMessageLenByType(getbits(bestmsg, 1, 5));
+    mm.score = dm->score;
 
-        // Set initial mm structure details
-        mm = zeroMessage;
+    // Decode the received message
+    memcpy(mm.msg, dm->msg, MODES_LONG_MSG_BYTES);
+    int result = decodeModesMessage(&mm);
+    if (result < 0) {
+        if (result == -1)
+            chunk->rejected_unknown_icao++;
+        else
+            chunk->rejected_bad++;
+        return 0;
+    }
+    Modes.stats_current.demod_accepted[mm.correctedbits]++;
+    Modes.stats_current.demod_bestPhase[dm->bestphase - 4]++;
+
+    // signal power was measured by demodRange
+    double signal_power = dm->scaled_signal_power / 65535.0 / 65535.0;
+    mm.signalLevel = dm->signalLevel;
+    Modes.stats_current.signal_power_sum += signal_power;
+    Modes.stats_current.signal_power_count += dm->signal_len;
+    chunk->sum_scaled_signal_power += dm->scaled_signal_power;
+
+    if (mm.signalLevel > Modes.stats_current.peak_signal_power)
+        Modes.stats_current.peak_signal_power = mm.signalLevel;
+    if (mm.signalLevel > 0.50119)
+        Modes.stats_current.strong_signal_count++; // signal power above -3dBFS
+
+    // Pass data to the next layer
+    useModesMessage(&mm);
+    return 1;
+}
 
-        // For consistency with how the Beast / Radarcape does it,
-        // we report the timestamp at the end of bit 56 (even if
-        // the frame is a 112-bit frame)
-        mm.timestampMsg = mag->sampleTimestamp + (pa -m) * 5 + (8 + 56) * 12 + bestphase;
+//
+// Look for Mode S messages with a preamble starting in [chunk->from, chunk->to).
+// The message itself may extend past chunk->to, the trailing samples of the
+// mag_buf take care of the last chunk.
+//
+// Without chunk->direct every scored position is collected, including the
+// ones inside a well scored message: only demodulate2400 knows whether that
+// message is accepted and the following positions can be skipped.
+//
+static void demodRange(void *arg) {
+    struct demod_chunk *chunk = arg;
+    struct mag_buf *mag = chunk->mag;
+    struct demod_msg local;
 
-        // compute message receive time as block-start-time + difference in the 12MHz clock
-        mm.sysTimestampMsg = mag->sysTimestamp + receiveclock_ms_elapsed(mag->sampleTimestamp, mm.timestampMsg);
+    uint16_t *m = mag->data;
 
-        // advance ifile artifical clock for every message received
-        if (Modes.sdr_type == SDR_IFILE)
-            Modes.synthetic_now = mm.sysTimestampMsg;
-
-        mm.score = bestscore;
-
-        // Decode the received message
-        {
-            memcpy(mm.msg, bestmsg, MODES_LONG_MSG_BYTES);
-            int result = decodeModesMessage(&mm);
-            if (result < 0) {
-                if (result == -1)
-                    Modes.stats_current.demod_rejected_unknown_icao++;
-                else
-                    Modes.stats_current.demod_rejected_bad++;
-                continue;
-            } else {
-                Modes.stats_current.demod_accepted[mm.correctedbits]++;
+    struct preamble_scan_state scan;
+    scan.m = m;
+    scan.end = chunk->to;
+    scan.block = scan.blockLen = 0;
+
+    uint16_t *pa;
+    uint16_t *stop = m + chunk->to;
+    for (pa = m + next_candidate(&scan, chunk->from); pa < stop; pa = m + next_candidate(&scan, pa - m + 1)) {
+        struct demod_msg *dm = &local;
+        if (!chunk->direct) {
+            if (chunk->msgCount == chunk->msgAlloc) {
+                chunk->msgAlloc = imax(64, 2 * chunk->msgAlloc);
+                chunk->msgs = realloc(chunk->msgs, chunk->msgAlloc * sizeof(struct demod_msg));
+                if (!chunk->msgs) {
+                    fprintf(stderr, "demodRange: out of memory!\n");
+                    abort();
+                }
             }
+            dm = &chunk->msgs[chunk->msgCount];
         }
 
-        Modes.stats_current.demod_bestPhase[bestphase - 4]++;
+        dm->score = demodScore(pa, dm);
 
-        // measure signal power
-        {
-            double signal_power;
-            uint64_t scaled_signal_power = 0;
-            int signal_len = msglen * 12 / 5;
-            int k;
-
-            for (k = 0; k < signal_len; ++k) {
-                uint32_t mag = pa[19 + k];
-                scaled_signal_power += mag * mag;
-            }
+        // no preamble detected
+        if (dm->score == -42)
+            continue;
 
-            signal_power = scaled_signal_power / 65535.0 / 65535.0;
-            mm.signalLevel = signal_power / signal_len;
-            Modes.stats_current.signal_power_sum += signal_power;
-            Modes.stats_current.signal_power_count += signal_len;
-            sum_scaled_signal_power += scaled_signal_power;
+        if (dm->score >= 0)
+            demodMeasure(mag, pa, dm);
+        else
+            dm->pos = pa - m;
 
-            if (mm.signalLevel > Modes.stats_current.peak_signal_power)
-                Modes.stats_current.peak_signal_power = mm.signalLevel;
-            if (mm.signalLevel > 0.50119)
-                Modes.stats_current.strong_signal_count++; // signal power above -3dBFS
+        if (!chunk->direct) {
+            chunk->msgCount++;
+            continue;
         }
 
+        demodCountPreamble(chunk, dm);
+
+        // Do we have a candidate?
+        if (dm->score < 0 || !demodUseMessage(chunk, dm))
+            continue; // nope.
+
         // Skip over the message:
         // (we actually skip to 8 bits before the end of the message,
         //  because we can often decode two messages that *almost* collide,
@@ -466,10 +758,120 @@ after_pre:
         //pa += msglen * 12 / 5;
         //
         // let's test something, only jump part of the message and let the preamble detection handle the rest.
-        pa += msglen * 8 / 4;
+        pa += dm->msglen * 8 / 4;
+    }
+}
 
-        // Pass data to the next layer
-        useModesMessage(&mm);
+void demodulate2400Init() {
+    init_bitsets();
+    init_preamble_scan();
+
+    demodChunkCount = imax(1, Modes.demodThreads);
+    demodChunks = calloc(demodChunkCount, sizeof(struct demod_chunk));
+    demodTasks = calloc(demodChunkCount, sizeof(threadpool_task_t));
+    if (!demodChunks || !demodTasks) {
+        fprintf(stderr, "Out of memory allocating demodulator state.\n");
+        exit(1);
+    }
+}
+
+void demodulate2400Cleanup() {
+    for (int i = 0; i < demodChunkCount; i++) {
+        sfree(demodChunks[i].msgs);
+    }
+    sfree(demodChunks);
+    sfree(demodTasks);
+    demodChunkCount = 0;
+}
+
+//
+// Given 'mlen' magnitude samples in 'm', sampled at 2.4MHz,
+// try to demodulate some Mode S messages.
+//
+// With --demod-threads, the buffer is split into one chunk per thread.
+// The threads find and score preambles, decodeModesMessage and everything
+// after it runs on this thread in sample order once all chunks are done.
+// Both paths decode the same messages: positions are rescored if the
+// icao filter changed after the threads scored them in a way that
+// matters for their score.
+//
+void demodulate2400(struct mag_buf *mag) {
+    uint32_t mlen = mag->length;
+    uint64_t sum_scaled_signal_power = 0;
+
+    // advance ifile artificial clock even if we don't receive anything
+    if (Modes.sdr_type == SDR_IFILE)
+        Modes.synthetic_now = mag->sysTimestamp;
+
+    int chunkCount = Modes.demodPool ? demodChunkCount : 1;
+    // keep chunk boundaries aligned to the preamble scan granularity
+    uint32_t chunkLen = ((mlen / chunkCount) + 63) & ~63u;
+
+    for (int i = 0; i < chunkCount; i++) {
+        struct demod_chunk *chunk = &demodChunks[i];
+        chunk->mag = mag;
+        chunk->from = imin(mlen, i * chunkLen);
+        chunk->to = (i == chunkCount - 1) ? mlen : imin(mlen, (i + 1) * chunkLen);
+        chunk->direct = (chunkCount == 1);
+        chunk->sum_scaled_signal_power = 0;
+        chunk->preambles = 0;
+        chunk->rejected_bad = 0;
+        chunk->rejected_unknown_icao = 0;
+        memset(chunk->preamblePhase, 0, sizeof(chunk->preamblePhase));
+        chunk->msgCount = 0;
+
+        demodTasks[i].function = demodRange;
+        demodTasks[i].argument = chunk;
+    }
+
+    if (chunkCount == 1) {
+        demodRange(&demodChunks[0]);
+    } else {
+        // the threads score against the icao filter as it is now
+        uint32_t filterGeneration = icaoFilterGeneration();
+        uint32_t filterRemovals = icaoFilterRemovals();
+        struct timespec before = threadpool_get_cumulative_thread_time(Modes.demodPool);
+        threadpool_run(Modes.demodPool, demodTasks, chunkCount);
+        struct timespec after = threadpool_get_cumulative_thread_time(Modes.demodPool);
+        timespec_add_elapsed(&before, &after, &Modes.stats_current.demod_cpu);
+
+        // same order and skipping as the single threaded loop in demodRange:
+        // positions inside an accepted message are dropped, after a rejected
+        // one the next position is tried
+        uint32_t horizon = 0;
+        for (int i = 0; i < chunkCount; i++) {
+            struct demod_chunk *chunk = &demodChunks[i];
+            for (int j = 0; j < chunk->msgCount; j++) {
+                struct demod_msg *dm = &chunk->msgs[j];
+                if (dm->pos < horizon)
+                    continue;
+
+                // an earlier message of this buffer changed the icao filter,
+                // score again like the single threaded loop would if that
+                // can make a difference here
+                if (icaoFilterGeneration() != filterGeneration && demodFilterChanged(dm, filterRemovals)) {
+                    uint16_t *pa = mag->data + dm->pos;
+                    dm->score = demodScore(pa, dm);
+                    if (dm->score >= 0)
+                        demodMeasure(mag, pa, dm);
+                }
+
+                demodCountPreamble(chunk, dm);
+
+                if (dm->score >= 0 && demodUseMessage(chunk, dm))
+                    horizon = dm->pos + dm->msglen * 8 / 4 + 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < chunkCount; i++) {
+        struct demod_chunk *chunk = &demodChunks[i];
+        Modes.stats_current.demod_preambles += chunk->preambles;
+        Modes.stats_current.demod_rejected_bad += chunk->rejected_bad;
+        Modes.stats_current.demod_rejected_unknown_icao += chunk->rejected_unknown_icao;
+        for (int k = 0; k < 5; k++)
+            Modes.stats_current.demod_preamblePhase[k] += chunk->preamblePhase[k];
+        sum_scaled_signal_power += chunk->sum_scaled_signal_power;
     }
 
     /* update noise power */
@@ -480,7 +882,6 @@ after_pre:
     }
 }
 
-
 #ifdef MODEAC_DEBUG
 
 static int yscale(unsigned signal) {
@@ -35,6 +35,8 @@
 
 struct mag_buf;
 
+void demodulate2400Init ();
+void demodulate2400Cleanup ();
 void demodulate2400 (struct mag_buf *mag);
 void demodulate2400AC (struct mag_buf *mag);
 
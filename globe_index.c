@@ -769,6 +769,9 @@ static int load_aircraft(char **p, char *end, int64_t now) {
     // make sure we don't think an extra position is still buffered in the trace memory
     a->tracePosBuffered = 0;
 
+    // the saved epoch is from the previous run
+    a->dirtyEpoch = Modes.apiEpoch;
+
     // read trace
     int size_state = stateBytes(a->trace_len);
     int size_all = stateAllBytes(a->trace_len);
@@ -72,6 +72,8 @@ static struct argp_option optionsReadsb[] = {
     {"freq", OptFreq, "<hz>", 0, "Set frequency (default: 1090 MHz)", 1},
     {"interactive", OptInteractive, 0, 0, "Interactive mode refreshing data on screen. Implies --throttle", 1},
     {"raw", OptRaw, 0, 0, "Show only messages hex values", 1},
+    {"demod-threads", OptDemodThreads, "<n>", 0, "Number of threads demodulating each sample buffer (default: 1, limited to the number of cores)", 1},
+    {"mag-buffers", OptMagBuffers, "<n>", 0, "Number of sample buffers queued between SDR and demodulator (default: "stringize(MODES_MAG_BUFFERS)", max: "stringize(MODES_MAG_BUFFERS_MAX)")", 1},
     {"preamble-threshold", OptPreambleThreshold, "<"stringize(PREAMBLE_THRESHOLD_MIN)"-"stringize(PREAMBLE_THRESHOLD_MAX)">", 0, "lower threshold --> more CPU usage (default: "stringize(PREAMBLE_THRESHOLD_DEFAULT)", pi zero / pi 1: "stringize(PREAMBLE_THRESHOLD_PIZERO)", hot CPU "stringize(PREAMBLE_THRESHOLD_HOT)")", 1},
     {"forward-mlat", OptForwardMlat, 0, 0, "Allow forwarding of received mlat results to output ports", 1},
     {"mlat", OptMlat, 0, 0, "Display raw messages in Beast ASCII mode", 1},
@@ -110,9 +112,13 @@ static struct argp_option optionsReadsb[] = {
     {"db-file", OptDbFile, "<file.csv.gz>", 0, "Default: \"none\"", 1},
     {"db-file-lt", OptDbFileLongtype, 0, 0, "Write long type to aircraft.json as field desc", 1},
     {0,0,0,0, "Network options:", 2},
-    {"net-connector", OptNetConnector, "<ip,port,protocol>", 0, "Establish connection, can be specified multiple times (e.g. 127.0.0.1,23004,beast_out) Protocols: beast_out, beast_in, raw_out, raw_in, sbs_in, sbs_in_jaero, sbs_out, sbs_out_jaero, vrs_out, json_out (one failover ip/address,port can be specified: primary-address,primary-port,protocol,failover-address,failover-port)", 2},
+    {"net-connector", OptNetConnector, "<ip,port,protocol>", 0, "Establish connection, can be specified multiple times (e.g. 127.0.0.1,23004,beast_out) Protocols: beast_out, beast_in, raw_out, raw_in, sbs_in, sbs_in_jaero, sbs_out, sbs_out_jaero, vrs_out, json_out (one failover ip/address,port can be specified: primary-address,primary-port,protocol,failover-address,failover-port) UDP Beast: udp_out / multicast_out send datagrams to the address, udp_in receives on the local address (joins the group for a multicast address) zlib compressed: beast_zlib_out, beast_reduce_zlib_out, sbs_zlib_out, beast_zlib_in, sbs_zlib_in", 2},
     {"net", OptNet, 0, 0, "Enable networking", 2},
     {"net-only", OptNetOnly, 0, 0, "Enable just networking, no RTL device or file used", 2},
+    {"beast-replay", OptBeastReplay, "<file>", 0, "Benchmark: replay a Beast binary capture as fast as possible through decoding, tracking and all outputs, time follows the message timestamps. Implies --net-only, prints throughput, CPU and memory use at exit", 2},
+    {"track-threads", OptTrackThreads, "<n>", 0, "With --net-only, number of threads tracking aircraft, each one owns a share of the aircraft (default: 1, limited to the number of cores)", 2},
+    {"net-io-threads", OptNetIoThreads, "<n>", 0, "Number of threads doing socket I/O for beast_in, raw_in and sbs_in listeners, each with its own epoll set and SO_REUSEPORT listeners (default: 0, all network I/O on the main thread; limited to the number of cores)", 2},
+    {"net-io-uring", OptNetIoUring, 0, 0, "Use io_uring for the listeners and clients of the main network loop: multishot accept and receive into provided buffers, sends batched per output flush (Linux 6.0+, falls back to epoll if not available)", 2},
     {"net-bind-address", OptNetBindAddr, "<ip>", 0, "IP address to bind to (default: Any; Use 127.0.0.1 for private)", 2},
     {"net-bo-port", OptNetBoPorts, "<ports>", 0, "TCP Beast output listen ports (default: 0)", 2},
     {"net-ri-port", OptNetRiPorts, "<ports>", 0, "TCP raw input listen ports  (default: 0)", 2},
@@ -122,6 +128,8 @@ static struct argp_option optionsReadsb[] = {
     {"net-sbs-jaero-port", OptNetJaeroPorts, "<ports>", 0, "TCP SBS Jaero output listen ports (default: 0)", 2},
     {"net-sbs-jaero-in-port", OptNetJaeroInPorts, "<ports>", 0, "TCP SBS Jaero input listen ports (default: 0)", 2},
     {"net-bi-port", OptNetBiPorts, "<ports>", 0, "TCP Beast input listen ports  (default: 0)", 2},
+    {"net-bi-udp-port", OptNetBiUdpPorts, "<ports>", 0, "UDP Beast input ports, datagrams of whole Beast messages as sent by udp_out (default: 0)", 2},
+    {"net-bi-zlib-port", OptNetBiZlibPorts, "<ports>", 0, "zlib compressed Beast input ports, as sent by beast_zlib_out / beast_reduce_zlib_out (default: 0)", 2},
     {"net-vrs-port", OptNetVRSPorts, "<ports>", 0, "TCP VRS json output listen ports (default: 0)", 2},
     {"net-vrs-interval", OptNetVRSInterval, "<seconds>", 0, "TCP VRS json output interval (default: 5)", 2},
     {"net-json-port", OptNetJsonPorts, "<ports>", 0, "TCP json position output listen ports (requires --write-json-globe-index) (default: 0)", 2},
@@ -138,6 +146,8 @@ static struct argp_option optionsReadsb[] = {
     {"net-ro-size", OptNetRoSize, "<size>", 0, "TCP output flush size (maximum amount of internally buffered data before writing to network) (default: 1200)", 2},
     {"net-ro-interval", OptNetRoIntervall, "<rate>", 0, "TCP output flush interval in seconds (maximum interval between two network writes of accumulated data)(default: 0.05, valid values 0.005 - 1.0)", 2},
     {"net-connector-delay", OptNetConnectorDelay, "<seconds>", 0, "Outbound re-connection delay (default: 30)", 2},
+    {"net-multicast-ttl", OptNetMulticastTtl, "<hops>", 0, "TTL of multicast_out datagrams (default: 1, local network only)", 2},
+    {"net-slow-client-policy", OptNetSlowClientPolicy, "<[service=]policy,...>", 0, "Output clients that can't keep up: disconnect (default), drop (oldest queued output), thin (beast_reduce style output until caught up) or pause (skip output until caught up). Without service= for all output services, services are named like the connector protocols (e.g. beast_out=thin,sbs_out=drop)", 2},
     {"net-heartbeat", OptNetHeartbeat, "<rate>", 0, "TCP heartbeat rate in seconds (default: 60 sec; 0 to disable)", 2},
     {"net-buffer", OptNetBuffer, "<n>", 0, "TCP buffer size 64Kb * (2^n) (default: n=2, 256Kb)", 2},
     {"net-verbatim", OptNetVerbatim, 0, 0, "Forward messages unchanged", 2},
@@ -171,7 +181,7 @@ static struct argp_option optionsReadsb[] = {
     {"beast-serial", OptBeastSerial, "<path>", 0, "Path to GNS HULC serial device (default /dev/ttyUSB0)", 6},
 
     {0,0,0,0, "ifile-specific options, use with --ifile:", 7},
-    {"ifile", OptIfileName, "<path>", 0, "Read samples from given file ('-' for stdin)", 7},
+    {"ifile", OptIfileName, "<path>", 0, "Read samples from given file ('-' for stdin), repeat to process several files back to back", 7},
     {"iformat", OptIfileFormat, "<type>", 0, "Set sample format (UC8, SC16, SC16Q11)", 7},
     {"throttle", OptIfileThrottle, 0, 0, "Process samples at the original capture speed", 7},
 #ifdef ENABLE_PLUTOSDR
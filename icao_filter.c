@@ -35,6 +35,10 @@ static uint32_t *icao_filter_b;
 static uint32_t *icao_filter_active;
 
 static uint32_t occupied;
+// bumped whenever icaoFilterTest may change its result for some address
+static uint32_t generation;
+// bumped whenever an address may stop matching
+static uint32_t removals;
 
 static inline uint32_t filterHash(uint32_t addr) {
     return addrHash(addr, filterBits);
@@ -68,6 +72,10 @@ static void icaoFilterResize(uint32_t bits) {
     uint32_t *oldA = icao_filter_a;
     uint32_t *oldB = icao_filter_b;
 
+    // entries only in the inactive table are dropped
+    generation++;
+    removals++;
+
     filterBits = bits;
     filterBuckets = 1ULL << filterBits;
     filterSize = filterBuckets * sizeof(uint32_t);
@@ -99,6 +107,8 @@ void icaoFilterExpire() {
     }
     // reset occupied count
     occupied = 0;
+    generation++;
+    removals++;
     if (icao_filter_active == icao_filter_a) {
 
         memset(icao_filter_b, 0xFF, filterSize);
@@ -120,6 +130,8 @@ void icaoFilterAdd(uint32_t addr) {
         }
     }
     if (icao_filter_active[h] == EMPTY) {
+        if (!icaoFilterTest(addr))
+            generation++;
         occupied++;
         icao_filter_active[h] = addr;
     }
@@ -129,6 +141,14 @@ void icaoFilterAdd(uint32_t addr) {
     }
 }
 
+uint32_t icaoFilterGeneration() {
+    return generation;
+}
+
+uint32_t icaoFilterRemovals() {
+    return removals;
+}
+
 int icaoFilterTest(uint32_t addr) {
     uint32_t h, h0;
 
@@ -34,6 +34,14 @@ void icaoFilterAdd (uint32_t addr);
 // Test if the given address matches the filter
 int icaoFilterTest (uint32_t addr);
 
+// Changes whenever icaoFilterTest may return a different result
+// for some address, results are unchanged while this stays the same.
+uint32_t icaoFilterGeneration ();
+
+// Changes whenever icaoFilterTest may stop matching some address. While
+// this stays the same, only addresses that didn't match can change.
+uint32_t icaoFilterRemovals ();
+
 // Test if the top 16 bits match any previously added address.
 // If they do, returns an arbitrary one of the matched
 // addresses. Returns 0 on failure.
@@ -783,6 +783,29 @@ char *sprintAircraftObject(char *p, char *end, struct aircraft *a, int64_t now,
     return p;
 }
 
+static inline void expiresAt(int64_t *expires, int64_t t, int64_t now) {
+    if (t > now && t < *expires)
+        *expires = t;
+}
+
+// until when the output of sprintAircraftObject (printMode 0) stays the same
+// apart from seen and seen_pos, assuming the aircraft doesn't change
+int64_t aircraftJsonExpires(struct aircraft *a, int64_t now) {
+    int64_t expires = INT64_MAX;
+    expiresAt(&expires, a->wind_updated + TRACK_EXPIRE, now);
+    expiresAt(&expires, a->oat_updated + TRACK_EXPIRE, now);
+    expiresAt(&expires, a->category_updated + Modes.trackExpireJaero, now);
+    expiresAt(&expires, a->seenPosReliable + TRACK_EXPIRE, now);
+    expiresAt(&expires, a->rr_seen + 2 * MINUTES, now);
+    expiresAt(&expires, a->seenPosReliable + 14 * 24 * HOURS, now);
+    if (a->nogpsCounter >= NOGPS_SHOW) {
+        expiresAt(&expires, a->seenAdsbReliable + 15 * SECONDS + 1, now);
+        expiresAt(&expires, a->seenAdsbReliable + NOGPS_DWELL, now);
+    }
+    expiresAt(&expires, a->acas_ra_valid.updated + 15 * SECONDS, now);
+    return expires;
+}
+
 char *sprintAircraftRecent(char *p, char *end, struct aircraft *a, int64_t now, int printMode, struct modesMessage *mm, int64_t recent) {
     if (printMode == 1) {
     }
@@ -976,18 +999,11 @@ int includeAircraftJson(int64_t now, struct aircraft *a) {
     return 0;
 }
 
-struct char_buffer generateAircraftBin() {
-    struct char_buffer cb;
-    int64_t now = mstime();
-    struct aircraft *a;
-
-    struct craftArray *ca = &Modes.aircraftActive;
-    size_t alloc = 4096 + ca->len * sizeof(struct binCraft); // The initial buffer is resized as needed
-
-    char *buf = aligned_malloc(alloc);
-    char *p = buf;
-    char *end = buf + alloc;
-
+// binCraft header, padded to the element size: time, element size, aircraft
+// with position, index, bounding box and message count. Returns where the
+// first element goes.
+char *writeBinCraftHeader(char *p, int64_t now, uint32_t index, int16_t south, int16_t west, int16_t north, int16_t east) {
+    char *start = p;
     uint32_t elementSize = sizeof(struct binCraft);
     memset(p, 0, elementSize);
 
@@ -1000,14 +1016,8 @@ struct char_buffer generateAircraftBin() {
     uint32_t ac_count_pos = Modes.globalStatsCount.readsb_aircraft_with_position;
     memWrite(p, ac_count_pos);
 
-    uint32_t index = 314159; // unnecessary
     memWrite(p, index);
 
-    int16_t south = -90;
-    int16_t west = -180;
-    int16_t north = 90;
-    int16_t east = 180;
-
     memWrite(p, south);
     memWrite(p, west);
     memWrite(p, north);
@@ -1016,10 +1026,29 @@ struct char_buffer generateAircraftBin() {
     uint32_t messageCount = Modes.stats_current.messages_total + Modes.stats_alltime.messages_total;
     memWrite(p, messageCount);
 
-    if (p - buf > (int) elementSize)
-        fprintf(stderr, "buffer overrun aircrafBin\n");
+#undef memWrite
+
+    if (p - start > (int) elementSize)
+        fprintf(stderr, "buffer overrun binCraft header\n");
+
+    return start + elementSize;
+}
+
+struct char_buffer generateAircraftBin() {
+    struct char_buffer cb;
+    int64_t now = mstime();
+    struct aircraft *a;
+
+    struct craftArray *ca = &Modes.aircraftActive;
+    size_t alloc = 4096 + ca->len * sizeof(struct binCraft); // The initial buffer is resized as needed
+
+    char *buf = aligned_malloc(alloc);
+    char *end = buf + alloc;
 
-    p = buf + elementSize;
+    uint32_t index = 314159; // unnecessary
+    char *p = writeBinCraftHeader(buf, now, index, -90, -180, 90, 180);
+
+#define memWrite(p, var) do { memcpy(p, &var, sizeof(var)); p += sizeof(var); } while(0)
 
     for (int i = 0; i < ca->len; i++) {
         a = ca->list[i];
@@ -1075,23 +1104,9 @@ struct char_buffer generateGlobeBin(int globe_index, int mil) {
         alloc += ca->len * sizeof(struct binCraft);
 
     char *buf = aligned_malloc(alloc);
-    char *p = buf;
     char *end = buf + alloc;
 
-    uint32_t elementSize = sizeof(struct binCraft);
-    memset(p, 0, elementSize);
-
-#define memWrite(p, var) do { memcpy(p, &var, sizeof(var)); p += sizeof(var); } while(0)
-
-    memWrite(p, now);
-
-    memWrite(p, elementSize);
-
-    uint32_t ac_count_pos = Modes.globalStatsCount.readsb_aircraft_with_position;
-    memWrite(p, ac_count_pos);
-
     uint32_t index = globe_index < 0 ? 42777 : globe_index;
-    memWrite(p, index);
 
     int16_t south = -90;
     int16_t west = -180;
@@ -1113,18 +1128,9 @@ struct char_buffer generateGlobeBin(int globe_index, int mil) {
         east = tile.east;
     }
 
-    memWrite(p, south);
-    memWrite(p, west);
-    memWrite(p, north);
-    memWrite(p, east);
-
-    uint32_t messageCount = Modes.stats_current.messages_total + Modes.stats_alltime.messages_total;
-    memWrite(p, messageCount);
+    char *p = writeBinCraftHeader(buf, now, index, south, west, north, east);
 
-    if (p - buf > (int) elementSize)
-        fprintf(stderr, "buffer overrun globeBin\n");
-
-    p = buf + elementSize;
+#define memWrite(p, var) do { memcpy(p, &var, sizeof(var)); p += sizeof(var); } while(0)
 
     if (good && ca->list) {
         for (int i = 0; i < ca->len; i++) {
@@ -2059,58 +2065,84 @@ skip_fields:
     return cb;
 }
 
+struct clientsJson {
+    char *buf;
+    char *p;
+    char *end;
+    size_t buflen;
+    int64_t now;
+};
+
+static void clientsJsonAppend(struct client *c, void *ctx) {
+    struct clientsJson *cj = ctx;
+    struct net_service *service = c->service;
+    if (!service)
+        return;
+    if (!service->read_handler)
+        return;
+
+    // check if we have enough space
+    if ((cj->p + 1000) >= cj->end) {
+        int used = cj->p - cj->buf;
+        cj->buflen *= 2;
+        cj->buf = (char *) realloc(cj->buf, cj->buflen);
+        cj->p = cj->buf + used;
+        cj->end = cj->buf + cj->buflen;
+    }
+
+    // clients of a network I/O thread are updated by that thread while we read them
+    char uuid[64]; // needs 36 chars and null byte
+    sprint_uuid(__atomic_load_n(&c->receiverId, __ATOMIC_RELAXED), __atomic_load_n(&c->receiverId2, __ATOMIC_RELAXED), uuid);
+    //fprintf(stderr, "printing rId %016"PRIx64"%016"PRIx64" %s\n", c->receiverId, c->receiverId2, uuid);
+
+    int64_t now = cj->now;
+    double elapsed = (now - c->connectedSince) / 1000.0;
+    int reduceSignaled = service->writer == &Modes.beast_in
+        && __atomic_load_n(&c->pingReceived, __ATOMIC_RELAXED) + 120 * SECONDS > now;
+    double recent_rtt;
+    __atomic_load(&c->recent_rtt, &recent_rtt, __ATOMIC_RELAXED);
+    cj->p = safe_snprintf(cj->p, cj->end, "[\"%s\",\"%49s\",%6.2f,%6.0f,%8.3f,%7.3f, %d,%5.0f],\n",
+            uuid,
+            c->proxy_string,
+            __atomic_load_n(&c->bytesReceived, __ATOMIC_RELAXED) / 128.0 / elapsed,
+            elapsed,
+            (double) __atomic_load_n(&c->messageCounter, __ATOMIC_RELAXED) / elapsed,
+            (double) __atomic_load_n(&c->positionCounter, __ATOMIC_RELAXED) / elapsed,
+            reduceSignaled,
+            recent_rtt);
+
+
+    if (cj->p >= cj->end)
+        fprintf(stderr, "buffer overrun client json\n");
+}
+
 struct char_buffer generateClientsJson() {
     struct char_buffer cb;
+    struct clientsJson cj;
     int64_t now = mstime();
 
-    size_t buflen = 1*1024*1024; // The initial buffer is resized as needed
-    char *buf = (char *) aligned_malloc(buflen), *p = buf, *end = buf + buflen;
+    cj.now = now;
+    cj.buflen = 1*1024*1024; // The initial buffer is resized as needed
+    cj.buf = (char *) aligned_malloc(cj.buflen);
+    cj.p = cj.buf;
+    cj.end = cj.buf + cj.buflen;
 
-    p = safe_snprintf(p, end, "{ \"now\" : %.1f,\n", now / 1000.0);
-    p = safe_snprintf(p, end, "  \"format\" : "
+    cj.p = safe_snprintf(cj.p, cj.end, "{ \"now\" : %.1f,\n", now / 1000.0);
+    cj.p = safe_snprintf(cj.p, cj.end, "  \"format\" : "
             "[ \"receiverId\", \"host:port\", \"avg. kbit/s\", \"conn time(s)\","
             " \"messages/s\", \"positions/s\", \"reduce_signal\", \"recent_rtt(ms)\" ],\n");
 
-    p = safe_snprintf(p, end, "  \"clients\" : [\n");
+    cj.p = safe_snprintf(cj.p, cj.end, "  \"clients\" : [\n");
 
     for (struct net_service *s = Modes.services; s; s = s->next) {
         for (struct client *c = s->clients; c; c = c->next) {
-            if (!c->service)
-                continue;
-            if (!s->read_handler)
-                continue;
-
-            // check if we have enough space
-            if ((p + 1000) >= end) {
-                int used = p - buf;
-                buflen *= 2;
-                buf = (char *) realloc(buf, buflen);
-                p = buf + used;
-                end = buf + buflen;
-            }
-
-            char uuid[64]; // needs 36 chars and null byte
-            sprint_uuid(c->receiverId, c->receiverId2, uuid);
-            //fprintf(stderr, "printing rId %016"PRIx64"%016"PRIx64" %s\n", c->receiverId, c->receiverId2, uuid);
-
-            double elapsed = (now - c->connectedSince) / 1000.0;
-            int reduceSignaled = c->service->writer == &Modes.beast_in
-                && c->pingReceived + 120 * SECONDS > now;
-            p = safe_snprintf(p, end, "[\"%s\",\"%49s\",%6.2f,%6.0f,%8.3f,%7.3f, %d,%5.0f],\n",
-                    uuid,
-                    c->proxy_string,
-                    c->bytesReceived / 128.0 / elapsed,
-                    elapsed,
-                    (double) c->messageCounter / elapsed,
-                    (double) c->positionCounter / elapsed,
-                    reduceSignaled,
-                    c->recent_rtt);
-
-
-            if (p >= end)
-                fprintf(stderr, "buffer overrun client json\n");
+            clientsJsonAppend(c, &cj);
         }
     }
+    // clients owned by network I/O threads (--net-io-threads)
+    netLoopsForEachClient(clientsJsonAppend, &cj);
+
+    char *buf = cj.buf, *p = cj.p, *end = cj.end;
 
     if (*(p-2) == ',')
         *(p-2) = ' ';
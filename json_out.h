@@ -32,8 +32,10 @@ void logACASInfoShort(uint32_t addr, unsigned char *MV, struct aircraft *a, stru
 
 char *sprintACASInfoShort(char *p, char *end, uint32_t addr, unsigned char *MV, struct aircraft *a, struct modesMessage *mm, int64_t now);
 char *sprintAircraftObject(char *p, char *end, struct aircraft *a, int64_t now, int printMode, struct modesMessage *mm);
+int64_t aircraftJsonExpires(struct aircraft *a, int64_t now);
 char *sprintAircraftRecent(char *p, char *end, struct aircraft *a, int64_t now, int printMode, struct modesMessage *mm, int64_t recent);
 struct char_buffer generateAircraftJson(int64_t onlyRecent);
+char *writeBinCraftHeader(char *p, int64_t now, uint32_t index, int16_t south, int16_t west, int16_t north, int16_t east);
 struct char_buffer generateAircraftBin();
 struct char_buffer generateGlobeBin(int globe_index, int mil);
 struct char_buffer generateGlobeJson(int globe_index);
@@ -300,11 +300,21 @@ static inline __attribute__((always_inline)) unsigned char fixDF17msgtype(unsign
     }
 }
 
-int scoreModesMessage(unsigned char *msg, int validbits) {
+// icaoFilterTest for scoreModesMessage, remembers an address that didn't match
+static inline int scoreFilterTest(uint32_t addr, uint32_t *unknownAddr) {
+    if (icaoFilterTest(addr))
+        return 1;
+    *unknownAddr = addr;
+    return 0;
+}
+
+int scoreModesMessage(unsigned char *msg, int validbits, uint32_t *unknownAddr) {
     int msgtype, msgbits, crc, iid;
     uint32_t addr;
     struct errorinfo *ei;
 
+    *unknownAddr = SCORE_ADDR_NONE;
+
     if (validbits < 56)
         return -2;
 
@@ -315,7 +325,7 @@ int scoreModesMessage(unsigned char *msg, int validbits) {
         if (origByte) {
             msg[0] = origByte; // restore byte
             // DF17 message with 1 bit error, return the correct score
-            if (icaoFilterTest(getbits(msg, 9, 32))) // check addr
+            if (scoreFilterTest(getbits(msg, 9, 32), unknownAddr)) // check addr
                 return 1800 / 2;
             else
                 return 1400 / 2;
@@ -350,7 +360,7 @@ int scoreModesMessage(unsigned char *msg, int validbits) {
         case 30: // Comm-D (ELM)
         case 31: // Comm-D (ELM)
 #endif
-            return icaoFilterTest(crc) ? 1000 : -1;
+            return scoreFilterTest(crc, unknownAddr) ? 1000 : -1;
 
         case 11: // All-call reply
             iid = crc & 0x7f;
@@ -373,7 +383,7 @@ int scoreModesMessage(unsigned char *msg, int validbits) {
                 correct_aa_field(&addr, ei);
 
                 // here, IID = 0 implicitly
-                if (icaoFilterTest(addr))
+                if (scoreFilterTest(addr, unknownAddr))
                     return 800;
                 else
                     return -1;
@@ -381,12 +391,12 @@ int scoreModesMessage(unsigned char *msg, int validbits) {
 
             // CRC was correct (ish)
             if (iid == 0) {
-                if (icaoFilterTest(addr))
+                if (scoreFilterTest(addr, unknownAddr))
                     return 1600;
                 else
                     return 750;
             } else { // iid != 0
-                if (icaoFilterTest(addr))
+                if (scoreFilterTest(addr, unknownAddr))
                     return 1000;
                 else
                     return -1;
@@ -402,7 +412,7 @@ int scoreModesMessage(unsigned char *msg, int validbits) {
             addr = getbits(msg, 9, 32);
             correct_aa_field(&addr, ei);
 
-            if (icaoFilterTest(addr))
+            if (scoreFilterTest(addr, unknownAddr))
                 return 1800 / (ei->errors + 1);
             else
                 return 1400 / (ei->errors + 1);
@@ -2247,9 +2257,27 @@ void useModesMessage(struct modesMessage *mm) {
 
     ++Modes.stats_current.messages_total;
 
+    if (Modes.trackPool) {
+        // SBS input looks at the tracking result right away, track it in order with the queue
+        if (!mm->sbs_in) {
+            trackShardQueue(mm);
+            return;
+        }
+        trackShardFlush();
+    }
+
     // Track aircraft state
     a = trackUpdateFromMessage(mm);
 
+    outputModesMessage(mm, a);
+}
+
+//
+// Everything after tracking: display, debug and feeding the output clients.
+// With sharded tracking this runs on the decode thread in message order once
+// a batch has been tracked.
+//
+void outputModesMessage(struct modesMessage *mm, struct aircraft *a) {
     // In non-interactive non-quiet mode, display messages on standard output
     if (!Modes.quiet || mm->addr == Modes.show_only || mm->maybe_addr == Modes.show_only) {
         displayModesMessage(mm);
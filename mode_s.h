@@ -30,10 +30,14 @@
 //
 // Functions exported from mode_s.c
 //
-int scoreModesMessage (unsigned char *msg, int validbits);
+// *unknownAddr is set to the address the score depends on if it's not in the
+// icao filter, SCORE_ADDR_NONE if the score doesn't depend on a missing address
+#define SCORE_ADDR_NONE (0xFFFFFFFF)
+int scoreModesMessage (unsigned char *msg, int validbits, uint32_t *unknownAddr);
 int decodeModesMessage (struct modesMessage *mm);
 void displayModesMessage (struct modesMessage *mm);
 void useModesMessage (struct modesMessage *mm);
+void outputModesMessage (struct modesMessage *mm, struct aircraft *a);
 
 // datafield extraction helpers
 
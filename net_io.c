@@ -60,6 +60,8 @@
 #include <netdb.h>
 #include <poll.h>
 #include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -109,6 +111,540 @@ static void modesCloseClient(struct client *c);
 static int flushClient(struct client *c, int64_t now);
 static char *read_uuid(struct client *c, char *p, char *eod);
 static void modesReadFromClient(struct client *c, int64_t start);
+static void handleEpoll(struct epoll_event *events, int count);
+static int dispatchFrame(struct client *c, char *p, int len, int remote, int64_t now);
+static void netLoopsInit(struct net_service **services, int serviceCount);
+
+//
+//=========================================================================
+//
+// Network I/O threads (--net-io-threads): each one runs its own epoll set
+// with its own SO_REUSEPORT listeners for the TCP input services and owns the
+// clients it accepts. Complete frames are copied into batches which the decode
+// thread runs through the service read handlers, so decoding and tracking see
+// the same calls as for clients of the main loop.
+//
+
+#define NET_BATCH_SIZE (256 * 1024)
+#define NET_LOOP_MAX_QUEUED 32 // batches in flight before a loop stops reading
+#define NET_LOOP_DECODE_BATCHES 4 // batches per loop the decode thread takes each round
+#define NET_LOOP_HOUSEKEEPING 100 // ms
+
+struct net_frame {
+    struct client *client;
+    read_fn handler;
+    uint64_t receiverId; // c->receiverId when the frame was read
+    int64_t now;
+    int32_t len;
+    int32_t remote;
+    char data[]; // frame followed by NUL
+};
+
+struct net_batch {
+    struct net_batch *next;
+    uint64_t seq;
+    int64_t used;
+    char data[NET_BATCH_SIZE];
+};
+
+struct net_loop {
+    threadT thread; // mutex protects clients list changes and the batch queue
+    int index;
+    int epfd;
+    struct epoll_event *events;
+    int maxEvents;
+    struct client *listenSockets;
+    int listenCount;
+    struct client *clients;
+    struct net_batch *filling; // only touched by the loop thread
+    struct net_batch *queued;
+    struct net_batch **queuedTail;
+    struct net_batch *done; // only touched by the decode thread
+    struct net_batch *freeBatches;
+    int inFlight; // batches published and not yet released by the decode thread
+    uint64_t published; // sequence number of the last published batch
+    uint64_t consumed; // sequence number of the last batch released by the decode thread
+    uint32_t currentPing;
+    int64_t nextHousekeeping;
+    int64_t nextBufCheck;
+    struct timespec cpu; // thread CPU not yet added to the stats
+    char aneterr[ANET_ERR_LEN];
+};
+
+static struct net_loop netLoops[NET_IO_THREADS_MAX];
+static int netLoopCount;
+static int netLoopWakeFd = -1; // written by loops after publishing a batch, part of Modes.net_epfd
+static _Thread_local struct net_loop *netLoopCurrent; // loop of the calling thread, NULL on the main loop
+static _Thread_local struct net_frame *netFrameCurrent; // queued frame being decoded
+
+static inline int clientEpfd(struct client *c) {
+    return c->loop ? c->loop->epfd : Modes.net_epfd;
+}
+
+// Flush and send timeouts are about the socket, they stay on the wall clock
+// when a replay runs the synthetic clock much faster than real time
+static inline int64_t flushClock(int64_t now) {
+    return Modes.synthetic_now ? msWallTime() : now;
+}
+
+//
+// io_uring backend (--net-io-uring): the listeners and accepted clients of the
+// main loop use multishot accept and multishot recv into a ring of provided
+// buffers instead of epoll and read(), sends are writev SQEs that go to the
+// kernel together once per writer flush. The ring fd sits in Modes.net_epfd
+// to wake the loop on completions. Connectors, the network I/O threads and
+// anything else not accepted from a listener stay on epoll.
+//
+
+#define URING_ENTRIES 1024
+#define URING_CQ_ENTRIES 16384
+#define URING_BUFS 256 // provided receive buffers
+#define URING_BUF_SIZE (16 * 1024)
+#define URING_BGID 1
+#define URING_REAP_MAX 1024 // completions picked up per loop iteration
+#define URING_DEFERRED 4096 // accept and receive completions waiting for uringReap
+#define URING_REAP_BYTES (4 * MODES_CLIENT_BUF_SIZE) // received data decoded per loop iteration
+
+// low bits of the SQE user_data, the rest is the client pointer
+#define URING_ACCEPT 1
+#define URING_RECV 2
+#define URING_SEND 3
+#define URING_TAG_MASK 7ULL
+
+static struct {
+    int active;
+    int accepting; // createGenericClient: the client comes from an io_uring listener
+    int deferredHead;
+    int deferredCount; // completions not yet handled, uringReap continues with them
+#ifdef HAVE_IO_URING
+    struct uring ring;
+    struct uringBufRing bufs;
+    struct io_uring_cqe *deferred;
+#endif
+} uringNet;
+
+static void uringArmRecv(struct client *c);
+static int uringFlushClient(struct client *c, int64_t now);
+static void uringNetInit(void);
+static void uringNetSubmit(void);
+static void uringDrain(int64_t now);
+
+//
+//=========================================================================
+//
+// Output chunks: a writer fills one chunk, on flush every client queues a
+// reference to it instead of a copy. Writer sized chunks are recycled.
+//
+
+#define NET_CHUNK_POOL 64 // writer sized chunks kept for reuse
+#define NET_SENDQ_SLOTS 16 // initial sendq ring size, grows as needed
+#define NET_SENDQ_IOV 64 // chunks handed to a single writev
+#define NET_SLOW_CLIENT_TIMEOUT (60 * SECONDS) // slow clients not taking any data are disconnected after all
+#define NET_RECEIVERID_FRAME_MAX (2 + 2 * 8) // 0x1a 0xe3 receiverId, every byte may be escaped
+// the thinned output gets at most one receiverId frame per chunk the full output doesn't have
+#define NET_THIN_CHUNK_SIZE (MODES_OUT_BUF_SIZE + NET_RECEIVERID_FRAME_MAX)
+
+static int8_t thinSkip; // the output being written isn't sent to thinned slow clients
+
+// UDP services (--net-bi-udp-port, udp_in / udp_out / multicast_out connectors)
+// carry whole Beast frames in every datagram
+#define NET_UDP_PAYLOAD 1400 // output datagrams stay below this, fits a 1500 byte MTU with IPv6 headers
+#define NET_UDP_BATCH 32 // datagrams per recvmmsg / sendmmsg
+#define NET_UDP_RECV_SIZE 9000 // largest datagram received (jumbo frames), longer ones are dropped
+
+#define NET_ZLIB_READ_SIZE (16*1024) // compressed input read at once, it inflates to several times that
+
+static struct net_chunk *chunkPool;
+static int chunkPoolCount;
+
+static struct net_chunk *chunkAlloc(int size) {
+    struct net_chunk *chunk;
+    if (size == MODES_OUT_BUF_SIZE && chunkPool) {
+        chunk = chunkPool;
+        chunkPool = chunk->next;
+        chunkPoolCount--;
+    } else if (!(chunk = malloc(sizeof(struct net_chunk) + size))) {
+        fprintf(stderr, "Out of memory allocating network output chunk\n");
+        exit(1);
+    }
+    chunk->next = NULL;
+    chunk->refCount = 1;
+    chunk->size = size;
+    chunk->len = 0;
+    chunk->receiverIdFrame = 0;
+    chunk->receiverIdStart = 0;
+    chunk->receiverIdEnd = 0;
+    return chunk;
+}
+
+static void chunkRelease(struct net_chunk *chunk) {
+    if (--chunk->refCount > 0)
+        return;
+    if (chunk->size == MODES_OUT_BUF_SIZE && chunkPoolCount < NET_CHUNK_POOL) {
+        chunk->next = chunkPool;
+        chunkPool = chunk;
+        chunkPoolCount++;
+        return;
+    }
+    free(chunk);
+}
+
+static void chunkPoolFree(void) {
+    while (chunkPool) {
+        struct net_chunk *chunk = chunkPool;
+        chunkPool = chunk->next;
+        free(chunk);
+    }
+    chunkPoolCount = 0;
+}
+
+// Append a chunk to the client sendq, the client takes a reference
+static void clientQueueChunk(struct client *c, struct net_chunk *chunk) {
+    if (c->sendq_count == c->sendq_slots) {
+        int slots = c->sendq_slots * 2;
+        struct net_chunk **sendq = malloc(slots * sizeof(struct net_chunk *));
+        if (!sendq) {
+            fprintf(stderr, "Out of memory allocating client SendQ\n");
+            exit(1);
+        }
+        for (int i = 0; i < c->sendq_count; i++)
+            sendq[i] = c->sendq[(c->sendq_head + i) % c->sendq_slots];
+        free(c->sendq);
+        c->sendq = sendq;
+        c->sendq_slots = slots;
+        c->sendq_head = 0;
+    }
+    c->sendq[(c->sendq_head + c->sendq_count) % c->sendq_slots] = chunk;
+    c->sendq_count++;
+    c->sendq_len += chunk->len;
+    chunk->refCount++;
+}
+
+// zlib connections (*_zlib_* connectors, --net-bi-zlib-port) use one stream
+// per connection. Output is deflated when the writer flushes and only sync
+// flushed every net_output_flush_interval, the bigger blocks compress better
+// and the latency stays what the writer buffering already allows.
+
+static void clientZlibInit(struct client *c, int deflating) {
+    if (!(c->zs = calloc(1, sizeof(z_stream)))) {
+        fprintf(stderr, "Out of memory allocating zlib stream\n");
+        exit(1);
+    }
+    int res = deflating ? deflateInit(c->zs, Z_DEFAULT_COMPRESSION) : inflateInit(c->zs);
+    if (res != Z_OK) {
+        fprintf(stderr, "zlib stream init failed: %s\n", zError(res));
+        exit(1);
+    }
+    c->zsDeflate = deflating;
+    c->zsFlushed = mstime();
+}
+
+static void clientZlibFree(struct client *c) {
+    if (!c->zs)
+        return;
+    if (c->zsDeflate)
+        deflateEnd(c->zs);
+    else
+        inflateEnd(c->zs);
+    sfree(c->zs);
+    c->zsDeflate = 0;
+    c->zsPending = 0;
+}
+
+// Deflate data into the sendq. The compressed output belongs to this client
+// alone, it's appended to the last queued chunk while that has room.
+static void clientDeflate(struct client *c, const char *data, int len, int flush) {
+    z_stream *zs = c->zs;
+    zs->next_in = (Bytef *) data;
+    zs->avail_in = len;
+    do {
+        struct net_chunk *chunk = NULL;
+        if (c->sendq_count)
+            chunk = c->sendq[(c->sendq_head + c->sendq_count - 1) % c->sendq_slots];
+        int queued = chunk && chunk->len < chunk->size;
+        if (!queued)
+            chunk = chunkAlloc(MODES_OUT_BUF_SIZE);
+
+        zs->next_out = (Bytef *) chunk->data + chunk->len;
+        zs->avail_out = chunk->size - chunk->len;
+        deflate(zs, flush); // only fails without progress, the loop ends then
+        int n = chunk->size - chunk->len - zs->avail_out;
+        chunk->len += n;
+
+        if (queued) {
+            c->sendq_len += n;
+        } else {
+            if (chunk->len)
+                clientQueueChunk(c, chunk);
+            chunkRelease(chunk);
+        }
+    } while (zs->avail_in || !zs->avail_out);
+
+    if (flush == Z_NO_FLUSH) {
+        c->zsPending = 1;
+    } else {
+        c->zsPending = 0;
+        c->zsFlushed = mstime();
+    }
+}
+
+// Queue data meant only for this client (pings, beast commands)
+static void clientQueueData(struct client *c, const char *data, int len) {
+    if (c->zsDeflate) {
+        clientDeflate(c, data, len, Z_SYNC_FLUSH);
+        return;
+    }
+    struct net_chunk *chunk = chunkAlloc(len);
+    memcpy(chunk->data, data, len);
+    chunk->len = len;
+    clientQueueChunk(c, chunk);
+    chunkRelease(chunk);
+}
+
+// Beast receiverId frame, big-endian, in its own message to make it backwards compatible.
+// Other dump1090 / readsb versions or beast implementations should discard unknown message types.
+static char *writeReceiverIdFrame(char *p, uint64_t receiverId) {
+    unsigned char ch;
+    *p++ = 0x1a;
+    *p++ = 0xe3; // good enough guess no one is using this.
+    for (int i = 7; i >= 0; i--) {
+        *p++ = (ch = ((receiverId >> (8 * i)) & 0xFF));
+        if (0x1A == ch) {
+            *p++ = ch;
+        }
+    }
+    return p;
+}
+
+static struct net_chunk *receiverIdChunk(uint64_t receiverId) {
+    struct net_chunk *chunk = chunkAlloc(NET_RECEIVERID_FRAME_MAX);
+    chunk->len = writeReceiverIdFrame(chunk->data, receiverId) - chunk->data;
+    chunk->receiverIdFrame = 1;
+    chunk->receiverIdStart = chunk->receiverIdEnd = receiverId;
+    return chunk;
+}
+
+// The beast output queued next assumes a different receiverId than the client
+// was left with: it skipped or dropped output, or was thinned
+static void clientQueueReceiverId(struct client *c, uint64_t receiverId) {
+    if (c->zsDeflate) {
+        char frame[NET_RECEIVERID_FRAME_MAX];
+        clientDeflate(c, frame, writeReceiverIdFrame(frame, receiverId) - frame, Z_NO_FLUSH);
+    } else {
+        struct net_chunk *chunk = receiverIdChunk(receiverId);
+        clientQueueChunk(c, chunk);
+        chunkRelease(chunk);
+    }
+    c->receiverIdSent = receiverId;
+}
+
+// Drop everything still queued for a client
+static void clientSendqClear(struct client *c) {
+    while (c->sendq_count) {
+        chunkRelease(c->sendq[c->sendq_head]);
+        c->sendq_head = (c->sendq_head + 1) % c->sendq_slots;
+        c->sendq_count--;
+    }
+    c->sendq_head = 0;
+    c->sendq_offset = 0;
+    c->sendq_len = 0;
+}
+
+// Drop the oldest queued chunk none of which has been sent yet, the first one
+// may be partially sent and io_uring may have a writev in flight. Returns 0 if
+// there is nothing to drop. A zlib stream can't lose data, nothing is dropped.
+static int clientSendqDropOldest(struct client *c) {
+    if (c->zs)
+        return 0;
+    int keep = 0;
+    int busy = 0;
+    while (keep < c->sendq_count && (busy < c->uringSending || (keep == 0 && c->sendq_offset))) {
+        struct net_chunk *chunk = c->sendq[(c->sendq_head + keep) % c->sendq_slots];
+        busy += chunk->len - (keep ? 0 : c->sendq_offset);
+        keep++;
+    }
+    // receiverId frames stand in for dropped chunks, they are kept
+    while (keep < c->sendq_count && c->sendq[(c->sendq_head + keep) % c->sendq_slots]->receiverIdFrame)
+        keep++;
+    if (keep == c->sendq_count)
+        return 0;
+    struct net_chunk *drop = c->sendq[(c->sendq_head + keep) % c->sendq_slots];
+    if (drop->receiverIdEnd != drop->receiverIdStart) {
+        // the output queued after it assumes the receiverId this one switched to
+        struct net_chunk *frame = receiverIdChunk(drop->receiverIdEnd);
+        c->sendq[(c->sendq_head + keep) % c->sendq_slots] = frame;
+        c->sendq_len += frame->len - drop->len;
+        chunkRelease(drop);
+        return 1;
+    }
+    for (int i = keep; i < c->sendq_count - 1; i++)
+        c->sendq[(c->sendq_head + i) % c->sendq_slots] = c->sendq[(c->sendq_head + i + 1) % c->sendq_slots];
+    c->sendq_count--;
+    c->sendq_len -= drop->len;
+    chunkRelease(drop);
+    return 1;
+}
+
+//
+//=========================================================================
+//
+// Client structs and read buffers: structs come from slabs and go back to a
+// free list when the client is freed. A read buffer is only allocated once a
+// client sends something and starts small. When more data is waiting than it
+// can take, it goes straight to the full size (stepping up slowly makes a busy
+// connection fall behind while the socket backlog builds up), then it's
+// halved on every check the client doesn't fill it and released once the
+// client is idle. So memory follows the data rate rather than the connection
+// count. Free buffers are kept per size, everything is shared by the main
+// loop and the network I/O threads.
+//
+
+#define NET_CLIENT_SLAB 64 // client structs allocated at once
+#define NET_CLIENT_BUF_MIN (4 * 1024) // initial and smallest read buffer size
+#define NET_CLIENT_BUF_SIZES 5 // NET_CLIENT_BUF_MIN .. MODES_CLIENT_BUF_SIZE
+#define NET_CLIENT_BUF_POOL (2 * 1024 * 1024) // bytes of free read buffers kept for each size
+#define NET_CLIENT_BUF_CHECK (10 * SECONDS) // interval for shrinking and releasing read buffers
+
+static struct {
+    pthread_mutex_t mutex;
+    struct client *freeClients;
+    struct client **slabs;
+    int slabCount;
+    char *freeBufs[NET_CLIENT_BUF_SIZES]; // linked through the first bytes of each buffer
+    int freeBufCount[NET_CLIENT_BUF_SIZES];
+} clientPool = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static struct client *clientAlloc(void) {
+    pthread_mutex_lock(&clientPool.mutex);
+    if (!clientPool.freeClients) {
+        struct client *slab = aligned_malloc(NET_CLIENT_SLAB * sizeof(struct client));
+        struct client **slabs = realloc(clientPool.slabs, (clientPool.slabCount + 1) * sizeof(struct client *));
+        if (!slab || !slabs) {
+            fprintf(stderr, "<3> FATAL: Out of memory allocating network clients\n");
+            exit(1);
+        }
+        clientPool.slabs = slabs;
+        clientPool.slabs[clientPool.slabCount++] = slab;
+        for (int i = NET_CLIENT_SLAB - 1; i >= 0; i--) {
+            slab[i].next = clientPool.freeClients;
+            clientPool.freeClients = &slab[i];
+        }
+    }
+    struct client *c = clientPool.freeClients;
+    clientPool.freeClients = c->next;
+    pthread_mutex_unlock(&clientPool.mutex);
+
+    memset(c, 0, sizeof(struct client));
+    return c;
+}
+
+static int clientBufIndex(int size) {
+    int k = 0;
+    while ((NET_CLIENT_BUF_MIN << k) < size)
+        k++;
+    return k;
+}
+
+// size usable bytes plus BYTE_SCAN_PADDING
+static char *clientBufGet(int size) {
+    int k = clientBufIndex(size);
+    char *buf;
+
+    pthread_mutex_lock(&clientPool.mutex);
+    if ((buf = clientPool.freeBufs[k])) {
+        clientPool.freeBufs[k] = *(char **) buf;
+        clientPool.freeBufCount[k]--;
+    }
+    pthread_mutex_unlock(&clientPool.mutex);
+
+    if (!buf && !(buf = malloc(size + BYTE_SCAN_PADDING))) {
+        fprintf(stderr, "<3> FATAL: Out of memory allocating client read buffer\n");
+        exit(1);
+    }
+    return buf;
+}
+
+static void clientBufPut(char *buf, int size) {
+    int k = clientBufIndex(size);
+
+    pthread_mutex_lock(&clientPool.mutex);
+    if (clientPool.freeBufCount[k] < NET_CLIENT_BUF_POOL / size) {
+        *(char **) buf = clientPool.freeBufs[k];
+        clientPool.freeBufs[k] = buf;
+        clientPool.freeBufCount[k]++;
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&clientPool.mutex);
+
+    free(buf);
+}
+
+// Move the buffered data to a read buffer of the given size, 0 releases the buffer.
+// Only called by the thread doing the reads for this client.
+static void clientBufResize(struct client *c, int size) {
+    char *buf = NULL;
+    if (size) {
+        buf = clientBufGet(size);
+        if (c->buflen)
+            memcpy(buf, c->buf, c->buflen);
+    }
+    if (c->buf)
+        clientBufPut(c->buf, c->bufSize);
+    c->buf = buf;
+    c->bufSize = size;
+}
+
+// More data was waiting than the read buffer could take
+static void clientBufFilled(struct client *c) {
+    c->bufFills++;
+    if (c->bufSize < MODES_CLIENT_BUF_SIZE)
+        clientBufResize(c, MODES_CLIENT_BUF_SIZE);
+}
+
+// Called every NET_CLIENT_BUF_CHECK: release the read buffer of idle clients,
+// halve it for clients that didn't fill it since the last check
+static void clientBufCheck(struct client *c, int64_t now) {
+    if (c->fd < 0 || !c->buf)
+        return;
+    if (!c->buflen && now > c->last_read + NET_CLIENT_BUF_CHECK)
+        clientBufResize(c, 0);
+    else if (!c->bufFills && c->bufSize > NET_CLIENT_BUF_MIN && c->buflen < c->bufSize / 4)
+        clientBufResize(c, c->bufSize / 2);
+    c->bufFills = 0;
+}
+
+// Release everything the client holds and return it to the pool
+static void clientFree(struct client *c) {
+    if (c->uringHoldFd)
+        anetCloseSocket(c->uringFd);
+    clientZlibFree(c);
+    clientSendqClear(c);
+    sfree(c->sendq);
+    sfree(c->uringIov);
+    if (c->buf)
+        clientBufPut(c->buf, c->bufSize);
+
+    pthread_mutex_lock(&clientPool.mutex);
+    c->next = clientPool.freeClients;
+    clientPool.freeClients = c;
+    pthread_mutex_unlock(&clientPool.mutex);
+}
+
+static void clientPoolFree(void) {
+    for (int i = 0; i < clientPool.slabCount; i++)
+        free(clientPool.slabs[i]);
+    sfree(clientPool.slabs);
+    clientPool.slabCount = 0;
+    clientPool.freeClients = NULL;
+    for (int k = 0; k < NET_CLIENT_BUF_SIZES; k++) {
+        while (clientPool.freeBufs[k]) {
+            char *buf = clientPool.freeBufs[k];
+            clientPool.freeBufs[k] = *(char **) buf;
+            free(buf);
+        }
+        clientPool.freeBufCount[k] = 0;
+    }
+}
 
 //
 //=========================================================================
@@ -154,10 +690,8 @@ struct net_service *serviceInit(const char *descr, struct net_writer *writer, he
         // set writer to zero
         memset(service->writer, 0, sizeof(struct net_writer));
 
-        if (!(service->writer->data = aligned_malloc(MODES_OUT_BUF_SIZE))) {
-            fprintf(stderr, "Out of memory allocating output buffer for service %s\n", descr);
-            exit(1);
-        }
+        service->writer->chunk = chunkAlloc(MODES_OUT_BUF_SIZE);
+        service->writer->data = service->writer->chunk->data;
 
         service->writer->service = service;
         service->writer->dataUsed = 0;
@@ -211,16 +745,12 @@ struct client *createGenericClient(struct net_service *service, int fd) {
         fprintf(stderr, "<3> FATAL: createGenericClient called with invalid parameters!\n");
         exit(1);
     }
-    if (!(c = (struct client *) aligned_malloc(sizeof (struct client)))) {
-        fprintf(stderr, "<3> FATAL: Out of memory allocating a new %s network client\n", service->descr);
-        exit(1);
-    }
-    memset(c, 0, sizeof (struct client));
+    c = clientAlloc();
 
     c->service = service;
     c->fd = fd;
-    c->last_flush = now;
-    c->last_send = now;
+    c->last_flush = flushClock(now);
+    c->last_send = c->last_flush;
     c->last_read = now;
     c->connectedSince = now;
 
@@ -241,40 +771,55 @@ struct client *createGenericClient(struct net_service *service, int fd) {
 
     //fprintf(stderr, "c->receiverId: %016"PRIx64"\n", c->receiverId);
 
+    if (service->compress)
+        clientZlibInit(c, 0);
+
     if (service->writer) {
         c->sendq_max = MODES_NET_SNDBUF_SIZE << Modes.net_sndbuf_size;
         if (service->sendqOverrideSize) {
             c->sendq_max = service->sendqOverrideSize;
         }
-        if (!(c->sendq = aligned_malloc(c->sendq_max))) {
+        c->sendq_slots = NET_SENDQ_SLOTS;
+        if (!(c->sendq = malloc(c->sendq_slots * sizeof(struct net_chunk *)))) {
             fprintf(stderr, "Out of memory allocating client SendQ\n");
             exit(1);
         }
-        // Have to keep track of this manually
-        service->writer->lastReceiverId = 0; // make sure to resend receiverId
-
-        service->writer->connections++;
+        __atomic_fetch_add(&service->writer->connections, 1, __ATOMIC_RELAXED);
     }
-    service->connections++;
-    Modes.modesClientCount++;
+    int connections = __atomic_add_fetch(&service->connections, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Modes.modesClientCount, 1, __ATOMIC_RELAXED);
 
-    c->next = service->clients;
-    service->clients = c;
+    c->loop = netLoopCurrent;
+    if (c->loop) {
+        pthread_mutex_lock(&c->loop->thread.mutex);
+        c->next = c->loop->clients;
+        c->loop->clients = c;
+        pthread_mutex_unlock(&c->loop->thread.mutex);
+    } else {
+        c->next = service->clients;
+        service->clients = c;
+    }
 
 
-    if (Modes.debug_net && service->connections % 50 == 0) {
-        fprintf(stderr, "%s connection count: %d\n", service->descr, service->connections);
+    if (Modes.debug_net && connections % 50 == 0) {
+        fprintf(stderr, "%s connection count: %d\n", service->descr, connections);
     }
 
-    if (service->writer && service->connections == 1) {
+    if (service->writer && connections == 1 && !c->loop) {
         service->writer->lastWrite = now; // suppress heartbeat initially
     }
 
+    if (uringNet.accepting && !c->loop) {
+        c->uring = 1;
+        uringArmRecv(c);
+        return c;
+    }
+
     epoll_data_t data;
     data.ptr = c;
     c->epollEvent.events = EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP;
     c->epollEvent.data = data;
-    if (epoll_ctl(Modes.net_epfd, EPOLL_CTL_ADD, c->fd, &c->epollEvent))
+    if (epoll_ctl(clientEpfd(c), EPOLL_CTL_ADD, c->fd, &c->epollEvent))
         perror("epoll_ctl fail:");
 
     return c;
@@ -330,6 +875,9 @@ static void checkServiceConnected(struct net_connector *con, int64_t now) {
     c->con = con;
     con->c = c;
 
+    if (con->compress)
+        clientZlibInit(c, strstr(con->protocol, "_out") != NULL);
+
     // sending UUID if hostname matches adsbexchange
     char uuid[130];
     uuid[0] = '\0';
@@ -352,10 +900,11 @@ static void checkServiceConnected(struct net_connector *con, int64_t now) {
             }
             uuid[res] = '\0';
 
-            c->sendq[c->sendq_len++] = 0x1A;
-            c->sendq[c->sendq_len++] = 0xE4;
-            strncpy(c->sendq + c->sendq_len, uuid, res);
-            c->sendq_len += res;
+            char msg[132];
+            msg[0] = 0x1A;
+            msg[1] = 0xE4;
+            memcpy(msg + 2, uuid, res);
+            clientQueueData(c, msg, res + 2);
         } else {
             uuid[0] = '\0';
             fprintf(stderr, "ERROR: Not a valid UUID: %s\n", Modes.uuidFile);
@@ -364,9 +913,7 @@ static void checkServiceConnected(struct net_connector *con, int64_t now) {
 
         // enable ping stuff
         // O for high resolution timer, both P and p already used for previous iterations
-        c->sendq[c->sendq_len++] = 0x1a;
-        c->sendq[c->sendq_len++] = 'W';
-        c->sendq[c->sendq_len++] = 'O';
+        clientQueueData(c, "\x1a" "WO", 3);
         if (flushClient(c, now) < 0) {
             return;
         }
@@ -383,6 +930,45 @@ static void checkServiceConnected(struct net_connector *con, int64_t now) {
 
 }
 
+// UDP connectors don't need to wait for a connection: udp_out / multicast_out
+// send to the address, udp_in binds to it
+static void serviceConnectDatagram(struct net_connector *con, struct addrinfo *ai, int64_t now) {
+    int fd;
+    if (con->service->writer) {
+        int multicast = (strcmp(con->protocol, "multicast_out") == 0);
+        if (multicast && !(ai->ai_family == AF_INET && IN_MULTICAST(ntohl(((struct sockaddr_in *) ai->ai_addr)->sin_addr.s_addr)))
+                && !(ai->ai_family == AF_INET6 && IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *) ai->ai_addr)->sin6_addr))) {
+            fprintf(stderr, "%s: %s%s is not a multicast group address\n",
+                    con->service->descr, con->address, con->resolved_addr);
+            return;
+        }
+        fd = anetUdpConnect(Modes.aneterr, ai->ai_addr, ai->ai_addrlen, multicast ? Modes.net_multicast_ttl : 0, SOCK_NONBLOCK);
+    } else {
+        fd = anetUdpBind(Modes.aneterr, ai->ai_addr, ai->ai_addrlen, SOCK_NONBLOCK);
+    }
+    if (fd == ANET_ERR) {
+        fprintf(stderr, "%s: %s%s port %s failed: %s\n",
+                con->service->descr, con->address, con->resolved_addr, con->port, Modes.aneterr);
+        return;
+    }
+
+    struct client *c = createSocketClient(con->service, fd);
+    strncpy(c->host, con->address, sizeof(c->host) - 1);
+    strncpy(c->port, con->port, sizeof(c->port) - 1);
+    setProxyString(c);
+
+    con->fd = fd;
+    con->connected = 1;
+    con->lastConnect = now;
+    c->con = con;
+    con->c = c;
+
+    if (!Modes.interactive) {
+        fprintf(stderr, "%s: %s %s%s port %s\n", con->service->descr,
+                con->service->writer ? "Sending to" : "Receiving on", con->address, con->resolved_addr, con->port);
+    }
+}
+
 // Initiate an outgoing connection.
 static void serviceConnect(struct net_connector *con, int64_t now) {
 
@@ -480,6 +1066,12 @@ static void serviceConnect(struct net_connector *con, int64_t now) {
 
 
     struct addrinfo *ai = con->try_addr;
+
+    if (con->service->datagram) {
+        serviceConnectDatagram(con, ai, now);
+        return;
+    }
+
     fd = anetCreateSocket(Modes.aneterr, ai->ai_family, SOCK_NONBLOCK);
 
     if (fd == ANET_ERR) {
@@ -611,6 +1203,13 @@ void serviceListen(struct net_service *service, char *bind_addr, char *bind_port
             service->unixSocket = strdup(buf);
             newfds[0] = fd;
             nfds = 1;
+        } else if (service->datagram) {
+            nfds = anetUdpServer(Modes.aneterr, buf, bind_addr, newfds, sizeof(newfds) / sizeof(newfds[0]), SOCK_NONBLOCK);
+            if (nfds == ANET_ERR) {
+                fprintf(stderr, "Error opening the UDP port %s (%s): %s\n",
+                        buf, service->descr, Modes.aneterr);
+                exit(1);
+            }
         } else {
             nfds = anetTcpServer(Modes.aneterr, buf, bind_addr, newfds, sizeof (newfds), SOCK_NONBLOCK);
             if (nfds == ANET_ERR) {
@@ -638,6 +1237,18 @@ void serviceListen(struct net_service *service, char *bind_addr, char *bind_port
         }
     }
 
+    if (service->datagram) {
+        // nothing to accept, every bound socket is a client of its own
+        for (int i = 0; i < n; i++) {
+            struct client *c = createGenericClient(service, fds[i]);
+            snprintf(c->host, sizeof(c->host), "%s", bind_addr ? bind_addr : "*");
+            snprintf(c->port, sizeof(c->port), "%s", bind_ports);
+            setProxyString(c);
+        }
+        sfree(fds);
+        return;
+    }
+
     service->listener_count = n;
     service->listener_fds = fds;
 
@@ -668,19 +1279,228 @@ void serviceClose(struct net_service *s) {
     if (s->listenSockets) {
         for (int i = 0; i < s->listener_count; ++i) {
             struct client *c = &s->listenSockets[i]; // not really a client
+            if (c->fd < 0)
+                continue; // handed over to the network I/O threads
             epoll_ctl(Modes.net_epfd, EPOLL_CTL_DEL, c->fd, &c->epollEvent);
             anetCloseSocket(s->listener_fds[i]);
         }
         sfree(s->listenSockets);
     }
     sfree(s->listener_fds);
-    if (s->writer && s->writer->data) {
-        sfree(s->writer->data);
+    if (s->writer && s->writer->chunk) {
+        chunkRelease(s->writer->chunk);
+        s->writer->chunk = NULL;
+        s->writer->data = NULL;
+    }
+    if (s->writer && s->writer->thinChunk) {
+        chunkRelease(s->writer->thinChunk);
+        s->writer->thinChunk = NULL;
     }
     sfree(s->unixSocket);
     sfree(s);
 }
 
+//
+// --beast-replay: a recorded Beast capture is fed into the Beast input service
+// over a socketpair as fast as the decoder takes it, every output writer gets a
+// client whose data is read and dropped. This exercises the same code path as a
+// network feed without needing a network.
+//
+static struct {
+    pthread_t thread;
+    int started;
+    int clockStarted;
+    int64_t firstTimestamp; // 12 MHz timestamp of the first message, at Modes.startup_time
+    int inputFd; // feeder end of the input socketpair
+    int *sinkFds; // feeder ends of the output socketpairs
+    int sinkCount;
+    struct timespec start;
+    struct timespec end;
+    struct timespec cpu; // feeder CPU, counted as reader CPU
+} replay;
+
+static void *beastReplayFeeder(void *arg) {
+    MODES_NOTUSED(arg);
+    int fd = open(Modes.beast_replay, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "beast-replay: open %s: %s\n", Modes.beast_replay, strerror(errno));
+        setExit(2);
+        return NULL;
+    }
+
+    int nfds = replay.sinkCount + 2;
+    size_t bufSize = 256 * 1024;
+    struct pollfd *pfd = malloc(nfds * sizeof(struct pollfd));
+    char *buf = malloc(bufSize);
+    if (!pfd || !buf) {
+        fprintf(stderr, "beast-replay: out of memory\n");
+        setExit(2);
+        close(fd);
+        sfree(pfd);
+        sfree(buf);
+        return NULL;
+    }
+    for (int i = 0; i < replay.sinkCount; i++) {
+        pfd[i].fd = replay.sinkFds[i];
+        pfd[i].events = POLLIN;
+    }
+    pfd[nfds - 2].fd = Modes.exitEventfd;
+    pfd[nfds - 2].events = POLLIN;
+    pfd[nfds - 1].fd = replay.inputFd;
+    pfd[nfds - 1].events = POLLOUT;
+
+    ssize_t len = 0;
+    ssize_t off = 0;
+    int eof = 0;
+
+    while (!Modes.exit) {
+        // once the capture has been sent, only the outputs are left to drain
+        int n = poll(pfd, eof ? nfds - 1 : nfds, 1000);
+        if (n < 0 && errno != EINTR)
+            break;
+        for (int i = 0; i < replay.sinkCount; i++) {
+            if (pfd[i].revents & POLLIN) {
+                while (read(pfd[i].fd, buf, bufSize) > 0);
+            }
+        }
+        if (eof || !(pfd[nfds - 1].revents & (POLLOUT | POLLERR | POLLHUP)))
+            continue;
+
+        if (off == len) {
+            len = read(fd, buf, bufSize);
+            off = 0;
+            if (len <= 0) {
+                // end of the capture, the decoder sees EOF after reading what's left
+                shutdown(replay.inputFd, SHUT_WR);
+                eof = 1;
+                len = 0;
+                continue;
+            }
+        }
+        ssize_t res = write(replay.inputFd, buf + off, len - off);
+        if (res > 0)
+            off += res;
+        else if (res < 0 && errno != EAGAIN && errno != EINTR)
+            break;
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &replay.cpu);
+    close(fd);
+    sfree(buf);
+    sfree(pfd);
+    return NULL;
+}
+
+static void beastReplayInit(void) {
+    int sv[2];
+
+    // sinks for all output writers so every output format is produced
+    for (struct net_service *s = Modes.services; s; s = s->next) {
+        if (!s->writer || s == Modes.beast_in_service)
+            continue;
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv)) {
+            perror("beast-replay: socketpair");
+            exit(1);
+        }
+        replay.sinkFds = realloc(replay.sinkFds, (replay.sinkCount + 1) * sizeof(int));
+        if (!replay.sinkFds) {
+            fprintf(stderr, "beast-replay: out of memory\n");
+            exit(1);
+        }
+        replay.sinkFds[replay.sinkCount++] = sv[1];
+        createGenericClient(s, sv[0]);
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv)) {
+        perror("beast-replay: socketpair");
+        exit(1);
+    }
+    replay.inputFd = sv[1];
+    createGenericClient(Modes.beast_in_service, sv[0]);
+
+    fprintf(stderr, "beast-replay: replaying %s, %d output sinks\n", Modes.beast_replay, replay.sinkCount);
+
+    clock_gettime(CLOCK_MONOTONIC, &replay.start);
+    if (pthread_create(&replay.thread, NULL, beastReplayFeeder, NULL)) {
+        fprintf(stderr, "beast-replay: pthread_create failed\n");
+        exit(1);
+    }
+    replay.started = 1;
+}
+
+// the replayed capture has been processed completely
+static void beastReplayDone(void) {
+    clock_gettime(CLOCK_MONOTONIC, &replay.end);
+    setExit(1);
+}
+
+static void beastReplayCleanup(void) {
+    if (!replay.started)
+        return;
+    pthread_join(replay.thread, NULL);
+    replay.started = 0;
+
+    add_timespecs(&replay.cpu, &Modes.stats_current.reader_cpu, &Modes.stats_current.reader_cpu);
+    if (!replay.end.tv_sec)
+        clock_gettime(CLOCK_MONOTONIC, &replay.end);
+
+    anetCloseSocket(replay.inputFd);
+    for (int i = 0; i < replay.sinkCount; i++)
+        anetCloseSocket(replay.sinkFds[i]);
+    sfree(replay.sinkFds);
+    replay.sinkCount = 0;
+}
+
+// wall clock seconds the replay took
+double beastReplaySeconds(void) {
+    return (replay.end.tv_sec - replay.start.tv_sec) + (replay.end.tv_nsec - replay.start.tv_nsec) * 1e-9;
+}
+
+struct named_service {
+    const char *name;
+    struct net_service *service;
+};
+
+// --net-slow-client-policy [service=]policy,...
+static void slowClientPolicyInit(struct named_service *outputs, int count) {
+    static const char *policies[] = { "disconnect", "drop", "thin", "pause" }; // slow_policy_t order
+    if (!Modes.net_slow_client_policy)
+        return;
+    char *copy = strdup(Modes.net_slow_client_policy);
+    char *saveptr = NULL;
+    for (char *tok = strtok_r(copy, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        char *name = NULL;
+        char *policy = tok;
+        char *eq = strchr(tok, '=');
+        if (eq) {
+            *eq = '\0';
+            name = tok;
+            policy = eq + 1;
+        }
+        int p = -1;
+        for (int k = 0; k < (int) (sizeof(policies) / sizeof(policies[0])); k++) {
+            if (strcmp(policy, policies[k]) == 0)
+                p = k;
+        }
+        if (p < 0) {
+            fprintf(stderr, "--net-slow-client-policy: Unknown policy: %s (disconnect, drop, thin, pause)\n", policy);
+            exit(1);
+        }
+        int found = 0;
+        for (int i = 0; i < count; i++) {
+            if (!name || strcmp(name, outputs[i].name) == 0) {
+                outputs[i].service->slowPolicy = p;
+                found = 1;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "--net-slow-client-policy: Unknown output service: %s\n", name);
+            exit(1);
+        }
+    }
+    sfree(copy);
+}
+
 void modesInitNet(void) {
     if (!Modes.net)
         return;
@@ -700,6 +1520,9 @@ void modesInitNet(void) {
     struct net_service *sbs_in_mlat;
     struct net_service *sbs_in_jaero;
     struct net_service *sbs_in_prio;
+    struct net_service *beast_udp_in;
+    struct net_service *beast_udp_out;
+    struct net_service *beast_zlib_in;
 
     struct rlimit limits;
     getrlimit(RLIMIT_NOFILE, &limits);
@@ -814,14 +1637,46 @@ void modesInitNet(void) {
     Modes.beast_in_service->sendqOverrideSize = 1024; // this is only for sending pings back, it doesn't need to use up memory
     serviceListen(Modes.beast_in_service, Modes.net_bind_address, Modes.net_input_beast_ports, Modes.net_epfd);
 
+    /* Beast over UDP */
+    beast_udp_in = serviceInit("Beast UDP input", NULL, NULL, READ_MODE_BEAST, NULL, decodeBinMessage);
+    beast_udp_in->datagram = 1;
+    serviceListen(beast_udp_in, Modes.net_bind_address, Modes.net_input_beast_udp_ports, Modes.net_epfd);
+
+    beast_udp_out = serviceInit("Beast UDP output", &Modes.beast_udp_out, send_beast_heartbeat, READ_MODE_IGNORE, NULL, NULL);
+    beast_udp_out->datagram = 1;
+
+    /* zlib compressed Beast input, beast_zlib_out / beast_reduce_zlib_out feeders */
+    beast_zlib_in = serviceInit("Beast zlib TCP input", NULL, NULL, READ_MODE_BEAST, NULL, decodeBinMessage);
+    beast_zlib_in->compress = 1;
+    serviceListen(beast_zlib_in, Modes.net_bind_address, Modes.net_input_beast_zlib_ports, Modes.net_epfd);
+
     // print newline after all the listen announcements in serviceListen
     fprintf(stderr, "\n");
 
+    struct named_service outputs[] = {
+        { "beast_out", beast_out }, { "beast_reduce_out", beast_reduce_out }, { "garbage_out", garbage_out },
+        { "raw_out", raw_out }, { "vrs_out", vrs_out }, { "json_out", json_out },
+        { "sbs_out", sbs_out }, { "sbs_out_replay", sbs_out_replay }, { "sbs_out_mlat", sbs_out_mlat },
+        { "sbs_out_jaero", sbs_out_jaero }, { "sbs_out_prio", sbs_out_prio },
+    };
+    slowClientPolicyInit(outputs, sizeof(outputs) / sizeof(outputs[0]));
+
+    struct net_service *loopServices[] = { sbs_in, sbs_in_mlat, sbs_in_prio, sbs_in_jaero, raw_in, Modes.beast_in_service, beast_zlib_in };
+    netLoopsInit(loopServices, sizeof(loopServices) / sizeof(loopServices[0]));
+
+    if (Modes.netIoUring)
+        uringNetInit();
+
     /* Beast input from local Modes-S Beast via USB */
     if (Modes.sdr_type == SDR_MODESBEAST || Modes.sdr_type == SDR_GNS) {
         createGenericClient(Modes.beast_in_service, Modes.beast_fd);
     }
 
+    /* Beast input from a recorded capture */
+    if (Modes.beast_replay) {
+        beastReplayInit();
+    }
+
     for (int i = 0; i < Modes.net_connectors_count; i++) {
         struct net_connector *con = Modes.net_connectors[i];
         if (strcmp(con->protocol, "beast_out") == 0)
@@ -856,6 +1711,23 @@ void modesInitNet(void) {
             con->service = sbs_out_prio;
         else if (strcmp(con->protocol, "sbs_out_replay") == 0)
             con->service = sbs_out_replay;
+        else if (strcmp(con->protocol, "udp_in") == 0)
+            con->service = beast_udp_in;
+        else if (strcmp(con->protocol, "udp_out") == 0 || strcmp(con->protocol, "multicast_out") == 0)
+            con->service = beast_udp_out;
+        else if (strcmp(con->protocol, "beast_zlib_out") == 0)
+            con->service = beast_out;
+        else if (strcmp(con->protocol, "beast_reduce_zlib_out") == 0)
+            con->service = beast_reduce_out;
+        else if (strcmp(con->protocol, "sbs_zlib_out") == 0)
+            con->service = sbs_out;
+        else if (strcmp(con->protocol, "beast_zlib_in") == 0)
+            con->service = Modes.beast_in_service;
+        else if (strcmp(con->protocol, "sbs_zlib_in") == 0)
+            con->service = sbs_in;
+
+        // same services as the plain protocols, the connection deflates its output or inflates its input
+        con->compress = (strstr(con->protocol, "_zlib_") != NULL);
 
     }
 }
@@ -864,58 +1736,66 @@ void modesInitNet(void) {
 //
 //=========================================================================
 // Accept new connections
-static void modesAcceptClients(struct client *c, int64_t now) {
-    if (!c || !c->acceptSocket)
+// Set up a client for a freshly accepted connection
+static void acceptClient(struct net_service *s, int fd, struct sockaddr *saddr, socklen_t slen, char *aneterr, int64_t now) {
+    int maxModesClients = Modes.max_fds * 7 / 8;
+    if (Modes.modesClientCount > maxModesClients) {
+        // drop new modes clients if the count nears max_fds ... we want some extra fds for other stuff
+        anetCloseSocket(fd);
+        static _Thread_local int64_t antiSpam;
+        if (now > antiSpam) {
+            antiSpam = now + 30 * SECONDS;
+            fprintf(stderr, "<3> Can't accept new connection, limited to %d clients, consider increasing ulimit!\n", maxModesClients);
+        }
         return;
+    }
 
-    int listen_fd = c->fd;
-    struct net_service *s = c->service;
-
-    struct sockaddr_storage storage;
-    struct sockaddr *saddr = (struct sockaddr *) &storage;
-    socklen_t slen = sizeof(storage);
+    struct client *c = createSocketClient(s, fd);
+    if (s->unixSocket && c) {
+        strcpy(c->host, s->unixSocket);
+        fprintf(stderr, "%s: new c at %s\n", c->service->descr, s->unixSocket);
+    } else if (c) {
+        // We created the client, save the sockaddr info and 'hostport'
+        getnameinfo(saddr, slen,
+                c->host, sizeof(c->host),
+                c->port, sizeof(c->port),
+                NI_NUMERICHOST | NI_NUMERICSERV);
+
+        setProxyString(c);
+        if (!Modes.netIngest && Modes.debug_net) {
+            fprintf(stderr, "%s: new c from %s port %s (fd %d)\n",
+                    c->service->descr, c->host, c->port, fd);
+        }
+        if (anetTcpKeepAlive(aneterr, fd) != ANET_OK)
+            fprintf(stderr, "%s: Unable to set keepalive on connection from %s port %s (fd %d)\n", c->service->descr, c->host, c->port, fd);
+    } else {
+        fprintf(stderr, "%s: Fatal: createSocketClient shouldn't fail!\n", s->descr);
+        exit(1);
+    }
+}
 
-    int fd;
-    errno = 0;
-    while ((fd = anetGenericAccept(Modes.aneterr, listen_fd, saddr, &slen, SOCK_NONBLOCK)) >= 0) {
+static void modesAcceptClients(struct client *c, int64_t now) {
+    if (!c || !c->acceptSocket)
+        return;
 
-        int maxModesClients = Modes.max_fds * 7 / 8;
-        if (Modes.modesClientCount > maxModesClients) {
-            // drop new modes clients if the count nears max_fds ... we want some extra fds for other stuff
-            anetCloseSocket(c->fd);
-            static int64_t antiSpam;
-            if (now > antiSpam) {
-                antiSpam = now + 30 * SECONDS;
-                fprintf(stderr, "<3> Can't accept new connection, limited to %d clients, consider increasing ulimit!\n", maxModesClients);
-            }
-        }
+    int listen_fd = c->fd;
+    struct net_service *s = c->service;
 
-        c = createSocketClient(s, fd);
-        if (s->unixSocket && c) {
-            strcpy(c->host, s->unixSocket);
-            fprintf(stderr, "%s: new c at %s\n", c->service->descr, s->unixSocket);
-        } else if (c) {
-            // We created the client, save the sockaddr info and 'hostport'
-            getnameinfo(saddr, slen,
-                    c->host, sizeof(c->host),
-                    c->port, sizeof(c->port),
-                    NI_NUMERICHOST | NI_NUMERICSERV);
+    struct sockaddr_storage storage;
+    struct sockaddr *saddr = (struct sockaddr *) &storage;
+    socklen_t slen = sizeof(storage);
 
-            setProxyString(c);
-            if (!Modes.netIngest && Modes.debug_net) {
-                fprintf(stderr, "%s: new c from %s port %s (fd %d)\n",
-                        c->service->descr, c->host, c->port, fd);
-            }
-            if (anetTcpKeepAlive(Modes.aneterr, fd) != ANET_OK)
-                fprintf(stderr, "%s: Unable to set keepalive on connection from %s port %s (fd %d)\n", c->service->descr, c->host, c->port, fd);
-        } else {
-            fprintf(stderr, "%s: Fatal: createSocketClient shouldn't fail!\n", s->descr);
-            exit(1);
-        }
+    char *aneterr = netLoopCurrent ? netLoopCurrent->aneterr : Modes.aneterr;
+
+    int fd;
+    errno = 0;
+    while ((fd = anetGenericAccept(aneterr, listen_fd, saddr, &slen, SOCK_NONBLOCK)) >= 0) {
+        acceptClient(s, fd, saddr, slen, aneterr, now);
+        slen = sizeof(storage);
     }
 
     if (!(errno & (EMFILE | EINTR | EAGAIN | EWOULDBLOCK))) {
-        fprintf(stderr, "%s: Error accepting new connection: %s\n", s->descr, Modes.aneterr);
+        fprintf(stderr, "%s: Error accepting new connection: %s\n", s->descr, aneterr);
     }
 }
 
@@ -938,12 +1818,33 @@ static void modesCloseClient(struct client *c) {
         fprintf(stderr, "disc: %6.1f s %6.2f kbit/s %s \n",
                 elapsed, kbitpersecond, c->proxy_string);
     }
-    epoll_ctl(Modes.net_epfd, EPOLL_CTL_DEL, c->fd, &c->epollEvent);
-    anetCloseSocket(c->fd);
-    c->service->connections--;
-    Modes.modesClientCount--;
+    if (c->uring) {
+        // makes the requests in flight for this socket complete
+        shutdown(c->fd, SHUT_RDWR);
+    } else {
+        epoll_ctl(clientEpfd(c), EPOLL_CTL_DEL, c->fd, &c->epollEvent);
+    }
+    if (c->uringPending) {
+        // SQEs carry the raw fd and may not even be submitted yet, closing now would let
+        // an accept hand out the same number and the writev would go to that client
+        c->uringHoldFd = 1;
+        c->uringFd = c->fd;
+    } else {
+        anetCloseSocket(c->fd);
+    }
+    if (!c->uringSending) // the kernel may still read the sendq, cleared when the client is freed
+        clientSendqClear(c);
+    __atomic_fetch_sub(&c->service->connections, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&Modes.modesClientCount, 1, __ATOMIC_RELAXED);
     if (c->service->writer) {
-        c->service->writer->connections--;
+        __atomic_fetch_sub(&c->service->writer->connections, 1, __ATOMIC_RELAXED);
+        if (c->slowState == NET_SLOW_THIN)
+            c->service->writer->thinClients--;
+    }
+    c->slowState = 0;
+    if (c->loop) {
+        // frames of this client may still be queued, free it once they are decoded
+        c->closeSeq = c->loop->published + (c->loop->filling->used ? 1 : 0);
     }
     struct net_connector *con = c->con;
     if (con) {
@@ -972,7 +1873,7 @@ static void modesCloseClient(struct client *c) {
     c->service = NULL;
     c->modeac_requested = 0;
 
-    if (Modes.mode_ac_auto)
+    if (Modes.mode_ac_auto && !c->loop)
         autoset_modeac();
 }
 
@@ -1020,7 +1921,8 @@ static void pingClient(struct client *c, uint32_t ping) {
     ping = ping & ((1 << 24) - 1);
     if (c->sendq_len + 8 >= c->sendq_max)
         return;
-    char *p = c->sendq + c->sendq_len;
+    char msg[8];
+    char *p = msg;
 
     *p++ = 0x1a;
     *p++ = 'P';
@@ -1034,7 +1936,7 @@ static void pingClient(struct client *c, uint32_t ping) {
     if (*(p-1) == 0x1a)
         *p++ = 0x1a;
 
-    c->sendq_len = p - c->sendq;
+    clientQueueData(c, msg, p - msg);
     if (0 && Modes.debug_ping)
         fprintf(stderr, "Sending Ping c: %d\n", ping);
 }
@@ -1043,18 +1945,18 @@ static void pong(struct client *c, int64_t now) {
         fprintf(stderr, "WAT?! now < c->pingReceived\n");
     pingClient(c, c->ping + (now - c->pingReceived));
 }
-static void pingSenders(struct net_service *service, int64_t now) {
+static void pingSenders(struct net_service *service, struct client *clients, uint32_t *currentPing, int64_t now) {
     if (!Modes.ping)
         return;
     uint32_t newPing = now & ((1 << 24) - 1);
     // only send a ping every 50th interval or every 5 seconds
     // the respoder will interpolate using the local clock
-    if (newPing >= Modes.currentPing + 5000 || newPing < Modes.currentPing) {
-        Modes.currentPing = newPing;
+    if (newPing >= *currentPing + 5000 || newPing < *currentPing) {
+        *currentPing = newPing;
         if (Modes.debug_ping)
             fprintf(stderr, "Sending Ping: %d\n", newPing);
-        for (struct client *c = service->clients; c; c = c->next) {
-            if (!c->service)
+        for (struct client *c = clients; c; c = c->next) {
+            if (c->service != service)
                 continue;
             // some devices can't deal with any data on the backchannel
             // for the time being only send to receivers that enable it on connect
@@ -1071,7 +1973,7 @@ static void pingSenders(struct net_service *service, int64_t now) {
 }
 static int pongReceived(struct client *c, int64_t now) {
     c->pongReceived = now;
-    static int64_t antiSpam;
+    static _Thread_local int64_t antiSpam;
 
     // times in milliseconds
 
@@ -1093,11 +1995,13 @@ static int pongReceived(struct client *c, int64_t now) {
         }
     }
 
-    c->rtt = current - pong;
+    int64_t rtt = current - pong;
 
-    if (c->rtt < 0) {
-        c->rtt = 0;
+    if (rtt < 0) {
+        rtt = 0;
     }
+    // read by the decode thread for clients of a network I/O thread
+    __atomic_store_n(&c->rtt, rtt, __ATOMIC_RELAXED);
 
     int32_t bucket = 0;
     float bucketsize = PING_BUCKETBASE;
@@ -1106,37 +2010,40 @@ static int pongReceived(struct client *c, int64_t now) {
         bucketmax += bucketsize;
         bucketmax = nearbyint(bucketmax / 10) * 10;
         bucketsize *= PING_BUCKETMULT;
-        if (c->rtt <= bucketmax) {
+        if (rtt <= bucketmax) {
             bucket = i;
             break;
         }
     }
-    Modes.stats_current.remote_ping_rtt[bucket]++;
+    __atomic_fetch_add(&Modes.stats_current.remote_ping_rtt[bucket], 1, __ATOMIC_RELAXED);
 
     // more quickly arrive at a sensible average
+    double recent_rtt;
     if (c->recent_rtt <= 0) {
-        c->recent_rtt = c->rtt;
+        recent_rtt = rtt;
     } else if (c->bytesReceived < 5000) {
-        c->recent_rtt = c->recent_rtt * 0.9 +  c->rtt * 0.1;
+        recent_rtt = c->recent_rtt * 0.9 +  rtt * 0.1;
     } else {
-        c->recent_rtt = c->recent_rtt * 0.995 +  c->rtt * 0.005;
+        recent_rtt = c->recent_rtt * 0.995 +  rtt * 0.005;
     }
+    // read by generateClientsJson
+    __atomic_store(&c->recent_rtt, &recent_rtt, __ATOMIC_RELAXED);
     if (c->latest_rtt <= 0) {
-        c->latest_rtt = c->rtt;
+        c->latest_rtt = rtt;
     } else {
-        c->latest_rtt = c->latest_rtt * 0.9 +  c->rtt * 0.1;
+        c->latest_rtt = c->latest_rtt * 0.9 +  rtt * 0.1;
     }
 
     if (Modes.debug_ping && 0) {
         char uuid[64]; // needs 36 chars and null byte
         sprint_uuid(c->receiverId, c->receiverId2, uuid);
         fprintf(stderr, "rId %s %ld %4.0f %s current: %ld pong: %ld\n",
-                uuid, (long) c->rtt, c->recent_rtt, c->proxy_string, (long) current, (long) pong);
+                uuid, (long) rtt, c->recent_rtt, c->proxy_string, (long) current, (long) pong);
     }
 
     // only log if the average is greater the rejection threshold, don't log for single packet events
     // actual discard / rejection happens elsewhere int the code
-    if ((c->latest_rtt > PING_REJECT && now > antiSpam) || c->rtt > PING_DISCONNECT) {
+    if ((c->latest_rtt > PING_REJECT && now > antiSpam) || rtt > PING_DISCONNECT) {
             char uuid[64]; // needs 36 chars and null byte
             sprint_uuid(c->receiverId, c->receiverId2, uuid);
             if (Modes.netIngest) {
@@ -1161,35 +2068,130 @@ static int pongReceived(struct client *c, int64_t now) {
                         c->latest_rtt, c->recent_rtt, uuid, c->proxy_string);
             }
             if (c->sendq_len + 3 < c->sendq_max) {
-                c->sendq[c->sendq_len++] = 0x1a;
-                c->sendq[c->sendq_len++] = 'W';
-                c->sendq[c->sendq_len++] = 'S';
-                c->pingReceived = now;
+                clientQueueData(c, "\x1a" "WS", 3);
+                __atomic_store_n(&c->pingReceived, now, __ATOMIC_RELAXED);
             }
             if (flushClient(c, now) < 0) {
                 return 1;
             }
         }
     }
-    if (Modes.netIngest && c->rtt > PING_DISCONNECT) {
+    if (Modes.netIngest && rtt > PING_DISCONNECT) {
         return 1; // disconnect the client if the messages are delayed too much
     }
     return 0;
 }
 
 
+// Drop bytesWritten sent bytes from the client sendq
+static void clientSendqConsume(struct client *c, int bytesWritten, int64_t now) {
+    // Release the chunks that were sent completely
+    int consumed = bytesWritten;
+    while (consumed > 0) {
+        struct net_chunk *chunk = c->sendq[c->sendq_head];
+        int left = chunk->len - c->sendq_offset;
+        if (consumed < left) {
+            c->sendq_offset += consumed;
+            break;
+        }
+        consumed -= left;
+        c->sendq_offset = 0;
+        c->sendq_head = (c->sendq_head + 1) % c->sendq_slots;
+        c->sendq_count--;
+        chunkRelease(chunk);
+    }
+
+    c->last_send = now;	// If we wrote anything, update this.
+    c->sendq_len -= bytesWritten;
+    if (c->sendq_len == 0) {
+        c->last_flush = now;
+    }
+}
+
+// If writing has failed for longer than 8 * flush_interval, disconnect.
+static int flushTimedOut(struct client *c, int64_t now) {
+    now = flushClock(now);
+    int64_t flushTimeout = imax(800, 8 * Modes.net_output_flush_interval);
+    int64_t since = c->last_flush;
+    if (c->service->slowPolicy != NET_SLOW_DISCONNECT) {
+        // slow clients are kept, only give up on ones that don't take any data
+        flushTimeout = NET_SLOW_CLIENT_TIMEOUT;
+        since = imax(c->last_flush, c->last_send);
+    }
+    if (since + flushTimeout < now) {
+        fprintf(stderr, "%s: Couldn't flush data for %.2fs (Insufficient bandwidth?): disconnecting: %s port %s (fd %d, SendQ %d)\n", c->service->descr, flushTimeout / 1000.0, c->host, c->port, c->fd, c->sendq_len);
+        __atomic_fetch_add(&Modes.stats_current.net_slow_disconnected, 1, __ATOMIC_RELAXED);
+        modesCloseClient(c);
+        return 1;
+    }
+    return 0;
+}
+
+// Datagram clients: every queued chunk goes out as one datagram, up to
+// NET_UDP_BATCH of them with a single sendmmsg. Datagrams are fire and forget,
+// one that can't be sent (nobody listening, no route) is dropped.
+// Returns the bytes done with or -1 with errno EAGAIN if the socket buffer is full.
+static int sendDatagrams(struct client *c) {
+    struct mmsghdr msgs[NET_UDP_BATCH];
+    struct iovec iov[NET_UDP_BATCH];
+    int count = 0;
+    for (int i = 0; i < c->sendq_count && count < NET_UDP_BATCH; i++) {
+        struct net_chunk *chunk = c->sendq[(c->sendq_head + i) % c->sendq_slots];
+        iov[count].iov_base = chunk->data;
+        iov[count].iov_len = chunk->len;
+        memset(&msgs[count], 0, sizeof(struct mmsghdr));
+        msgs[count].msg_hdr.msg_iov = &iov[count];
+        msgs[count].msg_hdr.msg_iovlen = 1;
+        count++;
+    }
+
+    int sent = sendmmsg(c->fd, msgs, count, 0);
+    if (sent < 0) {
+        int err = errno;
+        if (err == EAGAIN || err == EWOULDBLOCK)
+            return -1;
+        if (Modes.debug_net) {
+            fprintf(stderr, "%s: Dropped datagram to %s port %s: %s\n",
+                    c->service->descr, c->host, c->port, strerror(err));
+        }
+        sent = 1;
+    }
+
+    int bytes = 0;
+    for (int i = 0; i < sent; i++)
+        bytes += iov[i].iov_len;
+    return bytes;
+}
+
 static inline int flushClient(struct client *c, int64_t now) {
     if (!c->service) { fprintf(stderr, "report error: Ahlu8pie\n"); return -1; }
-    int toWrite = c->sendq_len;
-    char *psendq = c->sendq;
-
-    if (toWrite == 0) {
+    now = flushClock(now);
+    if (c->sendq_len == 0) {
         c->last_flush = now;
         return 0;
     }
+    if (c->uring)
+        return uringFlushClient(c, now);
+
+    int bytesWritten;
+    int err;
+    if (c->service->datagram) {
+        bytesWritten = sendDatagrams(c);
+        err = errno;
+    } else {
+        struct iovec iov[NET_SENDQ_IOV];
+        int iovcnt = 0;
+        for (int i = 0; i < c->sendq_count && iovcnt < NET_SENDQ_IOV; i++) {
+            struct net_chunk *chunk = c->sendq[(c->sendq_head + i) % c->sendq_slots];
+            int skip = i ? 0 : c->sendq_offset;
+            iov[iovcnt].iov_base = chunk->data + skip;
+            iov[iovcnt].iov_len = chunk->len - skip;
+            iovcnt++;
+        }
 
-    int bytesWritten = send(c->fd, psendq, toWrite, 0);
-    int err = errno;
+        bytesWritten = writev(c->fd, iov, iovcnt);
+        err = errno;
+    }
 
     // If we get -1, it's only fatal if it's not EAGAIN/EWOULDBLOCK
     if (bytesWritten < 0 && err != EAGAIN && err != EWOULDBLOCK) {
@@ -1200,37 +2202,22 @@ static inline int flushClient(struct client *c, int64_t now) {
         return 0;
     }
     if (bytesWritten > 0) {
-        // Advance buffer
-        psendq += bytesWritten;
-        toWrite -= bytesWritten;
-
-        c->last_send = now;	// If we wrote anything, update this.
-        if (bytesWritten == c->sendq_len) {
-            c->sendq_len = 0;
-            c->last_flush = now;
-        } else {
-            c->sendq_len -= bytesWritten;
-            memmove((void*)c->sendq, c->sendq + bytesWritten, toWrite);
-        }
+        clientSendqConsume(c, bytesWritten, now);
     }
     if (c->last_flush != now && !(c->epollEvent.events & EPOLLOUT)) {
         // if we couldn't flush our buffer, make epoll tell us when we can write again
         c->epollEvent.events |= EPOLLOUT;
-        if (epoll_ctl(Modes.net_epfd, EPOLL_CTL_MOD, c->fd, &c->epollEvent))
+        if (epoll_ctl(clientEpfd(c), EPOLL_CTL_MOD, c->fd, &c->epollEvent))
             perror("epoll_ctl fail:");
     }
     if ((c->epollEvent.events & EPOLLOUT) && c->last_flush == now) {
         // if set, remove EPOLLOUT from epoll if flush was successful
         c->epollEvent.events ^= EPOLLOUT;
-        if (epoll_ctl(Modes.net_epfd, EPOLL_CTL_MOD, c->fd, &c->epollEvent))
+        if (epoll_ctl(clientEpfd(c), EPOLL_CTL_MOD, c->fd, &c->epollEvent))
             perror("epoll_ctl fail:");
     }
 
-    // If writing has failed for longer than 8 * flush_interval, disconnect.
-    int64_t flushTimeout = imax(800, 8 * Modes.net_output_flush_interval);
-    if (c->last_flush + flushTimeout < now) {
-        fprintf(stderr, "%s: Couldn't flush data for %.2fs (Insufficient bandwidth?): disconnecting: %s port %s (fd %d, SendQ %d)\n", c->service->descr, flushTimeout / 1000.0, c->host, c->port, c->fd, c->sendq_len);
-        modesCloseClient(c);
+    if (flushTimedOut(c, now)) {
         return -1;
     }
     return bytesWritten;
@@ -1241,8 +2228,73 @@ static inline int flushClient(struct client *c, int64_t now) {
 //
 // Send the write buffer for the specified writer to all connected clients
 //
+// What a client gets from this flush of its writer under the slow client policy
+// of its service, NULL for nothing. NET_SLOW_DISCONNECT closes the client once
+// the chunk doesn't fit its sendq. The others keep it connected with a bounded
+// sendq: drop discards the oldest queued output, pause skips output until the
+// sendq has drained, thin switches it to beast_reduce style output (the
+// writer's thinChunk) while the sendq is over half full.
+static struct net_chunk *slowClientOutput(struct client *c, struct net_writer *writer, struct net_chunk *chunk) {
+    int max = c->sendq_max;
+    slow_policy_t policy = c->service->slowPolicy;
+
+    if (policy == NET_SLOW_DISCONNECT) {
+        // Too much data in client SendQ.  Drop client - SendQ exceeded.
+        fprintf(stderr, "%s: Dropped due to full SendQ: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
+                c->service->descr, c->host, c->port,
+                c->fd, c->sendq_len, c->buflen);
+        __atomic_fetch_add(&Modes.stats_current.net_slow_disconnected, 1, __ATOMIC_RELAXED);
+        modesCloseClient(c);
+        return NULL;
+    }
+
+    if (policy == NET_SLOW_PAUSE) {
+        if (c->slowState && c->sendq_len < max / 2)
+            c->slowState = 0;
+        else if (!c->slowState && c->sendq_len + chunk->len >= max)
+            c->slowState = NET_SLOW_PAUSE;
+        if (c->slowState) {
+            __atomic_fetch_add(&Modes.stats_current.net_slow_paused, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        return chunk;
+    }
+
+    if (policy == NET_SLOW_THIN) {
+        if (c->slowState && c->sendq_len < max / 4) {
+            c->slowState = 0;
+            writer->thinClients--;
+        } else if (c->slowState) {
+            // thinChunk was filled since the last flush
+            chunk = writer->thinChunk;
+            __atomic_fetch_add(&Modes.stats_current.net_slow_thinned, 1, __ATOMIC_RELAXED);
+        } else if (c->sendq_len + chunk->len >= max / 2) {
+            // thinned from the next flush on
+            c->slowState = NET_SLOW_THIN;
+            if (!writer->thinChunk)
+                writer->thinChunk = chunkAlloc(NET_THIN_CHUNK_SIZE);
+            writer->thinClients++;
+        }
+    }
+
+    // NET_SLOW_DROP, or thinning isn't enough
+    while (c->sendq_len + chunk->len >= max && clientSendqDropOldest(c))
+        __atomic_fetch_add(&Modes.stats_current.net_slow_dropped, 1, __ATOMIC_RELAXED);
+    if (c->sendq_len + chunk->len >= max) {
+        // everything queued is being sent already
+        __atomic_fetch_add(&Modes.stats_current.net_slow_dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    return chunk;
+}
+
 static void flushWrites(struct net_writer *writer) {
     int64_t now = mstime();
+    struct net_chunk *chunk = writer->chunk;
+    chunk->len = writer->dataUsed;
+    chunk->receiverIdEnd = writer->lastReceiverId;
+    if (writer->thinChunk)
+        writer->thinChunk->receiverIdEnd = writer->thinReceiverId;
     for (struct client *c = writer->service->clients; c; c = c->next) {
         if (!c->service)
             continue;
@@ -1250,28 +2302,84 @@ static void flushWrites(struct net_writer *writer) {
             if (c->pingEnabled) {
                 pong(c, now);
             }
-            if ((c->sendq_len + writer->dataUsed) >= c->sendq_max) {
-                // Too much data in client SendQ.  Drop client - SendQ exceeded.
-                fprintf(stderr, "%s: Dropped due to full SendQ: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
-                        c->service->descr, c->host, c->port,
-                        c->fd, c->sendq_len, c->buflen);
-                modesCloseClient(c);
-                continue;	// Go to the next client
+            struct net_chunk *out = chunk;
+            if (c->service->slowPolicy != NET_SLOW_DISCONNECT || (c->sendq_len + chunk->len) >= c->sendq_max) {
+                out = slowClientOutput(c, writer, chunk);
+                if (!c->service)
+                    continue;	// Go to the next client
+            }
+            // beast output: the client may have missed the receiverId this chunk assumes
+            if (out && out->len && out->receiverIdStart && out->receiverIdStart != c->receiverIdSent)
+                clientQueueReceiverId(c, out->receiverIdStart);
+            if (out && out->len)
+                c->receiverIdSent = out->receiverIdEnd;
+            // Queue a reference to the shared chunk, zlib connections get their own copy
+            if (out && out->len && c->zsDeflate)
+                clientDeflate(c, out->data, out->len,
+                        now >= c->zsFlushed + Modes.net_output_flush_interval ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            else if (out && out->len)
+                clientQueueChunk(c, out);
+            // The socket buffer of a client waiting for EPOLLOUT is full, a send
+            // attempt would only fail. Leave it queued until epoll reports it writable.
+            if ((c->epollEvent.events & EPOLLOUT) || c->uringSending) {
+                flushTimedOut(c, now);
+                continue;
             }
-            // Append the data to the end of the queue, increment len
-            memcpy(c->sendq + c->sendq_len, writer->data, writer->dataUsed);
-            c->sendq_len += writer->dataUsed;
             // Try flushing...
             if (flushClient(c, now) < 0) {
                 continue;
             }
         }
     }
+    // one submission for the sends of all clients
+    uringNetSubmit();
+    // sends that completed right away free up the sendqs before the next flush
+    uringDrain(now);
+    // Clients that couldn't send everything still hold the chunk, start a new one.
+    // Usually all of them could and the chunk is simply reused.
+    if (chunk->refCount > 1) {
+        chunkRelease(chunk);
+        writer->chunk = chunkAlloc(MODES_OUT_BUF_SIZE);
+        writer->data = writer->chunk->data;
+    }
+    if (writer->thinChunk && writer->thinChunk->refCount > 1) {
+        chunkRelease(writer->thinChunk);
+        writer->thinChunk = chunkAlloc(NET_THIN_CHUNK_SIZE);
+    }
     writer->dataUsed = 0;
     writer->lastWrite = now;
+    // datagrams can be lost, each one starts with the receiverId
+    if (writer->service->datagram)
+        writer->lastReceiverId = 0;
+    writer->chunk->receiverIdStart = writer->lastReceiverId;
+    writer->thinReceiverId = writer->lastReceiverId;
+    if (writer->thinChunk) {
+        writer->thinChunk->len = 0;
+        writer->thinChunk->receiverIdStart = writer->thinReceiverId;
+    }
     return;
 }
 
+// Sync flush zlib connections holding back deflated output for an interval
+static void zlibIntervalFlush(int64_t now) {
+    for (int i = 0; i < Modes.net_connectors_count; i++) {
+        struct client *c = Modes.net_connectors[i]->c;
+        if (!c || !c->service || !c->zsPending || now < c->zsFlushed + Modes.net_output_flush_interval)
+            continue;
+        clientDeflate(c, NULL, 0, Z_SYNC_FLUSH);
+        if (!(c->epollEvent.events & EPOLLOUT))
+            flushClient(c, now);
+    }
+}
+
+// Output is flushed once it reaches this size, datagram writers flush before
+// it would exceed NET_UDP_PAYLOAD so every chunk fits a single datagram
+static inline int writerFlushSize(struct net_writer *writer) {
+    if (writer->service->datagram)
+        return imin(Modes.net_output_flush_size, NET_UDP_PAYLOAD);
+    return Modes.net_output_flush_size;
+}
+
 // Prepare to write up to 'len' bytes to the given net_writer.
 // Returns a pointer to write to, or NULL to skip this write.
 static void *prepareWrite(struct net_writer *writer, int len) {
@@ -1279,7 +2387,7 @@ static void *prepareWrite(struct net_writer *writer, int len) {
         return NULL;
     }
 
-    if (writer->dataUsed && writer->dataUsed + len >= Modes.net_output_flush_size) {
+    if (writer->dataUsed && writer->dataUsed + len >= writerFlushSize(writer)) {
         flushWrites(writer);
         if (writer->dataUsed + len > MODES_OUT_BUF_SIZE) {
             // this shouldn't happen due to flushWrites only writing to internal client buffers
@@ -1295,9 +2403,16 @@ static void *prepareWrite(struct net_writer *writer, int len) {
 // endptr should point one byte past the last byte written
 // to the buffer returned from prepareWrite.
 static void completeWrite(struct net_writer *writer, void *endptr) {
+    if (writer->thinClients && !thinSkip) {
+        // copy for clients thinned by the slow client policy
+        char *start = (char *) writer->data + writer->dataUsed;
+        int len = (char *) endptr - start;
+        memcpy(writer->thinChunk->data + writer->thinChunk->len, start, len);
+        writer->thinChunk->len += len;
+    }
     writer->dataUsed = endptr - writer->data;
 
-    if (writer->dataUsed >= Modes.net_output_flush_size) {
+    if (writer->dataUsed >= writerFlushSize(writer)) {
         flushWrites(writer);
     }
 }
@@ -1319,18 +2434,18 @@ static void modesSendBeastOutput(struct modesMessage *mm, struct net_writer *wri
     if (!p)
         return;
 
-    // receiverId, big-endian, in own message to make it backwards compatible
     // only send the receiverId when it changes
-    if (Modes.netReceiverId && writer->lastReceiverId != mm->receiverId) {
-        writer->lastReceiverId = mm->receiverId;
-        *p++ = 0x1a;
-        // other dump1090 / readsb versions or beast implementations should discard unknown message types
-        *p++ = 0xe3; // good enough guess no one is using this.
-        for (int i = 7; i >= 0; i--) {
-            *p++ = (ch = ((mm->receiverId >> (8 * i)) & 0xFF));
-            if (0x1A == ch) {
-                *p++ = ch;
-            }
+    if (Modes.netReceiverId) {
+        if (writer->thinClients && !thinSkip) {
+            // the thinned output skipped the message that switched to this receiverId
+            struct net_chunk *thin = writer->thinChunk;
+            if (writer->thinReceiverId != mm->receiverId && writer->lastReceiverId == mm->receiverId)
+                thin->len = writeReceiverIdFrame(thin->data + thin->len, mm->receiverId) - thin->data;
+            writer->thinReceiverId = mm->receiverId;
+        }
+        if (writer->lastReceiverId != mm->receiverId) {
+            writer->lastReceiverId = mm->receiverId;
+            p = writeReceiverIdFrame(p, mm->receiverId);
         }
     }
 
@@ -1488,7 +2603,8 @@ static int decodeSbsLine(struct client *c, char *line, int remote, int64_t now)
     size_t line_len = strlen(line);
     size_t max_len = 200;
 
-    if (Modes.receiver_focus && c->receiverId != Modes.receiver_focus)
+    uint64_t receiverId = netFrameCurrent ? netFrameCurrent->receiverId : c->receiverId;
+    if (Modes.receiver_focus && receiverId != Modes.receiver_focus)
         return 0;
     if (line_len < 2) // heartbeat
         return 0;
@@ -1727,7 +2843,7 @@ basestation_invalid:
 //
 // Write SBS output to TCP clients
 //
-static void modesSendSBSOutput(struct modesMessage *mm, struct aircraft *a, struct net_writer *writer) {
+static void modesSendSBSOutput(struct modesMessage *mm, struct net_writer *writer) {
     char *p;
     struct timespec now;
     struct tm stTime_receive, stTime_now;
@@ -1790,8 +2906,13 @@ static void modesSendSBSOutput(struct modesMessage *mm, struct aircraft *a, stru
     // Fields 1 to 6 : SBS message type and ICAO address of the aircraft and some other stuff
     p += sprintf(p, "MSG,%d,1,1,%06X,1,", msgType, mm->addr);
 
-    // Find current system time
-    clock_gettime(CLOCK_REALTIME, &now);
+    // Find current system time, a replay uses the time of the message
+    if (Modes.synthetic_now) {
+        now.tv_sec = mm->sysTimestampMsg / 1000;
+        now.tv_nsec = (mm->sysTimestampMsg % 1000) * 1000000;
+    } else {
+        clock_gettime(CLOCK_REALTIME, &now);
+    }
     gmtime_r(&now.tv_sec, &stTime_now);
 
     // Find message reception time
@@ -1817,8 +2938,8 @@ static void modesSendSBSOutput(struct modesMessage *mm, struct aircraft *a, stru
     if (Modes.use_gnss) {
         if (mm->geom_alt_valid) {
             p += sprintf(p, ",%dH", mm->geom_alt);
-        } else if (mm->baro_alt_valid && trackDataValid(&a->geom_delta_valid)) {
-            p += sprintf(p, ",%dH", mm->baro_alt + a->geom_delta);
+        } else if (mm->baro_alt_valid && mm->ac_geom_delta_valid) {
+            p += sprintf(p, ",%dH", mm->baro_alt + mm->ac_geom_delta);
         } else if (mm->baro_alt_valid) {
             p += sprintf(p, ",%d", mm->baro_alt);
         } else {
@@ -1827,8 +2948,8 @@ static void modesSendSBSOutput(struct modesMessage *mm, struct aircraft *a, stru
     } else {
         if (mm->baro_alt_valid) {
             p += sprintf(p, ",%d", mm->baro_alt);
-        } else if (mm->geom_alt_valid && trackDataValid(&a->geom_delta_valid)) {
-            p += sprintf(p, ",%d", mm->geom_alt - a->geom_delta);
+        } else if (mm->geom_alt_valid && mm->ac_geom_delta_valid) {
+            p += sprintf(p, ",%d", mm->geom_alt - mm->ac_geom_delta);
         } else {
             p += sprintf(p, ",");
         }
@@ -1948,6 +3069,23 @@ static void send_sbs_heartbeat(struct net_service *service) {
     completeWrite(service->writer, data + len);
 }
 
+// object rendered by a tracker thread, see trackShardFlush()
+void jsonPositionWrite(const char *json, int len) {
+    char *p = prepareWrite(&Modes.json_out, len + 1);
+    if (!p)
+        return;
+
+    memcpy(p, json, len);
+    p += len;
+    *p++ = '\n';
+
+    completeWrite(&Modes.json_out, p);
+    if (Modes.json_out.dataUsed > 0) {
+        // flush unconditionally for this output
+        flushWrites(&Modes.json_out);
+    }
+}
+
 void jsonPositionOutput(struct modesMessage *mm, struct aircraft *a) {
     MODES_NOTUSED(mm);
     char *p;
@@ -1979,15 +3117,18 @@ void jsonPositionOutput(struct modesMessage *mm, struct aircraft *a) {
 void modesQueueOutput(struct modesMessage *mm, struct aircraft *a) {
     int is_mlat = (mm->source == SOURCE_MLAT);
 
+    // thinned slow clients only get what beast_reduce_out would forward
+    thinSkip = !mm->reduce_forward;
+
     if (Modes.garbage_ports && (mm->garbage || mm->pos_bad) && !mm->pos_old && Modes.garbage_out.connections) {
         modesSendBeastOutput(mm, &Modes.garbage_out);
     }
 
     if (a && (!Modes.sbsReduce || mm->reduce_forward)) {
         if ((!is_mlat || Modes.forward_mlat) && Modes.sbs_out.connections)
-            modesSendSBSOutput(mm, a, &Modes.sbs_out);
+            modesSendSBSOutput(mm, &Modes.sbs_out);
         if (is_mlat && Modes.sbs_out_mlat.connections)
-            modesSendSBSOutput(mm, a, &Modes.sbs_out_mlat);
+            modesSendSBSOutput(mm, &Modes.sbs_out_mlat);
     }
 
     if (!is_mlat && (Modes.net_verbatim || mm->correctedbits < 2) && Modes.raw_out.connections) {
@@ -2001,10 +3142,14 @@ void modesQueueOutput(struct modesMessage *mm, struct aircraft *a) {
         // Forward mlat messages via beast output only if --forward-mlat is set
         if (Modes.beast_out.connections)
             modesSendBeastOutput(mm, &Modes.beast_out);
+        if (Modes.beast_udp_out.connections)
+            modesSendBeastOutput(mm, &Modes.beast_udp_out);
         if (mm->reduce_forward && Modes.beast_reduce_out.connections) {
             modesSendBeastOutput(mm, &Modes.beast_reduce_out);
         }
     }
+
+    thinSkip = 0;
 }
 
 // Decode a little-endian IEEE754 float (binary32)
@@ -2265,7 +3410,7 @@ static int decodeBinMessage(struct client *c, char *p, int remote, int64_t now)
 
     ch = *p++; /// Get the message type
 
-    mm.receiverId = c->receiverId;
+    mm.receiverId = netFrameCurrent ? netFrameCurrent->receiverId : c->receiverId;
 
     if (ch == '2') {
         msgLen = MODES_SHORT_MSG_BYTES;
@@ -2324,6 +3469,21 @@ static int decodeBinMessage(struct client *c, char *p, int remote, int64_t now)
         mm.timestampMsg = mm.timestampMsg << 8 | (ch & 255);
     }
 
+    if (Modes.beast_replay) {
+        // replay: the clock follows the 12 MHz message timestamps from startup_time on,
+        // never going backwards
+        if (!replay.clockStarted) {
+            replay.clockStarted = 1;
+            replay.firstTimestamp = mm.timestampMsg;
+        }
+        int64_t replayNow = Modes.startup_time;
+        if (mm.timestampMsg > replay.firstTimestamp)
+            replayNow += (mm.timestampMsg - replay.firstTimestamp) / 12000;
+        if (replayNow > Modes.synthetic_now)
+            Modes.synthetic_now = replayNow;
+        now = Modes.synthetic_now;
+    }
+
     // record reception time as the time we read it.
     mm.sysTimestampMsg = now;
 
@@ -2385,11 +3545,12 @@ static int decodeBinMessage(struct client *c, char *p, int remote, int64_t now)
             }
         }
     }
-    if (c->pongReceived && c->pongReceived > now + 100) {
+    if (!c->loop && c->pongReceived && c->pongReceived > now + 100) {
         // if messages are received with more than 100 ms delay after a pong, recalculate c->rtt
         pongReceived(c, now);
     }
-    if (c->rtt && c->rtt > PING_REJECT && Modes.netIngest) {
+    int64_t rtt = __atomic_load_n(&c->rtt, __ATOMIC_RELAXED);
+    if (rtt && rtt > PING_REJECT && Modes.netIngest) {
         // don't discard CPRs, if we have better data speed_check generally will take care of delayed CPR messages
         // this way we get basic data even from high latency receivers
         // super high latency receivers are getting disconnected in pongReceived()
@@ -2609,442 +3770,625 @@ static const char *hexEscapeString(const char *str, char *buf, int len) {
 // The handler returns 0 on success, or 1 to signal this function we should
 // close the connection with the client in case of non-recoverable errors.
 //
-static void modesReadFromClient(struct client *c, int64_t start) {
-    assert(c->service);
-
-    int left;
-    int nread;
-    int bContinue = 1;
-    int discard = 0;
-
-    int64_t now = start;
-
-    for (int loop = 0; bContinue && loop < 32; loop++, now = mstime()) {
-
-        if (!discard && now > start + 200) {
-            discard = 1;
-            static int64_t antiSpam;
-            if (now > antiSpam + 5 * SECONDS) {
-                antiSpam = now;
-                if (Modes.netIngest && c->proxy_string[0] != '\0')
-                    fprintf(stderr, "<3>ERROR, not enough CPU: Discarding data from: %s (suppressing for 5 seconds)\n", c->proxy_string);
-                else
-                    fprintf(stderr, "<3>%s: ERROR, not enough CPU: Discarding data from: %s port %s (fd %d) (suppressing for 5 seconds)\n",
-                            c->service->descr, c->host, c->port, c->fd);
-            }
-        }
-        if (discard)
-            c->buflen = 0;
+// Make room in the client read buffer, if it's full it's badly formatted data and gets dropped.
+// Returns the number of bytes that can be appended.
+static int clientBufferLeft(struct client *c) {
+    if (!c->buf)
+        clientBufResize(c, NET_CLIENT_BUF_MIN);
 
-        left = MODES_CLIENT_BUF_SIZE - c->buflen - 1; // leave 1 extra byte for NUL termination in the ASCII case
+    int left = c->bufSize - c->buflen - 1; // leave 1 extra byte for NUL termination in the ASCII case
 
-        // If our buffer is full discard it, this is some badly formatted shit
-        if (left <= 0) {
-            c->garbage += c->buflen;
-            Modes.stats_current.remote_malformed_beast += c->buflen;
-            c->buflen = 0;
-            left = MODES_CLIENT_BUF_SIZE - c->buflen - 1; // leave 1 extra byte for NUL termination in the ASCII case
-            // If there is garbage, read more to discard it ASAP
-        }
-        // read instead of recv for modesbeast / gns-hulc ....
-        nread = read(c->fd, c->buf + c->buflen, left);
-        int err = errno;
+    // a message larger than the buffer, grow it to the maximum size before giving up
+    if (left <= 0 && c->bufSize < MODES_CLIENT_BUF_SIZE) {
+        clientBufFilled(c);
+        left = c->bufSize - c->buflen - 1;
+    }
 
-        // If we didn't get all the data we asked for, then return once we've processed what we did get.
-        if (nread != left) {
-            bContinue = 0;
-        }
+    // If our buffer is full discard it, this is some badly formatted shit
+    if (left <= 0) {
+        c->garbage += c->buflen;
+        __atomic_fetch_add(&Modes.stats_current.remote_malformed_beast, c->buflen, __ATOMIC_RELAXED);
+        c->buflen = 0;
+        left = c->bufSize - c->buflen - 1; // leave 1 extra byte for NUL termination in the ASCII case
+        // If there is garbage, read more to discard it ASAP
+    }
+    return left;
+}
 
-        if (nread > 0) {
-            c->last_read = now;
-        }
+static void clientReadError(struct client *c, int err) {
+    if (Modes.debug_net) {
+        fprintf(stderr, "%s: Socket Error: %s: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
+                c->service->descr, strerror(err), c->host, c->port,
+                c->fd, c->sendq_len, c->buflen);
+    }
+    modesCloseClient(c);
+}
 
-        if (nread < 0) {
-            if (err == EAGAIN || err == EWOULDBLOCK) {
-                // No data available, check later!
-                return;
-            }
-            // Other errors
-            if (Modes.debug_net) {
-                fprintf(stderr, "%s: Socket Error: %s: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
-                        c->service->descr, strerror(err), c->host, c->port,
-                        c->fd, c->sendq_len, c->buflen);
-            }
-            modesCloseClient(c);
-            return;
+static void clientReadEof(struct client *c) {
+    if (c->con) {
+        if (Modes.synthetic_now) {
+            Modes.synthetic_now = 0;
         }
+        fprintf(stderr, "%s: Remote server disconnected: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
+                c->service->descr, c->con->address, c->con->port, c->fd, c->sendq_len, c->buflen);
+    } else if (Modes.debug_net && !Modes.netIngest) {
+        fprintf(stderr, "%s: Listen client disconnected: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
+                c->service->descr, c->host, c->port, c->fd, c->sendq_len, c->buflen);
+    }
+    if (!c->con && Modes.debug_bogus) {
+        setExit(1);
+    }
+    if (Modes.beast_replay && c->service == Modes.beast_in_service) {
+        beastReplayDone();
+    }
+    modesCloseClient(c);
+}
 
-        // End of file
-        if (nread == 0) {
-            if (c->con) {
-                if (Modes.synthetic_now) {
-                    Modes.synthetic_now = 0;
+// Frame and handle nread bytes just appended to the client read buffer.
+// Returns -1 if the client was closed, 0 if there is nothing more to do for now
+static int modesProcessClientData(struct client *c, int nread, int64_t now) {
+    c->buflen += nread;
+    __atomic_fetch_add(&c->bytesReceived, nread, __ATOMIC_RELAXED);
+
+    char *som = c->buf; // first byte of next message
+    char *eod = c->buf + c->buflen; // one byte past end of data
+    // NUL-terminate so we are free to use strstr()
+    // nb: we never fill the last byte of the buffer with read data (see above) so this is safe
+    *eod = '\0';
+    char *p;
+    int remote = 1; // Messages will be marked remote by default
+    if ((c->fd == Modes.beast_fd) && (Modes.sdr_type == SDR_MODESBEAST || Modes.sdr_type == SDR_GNS)) {
+        /* Message from a local connected Modes-S beast or GNS5894 are passed off the internet */
+        remote = 0;
+    }
+
+    //char *lastSom = som;
+
+    // check for PROXY v1 header if connection is new / low bytes received
+    if (Modes.netIngest && c->bytesReceived <= 2 * MODES_CLIENT_BUF_SIZE) {
+        // disable this for the time being
+        if (c->buflen > 5 && som[0] == 'P' && som[1] == 'R') {
+            char *proxy = strstr(som, "PROXY ");
+            char *eop = strstr(som, "\r\n");
+            if (proxy && proxy == som) {
+                if (!eop) // incomplete proxy string (shouldn't happen but let's check anyhow)
+                    return 0;
+                *eop = '\0';
+                strncpy(c->proxy_string, proxy + 6, sizeof(c->proxy_string));
+                c->proxy_string[sizeof(c->proxy_string) - 1] = '\0'; // make sure it's null terminated
+                //fprintf(stderr, "%s\n", c->proxy_string);
+                *eop = '\r';
+
+                // expected string example: "PROXY TCP4 172.12.2.132 172.191.123.45 40223 30005"
+
+                char *space = proxy;
+                space = memchr(space + 1, ' ', eop - space - 1);
+                space = memchr(space + 1, ' ', eop - space - 1);
+                space = memchr(space + 1, ' ', eop - space - 1);
+                // hash up to 3rd space
+                if (eop - proxy > 10) {
+                    //fprintf(stderr, "%ld %ld %s\n", eop - proxy, space - proxy, space);
+                    __atomic_store_n(&c->receiverId, fasthash64(proxy, space - proxy, 0x2127599bf4325c37ULL), __ATOMIC_RELAXED);
                 }
-                fprintf(stderr, "%s: Remote server disconnected: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
-                        c->service->descr, c->con->address, c->con->port, c->fd, c->sendq_len, c->buflen);
-            } else if (Modes.debug_net && !Modes.netIngest) {
-                fprintf(stderr, "%s: Listen client disconnected: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
-                        c->service->descr, c->host, c->port, c->fd, c->sendq_len, c->buflen);
-            }
-            if (!c->con && Modes.debug_bogus) {
-                setExit(1);
+
+                som = eop + 2;
             }
-            modesCloseClient(c);
-            return;
         }
+    }
 
-        if (discard)
-            continue;
+    if (c->service->read_mode == READ_MODE_BEAST) {
+        // This is the Beast Binary scanning case.
+        // If there is a complete message still in the buffer, there must be the separator 'sep'
+        // in the buffer, note that we full-scan the buffer at every read for simplicity.
 
-        c->buflen += nread;
-        c->bytesReceived += nread;
-
-        char *som = c->buf; // first byte of next message
-        char *eod = c->buf + c->buflen; // one byte past end of data
-        // NUL-terminate so we are free to use strstr()
-        // nb: we never fill the last byte of the buffer with read data (see above) so this is safe
-        *eod = '\0';
-        char *p;
-        int remote = 1; // Messages will be marked remote by default
-        if ((c->fd == Modes.beast_fd) && (Modes.sdr_type == SDR_MODESBEAST || Modes.sdr_type == SDR_GNS)) {
-            /* Message from a local connected Modes-S beast or GNS5894 are passed off the internet */
-            remote = 0;
-        }
-
-        //char *lastSom = som;
-
-        // check for PROXY v1 header if connection is new / low bytes received
-        if (Modes.netIngest && c->bytesReceived <= 2 * MODES_CLIENT_BUF_SIZE) {
-            // disable this for the time being
-            if (c->buflen > 5 && som[0] == 'P' && som[1] == 'R') {
-                char *proxy = strstr(som, "PROXY ");
-                char *eop = strstr(som, "\r\n");
-                if (proxy && proxy == som) {
-                    if (!eop) // incomplete proxy string (shouldn't happen but let's check anyhow)
-                        break;
-                    *eop = '\0';
-                    strncpy(c->proxy_string, proxy + 6, sizeof(c->proxy_string));
-                    c->proxy_string[sizeof(c->proxy_string) - 1] = '\0'; // make sure it's null terminated
-                    //fprintf(stderr, "%s\n", c->proxy_string);
-                    *eop = '\r';
-
-                    // expected string example: "PROXY TCP4 172.12.2.132 172.191.123.45 40223 30005"
-
-                    char *space = proxy;
-                    space = memchr(space + 1, ' ', eop - space - 1);
-                    space = memchr(space + 1, ' ', eop - space - 1);
-                    space = memchr(space + 1, ' ', eop - space - 1);
-                    // hash up to 3rd space
-                    if (eop - proxy > 10) {
-                        //fprintf(stderr, "%ld %ld %s\n", eop - proxy, space - proxy, space);
-                        c->receiverId = fasthash64(proxy, space - proxy, 0x2127599bf4325c37ULL);
-                    }
 
-                    som = eop + 2;
-                }
+        // disconnect garbage feeds
+        if (c->garbage >= GARBAGE_THRESHOLD) {
+            if (1 || !Modes.netIngest || Modes.debug_receiver) {
+                *eod = '\0';
+                char sample[64];
+                hexEscapeString(som, sample, sizeof(sample));
+                sample[sizeof(sample) - 1] = '\0';
+                if (Modes.netIngest && c->proxy_string[0] != '\0')
+                    fprintf(stderr, "Garbage: Close: %s sample: %s\n", c->proxy_string, sample);
+                else
+                    fprintf(stderr, "Garbage: Close: %s port %s sample: %s\n", c->host, c->port, sample);
             }
+            modesCloseClient(c);
+            return -1;
         }
+        while (som < eod && ((p = byteFind(som, eod, (char) 0x1a)) != NULL)) { // The first byte of buffer 'should' be 0x1a
 
-        if (c->service->read_mode == READ_MODE_BEAST) {
-            // This is the Beast Binary scanning case.
-            // If there is a complete message still in the buffer, there must be the separator 'sep'
-            // in the buffer, note that we full-scan the buffer at every read for simplicity.
+            c->garbage += p - som;
+            __atomic_fetch_add(&Modes.stats_current.remote_malformed_beast, p - som, __ATOMIC_RELAXED);
 
+            //lastSom = p;
+            som = p; // consume garbage up to the 0x1a
+            ++p; // skip 0x1a
 
-            // disconnect garbage feeds
-            if (c->garbage >= GARBAGE_THRESHOLD) {
-                if (1 || !Modes.netIngest || Modes.debug_receiver) {
-                    *eod = '\0';
-                    char sample[64];
-                    hexEscapeString(som, sample, sizeof(sample));
-                    sample[sizeof(sample) - 1] = '\0';
-                    if (Modes.netIngest && c->proxy_string[0] != '\0')
-                        fprintf(stderr, "Garbage: Close: %s sample: %s\n", c->proxy_string, sample);
-                    else
-                        fprintf(stderr, "Garbage: Close: %s port %s sample: %s\n", c->host, c->port, sample);
-                }
-                modesCloseClient(c);
-                return;
+            if (p >= eod) {
+                // Incomplete message in buffer, retry later
+                break;
             }
-            while (som < eod && ((p = memchr(som, (char) 0x1a, eod - som)) != NULL)) { // The first byte of buffer 'should' be 0x1a
-
-                c->garbage += p - som;
-                Modes.stats_current.remote_malformed_beast += p - som;
 
-                //lastSom = p;
-                som = p; // consume garbage up to the 0x1a
-                ++p; // skip 0x1a
-
-                if (p >= eod) {
-                    // Incomplete message in buffer, retry later
-                    break;
-                }
-
-                char *eom; // one byte past end of message
-                unsigned char ch;
+            char *eom; // one byte past end of message
+            unsigned char ch;
 
 
-                // Check for message with receiverId prepended
-                ch = *p;
-                if (ch == 0xe3) {
-                    p++;
-                    uint64_t receiverId = 0;
-                    eom = p + 8;
-                    // we need to be careful of double escape characters in the receiverId
-                    for (int j = 0; j < 8 && p < eod && p < eom; j++) {
+            // Check for message with receiverId prepended
+            ch = *p;
+            if (ch == 0xe3) {
+                p++;
+                uint64_t receiverId = 0;
+                eom = p + 8;
+                // we need to be careful of double escape characters in the receiverId
+                for (int j = 0; j < 8 && p < eod && p < eom; j++) {
+                    ch = *p++;
+                    if (ch == 0x1A) {
                         ch = *p++;
-                        if (ch == 0x1A) {
-                            ch = *p++;
-                            eom++;
-                            if (p < eod && ch != 0x1A) { // check that it's indeed a double escape
-                                // might be start of message rather than double escape.
-                                c->garbage += p - 1 - som;
-                                Modes.stats_current.remote_malformed_beast += p - 1 - som;
-                                som = p - 1;
-                                goto beastWhileContinue;
-                            }
+                        eom++;
+                        if (p < eod && ch != 0x1A) { // check that it's indeed a double escape
+                            // might be start of message rather than double escape.
+                            c->garbage += p - 1 - som;
+                            __atomic_fetch_add(&Modes.stats_current.remote_malformed_beast, p - 1 - som, __ATOMIC_RELAXED);
+                            som = p - 1;
+                            goto beastWhileContinue;
                         }
-                        // Grab the receiver id (big endian format)
-                        receiverId = receiverId << 8 | (ch & 255);
-                    }
-                    if (!Modes.netIngest) {
-                        c->receiverId = receiverId;
                     }
+                    // Grab the receiver id (big endian format)
+                    receiverId = receiverId << 8 | (ch & 255);
+                }
+                if (!Modes.netIngest) {
+                    __atomic_store_n(&c->receiverId, receiverId, __ATOMIC_RELAXED);
+                }
 
-                    if (eom + 2 > eod)// Incomplete message in buffer, retry later
-                        break;
+                if (eom + 2 > eod)// Incomplete message in buffer, retry later
+                    break;
 
-                    som = p; // set start of next message
-                    p++; // skip 0x1a
-                }
+                som = p; // set start of next message
+                p++; // skip 0x1a
+            }
 
+            ch = *p;
+            if (ch == '2') {
+                eom = p + 1 + 6 + 1 + MODES_SHORT_MSG_BYTES;
+            } else if (ch == '3') {
+                eom = p + 1 + 6 + 1 + MODES_LONG_MSG_BYTES;
+            } else if (ch == '1') {
+                eom = p + 1 + 6 + 1 + MODEAC_MSG_BYTES;
+                if (0) {
+                    char sample[256];
+                    char *sampleStart = som - 32;
+                    if (sampleStart < c->buf)
+                        sampleStart = c->buf;
+                    *som = 'X';
+                    hexEscapeString(sampleStart, sample, sizeof(sample));
+                    *som = 0x1a;
+                    sample[sizeof(sample) - 1] = '\0';
+                    fprintf(stderr, "modeAC: som pos %d, sample %s, eom > eod %d\n", (int) (som - c->buf), sample, eom > eod);
+                }
+            } else if (ch == '5') {
+                eom = p + MODES_LONG_MSG_BYTES + 8;
+            } else if (ch == 0xe4) {
+                // read UUID and continue with next message
+                p++;
+                som = read_uuid(c, p, eod);
+                continue;
+            } else if (ch == 'P') {
+                //unsigned char *pu = (unsigned char*) p;
+                //fprintf(stderr, "%x %x %x %x %x\n", pu[0], pu[1], pu[2], pu[3], pu[4]);
+                eom = p + 4;
+            } else if (ch == 'W') {
+                // read command
+                p++;
                 ch = *p;
-                if (ch == '2') {
-                    eom = p + 1 + 6 + 1 + MODES_SHORT_MSG_BYTES;
-                } else if (ch == '3') {
-                    eom = p + 1 + 6 + 1 + MODES_LONG_MSG_BYTES;
-                } else if (ch == '1') {
-                    eom = p + 1 + 6 + 1 + MODEAC_MSG_BYTES;
-                    if (0) {
-                        char sample[256];
-                        char *sampleStart = som - 32;
-                        if (sampleStart < c->buf)
-                            sampleStart = c->buf;
-                        *som = 'X';
-                        hexEscapeString(sampleStart, sample, sizeof(sample));
-                        *som = 0x1a;
-                        sample[sizeof(sample) - 1] = '\0';
-                        fprintf(stderr, "modeAC: som pos %d, sample %s, eom > eod %d\n", (int) (som - c->buf), sample, eom > eod);
-                    }
-                } else if (ch == '5') {
-                    eom = p + MODES_LONG_MSG_BYTES + 8;
-                } else if (ch == 0xe4) {
-                    // read UUID and continue with next message
-                    p++;
-                    som = read_uuid(c, p, eod);
-                    continue;
-                } else if (ch == 'P') {
-                    //unsigned char *pu = (unsigned char*) p;
-                    //fprintf(stderr, "%x %x %x %x %x\n", pu[0], pu[1], pu[2], pu[3], pu[4]);
-                    eom = p + 4;
-                } else if (ch == 'W') {
-                    // read command
-                    p++;
-                    ch = *p;
-                    if (ch == 'O') {
-                        // O for high resolution timer, both P and p already used for previous iterations
-                        // explicitely enable ping for this client
-                        c->pingEnabled = 1;
-                        uint32_t newPing = now & ((1 << 24) - 1);
-                        if (Modes.debug_ping)
-                            fprintf(stderr, "Initial Ping: %d\n", newPing);
-                        pingClient(c, newPing);
-                        if (flushClient(c, now) < 0) {
-                            return;
-                        }
+                if (ch == 'O') {
+                    // O for high resolution timer, both P and p already used for previous iterations
+                    // explicitely enable ping for this client
+                    c->pingEnabled = 1;
+                    uint32_t newPing = now & ((1 << 24) - 1);
+                    if (Modes.debug_ping)
+                        fprintf(stderr, "Initial Ping: %d\n", newPing);
+                    pingClient(c, newPing);
+                    if (flushClient(c, now) < 0) {
+                        return -1;
                     }
-                    som += 2;
-                    continue;
-                } else {
-                    // Not a valid beast message, skip 0x1a
-                    // Skip following byte as well:
-                    // either: 0x1a (likely not a start of message but rather escaped 0x1a)
-                    // or: any other char is skipped anyhow when looking for the next 0x1a
-                    som += 2;
-                    Modes.stats_current.remote_malformed_beast += 2;
-                    c->garbage += 2;
-                    continue;
                 }
+                som += 2;
+                continue;
+            } else {
+                // Not a valid beast message, skip 0x1a
+                // Skip following byte as well:
+                // either: 0x1a (likely not a start of message but rather escaped 0x1a)
+                // or: any other char is skipped anyhow when looking for the next 0x1a
+                som += 2;
+                __atomic_fetch_add(&Modes.stats_current.remote_malformed_beast, 2, __ATOMIC_RELAXED);
+                c->garbage += 2;
+                continue;
+            }
 
-                if (eom > eod) // Incomplete message in buffer, retry later
-                    break;
+            if (eom > eod) // Incomplete message in buffer, retry later
+                break;
+
+            int frameLen = eom - p;
+            char noEscapeStorage[MODES_LONG_MSG_BYTES + 8 + 16]; // 16 extra for good measure
+            char *noEscape = p;
+
+            // we need to be careful of double escape characters in the message body
+            // without any, the message is handled in place
+            if (byteFind(p, eom, (char) 0x1A)) {
+                char *t = noEscapeStorage;
+                while (p < eom) {
+                    if (*p == (char) 0x1A) {
+                        p++;
+                        eom++;
+                        if (eom > eod) { // Incomplete message in buffer, retry later
+                            goto beastWhileBreak;
+                        }
+                        if (*p != (char) 0x1A) { // check that it's indeed a double escape
+                            // might be start of message rather than double escape.
+                            //
+                            c->garbage += p - 1 - som;
+                            __atomic_fetch_add(&Modes.stats_current.remote_malformed_beast, p - 1 - som, __ATOMIC_RELAXED);
+                            som = p - 1;
+
+                            if (0) {
+                                char sample[256];
+                                char *sampleStart = som - 32;
+                                if (sampleStart < c->buf)
+                                    sampleStart = c->buf;
+                                *som = 'X';
+                                hexEscapeString(sampleStart, sample, sizeof(sample));
+                                *som = 0x1a;
+                                sample[sizeof(sample) - 1] = '\0';
+                                fprintf(stderr, "not a double Escape: som pos %d, sample %s, eom - som %d\n", (int) (som - c->buf), sample, (int) (eom - som));
 
-                char noEscapeStorage[MODES_LONG_MSG_BYTES + 8 + 16]; // 16 extra for good measure
-                char *noEscape = p;
-
-                // we need to be careful of double escape characters in the message body
-                if (memchr(p, (char) 0x1A, eom - p)) {
-                    char *t = noEscapeStorage;
-                    while (p < eom) {
-                        if (*p == (char) 0x1A) {
-                            p++;
-                            eom++;
-                            if (eom > eod) { // Incomplete message in buffer, retry later
-                                goto beastWhileBreak;
-                            }
-                            if (*p != (char) 0x1A) { // check that it's indeed a double escape
-                                // might be start of message rather than double escape.
-                                //
-                                c->garbage += p - 1 - som;
-                                Modes.stats_current.remote_malformed_beast += p - 1 - som;
-                                som = p - 1;
-
-                                if (0) {
-                                    char sample[256];
-                                    char *sampleStart = som - 32;
-                                    if (sampleStart < c->buf)
-                                        sampleStart = c->buf;
-                                    *som = 'X';
-                                    hexEscapeString(sampleStart, sample, sizeof(sample));
-                                    *som = 0x1a;
-                                    sample[sizeof(sample) - 1] = '\0';
-                                    fprintf(stderr, "not a double Escape: som pos %d, sample %s, eom - som %d\n", (int) (som - c->buf), sample, (int) (eom - som));
-
-                                }
-
-                                goto beastWhileContinue;
                             }
+
+                            goto beastWhileContinue;
                         }
-                        *t++ = *p++;
                     }
-                    noEscape = noEscapeStorage;
+                    *t++ = *p++;
                 }
+                noEscape = noEscapeStorage;
+            }
 
-                if (eom > eod) // Incomplete message in buffer, retry later
-                    break;
+            if (eom > eod) // Incomplete message in buffer, retry later
+                break;
 
-                if (Modes.receiver_focus && c->receiverId != Modes.receiver_focus && noEscape[0] != 'P') {
-                    // advance to next message
-                    som = eom;
-                    continue;
-                }
+            if (Modes.receiver_focus && c->receiverId != Modes.receiver_focus && noEscape[0] != 'P') {
+                // advance to next message
+                som = eom;
+                continue;
+            }
 
-                // Have a 0x1a followed by 1/2/3/4/5 - pass message to handler.
-                if (c->service->read_handler(c, noEscape, remote, now)) {
-                    modesCloseClient(c);
-                    return;
-                }
+            // Have a 0x1a followed by 1/2/3/4/5 - pass message to handler.
+            if (dispatchFrame(c, noEscape, frameLen, remote, now)) {
+                modesCloseClient(c);
+                return -1;
+            }
 
 
-                // if we get some valid data, reduce the garbage counter.
-                if (c->garbage > 128)
-                    c->garbage -= 128;
+            // if we get some valid data, reduce the garbage counter.
+            if (c->garbage > 128)
+                c->garbage -= 128;
 
-                // advance to next message
-                som = eom;
+            // advance to next message
+            som = eom;
 
 beastWhileContinue:
-                ;
-            }
+            ;
+        }
 beastWhileBreak:
 
-            if (eod - som > 256) {
-                //fprintf(stderr, "beastWhile too much data remaining, garbage?!\n");
-                c->garbage += eod - som;
-                Modes.stats_current.remote_malformed_beast += eod - som;
-                som = eod;
-            }
-
-        } else if (c->service->read_mode == READ_MODE_IGNORE) {
-            // drop the bytes on the floor
+        if (eod - som > 256) {
+            //fprintf(stderr, "beastWhile too much data remaining, garbage?!\n");
+            c->garbage += eod - som;
+            __atomic_fetch_add(&Modes.stats_current.remote_malformed_beast, eod - som, __ATOMIC_RELAXED);
             som = eod;
+        }
 
-        } else if (c->service->read_mode == READ_MODE_BEAST_COMMAND) {
-            while (som < eod && ((p = memchr(som, (char) 0x1a, eod - som)) != NULL)) { // The first byte of buffer 'should' be 0x1a
-                char *eom; // one byte past end of message
+    } else if (c->service->read_mode == READ_MODE_IGNORE) {
+        // drop the bytes on the floor
+        som = eod;
 
-                som = p; // consume garbage up to the 0x1a
-                ++p; // skip 0x1a
+    } else if (c->service->read_mode == READ_MODE_BEAST_COMMAND) {
+        while (som < eod && ((p = byteFind(som, eod, (char) 0x1a)) != NULL)) { // The first byte of buffer 'should' be 0x1a
+            char *eom; // one byte past end of message
 
-                if (p >= eod) {
-                    // Incomplete message in buffer, retry later
-                    break;
-                }
+            som = p; // consume garbage up to the 0x1a
+            ++p; // skip 0x1a
 
-                if (*p == '1') {
-                    eom = p + 2;
-                } else if (*p == 'W') { // W command
-                    eom = p + 2;
-                } else if (*p == 'P') { // ping from the receiver
-                    eom = p + 4;
-                } else {
-                    // Not a valid beast command, skip 0x1a and try again
-                    ++som;
-                    continue;
-                }
+            if (p >= eod) {
+                // Incomplete message in buffer, retry later
+                break;
+            }
 
-                // we need to be careful of double escape characters in the message body
-                for (p = som + 1; p < eod && p < eom; p++) {
-                    if (0x1A == *p) {
-                        p++;
-                        eom++;
-                    }
-                }
+            if (*p == '1') {
+                eom = p + 2;
+            } else if (*p == 'W') { // W command
+                eom = p + 2;
+            } else if (*p == 'P') { // ping from the receiver
+                eom = p + 4;
+            } else {
+                // Not a valid beast command, skip 0x1a and try again
+                ++som;
+                continue;
+            }
 
-                if (eom > eod) { // Incomplete message in buffer, retry later
-                    break;
+            // we need to be careful of double escape characters in the message body
+            for (p = som + 1; p < eod && p < eom; p++) {
+                if (0x1A == *p) {
+                    p++;
+                    eom++;
                 }
+            }
 
-                // Pass message to handler.
-                if (c->service->read_handler(c, som + 1, remote, now)) {
-                    modesCloseClient(c);
-                    return;
-                }
+            if (eom > eod) { // Incomplete message in buffer, retry later
+                break;
+            }
 
-                // advance to next message
-                som = eom;
+            // Pass message to handler.
+            if (c->service->read_handler(c, som + 1, remote, now)) {
+                modesCloseClient(c);
+                return -1;
             }
 
-        } else if (c->service->read_mode == READ_MODE_ASCII) {
-            //
-            // This is the ASCII scanning case, AVR RAW or HTTP at present
-            // If there is a complete message still in the buffer, there must be the separator 'sep'
-            // in the buffer, note that we full-scan the buffer at every read for simplicity.
-
-            // Always NUL-terminate so we are free to use strstr()
-            // nb: we never fill the last byte of the buffer with read data (see above) so this is safe
-            *eod = '\0';
-
-            while (som < eod && (p = strstr(som, c->service->read_sep)) != NULL) { // end of first message if found
-                *p = '\0'; // The handler expects null terminated strings
-                if (c->service->read_handler(c, som, remote, now)) { // Pass message to handler.
-                    if (Modes.debug_net) {
-                        fprintf(stderr, "%s: Closing connection from %s port %s\n", c->service->descr, c->host, c->port);
-                    }
-                    modesCloseClient(c); // Handler returns 1 on error to signal we .
-                    return; // should close the client connection
+            // advance to next message
+            som = eom;
+        }
+
+    } else if (c->service->read_mode == READ_MODE_ASCII) {
+        //
+        // This is the ASCII scanning case, AVR RAW or HTTP at present
+        // If there is a complete message still in the buffer, there must be the separator 'sep'
+        // in the buffer, note that we full-scan the buffer at every read for simplicity.
+
+        while (som < eod && (p = sepFind(som, eod, c->service->read_sep, c->service->read_sep_len)) != NULL) { // end of first message if found
+            *p = '\0'; // The handler expects null terminated strings
+            if (dispatchFrame(c, som, p - som, remote, now)) { // Pass message to handler.
+                if (Modes.debug_net) {
+                    fprintf(stderr, "%s: Closing connection from %s port %s\n", c->service->descr, c->host, c->port);
                 }
-                som = p + c->service->read_sep_len; // Move to start of next message
+                modesCloseClient(c); // Handler returns 1 on error to signal we .
+                return -1; // should close the client connection
             }
+            som = p + c->service->read_sep_len; // Move to start of next message
         }
+    }
 
-        if (!c->receiverIdLocked && (c->bytesReceived > 512 || now > c->connectedSince + 10000)) {
-            lockReceiverId(c);
+    if (!c->receiverIdLocked && (c->bytesReceived > 512 || now > c->connectedSince + 10000)) {
+        lockReceiverId(c);
+    }
+
+    if (som > c->buf) { // We processed something - so
+        //som = lastSom;
+        c->buflen = eod - som; //     Update the unprocessed buffer length
+        if (c->buflen <= 0) {
+            if (c->buflen < 0)
+                fprintf(stderr, "codepoint Si0wereH\n");
+            c->buflen = 0;
+        } else {
+            memmove(c->buf, som, c->buflen); //     Move what's remaining to the start of the buffer
         }
+    } else { // If no message was decoded process the next client
+        return 0;
+    }
+    return 1;
+}
 
-        if (som > c->buf) { // We processed something - so
-            //som = lastSom;
-            c->buflen = eod - som; //     Update the unprocessed buffer length
-            if (c->buflen <= 0) {
-                if (c->buflen < 0)
-                    fprintf(stderr, "codepoint Si0wereH\n");
-                c->buflen = 0;
-            } else {
-                memmove(c->buf, som, c->buflen); //     Move what's remaining to the start of the buffer
+// Inflate the input of a zlib connection into the read buffer and process it.
+// Returns -1 if the client was closed
+static int clientInflate(struct client *c, const char *data, int len, int64_t now) {
+    z_stream *zs = c->zs;
+    zs->next_in = (Bytef *) data;
+    zs->avail_in = len;
+    c->last_read = now;
+    do {
+        int left = clientBufferLeft(c);
+        zs->next_out = (Bytef *) c->buf + c->buflen;
+        zs->avail_out = left;
+        int res = inflate(zs, Z_SYNC_FLUSH);
+        if (res == Z_STREAM_END) {
+            // the sender finished the stream, a new one may follow
+            inflateReset(zs);
+        } else if (res != Z_OK && res != Z_BUF_ERROR) {
+            fprintf(stderr, "%s: zlib stream error (%s): %s port %s (fd %d)\n",
+                    c->service->descr, zs->msg ? zs->msg : zError(res), c->host, c->port, c->fd);
+            modesCloseClient(c);
+            return -1;
+        }
+        int n = left - zs->avail_out;
+        if (n && modesProcessClientData(c, n, now) < 0)
+            return -1;
+        if (!zs->avail_out)
+            clientBufFilled(c);
+        if (res == Z_BUF_ERROR)
+            break; // no progress possible, needs more input
+    } while (zs->avail_in || !zs->avail_out);
+    return 0;
+}
+
+// Append received data to the read buffer and frame it, piece by piece if it doesn't fit.
+// Returns -1 if the client was closed
+static int clientReceived(struct client *c, const char *data, int len, int64_t now) {
+    if (c->zs)
+        return clientInflate(c, data, len, now);
+    while (len > 0 && c->service) {
+        int left = clientBufferLeft(c);
+        if (len > left) {
+            clientBufFilled(c);
+            left = clientBufferLeft(c);
+        }
+        int n = imin(left, len);
+        memcpy(c->buf + c->buflen, data, n);
+        data += n;
+        len -= n;
+        c->last_read = now;
+        if (modesProcessClientData(c, n, now) < 0)
+            return -1;
+    }
+    return c->service ? 0 : -1;
+}
+
+static void discardWarning(struct client *c, int64_t now) {
+    static _Thread_local int64_t antiSpam;
+    if (now > antiSpam + 5 * SECONDS) {
+        antiSpam = now;
+        if (Modes.netIngest && c->proxy_string[0] != '\0')
+            fprintf(stderr, "<3>ERROR, not enough CPU: Discarding data from: %s (suppressing for 5 seconds)\n", c->proxy_string);
+        else
+            fprintf(stderr, "<3>%s: ERROR, not enough CPU: Discarding data from: %s port %s (fd %d) (suppressing for 5 seconds)\n",
+                    c->service->descr, c->host, c->port, c->fd);
+    }
+}
+
+static void modesReadFromClient(struct client *c, int64_t start) {
+    assert(c->service);
+
+    char zdata[NET_ZLIB_READ_SIZE]; // zlib connections read here and inflate into c->buf
+
+    int left;
+    int nread;
+    int bContinue = 1;
+    int discard = 0;
+
+    int64_t now = start;
+
+    for (int loop = 0; bContinue && loop < 32; loop++, now = mstime()) {
+
+        // replay time follows the message timestamps, it's not an indication of falling behind
+        // a zlib stream can't skip data
+        if (!discard && now > start + 200 && !Modes.beast_replay && !c->zs) {
+            discard = 1;
+            discardWarning(c, now);
+        }
+        if (discard)
+            c->buflen = 0;
+
+        // the last read filled the buffer, there is more waiting
+        if (loop > 0 && !discard && !c->zs)
+            clientBufFilled(c);
+
+        char *target;
+        if (c->zs) {
+            target = zdata;
+            left = sizeof(zdata);
+        } else {
+            left = clientBufferLeft(c);
+            target = c->buf + c->buflen;
+        }
+
+        // read instead of recv for modesbeast / gns-hulc ....
+        nread = read(c->fd, target, left);
+        int err = errno;
+
+        // If we didn't get all the data we asked for, then return once we've processed what we did get.
+        if (nread != left) {
+            bContinue = 0;
+        }
+
+        if (nread > 0) {
+            c->last_read = now;
+        }
+
+        if (nread < 0) {
+            if (err == EAGAIN || err == EWOULDBLOCK) {
+                // No data available, check later!
+                return;
             }
-        } else { // If no message was decoded process the next client
+            // Other errors
+            clientReadError(c, err);
+            return;
+        }
+
+        // End of file
+        if (nread == 0) {
+            clientReadEof(c);
+            return;
+        }
+
+        if (discard)
+            continue;
+
+        if (c->zs) {
+            if (clientInflate(c, zdata, nread, now) < 0)
+                return;
+            continue;
+        }
+
+        if (modesProcessClientData(c, nread, now) <= 0)
             return;
+    }
+}
+
+// receiverId of a datagram sender, like setProxyString does for TCP clients
+static uint64_t datagramSenderId(struct sockaddr_storage *addr) {
+    if (addr->ss_family == AF_INET6) {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *) addr;
+        return fasthash64(&in6->sin6_addr, sizeof(in6->sin6_addr), 0x2127599bf4325c37ULL ^ in6->sin6_port);
+    }
+    struct sockaddr_in *in = (struct sockaddr_in *) addr;
+    return fasthash64(&in->sin_addr, sizeof(in->sin_addr), 0x2127599bf4325c37ULL ^ in->sin_port);
+}
+
+// Datagram clients: read up to NET_UDP_BATCH datagrams per recvmmsg. Every
+// datagram holds whole Beast frames and is framed on its own, its sender
+// determines the receiverId unless the datagram carries one.
+static void modesReadDatagrams(struct client *c, int64_t start) {
+    static char data[NET_UDP_BATCH][NET_UDP_RECV_SIZE]; // only used by the main network loop
+    struct mmsghdr msgs[NET_UDP_BATCH];
+    struct iovec iov[NET_UDP_BATCH];
+    struct sockaddr_storage addrs[NET_UDP_BATCH];
+    int discard = 0;
+    int64_t now = start;
+
+    for (int loop = 0; loop < 32; loop++, now = mstime()) {
+        if (!discard && now > start + 200 && !Modes.beast_replay) {
+            discard = 1;
+            discardWarning(c, now);
+        }
+
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < NET_UDP_BATCH; i++) {
+            iov[i].iov_base = data[i];
+            iov[i].iov_len = NET_UDP_RECV_SIZE;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+
+        int count = recvmmsg(c->fd, msgs, NET_UDP_BATCH, MSG_DONTWAIT, NULL);
+        if (count < 0) {
+            int err = errno;
+            if (err == EAGAIN || err == EWOULDBLOCK || err == EINTR)
+                return;
+            // errors of earlier sends (ICMP port unreachable and the like) are
+            // reported here, they don't make a datagram socket unusable
+            if (Modes.debug_net) {
+                fprintf(stderr, "%s: %s port %s: %s\n", c->service->descr, c->host, c->port, strerror(err));
+            }
+            continue;
         }
+
+        c->last_read = now;
+
+        for (int i = 0; i < count && !discard && c->service->read_mode != READ_MODE_IGNORE; i++) {
+            int len = msgs[i].msg_len;
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                c->garbage += len;
+                __atomic_fetch_add(&Modes.stats_current.remote_malformed_beast, len, __ATOMIC_RELAXED);
+                continue;
+            }
+            c->buflen = 0;
+            c->receiverId = datagramSenderId(&addrs[i]);
+            if (clientReceived(c, data[i], len, now) < 0)
+                return;
+        }
+
+        if (count < NET_UDP_BATCH)
+            return;
     }
 }
 
@@ -3071,6 +4415,11 @@ const char *airground_enum_string(airground_t ag) {
 }
 
 static void modesNetSecondWork(int64_t now) {
+    static int64_t nextBufCheck;
+    int bufCheck = (now >= nextBufCheck);
+    if (bufCheck)
+        nextBufCheck = now + NET_CLIENT_BUF_CHECK;
+
     struct net_service *s;
     for (s = Modes.services; s; s = s->next) {
         if (Modes.net_heartbeat_interval && s->writer
@@ -3079,6 +4428,8 @@ static void modesNetSecondWork(int64_t now) {
             // If we have generated no messages for a while, send a heartbeat
             s->writer->send_heartbeat(s);
         }
+        for (struct client *c = s->clients; bufCheck && c; c = c->next)
+            clientBufCheck(c, now);
     }
 }
 
@@ -3089,11 +4440,10 @@ void netFreeClients() {
 
     for (s = Modes.services; s; s = s->next) {
         for (prev = &s->clients, c = *prev; c; c = *prev) {
-            if (c->fd == -1) {
+            if (c->fd == -1 && !c->uringPending) {
                 // Recently closed, prune from list
                 *prev = c->next;
-                sfree(c->sendq);
-                sfree(c);
+                clientFree(c);
             } else {
                 prev = &c->next;
             }
@@ -3101,16 +4451,719 @@ void netFreeClients() {
     }
 }
 
-static void handleEpoll(int count) {
+//
+//=========================================================================
+//
+// Network I/O threads
+//
+
+static struct net_batch *netLoopBatch(struct net_loop *loop) {
+    struct net_batch *batch = loop->freeBatches;
+    if (batch) {
+        loop->freeBatches = batch->next;
+    } else if (!(batch = malloc(sizeof(struct net_batch)))) {
+        fprintf(stderr, "Out of memory allocating network frame batch\n");
+        exit(1);
+    }
+    batch->next = NULL;
+    batch->used = 0;
+    return batch;
+}
+
+// Hand the filled batch to the decode thread, blocks while the decode thread is too far behind
+static void netLoopPublish(struct net_loop *loop) {
+    if (!loop->filling->used)
+        return;
+
+    pthread_mutex_lock(&loop->thread.mutex);
+
+    struct net_batch *batch = loop->filling;
+    batch->seq = ++loop->published;
+    *loop->queuedTail = batch;
+    loop->queuedTail = &batch->next;
+    loop->inFlight++;
+
+    uint64_t one = 1;
+    if (write(netLoopWakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        perror("netLoopWakeFd write");
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    while (loop->inFlight >= NET_LOOP_MAX_QUEUED && !Modes.exit) {
+        threadTimedWait(&loop->thread, &ts, 100);
+    }
+
+    loop->filling = netLoopBatch(loop);
+
+    pthread_mutex_unlock(&loop->thread.mutex);
+}
+
+static int netLoopQueueFrame(struct client *c, char *p, int len, int remote, int64_t now) {
+    struct net_loop *loop = c->loop;
+    int64_t size = (sizeof(struct net_frame) + len + 1 + 7) & ~7;
+
+    if (loop->filling->used + size > NET_BATCH_SIZE)
+        netLoopPublish(loop);
+
+    struct net_frame *frame = (struct net_frame *) (loop->filling->data + loop->filling->used);
+    frame->client = c;
+    frame->handler = c->service->read_handler;
+    frame->receiverId = c->receiverId;
+    frame->now = now;
+    frame->len = len;
+    frame->remote = remote;
+    memcpy(frame->data, p, len);
+    frame->data[len] = '\0';
+    loop->filling->used += size;
+
+    return __atomic_load_n(&c->closeRequested, __ATOMIC_RELAXED);
+}
+
+// Pass a complete frame to the service read handler, clients of a network I/O
+// thread queue it for the decode thread instead (pongs are handled right away).
+// Returns 1 if the client should be closed.
+static int dispatchFrame(struct client *c, char *p, int len, int remote, int64_t now) {
+    if (!c->loop || (c->service->read_mode == READ_MODE_BEAST && p[0] == 'P'))
+        return c->service->read_handler(c, p, remote, now);
+    return netLoopQueueFrame(c, p, len, remote, now);
+}
+
+// Decode thread: run the queued frames of all loops through their handlers
+static void netLoopsDecode(void) {
+    for (int i = 0; i < netLoopCount; i++) {
+        struct net_loop *loop = &netLoops[i];
+
+        // take a limited number of batches per round so output flushing isn't held up
+        pthread_mutex_lock(&loop->thread.mutex);
+        struct net_batch *batches = loop->queued;
+        struct net_batch *last = NULL;
+        int taken = 0;
+        for (struct net_batch *batch = batches; batch && taken < NET_LOOP_DECODE_BATCHES; batch = batch->next, taken++)
+            last = batch;
+        if (last) {
+            loop->queued = last->next;
+            if (!loop->queued)
+                loop->queuedTail = &loop->queued;
+            last->next = NULL;
+        }
+        if (loop->queued) {
+            // more left, don't wait in the next epoll_wait
+            uint64_t one = 1;
+            if (write(netLoopWakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+                perror("netLoopWakeFd write");
+        }
+        pthread_mutex_unlock(&loop->thread.mutex);
+
+        if (!batches)
+            continue;
+
+        struct net_batch **tail = &loop->done;
+        while (*tail)
+            tail = &(*tail)->next;
+        *tail = batches;
+
+        for (struct net_batch *batch = batches; batch; batch = batch->next) {
+            char *p = batch->data;
+            char *end = batch->data + batch->used;
+            while (p < end) {
+                struct net_frame *frame = (struct net_frame *) p;
+                struct client *c = frame->client;
+                if (!__atomic_load_n(&c->closeRequested, __ATOMIC_RELAXED)) {
+                    netFrameCurrent = frame;
+                    if (frame->handler(c, frame->data, frame->remote, frame->now))
+                        __atomic_store_n(&c->closeRequested, 1, __ATOMIC_RELAXED);
+                    netFrameCurrent = NULL;
+                }
+                p += (sizeof(struct net_frame) + frame->len + 1 + 7) & ~7;
+            }
+        }
+    }
+}
+
+// Decode thread: give the decoded batches back once tracking is done with them
+static void netLoopsRelease(void) {
+    for (int i = 0; i < netLoopCount; i++) {
+        struct net_loop *loop = &netLoops[i];
+        struct net_batch *batches = loop->done;
+        if (!batches)
+            continue;
+        loop->done = NULL;
+
+        pthread_mutex_lock(&loop->thread.mutex);
+        while (batches) {
+            struct net_batch *batch = batches;
+            batches = batch->next;
+            loop->consumed = batch->seq;
+            loop->inFlight--;
+            batch->next = loop->freeBatches;
+            loop->freeBatches = batch;
+        }
+        add_timespecs(&loop->cpu, &Modes.stats_current.reader_cpu, &Modes.stats_current.reader_cpu);
+        loop->cpu.tv_sec = 0;
+        loop->cpu.tv_nsec = 0;
+        pthread_cond_signal(&loop->thread.cond);
+        pthread_mutex_unlock(&loop->thread.mutex);
+    }
+}
+
+static void netLoopHousekeeping(struct net_loop *loop, int64_t now) {
+    int bufCheck = (now >= loop->nextBufCheck);
+    if (bufCheck)
+        loop->nextBufCheck = now + NET_CLIENT_BUF_CHECK;
+
+    for (struct client *c = loop->clients; c; c = c->next) {
+        if (c->service && __atomic_load_n(&c->closeRequested, __ATOMIC_RELAXED))
+            modesCloseClient(c);
+        if (bufCheck)
+            clientBufCheck(c, now);
+    }
+
+    pingSenders(Modes.beast_in_service, loop->clients, &loop->currentPing, now);
+
+    // free closed clients once the decode thread is done with their frames
+    pthread_mutex_lock(&loop->thread.mutex);
+    struct client *c, **prev;
+    for (prev = &loop->clients, c = *prev; c; c = *prev) {
+        if (c->fd == -1 && c->closeSeq <= loop->consumed) {
+            *prev = c->next;
+            clientFree(c);
+        } else {
+            prev = &c->next;
+        }
+    }
+    pthread_mutex_unlock(&loop->thread.mutex);
+}
+
+static void *netLoopEntryPoint(void *arg) {
+    struct net_loop *loop = arg;
+    netLoopCurrent = loop;
+
+    while (!Modes.exit) {
+        int count = epoll_wait(loop->epfd, loop->events, loop->maxEvents, NET_LOOP_HOUSEKEEPING);
+
+        struct timespec cpu;
+        start_cpu_timing(&cpu);
+
+        handleEpoll(loop->events, count);
+        netLoopPublish(loop);
+
+        if (count == loop->maxEvents) {
+            epollAllocEvents(&loop->events, &loop->maxEvents);
+        }
+
+        int64_t now = mstime();
+        if (now >= loop->nextHousekeeping) {
+            loop->nextHousekeeping = now + NET_LOOP_HOUSEKEEPING;
+            netLoopHousekeeping(loop, now);
+        }
+
+        pthread_mutex_lock(&loop->thread.mutex);
+        end_cpu_timing(&cpu, &loop->cpu);
+        pthread_mutex_unlock(&loop->thread.mutex);
+    }
+    return NULL;
+}
+
+// Move the TCP listeners of the given services to the network I/O threads:
+// every thread listens on the same addresses with SO_REUSEPORT and the kernel
+// spreads new connections over them. Unix sockets stay on the main loop.
+static void netLoopsInit(struct net_service **services, int serviceCount) {
+    netLoopCount = Modes.netIoThreads;
+    if (!netLoopCount)
+        return;
+
+    netLoopWakeFd = eventfd(0, EFD_NONBLOCK);
+    if (netLoopWakeFd < 0) {
+        perror("eventfd");
+        exit(1);
+    }
+    struct epoll_event wakeEvent = { .events = EPOLLIN, .data.ptr = &netLoopWakeFd };
+    if (epoll_ctl(Modes.net_epfd, EPOLL_CTL_ADD, netLoopWakeFd, &wakeEvent))
+        perror("epoll_ctl fail:");
+
+    int listenCount = 0;
+    for (int k = 0; k < serviceCount; k++) {
+        listenCount += services[k]->listener_count;
+    }
+
+    for (int i = 0; i < netLoopCount; i++) {
+        struct net_loop *loop = &netLoops[i];
+        char name[32];
+        snprintf(name, sizeof(name), "netIo%d", i);
+        threadInit(&loop->thread, name);
+        loop->index = i;
+        loop->epfd = my_epoll_create();
+        epollAllocEvents(&loop->events, &loop->maxEvents);
+        loop->queuedTail = &loop->queued;
+        loop->filling = netLoopBatch(loop);
+        loop->listenSockets = aligned_malloc(imax(1, listenCount) * sizeof(struct client));
+        if (!loop->listenSockets) {
+            fprintf(stderr, "Out of memory allocating listen sockets\n");
+            exit(1);
+        }
+        memset(loop->listenSockets, 0, imax(1, listenCount) * sizeof(struct client));
+    }
+
+    for (int k = 0; k < serviceCount; k++) {
+        struct net_service *service = services[k];
+        for (int j = 0; j < service->listener_count; j++) {
+            struct client *listener = &service->listenSockets[j];
+            struct sockaddr_storage storage;
+            struct sockaddr *saddr = (struct sockaddr *) &storage;
+            socklen_t slen = sizeof(storage);
+
+            if (getsockname(listener->fd, saddr, &slen) || saddr->sa_family == AF_UNIX)
+                continue;
+
+            epoll_ctl(Modes.net_epfd, EPOLL_CTL_DEL, listener->fd, &listener->epollEvent);
+            anetCloseSocket(listener->fd);
+            listener->fd = -1;
+            service->listener_fds[j] = -1;
+
+            for (int i = 0; i < netLoopCount; i++) {
+                struct net_loop *loop = &netLoops[i];
+                int fd = anetTcpReusePortServer(loop->aneterr, saddr, slen, SOCK_NONBLOCK);
+                if (fd == ANET_ERR) {
+                    fprintf(stderr, "Error opening the listening socket for %s on network I/O thread %d: %s\n",
+                            service->descr, i, loop->aneterr);
+                    exit(1);
+                }
+                struct client *c = &loop->listenSockets[loop->listenCount++];
+                c->service = service;
+                c->fd = fd;
+                c->acceptSocket = 1;
+                c->loop = loop;
+                c->epollEvent.events = EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP;
+                c->epollEvent.data.ptr = c;
+                if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, c->fd, &c->epollEvent))
+                    perror("epoll_ctl fail:");
+            }
+        }
+    }
+
+    for (int i = 0; i < netLoopCount; i++) {
+        threadCreate(&netLoops[i].thread, NULL, netLoopEntryPoint, &netLoops[i]);
+    }
+    if (!Modes.quiet) {
+        fprintf(stderr, "network input: %d I/O threads\n", netLoopCount);
+    }
+}
+
+static void netLoopsCleanup(void) {
+    for (int i = 0; i < netLoopCount; i++) {
+        threadSignalJoin(&netLoops[i].thread);
+    }
+    for (int i = 0; i < netLoopCount; i++) {
+        struct net_loop *loop = &netLoops[i];
+
+        struct client *c = loop->clients, *nc;
+        while (c) {
+            nc = c->next;
+            if (c->fd >= 0)
+                anetCloseSocket(c->fd);
+            clientFree(c);
+            c = nc;
+        }
+        loop->clients = NULL;
+
+        for (int j = 0; j < loop->listenCount; j++)
+            anetCloseSocket(loop->listenSockets[j].fd);
+        sfree(loop->listenSockets);
+        loop->listenCount = 0;
+
+        struct net_batch *lists[] = { loop->filling, loop->queued, loop->done, loop->freeBatches };
+        for (int k = 0; k < 4; k++) {
+            struct net_batch *batch = lists[k];
+            while (batch) {
+                struct net_batch *next = batch->next;
+                free(batch);
+                batch = next;
+            }
+        }
+        loop->filling = loop->queued = loop->done = loop->freeBatches = NULL;
+
+        close(loop->epfd);
+        sfree(loop->events);
+    }
+    netLoopCount = 0;
+    if (netLoopWakeFd >= 0) {
+        close(netLoopWakeFd);
+        netLoopWakeFd = -1;
+    }
+}
+
+// Call fn for every client owned by a network I/O thread
+void netLoopsForEachClient(void (*fn)(struct client *, void *), void *ctx) {
+    for (int i = 0; i < netLoopCount; i++) {
+        struct net_loop *loop = &netLoops[i];
+        pthread_mutex_lock(&loop->thread.mutex);
+        for (struct client *c = loop->clients; c; c = c->next) {
+            fn(c, ctx);
+        }
+        pthread_mutex_unlock(&loop->thread.mutex);
+    }
+}
+
+//
+//=========================================================================
+//
+// io_uring backend
+//
+
+#ifdef HAVE_IO_URING
+
+static void uringArmAccept(struct client *listener) {
+    struct io_uring_sqe *sqe = uringGetSqe(&uringNet.ring);
+    if (!sqe) {
+        fprintf(stderr, "%s: io_uring submission queue full, can't accept connections\n", listener->service->descr);
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listener->fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC; // blocking, io_uring waits for the socket on its own
+    sqe->user_data = (uintptr_t) listener | URING_ACCEPT;
+}
+
+static void uringArmRecv(struct client *c) {
+    struct io_uring_sqe *sqe = uringGetSqe(&uringNet.ring);
+    if (!sqe) {
+        fprintf(stderr, "%s: io_uring submission queue full, disconnecting: %s port %s\n", c->service->descr, c->host, c->port);
+        modesCloseClient(c);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = (uintptr_t) c | URING_RECV;
+    c->uringPending++;
+}
+
+static int uringFlushClient(struct client *c, int64_t now) {
+    if (c->uringSending) {
+        // the previous writev hasn't completed, the socket buffer is full
+        return flushTimedOut(c, now) ? -1 : 0;
+    }
+    if (!c->uringIov && !(c->uringIov = malloc(NET_SENDQ_IOV * sizeof(struct iovec)))) {
+        fprintf(stderr, "Out of memory allocating client iovecs\n");
+        exit(1);
+    }
+    int iovcnt = 0;
+    int len = 0;
+    for (int i = 0; i < c->sendq_count && iovcnt < NET_SENDQ_IOV; i++) {
+        struct net_chunk *chunk = c->sendq[(c->sendq_head + i) % c->sendq_slots];
+        int skip = i ? 0 : c->sendq_offset;
+        c->uringIov[iovcnt].iov_base = chunk->data + skip;
+        c->uringIov[iovcnt].iov_len = chunk->len - skip;
+        len += chunk->len - skip;
+        iovcnt++;
+    }
+
+    struct io_uring_sqe *sqe = uringGetSqe(&uringNet.ring);
+    if (!sqe)
+        return 0; // try again with the next flush
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = c->fd;
+    sqe->addr = (uintptr_t) c->uringIov;
+    sqe->len = iovcnt;
+    sqe->user_data = (uintptr_t) c | URING_SEND;
+    c->uringSending = len;
+    c->uringPending++;
+    return 0;
+}
+
+static void uringAccepted(struct client *listener, int res, unsigned flags, int64_t now) {
+    struct net_service *s = listener->service;
+    if (res >= 0) {
+        struct sockaddr_storage storage;
+        struct sockaddr *saddr = (struct sockaddr *) &storage;
+        socklen_t slen = sizeof(storage);
+        if (getpeername(res, saddr, &slen) < 0)
+            slen = 0;
+        uringNet.accepting = 1;
+        acceptClient(s, res, saddr, slen, Modes.aneterr, now);
+        uringNet.accepting = 0;
+    } else if (res != -EAGAIN && res != -EINTR && res != -ECANCELED) {
+        fprintf(stderr, "%s: Error accepting new connection: %s\n", s->descr, strerror(-res));
+    }
+    if (!(flags & IORING_CQE_F_MORE) && listener->fd >= 0 && !Modes.exit)
+        uringArmAccept(listener);
+}
+
+static void uringReceived(struct client *c, int res, unsigned flags, int64_t start) {
+    if (!(flags & IORING_CQE_F_MORE))
+        c->uringPending--;
+
     int64_t now = mstime();
+    // same as modesReadFromClient, this round took too long to keep up,
+    // a zlib stream can't skip data
+    int discard = (c->service && now > start + 200 && !Modes.beast_replay && !c->zs);
+    if (discard) {
+        c->buflen = 0;
+        discardWarning(c, now);
+    }
+
+    if ((flags & IORING_CQE_F_BUFFER) && !discard) {
+        unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        clientReceived(c, uringBuf(&uringNet.bufs, bid), res, now);
+    }
+    if (flags & IORING_CQE_F_BUFFER)
+        uringBufRecycle(&uringNet.bufs, flags >> IORING_CQE_BUFFER_SHIFT);
+
+    if (!c->service)
+        return;
 
+    if (res == 0) {
+        clientReadEof(c);
+    } else if (res < 0 && res != -ENOBUFS && res != -EAGAIN && res != -EINTR) {
+        clientReadError(c, -res);
+    } else if (!(flags & IORING_CQE_F_MORE)) {
+        // out of provided buffers or the kernel ended the multishot for another reason
+        uringArmRecv(c);
+    }
+}
+
+static void uringSent(struct client *c, int res, int64_t now) {
+    now = flushClock(now);
+    int len = c->uringSending;
+    c->uringPending--;
+    c->uringSending = 0;
+    if (!c->service)
+        return;
+    if (res < 0 && res != -EAGAIN && res != -EINTR) {
+        fprintf(stderr, "%s: Send Error: %s: %s port %s (fd %d, SendQ %d, RecvQ %d)\n",
+                c->service->descr, strerror(-res), c->host, c->port,
+                c->fd, c->sendq_len, c->buflen);
+        modesCloseClient(c);
+        return;
+    }
+    if (res > 0)
+        clientSendqConsume(c, res, now);
+    // everything queued when the writev was submitted went out, what came
+    // in while it was in flight doesn't mean the client is falling behind
+    if (res == len)
+        c->last_flush = now;
+    // queue what was left over or added in the meantime
+    if (c->sendq_len)
+        uringFlushClient(c, now);
+}
+
+// Send completions are handled right away, they free up sendq space. Accepts
+// and receives are deferred to uringReap which works them off one at a time,
+// draining new completions in between: decoding a large backlog of received
+// data produces output and the sends completing meanwhile keep the sendqs
+// from overflowing.
+static void uringDrain(int64_t now) {
+    struct io_uring_cqe *cqe;
+    if (!uringNet.active)
+        return;
+    for (int i = 0; i < URING_REAP_MAX && uringNet.deferredCount < URING_DEFERRED && (cqe = uringPeekCqe(&uringNet.ring)); i++) {
+        struct io_uring_cqe copy = *cqe;
+        uringCqeSeen(&uringNet.ring);
+
+        struct client *c = (struct client *) (uintptr_t) (copy.user_data & ~URING_TAG_MASK);
+        switch (copy.user_data & URING_TAG_MASK) {
+            case URING_ACCEPT:
+            case URING_RECV:
+                uringNet.deferred[(uringNet.deferredHead + uringNet.deferredCount++) % URING_DEFERRED] = copy;
+                break;
+            case URING_SEND:
+                uringSent(c, copy.res, now);
+                break;
+            default:
+                if (copy.flags & IORING_CQE_F_BUFFER)
+                    uringBufRecycle(&uringNet.bufs, copy.flags >> IORING_CQE_BUFFER_SHIFT);
+                break;
+        }
+    }
+}
+
+// Receives beyond URING_REAP_BYTES stay deferred to the next loop iteration.
+static void uringReap(int64_t now) {
+    int bytes = 0;
+    for (int i = 0; i < URING_REAP_MAX && bytes < URING_REAP_BYTES; i++) {
+        uringDrain(now);
+        if (!uringNet.deferredCount)
+            break;
+        struct io_uring_cqe cqe = uringNet.deferred[uringNet.deferredHead];
+        uringNet.deferredHead = (uringNet.deferredHead + 1) % URING_DEFERRED;
+        uringNet.deferredCount--;
+
+        struct client *c = (struct client *) (uintptr_t) (cqe.user_data & ~URING_TAG_MASK);
+        if ((cqe.user_data & URING_TAG_MASK) == URING_ACCEPT) {
+            uringAccepted(c, cqe.res, cqe.flags, now);
+        } else {
+            bytes += imax(0, cqe.res);
+            uringReceived(c, cqe.res, cqe.flags, now);
+        }
+    }
+}
+
+// multishot receive into provided buffers needs Linux 6.0, try it on a socketpair
+static int uringProbe(void) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+        return -errno;
+
+    struct io_uring_sqe *sqe = uringGetSqe(&uringNet.ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sv[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = 0;
+
+    int res = uringSubmit(&uringNet.ring);
+    if (res >= 0 && write(sv[1], "x", 1) != 1)
+        res = -errno;
+    if (res >= 0)
+        res = uringWait(&uringNet.ring, 1);
+
+    struct io_uring_cqe *cqe = uringPeekCqe(&uringNet.ring);
+    if (res >= 0) {
+        if (!cqe)
+            res = -EIO;
+        else if (cqe->res < 0)
+            res = cqe->res;
+        else if (!(cqe->flags & IORING_CQE_F_MORE))
+            res = -EOPNOTSUPP;
+    }
+    if (cqe) {
+        if (cqe->flags & IORING_CQE_F_BUFFER)
+            uringBufRecycle(&uringNet.bufs, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        uringCqeSeen(&uringNet.ring);
+    }
+    // the final completion of the probe is ignored by uringDrain
+
+    shutdown(sv[0], SHUT_RDWR);
+    close(sv[0]);
+    close(sv[1]);
+    return res < 0 ? res : 0;
+}
+
+static void uringNetInit(void) {
+    if (!(uringNet.deferred = malloc(URING_DEFERRED * sizeof(struct io_uring_cqe)))) {
+        fprintf(stderr, "Out of memory allocating io_uring completion queue\n");
+        exit(1);
+    }
+    int err = uringInit(&uringNet.ring, URING_ENTRIES, URING_CQ_ENTRIES);
+    if (!err)
+        err = uringBufRingInit(&uringNet.ring, &uringNet.bufs, URING_BGID, URING_BUFS, URING_BUF_SIZE);
+    if (!err)
+        err = uringProbe();
+    if (err) {
+        fprintf(stderr, "io_uring not usable (%s), using epoll\n", strerror(-err));
+        uringBufRingFree(&uringNet.bufs);
+        if (uringNet.ring.fd > 0)
+            uringClose(&uringNet.ring);
+        sfree(uringNet.deferred);
+        return;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = &uringNet };
+    if (epoll_ctl(Modes.net_epfd, EPOLL_CTL_ADD, uringNet.ring.fd, &event))
+        perror("epoll_ctl fail:");
+
+    for (struct net_service *s = Modes.services; s; s = s->next) {
+        if (!s->listenSockets)
+            continue;
+        for (int i = 0; i < s->listener_count; i++) {
+            struct client *listener = &s->listenSockets[i];
+            if (listener->fd < 0)
+                continue; // handed over to the network I/O threads
+            epoll_ctl(Modes.net_epfd, EPOLL_CTL_DEL, listener->fd, &listener->epollEvent);
+            listener->uring = 1;
+            uringArmAccept(listener);
+        }
+    }
+    uringNet.active = 1;
+    uringSubmit(&uringNet.ring);
+
+    if (!Modes.quiet)
+        fprintf(stderr, "network: using io_uring\n");
+}
+
+static void uringNetSubmit(void) {
+    if (!uringNet.active)
+        return;
+    int res = uringSubmit(&uringNet.ring);
+    if (res < 0 && res != -EAGAIN && res != -EBUSY) {
+        static int64_t antiSpam;
+        int64_t now = mstime();
+        if (now > antiSpam) {
+            antiSpam = now + 30 * SECONDS;
+            fprintf(stderr, "io_uring submit failed: %s\n", strerror(-res));
+        }
+    }
+}
+
+static void uringNetCleanup(void) {
+    if (!uringNet.active)
+        return;
+    // closing the ring cancels everything in flight
+    uringClose(&uringNet.ring);
+    uringBufRingFree(&uringNet.bufs);
+    sfree(uringNet.deferred);
+    uringNet.deferredCount = 0;
+    uringNet.active = 0;
+    for (struct net_service *s = Modes.services; s; s = s->next) {
+        for (struct client *c = s->clients; c; c = c->next) {
+            c->uringPending = 0;
+            c->uringSending = 0;
+        }
+    }
+}
+
+#else
+
+static void uringArmRecv(struct client *c) {
+    MODES_NOTUSED(c);
+}
+static int uringFlushClient(struct client *c, int64_t now) {
+    MODES_NOTUSED(c);
+    MODES_NOTUSED(now);
+    return 0;
+}
+static void uringDrain(int64_t now) {
+    MODES_NOTUSED(now);
+}
+static void uringReap(int64_t now) {
+    MODES_NOTUSED(now);
+}
+static void uringNetInit(void) {
+    fprintf(stderr, "io_uring not supported by this build, using epoll\n");
+}
+static void uringNetSubmit(void) {
+}
+static void uringNetCleanup(void) {
+}
+
+#endif // HAVE_IO_URING
+
+static void handleEpoll(struct epoll_event *events, int count) {
+    int64_t now = mstime();
+
+    int reaped = 0;
     int i;
     for (i = 0; i < count; i++) {
-        struct epoll_event event = Modes.net_events[i];
+        struct epoll_event event = events[i];
         if (event.data.ptr == &Modes.exitEventfd)
             return;
+        if (event.data.ptr == &uringNet) {
+            uringReap(now);
+            reaped = 1;
+            continue;
+        }
+        if (event.data.ptr == &netLoopWakeFd) {
+            uint64_t value;
+            if (read(netLoopWakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+                perror("netLoopWakeFd read");
+            continue;
+        }
 
-        struct client *cl = (struct client *) Modes.net_events[i].data.ptr;
+        struct client *cl = (struct client *) events[i].data.ptr;
         if (!cl) { fprintf(stderr, "handleEpoll: epollEvent.data.ptr == NULL\n"); continue; }
 
         if (cl->acceptSocket || cl->net_connector_dummyClient) {
@@ -3128,11 +5181,15 @@ static void handleEpoll(int count) {
             }
 
             if ((event.events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))) {
-                if (cl->service)
+                if (cl->service && cl->service->datagram)
+                    modesReadDatagrams(cl, now);
+                else if (cl->service)
                     modesReadFromClient(cl, now);
             }
         }
     }
+    if (!reaped && uringNet.deferredCount)
+        uringReap(now);
 }
 //
 // Perform periodic network work
@@ -3146,6 +5203,9 @@ void modesNetPeriodicWork(void) {
         epollAllocEvents(&Modes.net_events, &Modes.net_maxEvents);
     }
 
+    // hand this round's sends and re-armed receives to the kernel in one go
+    uringNetSubmit();
+
     // unlock decode mutex for waiting in handleEpoll
     pthread_mutex_unlock(&Threads.decode.mutex);
 
@@ -3157,6 +5217,10 @@ void modesNetPeriodicWork(void) {
         // NO WAIT WHEN USING AN SDR !! IMPORTANT !!
         wait_ms = 0;
     }
+    if (uringNet.deferredCount) {
+        // received data left over from the last round
+        wait_ms = 0;
+    }
 
     int count = epoll_wait(Modes.net_epfd, Modes.net_events, Modes.net_maxEvents, wait_ms);
 
@@ -3164,7 +5228,15 @@ void modesNetPeriodicWork(void) {
 
     int64_t interval = lapWatch(&watch);
 
-    handleEpoll(count);
+    handleEpoll(Modes.net_events, count);
+
+    // decode what the network I/O threads have queued
+    netLoopsDecode();
+
+    // track the messages read in this round before anything else looks at the aircraft
+    trackShardFlush();
+
+    netLoopsRelease();
 
     if (count == Modes.net_maxEvents) {
         epollAllocEvents(&Modes.net_events, &Modes.net_maxEvents);
@@ -3179,7 +5251,7 @@ void modesNetPeriodicWork(void) {
         modesNetSecondWork(now);
     }
 
-    pingSenders(Modes.beast_in_service, now);
+    pingSenders(Modes.beast_in_service, Modes.beast_in_service->clients, &Modes.currentPing, now);
 
     int64_t elapsed2 = lapWatch(&watch);
 
@@ -3196,12 +5268,15 @@ void modesNetPeriodicWork(void) {
                 //fprintf(stderr, "%s: interval flush\n", s->descr);
             }
         }
+        zlibIntervalFlush(now);
     }
 
     int64_t elapsed3 = lapWatch(&watch);
 
     static int64_t antiSpam;
-    if ((elapsed1 > 150 || elapsed2 > 150 || elapsed3 > 150 || interval > 1100) && now > antiSpam + 5 * SECONDS) {
+    // a replay decodes as fast as it can, long rounds are expected there
+    if ((elapsed1 > 150 || elapsed2 > 150 || elapsed3 > 150 || interval > 1100) && now > antiSpam + 5 * SECONDS
+            && !Modes.beast_replay) {
         antiSpam = now;
         fprintf(stderr, "<3>High load: modesNetPeriodicWork() elapsed1/2/3/interval %"PRId64"/%"PRId64"/%"PRId64"/%"PRId64" ms, suppressing for 5 seconds!\n",
                 elapsed1, elapsed2, elapsed3, interval);
@@ -3296,17 +5371,16 @@ static void *pthreadGetaddrinfo(void *param) {
 void cleanupNetwork(void) {
     if (!Modes.net)
         return;
+    beastReplayCleanup();
+    netLoopsCleanup();
+    uringNetCleanup();
     for (struct net_service *s = Modes.services; s; s = s->next) {
         struct client *c = s->clients, *nc;
         while (c) {
             nc = c->next;
 
             anetCloseSocket(c->fd);
-            c->sendq_len = 0;
-            if (c->sendq) {
-                sfree(c->sendq);
-            }
-            sfree(c);
+            clientFree(c);
 
             c = nc;
         }
@@ -3320,6 +5394,8 @@ void cleanupNetwork(void) {
         serviceClose(s);
         s = ns;
     }
+    chunkPoolFree();
+    clientPoolFree();
 
     for (int i = 0; i < Modes.net_connectors_count; i++) {
         struct net_connector *con = Modes.net_connectors[i];
@@ -3402,8 +5478,8 @@ static char *read_uuid(struct client *c, char *p, char *eod) {
 
     if (valid >= 16) {
 
-        c->receiverId = receiverId;
-        c->receiverId2 = receiverId2;
+        __atomic_store_n(&c->receiverId, receiverId, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->receiverId2, receiverId2, __ATOMIC_RELAXED);
 
         if (Modes.debug_uuid) {
             char uuid[64]; // needs 36 chars and null byte
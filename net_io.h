@@ -26,12 +26,15 @@
 
 #include <sys/socket.h>
 
+#define NET_IO_THREADS_MAX 16
+
 // Describes a networking service (group of connections)
 
 struct aircraft;
 struct modesMessage;
 struct client;
 struct net_service;
+struct net_loop;
 typedef int (*read_fn)(struct client *, char *, int, int64_t);
 typedef void (*heartbeat_fn)(struct net_service *);
 
@@ -43,6 +46,15 @@ typedef enum
     READ_MODE_ASCII
 } read_mode_t;
 
+/* Clients of an output service that can't keep up (--net-slow-client-policy) */
+typedef enum
+{
+    NET_SLOW_DISCONNECT, // close the connection, the default
+    NET_SLOW_DROP, // drop the oldest queued output
+    NET_SLOW_THIN, // only send beast_reduce style output until the sendq has drained
+    NET_SLOW_PAUSE, // skip output until the sendq has drained
+} slow_policy_t;
+
 /* Data mode to feed push server */
 typedef enum
 {
@@ -71,24 +83,57 @@ struct net_service
     struct client *listenSockets; // dummy client structs for all open sockets for epoll commonality
     char* unixSocket; // path of unix socket
     int sendqOverrideSize; // override size of program internal sendq for each client associated with this service
+    int datagram; // UDP: every socket is a client, each chunk of output is sent as one datagram
+    int compress; // input of the clients is a zlib stream (--net-bi-zlib-port)
+    slow_policy_t slowPolicy; // what to do with clients that can't keep up with the output
 };
 
 // Structure used to describe a networking client
+//
+// With --net-io-threads a client of an input service is owned by its network I/O
+// thread (loop): the read buffer, framing, garbage, ping / pong and rtt state as
+// well as the sendq are only written by that thread. The decode thread only reads
+// the client through its queued frames (receiverId is copied into the frame), the
+// exceptions are rtt, closeRequested and the message / position counters.
+// Fields also read by generateClientsJson or the decode thread are accessed with
+// __atomic builtins.
 
 struct client
 {
     struct client* next; // Pointer to next client
     struct net_service *service; // Service this client is part of
     int fd; // File descriptor
+    char *buf; // Read buffer+BYTE_SCAN_PADDING, allocated on the first read and sized with the data rate
+    int bufSize; // Usable size of buf
     int buflen; // Amount of data on buffer
+    int bufFills; // Reads that filled the buffer since the last size check
     int8_t acceptSocket; // not really a client but rather an accept Socket ... only fd and epollEvent will be valid
     int8_t net_connector_dummyClient; // dummy client used by net_connector
     int8_t pingEnabled;
     int8_t modeac_requested; // 1 if this Beast output connection has asked for A/C
     int8_t receiverIdLocked; // receiverId has been transmitted by other side.
-    char *sendq;  // Write buffer - allocated later
+    int8_t closeRequested; // set by the decode thread, the owning network I/O thread closes the client
+    struct net_loop *loop; // network I/O thread owning this client, NULL for the main loop
+    uint64_t closeSeq; // loop clients: frame batch that must be consumed before the client can be freed
+    int8_t uring; // reads and writes go through io_uring (--net-io-uring)
+    int uringPending; // io_uring requests referencing this client, it can't be freed before they complete
+    int uringSending; // bytes of the writev in flight
+    int8_t uringHoldFd; // closed with requests in flight, uringFd stays open until the client is freed
+    int uringFd; // so the fd number can't be reused by an accept while SQEs still name it
+    struct iovec *uringIov; // iovecs of the writev in flight
+    z_stream *zs; // zlib connections: deflates the output or inflates the input
+    int8_t zsDeflate; // zs compresses the output
+    int8_t zsPending; // deflated output not sync flushed yet
+    int64_t zsFlushed; // last sync flush of the output
+    int8_t slowState; // NET_SLOW_THIN / NET_SLOW_PAUSE while the client is degraded, 0 otherwise
+    struct net_chunk **sendq; // Ring of queued output chunks - allocated later
+    int sendq_slots; // Size of the sendq ring
+    int sendq_head; // First queued chunk
+    int sendq_count; // Number of queued chunks
+    int sendq_offset; // Bytes of the first chunk already sent
     int sendq_len; // Amount of data in SendQ
     int sendq_max; // Max size of SendQ
+    uint64_t receiverIdSent; // receiverId in effect at the end of the queued beast output
     uint32_t ping; // only 24 bit are ever sent
     uint32_t pong; // only 24 bit are ever sent
     int64_t pingReceived;
@@ -116,7 +161,6 @@ struct client
     ALIGNED char proxy_string[256]; // store string received from PROXY protocol v1 (v2 not supported currently)
     ALIGNED char host[NI_MAXHOST]; // For logging
     ALIGNED char port[NI_MAXSERV];
-    ALIGNED char buf[MODES_CLIENT_BUF_SIZE + 4]; // Read buffer+padding
 };
 
 // Client connection
@@ -130,6 +174,7 @@ struct net_connector
     char *port1;
     char *protocol;
     struct net_service *service;
+    int compress; // *_zlib_* protocols: the data direction of the connection is zlib compressed
     struct client* c;
     int use_addr;
     int connected;
@@ -152,9 +197,25 @@ struct net_connector
 
 // Common writer state for all output sockets of one type
 
+// Block of output data, immutable once queued to clients.
+// Every client holding it in its sendq owns a reference, so one flush of a
+// writer is shared by all its clients instead of being copied to each.
+struct net_chunk
+{
+    struct net_chunk *next; // free list
+    int refCount;
+    int size; // allocated size of data
+    int len; // bytes used
+    int8_t receiverIdFrame; // only a receiverId frame queued for one client, never dropped
+    uint64_t receiverIdStart; // beast output: receiverId the data assumes at its start, 0 if none
+    uint64_t receiverIdEnd; // receiverId in effect at its end
+    char data[];
+};
+
 struct net_writer
 {
-    void *data; // shared write buffer, sized MODES_OUT_BUF_SIZE
+    struct net_chunk *chunk; // chunk currently being filled
+    void *data; // shared write buffer (chunk->data), sized MODES_OUT_BUF_SIZE
     int dataUsed; // number of bytes of write buffer currently used
     int connections; // number of active clients
     struct net_service *service; // owning service
@@ -162,6 +223,9 @@ struct net_writer
     int64_t lastWrite; // time of last write to clients
     uint64_t lastReceiverId;
     int noTimestamps;
+    struct net_chunk *thinChunk; // beast_reduce style copy of the output for thinned clients
+    uint64_t thinReceiverId; // lastReceiverId of the thinned output, it skips messages
+    int thinClients; // clients in NET_SLOW_THIN state, thinChunk is only filled while there are any
 };
 
 struct net_service *serviceInit (const char *descr, struct net_writer *writer, heartbeat_fn hb_handler, read_mode_t mode, const char *sep, read_fn read_handler);
@@ -175,9 +239,12 @@ void sendBeastSettings (int fd, const char *settings);
 void modesInitNet (void);
 void modesQueueOutput (struct modesMessage *mm, struct aircraft *a);
 void jsonPositionOutput(struct modesMessage *mm, struct aircraft *a);
+void jsonPositionWrite(const char *json, int len);
 void modesNetPeriodicWork (void);
 void cleanupNetwork(void);
+double beastReplaySeconds(void);
 void netFreeClients();
+void netLoopsForEachClient(void (*fn)(struct client *, void *), void *ctx);
 
 void writeJsonToNet(struct net_writer *writer, struct char_buffer cb);
 
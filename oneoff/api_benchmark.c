@@ -0,0 +1,368 @@
+// Part of readsb, a Mode-S/ADSB/TIS message decoder.
+//
+// api_benchmark.c: benchmarks for the API box and circle queries
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "../readsb.h"
+
+// Synthetic aircraft, most of them around a few busy regions like real
+// traffic, the rest spread over the globe including the polar regions.
+// The grid queries are checked against the previous implementation:
+// binary search on the longitude sorted list, then filter by latitude.
+// The grid reorders its list, the reference keeps a longitude sorted copy.
+// Attribute filters are checked per entry on the reference side, the grid
+// scans its column arrays.
+
+#define TEST_AIRCRAFT 50000
+
+struct _Modes Modes;
+
+void setExit(int arg) {
+    MODES_NOTUSED(arg);
+}
+
+// the real one is in track.c which pulls in the whole decoder, same formula
+double greatcircle(double lat0, double lon0, double lat1, double lon1, int approx) {
+    MODES_NOTUSED(approx);
+    lat0 = lat0 * M_PI / 180;
+    lon0 = lon0 * M_PI / 180;
+    lat1 = lat1 * M_PI / 180;
+    lon1 = lon1 * M_PI / 180;
+    double dlat = lat1 - lat0;
+    double dlon = lon1 - lon0;
+    double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat0) * cos(lat1) * sin(dlon / 2) * sin(dlon / 2);
+    return 6371e3 * 2 * atan2(sqrt(a), sqrt(1.0 - a));
+}
+
+static double uniform(double from, double to) {
+    return from + (to - from) * (rand() / (double) RAND_MAX);
+}
+
+static int compareLon(const void *p1, const void *p2) {
+    struct apiEntry *a1 = (struct apiEntry*) p1;
+    struct apiEntry *a2 = (struct apiEntry*) p2;
+    return (a1->lon > a2->lon) - (a1->lon < a2->lon);
+}
+
+static void prepare(struct apiBuffer *buffer) {
+    static const struct { double lat, lon, spread; } hubs[] = {
+        { 50, 8, 8 }, { 40, -95, 12 }, { 34, 118, 8 }, { 25, 55, 5 }, { -33, 151, 3 },
+    };
+    int hubCount = sizeof(hubs) / sizeof(hubs[0]);
+    static const char *types[] = { "A320", "B738", "A321", "B77W", "E190", "C172", "A20N", "B789", "DH8D", "PC12", "H145" };
+    int typeCount = sizeof(types) / sizeof(types[0]);
+
+    srand(1);
+    buffer->alloc = TEST_AIRCRAFT;
+    buffer->list = aligned_malloc(buffer->alloc * sizeof(struct apiEntry));
+    memset(buffer->list, 0, buffer->alloc * sizeof(struct apiEntry));
+    for (int i = 0; i < TEST_AIRCRAFT; i++) {
+        struct apiEntry *e = &buffer->list[i];
+        double lat, lon;
+        int kind = rand() % 100;
+        if (kind < 60) {
+            int h = rand() % hubCount;
+            lat = hubs[h].lat + uniform(-1, 1) * uniform(0, hubs[h].spread);
+            lon = hubs[h].lon + uniform(-1, 1) * uniform(0, hubs[h].spread) * 1.5;
+        } else if (kind < 95) {
+            lat = uniform(-60, 75);
+            lon = uniform(-180, 180);
+        } else {
+            lat = uniform(75, 90);
+            lon = uniform(-180, 180);
+        }
+        e->addr = i;
+        e->jsonOffset.len = 300;
+        e->alt = (rand() % 20 == 0) ? INT32_MAX : (rand() % 45000) / 25 * 25;
+        if (rand() % 10)
+            strncpy(e->typeCode, types[rand() % typeCount], sizeof(e->typeCode));
+        // military, interesting, PIA, LADD
+        e->dbFlags = (rand() % 50 == 0) | (rand() % 30 == 0) << 1 | (rand() % 100 == 0) << 2 | (rand() % 40 == 0) << 3;
+        if (kind % 50 == 1) {
+            // no position
+            e->lat = INT32_MAX;
+            e->lon = INT32_MAX;
+        } else {
+            e->lat = (int32_t) (fmin(90, lat) * 1E6);
+            e->lon = (int32_t) (fmax(-180, fmin(180, lon)) * 1E6);
+        }
+    }
+    buffer->len = TEST_AIRCRAFT;
+    qsort(buffer->list, buffer->len, sizeof(struct apiEntry), compareLon);
+}
+
+// reference: the lookup used before the grid, plus the attribute filters entry by entry
+static bool referenceFilter(struct apiFilter *filter, struct apiEntry *e) {
+    if (!filter)
+        return true;
+    if (filter->hasAlt && (e->alt < filter->minAlt || e->alt > filter->maxAlt))
+        return false;
+    if (filter->typeCount) {
+        bool found = false;
+        for (int k = 0; k < filter->typeCount; k++)
+            found |= !memcmp(e->typeCode, &filter->types[k], sizeof(e->typeCode));
+        if (!found)
+            return false;
+    }
+    return (e->dbFlags & filter->dbFlagsMask) == filter->dbFlagsWant;
+}
+
+static struct range findLonRange(int32_t ref_from, int32_t ref_to, struct apiEntry *list, int len) {
+    struct range res = { 0, 0 };
+    if (len == 0 || ref_from > ref_to)
+        return res;
+    int i = 0;
+    int j = len - 1;
+    while (j > i + 1) {
+        int pivot = (i + j) / 2;
+        if (list[pivot].lon < ref_from)
+            i = pivot;
+        else
+            j = pivot;
+    }
+    if (list[j].lon < ref_from)
+        res.from = j + 1;
+    else if (list[i].lon < ref_from)
+        res.from = i + 1;
+    else
+        res.from = i;
+
+    i = imin(res.from, len - 1);
+    j = len - 1;
+    while (j > i + 1) {
+        int pivot = (i + j) / 2;
+        if (list[pivot].lon <= ref_to)
+            i = pivot;
+        else
+            j = pivot;
+    }
+    if (list[j].lon <= ref_to)
+        res.to = j + 1;
+    else if (list[i].lon <= ref_to)
+        res.to = i + 1;
+    else
+        res.to = i;
+    return res;
+}
+
+static int lonRanges(struct apiBuffer *buffer, int32_t lon1, int32_t lon2, struct range *r) {
+    memset(r, 0, 2 * sizeof(struct range));
+    if (lon1 <= lon2) {
+        r[0] = findLonRange(lon1, lon2, buffer->list, buffer->len);
+    } else {
+        r[0] = findLonRange(lon1, 180E6, buffer->list, buffer->len);
+        r[1] = findLonRange(-180E6, lon2, buffer->list, buffer->len);
+    }
+    return 2;
+}
+
+static int referenceBox(struct apiBuffer *buffer, double *box, struct apiFilter *filter, struct apiEntry *matches, size_t *alloc) {
+    struct range r[2];
+    int count = 0;
+    int32_t lat1 = (int32_t) (box[0] * 1E6);
+    int32_t lat2 = (int32_t) (box[1] * 1E6);
+    lonRanges(buffer, (int32_t) (box[2] * 1E6), (int32_t) (box[3] * 1E6), r);
+    for (int k = 0; k < 2; k++) {
+        for (int j = r[k].from; j < r[k].to; j++) {
+            struct apiEntry *e = &buffer->list[j];
+            if (e->lat >= lat1 && e->lat <= lat2 && referenceFilter(filter, e)) {
+                matches[count++] = *e;
+                *alloc += e->jsonOffset.len;
+            }
+        }
+    }
+    return count;
+}
+
+static int referenceCircle(struct apiBuffer *buffer, struct apiCircle *circle, struct apiFilter *filter, struct apiEntry *matches, size_t *alloc) {
+    struct range r[2];
+    int count = 0;
+    double lat = circle->lat;
+    double lon = circle->lon;
+    double radius = circle->radius;
+    double circum = 40075e3;
+    double fudge = 1.002;
+    double latdiff = fudge * radius / (circum / 2) * 180.0;
+    int32_t lat1 = (int32_t) (fmax(-90, lat - latdiff) * 1E6);
+    int32_t lat2 = (int32_t) (fmin(90, lat + latdiff) * 1E6);
+    double londiff = fmin(fudge * radius / (cos(lat * M_PI / 180.0) * circum + 1) * 360, 179.9999);
+    double o1 = lon - londiff;
+    double o2 = lon + londiff;
+    o1 = o1 < -180 ? o1 + 360: o1;
+    o2 = o2 > 180 ? o2 - 360 : o2;
+    lonRanges(buffer, (int32_t) (o1 * 1E6), (int32_t) (o2 * 1E6), r);
+
+    double minDistance = 300E6;
+    for (int k = 0; k < 2; k++) {
+        for (int j = r[k].from; j < r[k].to; j++) {
+            struct apiEntry *e = &buffer->list[j];
+            if (e->lat < lat1 || e->lat > lat2 || !referenceFilter(filter, e))
+                continue;
+            double dist = greatcircle(lat, lon, e->lat / 1E6, e->lon / 1E6, 0);
+            if (dist >= radius)
+                continue;
+            if (circle->onlyClosest) {
+                if (dist < minDistance) {
+                    matches[0] = *e;
+                    minDistance = dist;
+                    count = 1;
+                }
+            } else {
+                matches[count++] = *e;
+            }
+            *alloc += e->jsonOffset.len;
+        }
+    }
+    return count;
+}
+
+struct query {
+    const char *name;
+    double box[4];
+    struct apiCircle circle;
+    struct apiFilter *filter;
+};
+
+// result order differs between the two, compare count and a sum of the addresses
+static uint64_t resultSum(struct apiEntry *matches, int count) {
+    uint64_t sum = 0;
+    for (int i = 0; i < count; i++)
+        sum += matches[i].addr * 2654435761ULL;
+    return sum;
+}
+
+static void test(struct apiBuffer *lonSorted, struct apiBuffer *grid, struct query *q, struct apiEntry *matches, double seconds) {
+    double nanos[2];
+    int counts[2];
+    uint64_t sums[2];
+
+    for (int impl = 0; impl < 2; impl++) {
+        struct timespec total = { 0, 0 };
+        int iterations = 0;
+        int count = 0;
+        while (total.tv_sec + total.tv_nsec * 1e-9 < seconds) {
+            struct timespec start;
+            size_t alloc = 0;
+            start_cpu_timing(&start);
+            for (int k = 0; k < 16; k++) {
+                if (q->circle.radius) {
+                    count = impl ? apiFindInCircle(grid, &q->circle, q->filter, matches, &alloc)
+                        : referenceCircle(lonSorted, &q->circle, q->filter, matches, &alloc);
+                } else {
+                    count = impl ? apiFindInBox(grid, q->box, q->filter, matches, &alloc)
+                        : referenceBox(lonSorted, q->box, q->filter, matches, &alloc);
+                }
+            }
+            end_cpu_timing(&start, &total);
+            iterations += 16;
+        }
+        nanos[impl] = (total.tv_sec * 1e9 + total.tv_nsec) / iterations;
+        counts[impl] = count;
+        sums[impl] = resultSum(matches, count);
+    }
+
+    int ok = counts[0] == counts[1] && sums[0] == sums[1];
+    fprintf(stderr, "%-28s %6d matches   lon sort %9.1f us   grid %8.1f us   %5.1fx%s\n",
+            q->name, counts[1], nanos[0] / 1e3, nanos[1] / 1e3, nanos[0] / nanos[1], ok ? "" : "   MISMATCH");
+}
+
+// The list is reallocated for the aircraft count of each update, the
+// spare it gets sorted into has to follow when the count shrinks and grows
+// again. An overflow shows up with -fsanitize=address, a lost or duplicated
+// entry in the sum.
+static void resizeCheck(struct apiBuffer *lonSorted) {
+    static const int counts[] = { 1000, 500, 1000, 20000, 300, TEST_AIRCRAFT };
+    struct apiBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    int ok = 1;
+    for (unsigned k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+        int n = counts[k];
+        sfree(buffer.list);
+        buffer.alloc = n + 128;
+        buffer.len = n;
+        buffer.list = aligned_malloc(buffer.alloc * sizeof(struct apiEntry));
+        memcpy(buffer.list, lonSorted->list, n * sizeof(struct apiEntry));
+        apiGridBuild(&buffer);
+        if (resultSum(buffer.list, n) != resultSum(lonSorted->list, n))
+            ok = 0;
+    }
+    fprintf(stderr, "grid rebuild with shrinking and growing lists%s\n", ok ? ": ok" : ": MISMATCH");
+    apiGridFree(&buffer);
+    sfree(buffer.list);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+
+    struct apiBuffer lonSorted;
+    memset(&lonSorted, 0, sizeof(lonSorted));
+    prepare(&lonSorted);
+
+    struct apiBuffer grid;
+    memset(&grid, 0, sizeof(grid));
+    grid.alloc = lonSorted.alloc;
+    grid.len = lonSorted.len;
+    grid.list = aligned_malloc(grid.alloc * sizeof(struct apiEntry));
+
+    struct timespec build = { 0, 0 };
+    for (int i = 0; i < 100; i++) {
+        struct timespec start;
+        memcpy(grid.list, lonSorted.list, grid.len * sizeof(struct apiEntry));
+        start_cpu_timing(&start);
+        apiGridBuild(&grid);
+        end_cpu_timing(&start, &build);
+    }
+    fprintf(stderr, "%d aircraft, grid build %.1f us\n", TEST_AIRCRAFT, (build.tv_sec * 1e9 + build.tv_nsec) / 100 / 1e3);
+    resizeCheck(&lonSorted);
+
+    struct apiFilter high = { .minAlt = 30000, .maxAlt = INT32_MAX - 1, .hasAlt = true };
+    struct apiFilter types = { .typeCount = 2 };
+    memcpy(&types.types[0], "A320", 4);
+    memcpy(&types.types[1], "B738", 4);
+    struct apiFilter mil = { .dbFlagsMask = 1, .dbFlagsWant = 1 };
+    struct apiFilter combined = types;
+    combined.minAlt = 10000;
+    combined.maxAlt = INT32_MAX - 1;
+    combined.hasAlt = true;
+    combined.dbFlagsMask = 1 | 8;
+    combined.dbFlagsWant = 8;
+
+    struct query queries[] = {
+        { "box regional", .box = { 45, 55, 0, 20 } },
+        { "box lat band", .box = { 50, 51, -180, 180 } },
+        { "box lon strip", .box = { -90, 90, 9.9, 10.1 } },
+        { "box antimeridian", .box = { 50, 70, 170, -170 } },
+        { "box world", .box = { -90, 90, -180, 180 } },
+        { "circle 100 nmi", .circle = { 50, 8, 100 * 1852, false } },
+        { "circle 250 nmi polar", .circle = { 88, 0, 250 * 1852, false } },
+        { "closest 50 nmi", .circle = { 40, -95, 50 * 1852, true } },
+        { "world minAlt", .box = { -90, 90, -180, 180 }, .filter = &high },
+        { "world type", .box = { -90, 90, -180, 180 }, .filter = &types },
+        { "world mil", .box = { -90, 90, -180, 180 }, .filter = &mil },
+        { "world alt type ladd !mil", .box = { -90, 90, -180, 180 }, .filter = &combined },
+        { "regional minAlt type", .box = { 45, 55, 0, 20 }, .filter = &combined },
+        { "circle 250 nmi mil", .circle = { 50, 8, 250 * 1852, false }, .filter = &mil },
+    };
+
+    struct apiEntry *matches = aligned_malloc(TEST_AIRCRAFT * sizeof(struct apiEntry));
+    for (unsigned i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+        test(&lonSorted, &grid, &queries[i], matches, seconds);
+
+    sfree(matches);
+    apiGridFree(&grid);
+    sfree(grid.list);
+    sfree(lonSorted.list);
+}
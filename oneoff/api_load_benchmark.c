@@ -0,0 +1,144 @@
+// Part of readsb, a Mode-S/ADSB/TIS message decoder.
+//
+// api_load_benchmark.c: load test for apiUpdate with a worldwide aircraft count
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "../readsb.h"
+
+// Synthetic aircraft with the fields a busy aggregator sees, then apiUpdate
+// is run like the apiUpdate thread does every json_interval. Between updates
+// a share of the aircraft gets a new position like traffic would, the rest
+// keep their JSON from the previous buffer. Each update has to finish well
+// within json_interval, the aircraft count grows during the first updates
+// to exercise growing the buffers.
+
+struct _Modes Modes;
+struct _Threads Threads;
+
+void setExit(int arg) {
+    MODES_NOTUSED(arg);
+}
+
+void receiverPositionChanged(float lat, float lon, float alt) {
+    MODES_NOTUSED(lat);
+    MODES_NOTUSED(lon);
+    MODES_NOTUSED(alt);
+}
+
+static double uniform(double from, double to) {
+    return from + (to - from) * (rand() / (double) RAND_MAX);
+}
+
+static void validate(data_validity *v, int64_t now) {
+    v->source = SOURCE_ADSB;
+    v->updated = now;
+    v->next_reduce_forward = now;
+}
+
+static void move(struct aircraft *a, int64_t now) {
+    a->lat = fmax(-89.9, fmin(89.9, a->lat + uniform(-0.01, 0.01)));
+    a->lon = fmax(-179.9, fmin(179.9, a->lon + uniform(-0.01, 0.01)));
+    a->baro_alt = imax(0, a->baro_alt + (rand() % 3 - 1) * 25);
+    a->seen = now;
+    a->seen_pos = now;
+    a->seenPosReliable = now;
+    a->messages++;
+    validate(&a->position_valid, now);
+    validate(&a->baro_alt_valid, now);
+    a->dirtyEpoch = Modes.apiEpoch;
+}
+
+static void addAircraft(int count, int64_t now) {
+    for (int i = Modes.aircraftActive.len; i < count; i++) {
+        struct aircraft *a = aircraftCreate(0x100000 + i * 7);
+        a->addrtype = ADDR_ADSB_ICAO;
+        a->lat = uniform(-60, 75);
+        a->lon = uniform(-180, 180);
+        a->baro_alt = (rand() % 45000) / 25 * 25;
+        a->geom_alt = a->baro_alt + 200;
+        a->gs = uniform(100, 500);
+        a->track = uniform(0, 360);
+        a->squawk = rand() % 07777;
+        a->category = 0xA3;
+        snprintf(a->callsign, sizeof(a->callsign), "TST%04d ", i % 10000);
+        a->pos_reliable_odd = a->pos_reliable_even = 2;
+        a->alt_reliable = 2;
+        a->messages = rand() % 1000;
+        validate(&a->callsign_valid, now);
+        validate(&a->geom_alt_valid, now);
+        validate(&a->gs_valid, now);
+        validate(&a->track_valid, now);
+        validate(&a->squawk_valid, now);
+        move(a, now);
+        ca_add(&Modes.aircraftActive, a);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 200000;
+    // share of the aircraft with a new position between two updates
+    double moving = argc > 2 ? atof(argv[2]) : 0.3;
+    int updates = 10;
+
+    srand(1);
+    Modes.json_interval = 1000;
+    Modes.json_reliable = 1;
+    for (int i = 0; i < API_THREADS; i++)
+        pthread_mutex_init(&Modes.apiThread[i].mutex, NULL);
+    pthread_mutex_init(&Modes.apiFlipMutex, NULL);
+    ca_init(&Modes.aircraftActive);
+    quickInit();
+
+    double worst = 0;
+    for (int u = 0; u < updates; u++) {
+        int64_t now = mstime();
+        // a quarter more aircraft with each of the first updates, then all of them
+        int target = (u < 4) ? count / 4 * (u + 1) : count;
+        if (Modes.aircraftActive.len < target)
+            addAircraft(target, now);
+        quickInit();
+
+        int moved = 0;
+        if (u > 0) {
+            for (int i = 0; i < Modes.aircraftActive.len; i++) {
+                if (rand() < moving * RAND_MAX) {
+                    move(Modes.aircraftActive.list[i], now);
+                    moved++;
+                }
+            }
+        }
+
+        struct timespec cpu = { 0, 0 };
+        struct timespec wall = { 0, 0 };
+        struct timespec start, startWall;
+        start_monotonic_timing(&startWall);
+        start_cpu_timing(&start);
+        int len = apiUpdate(&Modes.aircraftActive);
+        end_cpu_timing(&start, &cpu);
+        end_monotonic_timing(&startWall, &wall);
+
+        double ms = cpu.tv_sec * 1e3 + cpu.tv_nsec / 1e6;
+        worst = fmax(worst, ms);
+        struct apiBuffer *buffer = &Modes.apiBuffer[Modes.apiFlip];
+        fprintf(stderr, "update %2d: %6d aircraft %6d moved   %7.1f ms cpu %7.1f ms wall   list alloc %6d json %5.1f MB\n",
+                u, len, moved, ms, wall.tv_sec * 1e3 + wall.tv_nsec / 1e6, buffer->alloc, buffer->jsonAlloc / 1e6);
+    }
+
+    int ok = worst < Modes.json_interval;
+    fprintf(stderr, "%d aircraft: slowest update %.1f ms, json_interval %d ms%s\n",
+            count, worst, (int) Modes.json_interval, ok ? "" : "   TOO SLOW");
+    return ok ? 0 : 1;
+}
@@ -28,6 +28,7 @@ static void **testdata_uc8;
 static void **testdata_sc16;
 static void **testdata_sc16q11;
 static uint16_t *outdata;
+static uint16_t *refdata;
 
 // SC16Q11_TABLE_BITS notes:
 
@@ -60,6 +61,12 @@ static uint16_t *outdata;
 // SC16Q11_TABLE_BITS=8:          5.77M samples/second
 // SC16Q11_TABLE_BITS=7:         10.23M samples/second
 
+struct _Modes Modes;
+
+void setExit(int arg) {
+    MODES_NOTUSED(arg);
+}
+
 void prepare()
 {
     srand(1);
@@ -68,6 +75,7 @@ void prepare()
     testdata_sc16 = calloc(10, sizeof(void*));
     testdata_sc16q11 = calloc(10, sizeof(void*));
     outdata = calloc(MODES_MAG_BUF_SAMPLES, sizeof(uint16_t));
+    refdata = calloc(MODES_MAG_BUF_SAMPLES, sizeof(uint16_t));
 
     for (int buf = 0; buf < 10; ++buf) {
         uint8_t *uc8 = calloc(MODES_MAG_BUF_SAMPLES, 2);
@@ -93,60 +101,126 @@ void prepare()
     }
 }
 
-void test(const char *what, input_format_t format, void **data, double sample_rate, bool filter_dc) {
-    fprintf(stderr, "Benchmarking: %s ", what);
+static const char *format_name(input_format_t format) {
+    switch (format) {
+        case INPUT_UC8: return "UC8";
+        case INPUT_SC16: return "SC16";
+        case INPUT_SC16Q11: return "SC16Q11";
+    }
+    return "unknown";
+}
+
+static void **format_data(input_format_t format) {
+    switch (format) {
+        case INPUT_UC8: return testdata_uc8;
+        case INPUT_SC16: return testdata_sc16;
+        case INPUT_SC16Q11: return testdata_sc16q11;
+    }
+    return NULL;
+}
+
+// the last table entry for a format is the plain float path, use it as reference
+static int reference_index(input_format_t format) {
+    int ref = -1;
+    input_format_t f;
+    for (int i = 0; converter_description(i, &f, NULL); i++) {
+        if (f == format)
+            ref = i;
+    }
+    return ref;
+}
+
+// largest difference to the reference converter on the first test buffer
+static int max_deviation(int index, input_format_t format, bool filter_dc, double *level_err, double *power_err) {
+    struct converter_state *state, *ref_state;
+    double level, power, ref_level, ref_power;
+    void **data = format_data(format);
+
+    iq_convert_fn converter = init_converter_by_index(index, 2400000, filter_dc, &state);
+    iq_convert_fn reference = init_converter_by_index(reference_index(format), 2400000, filter_dc, &ref_state);
+    if (!converter || !reference)
+        return -1;
+
+    // run both over a few buffers so the DC filter state matters
+    for (int i = 0; i < 10; i++) {
+        converter(data[i], outdata, MODES_MAG_BUF_SAMPLES, state, &level, &power);
+        reference(data[i], refdata, MODES_MAG_BUF_SAMPLES, ref_state, &ref_level, &ref_power);
+    }
+
+    int max = 0;
+    for (unsigned i = 0; i < MODES_MAG_BUF_SAMPLES; ++i) {
+        max = imax(max, abs((int) outdata[i] - (int) refdata[i]));
+    }
+    *level_err = fabs(level - ref_level);
+    *power_err = fabs(power - ref_power);
+
+    free(state);
+    free(ref_state);
+    return max;
+}
+
+void test(int index, bool filter_dc, double seconds) {
+    input_format_t format;
+    const char *what = converter_description(index, &format, NULL);
+    void **data = format_data(format);
 
     struct converter_state *state;
-    iq_convert_fn converter = init_converter(format, sample_rate, filter_dc, &state);
+    iq_convert_fn converter = init_converter_by_index(index, 2400000, filter_dc, &state);
     if (!converter) {
-        fprintf(stderr, "Can't initialize converter\n");
+        fprintf(stderr, "%-28s %-6s unsupported on this CPU\n", what, filter_dc ? "DC" : "no DC");
         return;
     }
 
     struct timespec total = { 0, 0 };
     int iterations = 0;
+    double mean_level, mean_power;
 
     // Run it once to force init.
     converter(data[0], outdata, MODES_MAG_BUF_SAMPLES, state, NULL, NULL);
 
-    while (total.tv_sec < 5) {
-        fprintf(stderr, ".");
-
+    while (total.tv_sec + total.tv_nsec * 1e-9 < seconds) {
         struct timespec start;
         start_cpu_timing(&start);
 
         for (int i = 0; i < 10; ++i) {
-            converter(data[i], outdata, MODES_MAG_BUF_SAMPLES, state, NULL, NULL);
+            // the reader thread always asks for the mean level and power
+            converter(data[i], outdata, MODES_MAG_BUF_SAMPLES, state, &mean_level, &mean_power);
         }
 
         end_cpu_timing(&start, &total);
         iterations++;
     }
 
-    fprintf(stderr, "\n");
-    cleanup_converter(state);
+    free(state);
+
+    double level_err = 0, power_err = 0;
+    int deviation = max_deviation(index, format, filter_dc, &level_err, &power_err);
 
     double samples = 10.0 * iterations * MODES_MAG_BUF_SAMPLES;
     double nanos = total.tv_sec * 1e9 + total.tv_nsec;
-    fprintf(stderr, "  %.2fM samples in %.6f seconds\n",
-            samples / 1e6, nanos / 1e9);
-    fprintf(stderr, "  %.2fM samples/second\n",
-            samples / nanos * 1e3);
+    // CPU time of this thread, so this is per core
+    fprintf(stderr, "%-28s %-6s %9.2f MS/s/core   max diff %5d   mean level/power diff %.1e/%.1e\n",
+            what, filter_dc ? "DC" : "no DC", samples / nanos * 1e3, deviation, level_err, power_err);
 }
 
 int main(int argc, char **argv)
 {
-    MODES_NOTUSED(argc);
-    MODES_NOTUSED(argv);
+    // optional: only benchmark this format (UC8 / SC16 / SC16Q11)
+    const char *only = argc > 1 ? argv[1] : NULL;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
 
     prepare();
 
-    test("SC16Q11, DC", INPUT_SC16Q11, testdata_sc16q11, 2400000, true);
-    test("SC16Q11, no DC", INPUT_SC16Q11, testdata_sc16q11, 2400000, false);
-
-    test("UC8, DC", INPUT_UC8, testdata_uc8, 2400000, true);
-    test("UC8, no DC", INPUT_UC8, testdata_uc8, 2400000, false);
+    input_format_t format;
+    int can_filter_dc;
+    for (int i = 0; converter_description(i, &format, &can_filter_dc); i++) {
+        if (only && strcasecmp(only, format_name(format)))
+            continue;
+        // the DC capable converters are also used without DC filter
+        test(i, false, seconds);
+        if (can_filter_dc)
+            test(i, true, seconds);
+    }
 
-    test("SC16, DC", INPUT_SC16, testdata_sc16, 2400000, true);
-    test("SC16, no DC", INPUT_SC16, testdata_sc16, 2400000, false);
+    cleanup_converter(NULL);
 }
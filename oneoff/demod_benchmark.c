@@ -0,0 +1,219 @@
+// Part of readsb, a Mode-S/ADSB/TIS message decoder.
+//
+// demod_benchmark.c: demodulate2400 with and without --demod-threads
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "../readsb.h"
+
+// Synthetic 2.4 MS/s magnitude buffers with DF17, DF11 and DF4 replies on
+// top of noise go through demodulate2400 with 1 thread and with the pool.
+// Two kinds of traffic: a fixed set of aircraft, all of them in the icao
+// filter after the first buffers, and the same set plus a steady stream of
+// aircraft that weren't seen before. Their DF17 adds the address while the
+// rest of the buffer is merged, a DF4 later in the buffer only decodes once
+// it's known. Both thread counts have to decode the same messages, the
+// decode thread CPU time per buffer is the part that stays serial.
+
+struct _Modes Modes;
+struct _Threads Threads;
+
+void setExit(int arg) {
+    MODES_NOTUSED(arg);
+}
+
+void receiverPositionChanged(float lat, float lon, float alt) {
+    MODES_NOTUSED(lat);
+    MODES_NOTUSED(lon);
+    MODES_NOTUSED(alt);
+}
+
+#define BUFFERS 200
+#define FRAMES_PER_BUFFER 250
+#define FIXED_AIRCRAFT 300
+
+static uint16_t *buffers[BUFFERS];
+
+// a reply with valid parity, DF4 has the address in the parity
+static int encodeFrame(unsigned char *msg, int df, uint32_t addr) {
+    int bytes = (df == 17) ? MODES_LONG_MSG_BYTES : MODES_SHORT_MSG_BYTES;
+    memset(msg, 0, MODES_LONG_MSG_BYTES);
+    msg[0] = df << 3 | 5;
+    if (df == 4) {
+        // altitude code of 25 ft steps
+        msg[2] = 0x10;
+        msg[3] = 0x30 | (addr & 0x0f);
+    } else {
+        msg[1] = addr >> 16;
+        msg[2] = addr >> 8;
+        msg[3] = addr;
+    }
+    if (df == 17) {
+        // aircraft identification
+        msg[4] = 0x20;
+        for (int i = 5; i < 10; i++)
+            msg[i] = rand();
+    }
+    uint32_t crc = modesChecksum(msg, bytes * 8);
+    if (df == 4)
+        crc ^= addr;
+    msg[bytes - 3] = crc >> 16;
+    msg[bytes - 2] = crc >> 8;
+    msg[bytes - 1] = crc;
+    return bytes * 8;
+}
+
+// add a frame starting at sample pos + tick / 5 (12 MHz ticks, a chip is 6 ticks)
+static void renderFrame(uint16_t *m, uint32_t pos, int tick, unsigned char *msg, int bits, int amp) {
+    static const int preamble[] = { 0, 2, 7, 9 };
+    uint32_t chips[4 + MODES_LONG_MSG_BITS];
+    int count = 0;
+    for (int i = 0; i < 4; i++)
+        chips[count++] = preamble[i];
+    for (int i = 0; i < bits; i++) {
+        int bit = (msg[i / 8] >> (7 - i % 8)) & 1;
+        chips[count++] = 16 + 2 * i + !bit;
+    }
+    for (int i = 0; i < count; i++) {
+        for (int t = 0; t < 6; t++) {
+            uint32_t k = pos + (tick + chips[i] * 6 + t) / 5;
+            m[k] = imin(65535, m[k] + amp / 5);
+        }
+    }
+}
+
+// newPerBuffer aircraft that haven't been seen before show up in every buffer
+static void generate(int newPerBuffer) {
+    uint32_t total = MODES_MAG_BUF_SAMPLES + Modes.trailing_samples;
+    uint32_t nextNew = 0x800000;
+    srand(1);
+    for (int b = 0; b < BUFFERS; b++) {
+        if (!buffers[b])
+            buffers[b] = aligned_malloc(total * sizeof(uint16_t));
+        uint16_t *m = buffers[b];
+        for (uint32_t k = 0; k < total; k++)
+            m[k] = 100 + rand() % 600;
+
+        int df[FRAMES_PER_BUFFER];
+        uint32_t addr[FRAMES_PER_BUFFER];
+        for (int i = 0; i < FRAMES_PER_BUFFER; i++) {
+            int r = rand() % 4;
+            df[i] = (r < 2) ? 17 : (r == 2 ? 11 : 4);
+            addr[i] = 0x400000 + rand() % FIXED_AIRCRAFT;
+        }
+        // a DF17 in the first half, a DF4 of the same aircraft in the second
+        for (int n = 0; n < newPerBuffer; n++) {
+            int i = rand() % (FRAMES_PER_BUFFER / 2);
+            int j = FRAMES_PER_BUFFER / 2 + rand() % (FRAMES_PER_BUFFER / 2);
+            df[i] = 17;
+            df[j] = 4;
+            addr[i] = addr[j] = nextNew++;
+        }
+
+        uint32_t pos = 100;
+        for (int i = 0; i < FRAMES_PER_BUFFER; i++) {
+            unsigned char msg[MODES_LONG_MSG_BYTES];
+            int bits = encodeFrame(msg, df[i], addr[i]);
+            renderFrame(m, pos, rand() % 5, msg, bits, 3000 + rand() % 30000);
+            // 120 us for a long frame, then a gap
+            pos += 290 + rand() % 220;
+        }
+    }
+}
+
+struct result {
+    uint64_t accepted;
+    double wallMs;
+    double serialMs;
+};
+
+static struct result run(int threads) {
+    struct result res = { 0 };
+
+    // every run starts without known addresses
+    icaoFilterInit();
+    memset(&Modes.stats_current, 0, sizeof(Modes.stats_current));
+    Modes.demodThreads = threads;
+    Modes.demodPool = (threads > 1) ? threadpool_create(threads) : NULL;
+    demodulate2400Init();
+
+    struct mag_buf mag;
+    memset(&mag, 0, sizeof(mag));
+    mag.length = MODES_MAG_BUF_SAMPLES;
+    mag.mean_power = 1e-4;
+    int64_t start = mstime();
+
+    struct timespec wall = { 0, 0 };
+    struct timespec cpu = { 0, 0 };
+    for (int b = 0; b < BUFFERS; b++) {
+        mag.data = buffers[b];
+        mag.sampleTimestamp = (int64_t) b * mag.length * 5;
+        mag.sysTimestamp = start + (int64_t) b * mag.length / 2400;
+
+        struct timespec startWall, startCpu;
+        start_monotonic_timing(&startWall);
+        start_cpu_timing(&startCpu);
+        demodulate2400(&mag);
+        end_cpu_timing(&startCpu, &cpu);
+        end_monotonic_timing(&startWall, &wall);
+    }
+
+    for (int k = 0; k <= MODES_MAX_BITERRORS; k++)
+        res.accepted += Modes.stats_current.demod_accepted[k];
+    res.wallMs = (wall.tv_sec * 1e3 + wall.tv_nsec / 1e6) / BUFFERS;
+    res.serialMs = (cpu.tv_sec * 1e3 + cpu.tv_nsec / 1e6) / BUFFERS;
+
+    demodulate2400Cleanup();
+    if (Modes.demodPool)
+        threadpool_destroy(Modes.demodPool);
+    Modes.demodPool = NULL;
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int newPerBuffer = argc > 2 ? atoi(argv[2]) : 25;
+
+    Modes.quiet = 1;
+    Modes.json_reliable = 1;
+    Modes.preambleThreshold = PREAMBLE_THRESHOLD_DEFAULT;
+    Modes.sample_rate = 2400000.0;
+    Modes.trailing_samples = (unsigned)((MODES_PREAMBLE_US + MODES_LONG_MSG_BITS + 16) * 1e-6 * Modes.sample_rate);
+    ca_init(&Modes.aircraftActive);
+    quickInit();
+    modesChecksumInit(1);
+    modeACInit();
+    geomag_init();
+    init_globe_index();
+
+    int ok = 1;
+    const char *names[2] = { "fixed aircraft", "new aircraft" };
+    int newCounts[2] = { 0, newPerBuffer };
+    for (int s = 0; s < 2; s++) {
+        generate(newCounts[s]);
+        struct result single = run(1);
+        struct result pooled = run(threads);
+        int same = single.accepted == pooled.accepted;
+        ok = ok && same;
+        fprintf(stderr, "%-14s %3d new/buffer: 1 thread %6.2f ms/buffer, %d threads %6.2f ms/buffer (decode thread %6.2f ms), %llu / %llu messages%s\n",
+                names[s], newCounts[s], single.wallMs, threads, pooled.wallMs, pooled.serialMs,
+                (unsigned long long) single.accepted, (unsigned long long) pooled.accepted,
+                same ? "" : "   MISMATCH");
+    }
+
+    for (int b = 0; b < BUFFERS; b++)
+        sfree(buffers[b]);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+// Part of readsb, a Mode-S/ADSB/TIS message decoder.
+//
+// parse_benchmark.c: benchmarks for framing Beast, raw and SBS network input
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "../readsb.h"
+
+// The framing loops below follow the ones in modesProcessClientData, minus
+// the handlers: every frame found is folded into a checksum so the scanners
+// can be checked against the memchr / strstr reference.
+//
+// Test data is split into blocks that fit a client buffer like a busy feed
+// would arrive, each block holds whole messages.
+
+#define TEST_BLOCKS 32
+#define TEST_BLOCK_SIZE (MODES_CLIENT_BUF_SIZE - 1)
+
+struct _Modes Modes;
+
+void setExit(int arg) {
+    MODES_NOTUSED(arg);
+}
+
+struct block {
+    char *data;
+    int len;
+};
+
+struct result {
+    uint64_t frames;
+    uint64_t escaped;
+    uint64_t checksum;
+};
+
+static struct block beast[TEST_BLOCKS];
+static struct block raw[TEST_BLOCKS];
+static struct block sbs[TEST_BLOCKS];
+
+static void fold(struct result *r, const char *frame, int len) {
+    r->frames++;
+    r->checksum = r->checksum * 31 + len;
+    r->checksum = r->checksum * 31 + (unsigned char) frame[0];
+    r->checksum = r->checksum * 31 + (unsigned char) frame[len - 1];
+}
+
+static int beastEscape(char *out, const unsigned char *in, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        out[n++] = in[i];
+        if (in[i] == 0x1a)
+            out[n++] = 0x1a;
+    }
+    return n;
+}
+
+static void prepare() {
+    srand(1);
+    for (int b = 0; b < TEST_BLOCKS; b++) {
+        beast[b].data = malloc(TEST_BLOCK_SIZE + BYTE_SCAN_PADDING);
+        raw[b].data = malloc(TEST_BLOCK_SIZE + BYTE_SCAN_PADDING);
+        sbs[b].data = malloc(TEST_BLOCK_SIZE + BYTE_SCAN_PADDING);
+
+        // random timestamps, signal levels and payloads, about 8% of the
+        // messages contain an escaped 0x1a like real traffic
+        char *p = beast[b].data;
+        char *end = p + TEST_BLOCK_SIZE;
+        while (end - p > 2 * (2 + 2 * (6 + 1 + 14))) {
+            unsigned char body[6 + 1 + 14];
+            int type = (rand() % 3) ? '3' : '2';
+            int len = 6 + 1 + (type == '3' ? 14 : 7);
+            for (int i = 0; i < len; i++)
+                body[i] = rand();
+            *p++ = 0x1a;
+            *p++ = type;
+            p += beastEscape(p, body, len);
+        }
+        beast[b].len = p - beast[b].data;
+
+        p = raw[b].data;
+        end = p + TEST_BLOCK_SIZE;
+        while (end - p > 64) {
+            p += sprintf(p, "*%08X%08X%08X%04X;\n", rand(), rand(), rand(), rand() & 0xffff);
+        }
+        raw[b].len = p - raw[b].data;
+
+        p = sbs[b].data;
+        end = p + TEST_BLOCK_SIZE;
+        while (end - p > 256) {
+            p += sprintf(p, "MSG,3,1,1,%06X,1,2024/06/01,12:%02d:%02d.%03d,2024/06/01,12:%02d:%02d.%03d,,%d,,,%.5f,%.5f,,,0,0,0,0\n",
+                    rand() & 0xffffff, rand() % 60, rand() % 60, rand() % 1000, rand() % 60, rand() % 60, rand() % 1000,
+                    rand() % 45000, (rand() % 180000) / 1000.0 - 90, (rand() % 360000) / 1000.0 - 180);
+        }
+        sbs[b].len = p - sbs[b].data;
+    }
+}
+
+static int beastFrameEnd(const char *p, const char **eom) {
+    switch (*p) {
+        case '1': *eom = p + 1 + 6 + 1 + MODEAC_MSG_BYTES; return 1;
+        case '2': *eom = p + 1 + 6 + 1 + MODES_SHORT_MSG_BYTES; return 1;
+        case '3': *eom = p + 1 + 6 + 1 + MODES_LONG_MSG_BYTES; return 1;
+        default: return 0;
+    }
+}
+
+// handle the frame from the 0x1a at som, returns the start of the next one or NULL if it's incomplete
+static const char *beastFrame(const char *som, const char *eod, int hasEscape, struct result *r) {
+    const char *p = som + 1;
+    const char *eom;
+    if (p >= eod)
+        return NULL;
+    if (!beastFrameEnd(p, &eom))
+        return som + 2;
+    if (eom > eod)
+        return NULL;
+
+    char noEscapeStorage[MODES_LONG_MSG_BYTES + 8 + 16];
+    const char *noEscape = p;
+    if (hasEscape) {
+        char *t = noEscapeStorage;
+        while (p < eom) {
+            if (*p == (char) 0x1a) {
+                p++;
+                eom++;
+                if (eom > eod)
+                    return NULL;
+                if (*p != (char) 0x1a)
+                    return p - 1;
+            }
+            *t++ = *p++;
+        }
+        noEscape = noEscapeStorage;
+        r->escaped++;
+    }
+    fold(r, noEscape, 1 + 6 + 1 + (*noEscape == '3' ? MODES_LONG_MSG_BYTES : MODES_SHORT_MSG_BYTES));
+    return eom;
+}
+
+static void beastReference(const struct block *blk, struct result *r) {
+    const char *som = blk->data;
+    const char *eod = som + blk->len;
+    const char *p;
+    while (som < eod && (p = memchr(som, (char) 0x1a, eod - som)) != NULL) {
+        const char *eom;
+        int hasEscape = beastFrameEnd(p + 1, &eom) && eom <= eod && memchr(p + 1, (char) 0x1a, eom - p - 1);
+        if (!(som = beastFrame(p, eod, hasEscape, r)))
+            break;
+    }
+}
+
+static void beastScan(const struct block *blk, struct result *r) {
+    const char *som = blk->data;
+    const char *eod = som + blk->len;
+    const char *p;
+    while (som < eod && (p = byteFind(som, eod, (char) 0x1a)) != NULL) {
+        const char *eom;
+        int hasEscape = beastFrameEnd(p + 1, &eom) && eom <= eod && byteFind(p + 1, eom, (char) 0x1a);
+        if (!(som = beastFrame(p, eod, hasEscape, r)))
+            break;
+    }
+}
+
+// the ASCII framing writes NUL terminators, work on a copy like a client buffer
+static char lineBuf[MODES_CLIENT_BUF_SIZE + BYTE_SCAN_PADDING];
+
+static void linesReference(const struct block *blk, struct result *r) {
+    memcpy(lineBuf, blk->data, blk->len);
+    char *som = lineBuf;
+    char *eod = som + blk->len;
+    char *p;
+    *eod = '\0';
+    while (som < eod && (p = strstr(som, "\n")) != NULL) {
+        *p = '\0';
+        fold(r, som, p - som);
+        som = p + 1;
+    }
+}
+
+static void linesScan(const struct block *blk, struct result *r) {
+    memcpy(lineBuf, blk->data, blk->len);
+    char *som = lineBuf;
+    char *eod = som + blk->len;
+    char *p;
+    *eod = '\0';
+    while (som < eod && (p = sepFind(som, eod, "\n", 1)) != NULL) {
+        *p = '\0';
+        fold(r, som, p - som);
+        som = p + 1;
+    }
+}
+
+static void test(const char *format, struct block *blocks, const char *what,
+        void (*frame)(const struct block *, struct result *), const struct result *ref, struct result *out, double seconds) {
+    struct timespec total = { 0, 0 };
+    struct result r;
+    uint64_t bytes = 0;
+    int iterations = 0;
+
+    while (total.tv_sec + total.tv_nsec * 1e-9 < seconds) {
+        struct timespec start;
+        memset(&r, 0, sizeof(r));
+        start_cpu_timing(&start);
+        for (int b = 0; b < TEST_BLOCKS; b++)
+            frame(&blocks[b], &r);
+        end_cpu_timing(&start, &total);
+        iterations++;
+    }
+    for (int b = 0; b < TEST_BLOCKS; b++)
+        bytes += blocks[b].len;
+
+    if (out)
+        *out = r;
+    if (!ref)
+        ref = &r;
+
+    double nanos = total.tv_sec * 1e9 + total.tv_nsec;
+    int ok = r.frames == ref->frames && r.escaped == ref->escaped && r.checksum == ref->checksum;
+    // CPU time of this thread, so this is per core
+    fprintf(stderr, "%-6s %-16s %9.1f MB/s/core %8.2f M msgs/s/core   %llu msgs, %llu escaped%s\n",
+            format, what, iterations * bytes / nanos * 1e3, iterations * r.frames / nanos * 1e3,
+            (unsigned long long) r.frames, (unsigned long long) r.escaped, ok ? "" : "   MISMATCH");
+}
+
+int main(int argc, char **argv)
+{
+    // optional: only benchmark this format (beast / raw / sbs)
+    const char *only = argc > 1 ? argv[1] : NULL;
+    double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+
+    prepare();
+
+    static const struct {
+        const char *name;
+        struct block *blocks;
+        void (*reference)(const struct block *, struct result *);
+        const char *referenceName;
+        void (*scan)(const struct block *, struct result *);
+    } formats[] = {
+        { "beast", beast, beastReference, "memchr", beastScan },
+        { "raw", raw, linesReference, "strstr", linesScan },
+        { "sbs", sbs, linesReference, "strstr", linesScan },
+    };
+
+    for (unsigned f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        if (only && strcasecmp(only, formats[f].name))
+            continue;
+        struct result ref;
+        test(formats[f].name, formats[f].blocks, formats[f].referenceName, formats[f].reference, NULL, &ref, seconds);
+        test(formats[f].name, formats[f].blocks, "byteFind " BYTE_SCAN_DESCRIPTION, formats[f].scan, &ref, NULL, seconds);
+    }
+}
@@ -0,0 +1,175 @@
+// Part of readsb, a Mode-S/ADSB/TIS message decoder.
+//
+// track_benchmark.c: tracking throughput with and without --track-threads
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "../readsb.h"
+
+// A Beast capture is decoded up front, then the messages go through
+// useModesMessage like net-only mode does, tracked inline (1 thread) or
+// queued to the tracker shards like with --track-threads. Only this
+// part is timed, decoding and the output stage don't change with the
+// thread count. Run it once per thread count, the aircraft state isn't
+// reset between runs.
+
+struct _Modes Modes;
+struct _Threads Threads;
+
+void setExit(int arg) {
+    MODES_NOTUSED(arg);
+}
+
+void receiverPositionChanged(float lat, float lon, float alt) {
+    MODES_NOTUSED(lat);
+    MODES_NOTUSED(lon);
+    MODES_NOTUSED(alt);
+}
+
+static struct modesMessage *msgs;
+static int msgCount;
+static int msgAlloc;
+
+// decode one unescaped Beast frame
+static void addFrame(unsigned char *p, int msgLen, int64_t *startTime) {
+    struct modesMessage mm;
+    memset(&mm, 0, sizeof(mm));
+    mm.remote = 1;
+
+    for (int j = 0; j < 6; j++)
+        mm.timestampMsg = mm.timestampMsg << 8 | *p++;
+    mm.signalLevel = (*p / 255.0) * (*p / 255.0);
+    p++;
+    memcpy(mm.msg, p, msgLen);
+
+    // same clock as --beast-replay
+    if (!*startTime)
+        *startTime = mstime() - mm.timestampMsg / 12000U;
+    mm.sysTimestampMsg = *startTime + mm.timestampMsg / 12000U;
+    if (msgCount && mm.sysTimestampMsg < msgs[msgCount - 1].sysTimestampMsg)
+        mm.sysTimestampMsg = msgs[msgCount - 1].sysTimestampMsg;
+
+    if (msgLen == MODEAC_MSG_BYTES)
+        decodeModeAMessage(&mm, (mm.msg[0] << 8) | mm.msg[1]);
+    else if (decodeModesMessage(&mm) < 0)
+        return;
+
+    if (msgCount == msgAlloc) {
+        msgAlloc = imax(1024, 2 * msgAlloc);
+        msgs = realloc(msgs, msgAlloc * sizeof(struct modesMessage));
+        if (!msgs) {
+            fprintf(stderr, "track_benchmark: out of memory!\n");
+            exit(1);
+        }
+    }
+    msgs[msgCount++] = mm;
+}
+
+static void readCapture(char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    int64_t startTime = 0;
+    unsigned char frame[2 + 7 + MODES_LONG_MSG_BYTES];
+    int c;
+    while ((c = getc(f)) != EOF) {
+        if (c != 0x1a)
+            continue;
+        int type = getc(f);
+        int msgLen;
+        switch (type) {
+            case '1': msgLen = MODEAC_MSG_BYTES; break;
+            case '2': msgLen = MODES_SHORT_MSG_BYTES; break;
+            case '3': msgLen = MODES_LONG_MSG_BYTES; break;
+            default: continue;
+        }
+        int len = 0;
+        while (len < 7 + msgLen && (c = getc(f)) != EOF) {
+            // 0x1a is escaped by doubling it
+            if (c == 0x1a && (c = getc(f)) != 0x1a) {
+                ungetc(c, f);
+                break;
+            }
+            frame[len++] = c;
+        }
+        if (len == 7 + msgLen)
+            addFrame(frame, msgLen, &startTime);
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <beast capture> [threads] [repeat]\n", argv[0]);
+        return 1;
+    }
+    int threads = argc > 2 ? atoi(argv[2]) : 1;
+    int repeat = argc > 3 ? atoi(argv[3]) : 5;
+
+    Modes.net_only = 1;
+    Modes.quiet = 1;
+    Modes.json_reliable = 1;
+    Modes.position_persistence = 4;
+    Modes.trackThreads = imax(1, threads);
+    ca_init(&Modes.aircraftActive);
+    quickInit();
+    modesChecksumInit(1);
+    icaoFilterInit();
+    modeACInit();
+    geomag_init();
+    init_globe_index();
+
+    readCapture(argv[1]);
+    if (!msgCount) {
+        fprintf(stderr, "%s: no messages\n", argv[1]);
+        return 1;
+    }
+
+    if (Modes.trackThreads > 1)
+        Modes.trackPool = threadpool_create(Modes.trackThreads);
+    trackShardInit();
+
+    // the capture is tracked several times in a row, later rounds look
+    // like the same traffic arriving again
+    int64_t span = msgs[msgCount - 1].sysTimestampMsg - msgs[0].sysTimestampMsg + 1000;
+    double best = 0;
+    for (int r = 0; r < repeat; r++) {
+        struct timespec wall = { 0, 0 };
+        struct timespec start;
+        start_monotonic_timing(&start);
+        for (int i = 0; i < msgCount; i++) {
+            struct modesMessage mm = msgs[i];
+            mm.sysTimestampMsg += r * span;
+            useModesMessage(&mm);
+        }
+        trackShardFlush();
+        end_monotonic_timing(&start, &wall);
+
+        double seconds = wall.tv_sec + wall.tv_nsec * 1e-9;
+        double rate = msgCount / seconds;
+        best = fmax(best, rate);
+        fprintf(stderr, "round %d: %8d messages %7.3f s %9.0f msg/s\n", r, msgCount, seconds, rate);
+    }
+    fprintf(stderr, "track-threads %d (%d cores): best %.0f msg/s, %d aircraft\n",
+            Modes.trackThreads, (int) sysconf(_SC_NPROCESSORS_ONLN), best, Modes.aircraftActive.len);
+
+    trackShardCleanup();
+    if (Modes.trackPool)
+        threadpool_destroy(Modes.trackPool);
+    sfree(msgs);
+    return 0;
+}
@@ -120,6 +120,9 @@ static void configSetDefaults(void) {
     Modes.net_output_sbs_ports = strdup("0");
     Modes.net_input_sbs_ports = strdup("0");
     Modes.net_input_beast_ports = strdup("0");
+    Modes.net_input_beast_udp_ports = strdup("0");
+    Modes.net_input_beast_zlib_ports = strdup("0");
+    Modes.net_multicast_ttl = 1;
     Modes.net_output_beast_ports = strdup("0");
     Modes.net_output_beast_reduce_ports = strdup("0");
     Modes.net_output_beast_reduce_interval = 125;
@@ -217,6 +220,15 @@ static void modesInit(void) {
     Modes.allPoolTasks = malloc(Modes.allPoolMaxTasks * sizeof(threadpool_task_t));
     Modes.allPoolRanges = malloc(Modes.allPoolMaxTasks * sizeof(struct task_info));
 
+    if (Modes.demodThreads > 1 && !Modes.net_only) {
+        // the decode thread only waits for the pool, it doesn't count towards the threads
+        Modes.demodPool = threadpool_create(Modes.demodThreads);
+    }
+
+    if (Modes.trackThreads > 1 && Modes.net_only) {
+        Modes.trackPool = threadpool_create(Modes.trackThreads);
+    }
+
     for (int i = 0; i <= GLOBE_MAX_INDEX; i++) {
         ca_init(&Modes.globeLists[i]);
     }
@@ -230,20 +242,12 @@ static void modesInit(void) {
     Modes.trailing_samples = (unsigned)((MODES_PREAMBLE_US + MODES_LONG_MSG_BITS + 16) * 1e-6 * Modes.sample_rate);
 
     if (!Modes.net_only) {
-        for (int i = 0; i < MODES_MAG_BUFFERS; ++i) {
-            size_t alloc = (MODES_MAG_BUF_SAMPLES + Modes.trailing_samples) * sizeof (uint16_t);
-            if ((Modes.mag_buffers[i].data = aligned_malloc(alloc)) == NULL) {
-                fprintf(stderr, "Out of memory allocating magnitude buffer.\n");
-                exit(1);
-            }
-            memset(Modes.mag_buffers[i].data, 0, alloc);
-
-            Modes.mag_buffers[i].length = 0;
-            Modes.mag_buffers[i].dropped = 0;
-            Modes.mag_buffers[i].sampleTimestamp = 0;
-        }
+        fifoInit();
     }
 
+    demodulate2400Init();
+    trackShardInit();
+
     // Prepare error correction tables
     modesChecksumInit(Modes.nfix_crc);
     icaoFilterInit();
@@ -356,7 +360,8 @@ static void trackPeriodicUpdate() {
     Modes.currentTask = "unlocked";
 
     static int64_t antiSpam;
-    if ((Modes.debug_removeStaleDuration && Modes.next_remove_stale == now + 1 * SECONDS) || ((elapsed1 > 150 || elapsed2 > 150) && now > antiSpam + 30 * SECONDS)) {
+    if ((Modes.debug_removeStaleDuration && Modes.next_remove_stale == now + 1 * SECONDS)
+            || ((elapsed1 > 150 || elapsed2 > 150) && now > antiSpam + 30 * SECONDS && !Modes.beast_replay)) {
         fprintf(stderr, "<3>High load: removeStale took %"PRIi64"/%"PRIi64" ms! upcount: %d stats: %d (suppressing for 30 seconds)\n", elapsed1, elapsed2, (int) (upcount % (1 * SECONDS / PERIODIC_UPDATE)), Modes.updateStats);
         antiSpam = now;
     }
@@ -633,23 +638,13 @@ static void *decodeEntryPoint(void *arg) {
         while (!Modes.exit) {
             struct timespec start_time;
 
-            lockReader();
-            // reader is locked, and possibly we have data.
-            // copy out reader CPU time and reset it
-            add_timespecs(&Modes.reader_cpu_accumulator, &Modes.stats_current.reader_cpu, &Modes.stats_current.reader_cpu);
-            Modes.reader_cpu_accumulator.tv_sec = 0;
-            Modes.reader_cpu_accumulator.tv_nsec = 0;
-
-            struct mag_buf *buf = NULL;
-            if (Modes.first_free_buffer != Modes.first_filled_buffer) {
-                // FIFO is not empty, process one buffer.
-                buf = &Modes.mag_buffers[Modes.first_filled_buffer];
-            } else {
-                buf = NULL;
-            }
-            unlockReader();
+            // process one buffer if the FIFO is not empty
+            struct mag_buf *buf = fifoConsumerBuf();
 
             if (buf) {
+                // reader CPU time comes with the buffer
+                add_timespecs(&buf->reader_cpu, &Modes.stats_current.reader_cpu, &Modes.stats_current.reader_cpu);
+
                 start_cpu_timing(&start_time);
                 demodulate2400(buf);
                 if (Modes.mode_ac) {
@@ -660,13 +655,6 @@ static void *decodeEntryPoint(void *arg) {
                 Modes.stats_current.samples_dropped += buf->dropped;
                 end_cpu_timing(&start_time, &Modes.stats_current.demod_cpu);
 
-                // Mark the buffer we just processed as completed.
-                lockReader();
-                Modes.first_filled_buffer = (Modes.first_filled_buffer + 1) % MODES_MAG_BUFFERS;
-                pthread_cond_signal(&Threads.reader.cond);
-                unlockReader();
-
-
                 Modes.stats_current.samples_lost += MODES_MAG_BUF_SAMPLES - buf->length;
                 {
                     static int64_t last_sys;
@@ -695,6 +683,10 @@ static void *decodeEntryPoint(void *arg) {
                     }
                 }
 
+                // Mark the buffer we just processed as completed.
+                // Only now, the reader may refill it as soon as it's released.
+                fifoConsumerRelease();
+
                 watchdogCounter = 100; // roughly 10 seconds
             } else {
                 // Nothing to process this time around.
@@ -709,16 +701,15 @@ static void *decodeEntryPoint(void *arg) {
             backgroundTasks(now);
             end_cpu_timing(&start_time, &Modes.stats_current.background_cpu);
 
-            lockReader();
-            int newData = (Modes.first_free_buffer != Modes.first_filled_buffer);
-            unlockReader();
-
-            if (!newData) {
+            if (fifoEmpty()) {
                 /* wait for more data.
                  * we should be getting data every 50-60ms. wait for max 80 before we give up and do some background work.
                  * this is fairly aggressive as all our network I/O runs out of the background work!
+                 * the reader wakes us via eventfd, release the decode lock meanwhile so upkeep can take it
                  */
-                threadTimedWait(&Threads.decode, &ts, 80);
+                pthread_mutex_unlock(&Threads.decode.mutex);
+                fifoConsumerWait(80);
+                pthread_mutex_lock(&Threads.decode.mutex);
             }
             if (now > Modes.next_remove_stale + 5 * SECONDS) {
                 threadTimedWait(&Threads.decode, &ts, 5);
@@ -895,6 +886,9 @@ static void cleanup_and_exit(int code) {
     sfree(Modes.net_bind_address);
     sfree(Modes.db_file);
     sfree(Modes.net_input_beast_ports);
+    sfree(Modes.net_input_beast_udp_ports);
+    sfree(Modes.net_input_beast_zlib_ports);
+    sfree(Modes.net_slow_client_policy);
     sfree(Modes.net_output_beast_ports);
     sfree(Modes.net_output_beast_reduce_ports);
     sfree(Modes.net_output_vrs_ports);
@@ -908,14 +902,14 @@ static void cleanup_and_exit(int code) {
     sfree(Modes.net_output_api_ports);
     sfree(Modes.beast_serial);
     sfree(Modes.uuidFile);
+    sfree(Modes.beast_replay);
     sfree(Modes.dbIndex);
     sfree(Modes.db);
 
-    int i;
-    for (i = 0; i < MODES_MAG_BUFFERS; ++i) {
-        sfree(Modes.mag_buffers[i].data);
-    }
+    fifoDestroy();
     crcCleanupTables();
+    demodulate2400Cleanup();
+    trackShardCleanup();
 
     receiverCleanup();
 
@@ -976,12 +970,22 @@ static int make_net_connector(char *arg) {
             && strcmp(con->protocol, "sbs_out_jaero") != 0
             && strcmp(con->protocol, "sbs_out_prio") != 0
             && strcmp(con->protocol, "json_out") != 0
+            && strcmp(con->protocol, "udp_in") != 0
+            && strcmp(con->protocol, "udp_out") != 0
+            && strcmp(con->protocol, "multicast_out") != 0
+            && strcmp(con->protocol, "beast_zlib_out") != 0
+            && strcmp(con->protocol, "beast_reduce_zlib_out") != 0
+            && strcmp(con->protocol, "sbs_zlib_out") != 0
+            && strcmp(con->protocol, "beast_zlib_in") != 0
+            && strcmp(con->protocol, "sbs_zlib_in") != 0
        ) {
         fprintf(stderr, "--net-connector: Unknown protocol: %s\n", con->protocol);
         fprintf(stderr, "Supported protocols: beast_out, beast_in, beast_reduce_out, raw_out, raw_in, \n"
                 "sbs_out, sbs_out_replay, sbs_out_mlat, sbs_out_jaero, \n"
                 "sbs_in, sbs_in_mlat, sbs_in_jaero, \n"
-                "vrs_out, json_out\n");
+                "vrs_out, json_out, \n"
+                "udp_in, udp_out, multicast_out, \n"
+                "beast_zlib_out, beast_reduce_zlib_out, sbs_zlib_out, beast_zlib_in, sbs_zlib_in\n");
         return 1;
     }
     if (strcmp(con->address, "") == 0 || strcmp(con->address, "") == 0) {
@@ -1042,6 +1046,12 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
         case OptPreambleThreshold:
             Modes.preambleThreshold = (uint32_t) (imax(imin(strtoll(arg, NULL, 10), PREAMBLE_THRESHOLD_MAX), PREAMBLE_THRESHOLD_MIN));
             break;
+        case OptDemodThreads:
+            Modes.demodThreads = atoi(arg);
+            break;
+        case OptMagBuffers:
+            Modes.mag_buffer_count = atoi(arg);
+            break;
         case OptNet:
             Modes.net = 1;
             break;
@@ -1056,6 +1066,22 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
             Modes.sdr_type = SDR_NONE;
             Modes.net_only = 1;
             break;
+        case OptBeastReplay:
+            sfree(Modes.beast_replay);
+            Modes.beast_replay = strdup(arg);
+            Modes.net = 1;
+            Modes.sdr_type = SDR_NONE;
+            Modes.net_only = 1;
+            break;
+        case OptTrackThreads:
+            Modes.trackThreads = atoi(arg);
+            break;
+        case OptNetIoThreads:
+            Modes.netIoThreads = atoi(arg);
+            break;
+        case OptNetIoUring:
+            Modes.netIoUring = 1;
+            break;
         case OptQuiet:
             Modes.quiet = 1;
             break;
@@ -1240,6 +1266,14 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
             sfree(Modes.net_input_beast_ports);
             Modes.net_input_beast_ports = strdup(arg);
             break;
+        case OptNetBiUdpPorts:
+            sfree(Modes.net_input_beast_udp_ports);
+            Modes.net_input_beast_udp_ports = strdup(arg);
+            break;
+        case OptNetBiZlibPorts:
+            sfree(Modes.net_input_beast_zlib_ports);
+            Modes.net_input_beast_zlib_ports = strdup(arg);
+            break;
         case OptNetBeastReducePorts:
             sfree(Modes.net_output_beast_reduce_ports);
             Modes.net_output_beast_reduce_ports = strdup(arg);
@@ -1329,6 +1363,13 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
         case OptNetConnectorDelay:
             Modes.net_connector_delay = (int64_t) (1000 * atof(arg));
             break;
+        case OptNetMulticastTtl:
+            Modes.net_multicast_ttl = imax(1, imin(255, atoi(arg)));
+            break;
+        case OptNetSlowClientPolicy:
+            sfree(Modes.net_slow_client_policy);
+            Modes.net_slow_client_policy = strdup(arg);
+            break;
 
         case OptTraceFocus:
             Modes.trace_focus = (uint32_t) strtol(arg, NULL, 16);
@@ -1554,6 +1595,12 @@ static void configAfterParse() {
     if (!Modes.preambleThreshold) {
         Modes.preambleThreshold = PREAMBLE_THRESHOLD_DEFAULT;
     }
+    Modes.demodThreads = imax(1, imin(Modes.demodThreads, Modes.num_procs));
+    Modes.trackThreads = imax(1, imin(Modes.trackThreads, Modes.num_procs));
+    Modes.netIoThreads = imax(0, imin(Modes.netIoThreads, imin(NET_IO_THREADS_MAX, Modes.num_procs)));
+    if (!Modes.mag_buffer_count)
+        Modes.mag_buffer_count = MODES_MAG_BUFFERS;
+    Modes.mag_buffer_count = imax(MODES_MAG_BUFFERS_MIN, imin(Modes.mag_buffer_count, MODES_MAG_BUFFERS_MAX));
 
     if (Modes.mode_ac)
         Modes.mode_ac_auto = 0;
@@ -1646,6 +1693,15 @@ static void configAfterParse() {
     } else {
         Modes.net_only = 0;
     }
+
+    if (Modes.beast_replay) {
+        // the whole replay runs on the synthetic clock, starting at the
+        // modification time of the capture so repeated runs see the same times
+        struct stat st;
+        if (stat(Modes.beast_replay, &st) == 0)
+            Modes.startup_time = (int64_t) st.st_mtime * SECONDS;
+        Modes.synthetic_now = Modes.startup_time;
+    }
 }
 
 static void miscStuff() {
@@ -1721,7 +1777,7 @@ static void miscStuff() {
 
     int64_t elapsed = stopWatch(&watch);
     static int64_t antiSpam2;
-    if (elapsed > 12 * SECONDS && now > antiSpam2 + 30 * SECONDS) {
+    if (elapsed > 12 * SECONDS && now > antiSpam2 + 30 * SECONDS && !Modes.beast_replay) {
         fprintf(stderr, "<3>High load: heatmap_and_stuff took %"PRIu64" ms! Suppressing for 30 seconds\n", elapsed);
         antiSpam2 = now;
     }
@@ -1964,6 +2020,9 @@ int main(int argc, char **argv) {
     if (Modes.stats) {
         display_total_stats();
     }
+    if (Modes.beast_replay) {
+        display_replay_stats(beastReplaySeconds());
+    }
 
     // frees aircraft when Modes.free_aircraft is set
     // writes state if Modes.state_dir is set
@@ -1972,6 +2031,10 @@ int main(int argc, char **argv) {
 
     threadpool_destroy(Modes.tracePool);
     threadpool_destroy(Modes.allPool);
+    if (Modes.demodPool)
+        threadpool_destroy(Modes.demodPool);
+    if (Modes.trackPool)
+        threadpool_destroy(Modes.trackPool);
 
     sfree(Modes.tracePoolTasks);
     sfree(Modes.tracePoolRanges);
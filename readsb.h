@@ -101,6 +101,7 @@
 #include <sched.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <stdatomic.h>
 #include "minilzo/minilzo.h"
 #include "threadpool.h"
 
@@ -113,7 +114,9 @@
 #define MODES_RTL_BUFFERS       16                         // Number of RTL buffers
 #define MODES_RTL_BUF_SIZE      (16*16384)                 // 256k
 #define MODES_MAG_BUF_SAMPLES   (MODES_RTL_BUF_SIZE / 2)   // Each sample is 2 bytes
-#define MODES_MAG_BUFFERS       12                         // Number of magnitude buffers (should be smaller than RTL_BUFFERS for flowcontrol to work)
+#define MODES_MAG_BUFFERS       12                         // Default number of magnitude buffers (should be smaller than RTL_BUFFERS for flowcontrol to work)
+#define MODES_MAG_BUFFERS_MIN   4
+#define MODES_MAG_BUFFERS_MAX   256
 #define MODES_AUTO_GAIN         -100                       // Use automatic gain
 #define MODES_MAX_GAIN          999999                     // Use max available gain
 #define MODEAC_MSG_BYTES        2
@@ -349,6 +352,8 @@ typedef enum {
 #include "util.h"
 #include "fasthash.h"
 #include "anet.h"
+#include "uring.h"
+#include "byte_scan.h"
 #include "net_io.h"
 #include "crc.h"
 #include "demod_2400.h"
@@ -363,6 +368,7 @@ typedef enum {
 #include "geomag.h"
 #include "json_out.h"
 #include "api.h"
+#include "api_grid.h"
 
 //======================== structure declarations =========================
 
@@ -382,6 +388,7 @@ struct mag_buf
     unsigned length; // Number of valid samples _after_ overlap. Total buffer length is buf->length + Modes.trailing_samples.
     int64_t sysTimestamp; // Estimated system time at start of block
     int64_t sysMicroseconds; // sysTimestamp in microseconds
+    struct timespec reader_cpu; // CPU time used by the reader thread to produce this block
     uint16_t *data; // Magnitude data. Starts with Modes.trailing_samples worth of overlap from the previous block
 #if defined(__arm__)
     /*padding 4 bytes*/
@@ -422,6 +429,12 @@ struct _Modes
     threadpool_t *tracePool;
     threadpool_task_t *tracePoolTasks;
     struct task_info *tracePoolRanges;
+    int demodThreads;
+    threadpool_t *demodPool;
+    int trackThreads;
+    threadpool_t *trackPool;
+    int netIoThreads;
+    int8_t netIoUring;
     int lockThreadsCount;
     ALIGNED threadT *lockThreads[LOCK_THREADS_MAX];
 
@@ -431,8 +444,9 @@ struct _Modes
     char *currentTask;
     int64_t joinTimeout;
 
-    unsigned first_free_buffer; // Entry in mag_buffers that will next be filled with input.
-    unsigned first_filled_buffer; // Entry in mag_buffers that has valid data and will be demodulated next. If equal to next_free_buffer, there is no unprocessed data.
+    atomic_uint first_free_buffer; // Entry in mag_buffers that will next be filled with input, only written by the reader thread.
+    atomic_uint first_filled_buffer; // Entry in mag_buffers that has valid data and will be demodulated next, only written by the decode thread. If equal to first_free_buffer, there is no unprocessed data.
+    unsigned mag_buffer_count; // --mag-buffers, number of entries in mag_buffers
     unsigned trailing_samples; // extra trailing samples in magnitude buffers
     int volatile exit; // Exit from the main loop when true
     int fd; // --ifile option file descriptor
@@ -469,6 +483,7 @@ struct _Modes
     struct net_writer raw_out; // Raw output
     struct net_writer beast_out; // Beast-format output
     struct net_writer beast_reduce_out; // Reduced data Beast-format output
+    struct net_writer beast_udp_out; // Beast-format UDP / multicast output
     struct net_writer beast_in; // for sending pings to clients sending us beast data
     struct net_writer garbage_out; // Beast-format output
     struct net_writer sbs_out; // SBS-format output
@@ -489,6 +504,7 @@ struct _Modes
     int8_t apiUpdate; // creates json snippets also by non api stuff
     int8_t api; // enable api output
     int apiFlip;
+    uint32_t apiEpoch; // incremented by every apiUpdate, see aircraft.dirtyEpoch
     struct net_service apiService;
     struct apiCon **apiListeners;
 
@@ -572,6 +588,8 @@ struct _Modes
     float beast_reduce_filter_distance;
     float beast_reduce_filter_altitude;
     int64_t net_connector_delay;
+    int net_multicast_ttl; // TTL of multicast_out datagrams
+    char *net_slow_client_policy; // --net-slow-client-policy, applied by modesInitNet
     int64_t net_heartbeat_interval; // TCP heartbeat interval (milliseconds)
     int64_t net_output_flush_interval; // Maximum interval (in milliseconds) between outputwrites
     double fUserLat; // Users receiver/antenna lat/lon needed for initial surface location
@@ -589,6 +607,8 @@ struct _Modes
     char *net_output_jaero_ports; // jaero SBS output ports
     char *net_input_jaero_ports; // jaero SBS input ports
     char *net_input_beast_ports; // List of Beast input TCP ports
+    char *net_input_beast_udp_ports; // List of Beast input UDP ports
+    char *net_input_beast_zlib_ports; // List of zlib compressed Beast input TCP ports
     char *net_output_beast_ports; // List of Beast output TCP ports
     char *net_output_beast_reduce_ports; // List of Beast output TCP ports
     char *net_output_json_ports;
@@ -601,6 +621,7 @@ struct _Modes
     int net_connectors_size;
     int64_t synthetic_now;
     char *uuidFile;
+    char *beast_replay; // --beast-replay capture file
     char *filename; // Input form file, --ifile option
     char *net_bind_address; // Bind address
     char *json_dir; // Path to json base directory, or NULL not to write json.
@@ -644,8 +665,7 @@ struct _Modes
     int8_t updateStats;
     int8_t staleStop;
 
-    struct timespec reader_cpu_accumulator; // CPU time used by the reader thread, copied out and reset by the main thread under the mutex
-    ALIGNED struct mag_buf mag_buffers[MODES_MAG_BUFFERS]; // Converted magnitude buffers from RTL or file input
+    struct mag_buf *mag_buffers; // Converted magnitude buffers from RTL or file input, see fifo* in sdr.c
 
     int64_t startup_time;
     int64_t next_stats_update;
@@ -819,6 +839,9 @@ struct modesMessage
     double distance_traveled; // set in speed_check, zero is invalid
     double receiver_distance; // distance to receiver
     float calculated_track; // set in speed_check, -1 is invalid
+    // aircraft geom_delta when this message was tracked, for SBS output
+    int ac_geom_delta;
+    bool ac_geom_delta_valid;
 
     commb_format_t commb_format; // Inferred format of a comm-b message
 
@@ -920,6 +943,8 @@ enum {
     OptInteractiveTTL,
     OptRaw,
     OptPreambleThreshold,
+    OptDemodThreads,
+    OptMagBuffers,
     OptModeAc,
     OptModeAcAuto,
     OptForwardMlat,
@@ -969,6 +994,10 @@ enum {
     OptBiasTee,
     OptNet,
     OptNetOnly,
+    OptBeastReplay,
+    OptTrackThreads,
+    OptNetIoThreads,
+    OptNetIoUring,
     OptNetBindAddr,
     OptNetRiPorts,
     OptNetRoPorts,
@@ -977,7 +1006,11 @@ enum {
     OptNetJaeroPorts,
     OptNetJaeroInPorts,
     OptNetBiPorts,
+    OptNetBiUdpPorts,
+    OptNetBiZlibPorts,
     OptNetBoPorts,
+    OptNetMulticastTtl,
+    OptNetSlowClientPolicy,
     OptNetBeastReducePorts,
     OptNetBeastReduceInterval,
     OptNetBeastReduceFilterAlt,
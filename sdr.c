@@ -23,6 +23,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "readsb.h"
+#include <poll.h>
 
 #include "sdr_ifile.h"
 #ifdef ENABLE_RTLSDR
@@ -177,12 +178,171 @@ void sdrClose() {
     current_handler()->close();
 }
 
-void lockReader() {
-    pthread_mutex_lock(&Threads.reader.mutex);
+//
+// Single producer / single consumer FIFO of magnitude buffers.
+//
+// The SDR reader thread fills Modes.mag_buffers[first_free_buffer] and
+// publishes it by advancing first_free_buffer, the decode thread
+// demodulates Modes.mag_buffers[first_filled_buffer] and releases it by
+// advancing first_filled_buffer. Each index is only written by one side,
+// so no lock is needed.
+//
+// A side that runs out of work sets its waiting flag, checks the FIFO
+// again and then sleeps on its eventfd. The other side only writes to the
+// eventfd when it sees the flag, so there is no syscall per buffer while
+// both sides are busy.
+//
+
+static struct {
+    int dataFd; // written when a buffer was published
+    int freeFd; // written when a buffer was released
+    atomic_int decodeWaiting;
+    atomic_int readerWaiting;
+} fifo = { -1, -1, 0, 0 };
+
+void fifoInit() {
+    Modes.mag_buffers = calloc(Modes.mag_buffer_count, sizeof(struct mag_buf));
+    if (!Modes.mag_buffers) {
+        fprintf(stderr, "Out of memory allocating magnitude buffers.\n");
+        exit(1);
+    }
+    for (unsigned i = 0; i < Modes.mag_buffer_count; ++i) {
+        size_t alloc = (MODES_MAG_BUF_SAMPLES + Modes.trailing_samples) * sizeof (uint16_t);
+        if ((Modes.mag_buffers[i].data = aligned_malloc(alloc)) == NULL) {
+            fprintf(stderr, "Out of memory allocating magnitude buffer.\n");
+            exit(1);
+        }
+        memset(Modes.mag_buffers[i].data, 0, alloc);
+    }
+    atomic_store(&Modes.first_free_buffer, 0);
+    atomic_store(&Modes.first_filled_buffer, 0);
+
+    fifo.dataFd = eventfd(0, EFD_NONBLOCK);
+    fifo.freeFd = eventfd(0, EFD_NONBLOCK);
+    if (fifo.dataFd < 0 || fifo.freeFd < 0) {
+        perror("fifoInit: eventfd");
+        exit(1);
+    }
+}
+
+void fifoDestroy() {
+    if (Modes.mag_buffers) {
+        for (unsigned i = 0; i < Modes.mag_buffer_count; ++i) {
+            sfree(Modes.mag_buffers[i].data);
+        }
+        sfree(Modes.mag_buffers);
+    }
+    if (fifo.dataFd >= 0)
+        close(fifo.dataFd);
+    if (fifo.freeFd >= 0)
+        close(fifo.freeFd);
+    fifo.dataFd = fifo.freeFd = -1;
+}
+
+static void fifoSignal(int fd, atomic_int *waiting) {
+    if (atomic_exchange(waiting, 0)) {
+        uint64_t one = 1;
+        ssize_t res = write(fd, &one, sizeof(one));
+        MODES_NOTUSED(res);
+    }
+}
+
+// sleep on fd until signaled, exit is requested or timeout_ms has passed,
+// unless ready() is already true after announcing that we are waiting
+static void fifoWait(int fd, atomic_int *waiting, bool (*ready)(), int64_t timeout_ms) {
+    atomic_store(waiting, 1);
+    if (ready() || Modes.exit) {
+        atomic_store(waiting, 0);
+        return;
+    }
+
+    struct pollfd pfd[2] = {
+        { .fd = fd, .events = POLLIN },
+        { .fd = Modes.exitEventfd, .events = POLLIN },
+    };
+    if (poll(pfd, 2, timeout_ms) > 0 && (pfd[0].revents & POLLIN)) {
+        uint64_t count;
+        ssize_t res = read(fd, &count, sizeof(count));
+        MODES_NOTUSED(res);
+    }
+    atomic_store(waiting, 0);
+}
+
+static bool fifoHasData() {
+    return atomic_load_explicit(&Modes.first_filled_buffer, memory_order_relaxed)
+        != atomic_load_explicit(&Modes.first_free_buffer, memory_order_acquire);
 }
-void unlockReader() {
-    pthread_mutex_unlock(&Threads.reader.mutex);
+
+static bool fifoHasFree() {
+    unsigned count = Modes.mag_buffer_count;
+    unsigned next_free = (atomic_load_explicit(&Modes.first_free_buffer, memory_order_relaxed) + 1) % count;
+    return next_free != atomic_load_explicit(&Modes.first_filled_buffer, memory_order_acquire);
+}
+
+bool fifoEmpty() {
+    return !fifoHasData();
+}
+
+struct mag_buf *fifoProducerBuf(struct mag_buf **lastbuf, unsigned *free_bufs) {
+    unsigned count = Modes.mag_buffer_count;
+    unsigned free_idx = atomic_load_explicit(&Modes.first_free_buffer, memory_order_relaxed);
+    unsigned filled_idx = atomic_load_explicit(&Modes.first_filled_buffer, memory_order_acquire);
+    unsigned next_free = (free_idx + 1) % count;
+
+    if (lastbuf)
+        *lastbuf = &Modes.mag_buffers[(free_idx + count - 1) % count];
+    if (free_bufs)
+        *free_bufs = (filled_idx + count - next_free) % count;
+
+    return &Modes.mag_buffers[free_idx];
+}
+
+void fifoProducerPublish(struct timespec *thread_cpu) {
+    unsigned count = Modes.mag_buffer_count;
+    unsigned free_idx = atomic_load_explicit(&Modes.first_free_buffer, memory_order_relaxed);
+    unsigned next_free = (free_idx + 1) % count;
+    struct mag_buf *outbuf = &Modes.mag_buffers[free_idx];
+
+    // the CPU time spent since the last published buffer travels with this buffer
+    outbuf->reader_cpu.tv_sec = 0;
+    outbuf->reader_cpu.tv_nsec = 0;
+    if (thread_cpu) {
+        end_cpu_timing(thread_cpu, &outbuf->reader_cpu);
+        start_cpu_timing(thread_cpu);
+    }
+
+    // the caller made sure there is a free buffer, the decode thread doesn't touch it
+    Modes.mag_buffers[next_free].dropped = 0;
+    Modes.mag_buffers[next_free].length = 0; // just in case
+
+    atomic_store_explicit(&Modes.first_free_buffer, next_free, memory_order_release);
+    wakeDecode();
 }
+
+void fifoProducerWait(int64_t timeout_ms) {
+    fifoWait(fifo.freeFd, &fifo.readerWaiting, fifoHasFree, timeout_ms);
+}
+
+void fifoProducerWaitEmpty(int64_t timeout_ms) {
+    fifoWait(fifo.freeFd, &fifo.readerWaiting, fifoEmpty, timeout_ms);
+}
+
+struct mag_buf *fifoConsumerBuf() {
+    if (!fifoHasData())
+        return NULL;
+    return &Modes.mag_buffers[atomic_load_explicit(&Modes.first_filled_buffer, memory_order_relaxed)];
+}
+
+void fifoConsumerRelease() {
+    unsigned filled_idx = atomic_load_explicit(&Modes.first_filled_buffer, memory_order_relaxed);
+    atomic_store_explicit(&Modes.first_filled_buffer, (filled_idx + 1) % Modes.mag_buffer_count, memory_order_release);
+    fifoSignal(fifo.freeFd, &fifo.readerWaiting);
+}
+
+void fifoConsumerWait(int64_t timeout_ms) {
+    fifoWait(fifo.dataFd, &fifo.decodeWaiting, fifoHasData, timeout_ms);
+}
+
 void wakeDecode() {
-    pthread_cond_signal(&Threads.decode.cond);
+    fifoSignal(fifo.dataFd, &fifo.decodeWaiting);
 }
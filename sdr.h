@@ -35,8 +35,23 @@ bool sdrHasRun();
 void sdrCancel ();
 void sdrClose ();
 
-void lockReader();
-void unlockReader();
+// magnitude buffer FIFO between the SDR reader thread and the decode thread
+void fifoInit();
+void fifoDestroy();
+bool fifoEmpty();
+
+// reader thread: buffer to fill next, the previously published buffer and the
+// number of free buffers after this one, publish the buffer, wait for a free one
+struct mag_buf *fifoProducerBuf(struct mag_buf **lastbuf, unsigned *free_bufs);
+void fifoProducerPublish(struct timespec *thread_cpu);
+void fifoProducerWait(int64_t timeout_ms);
+void fifoProducerWaitEmpty(int64_t timeout_ms);
+
+// decode thread: oldest published buffer or NULL, release it, wait for one
+struct mag_buf *fifoConsumerBuf();
+void fifoConsumerRelease();
+void fifoConsumerWait(int64_t timeout_ms);
+
 void wakeDecode();
 
 #endif
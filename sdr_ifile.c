@@ -55,6 +55,11 @@
 #include "readsb.h"
 #include "sdr_ifile.h"
 
+#include <sys/mman.h>
+
+// release already converted parts of a mapping in steps of this size
+#define IFILE_MAP_RELEASE (16 * 1024 * 1024)
+
 static struct {
     input_format_t input_format;
     int fd;
@@ -65,11 +70,20 @@ static struct {
     void *readbuf;
     iq_convert_fn converter;
     struct converter_state *converter_state;
-    const char *filename;
+    char **filenames;
+    int filenameCount;
+    int fileIndex;
+    // regular files are mapped and converted in place
+    uint8_t *map;
+    size_t mapSize;
+    size_t mapOffset;
+    size_t mapReleased;
 } ifile;
 
 void ifileInitConfig(void) {
-    ifile.filename = NULL;
+    ifile.filenames = NULL;
+    ifile.filenameCount = 0;
+    ifile.fileIndex = 0;
     ifile.input_format = INPUT_UC8;
     ifile.throttle = false;
     ifile.fd = -1;
@@ -77,13 +91,23 @@ void ifileInitConfig(void) {
     ifile.readbuf = NULL;
     ifile.converter = NULL;
     ifile.converter_state = NULL;
+    ifile.map = NULL;
+    ifile.mapSize = 0;
+    ifile.mapOffset = 0;
+    ifile.mapReleased = 0;
     Modes.synthetic_now = Modes.startup_time;
 }
 
 bool ifileHandleOption(int argc, char *argv) {
     switch (argc) {
         case OptIfileName:
-            ifile.filename = strdup(argv);
+            // --ifile can be given multiple times, the files are processed back to back
+            ifile.filenames = realloc(ifile.filenames, (ifile.filenameCount + 1) * sizeof (char *));
+            if (!ifile.filenames) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+            ifile.filenames[ifile.filenameCount++] = strdup(argv);
             Modes.sdr_type = SDR_IFILE;
             break;
         case OptIfileFormat:
@@ -113,17 +137,123 @@ bool ifileHandleOption(int argc, char *argv) {
 // instead of using an RTLSDR device
 //
 
-bool ifileOpen(void) {
-    if (!ifile.filename) {
-        fprintf(stderr, "SDR type 'ifile' requires an --ifile argument\n");
-        return false;
+static void ifileCloseFile(void) {
+    if (ifile.map) {
+        munmap(ifile.map, ifile.mapSize);
+        ifile.map = NULL;
+        ifile.mapSize = 0;
+    }
+    if (ifile.fd >= 0 && ifile.fd != STDIN_FILENO) {
+        close(ifile.fd);
+    }
+    ifile.fd = -1;
+}
+
+// Open the next file of the list, regular files are mapped instead of read
+static bool ifileOpenNext(void) {
+    ifileCloseFile();
+
+    while (ifile.fileIndex < ifile.filenameCount) {
+        const char *filename = ifile.filenames[ifile.fileIndex++];
+
+        if (!strcmp(filename, "-")) {
+            ifile.fd = STDIN_FILENO;
+            return true;
+        }
+        if ((ifile.fd = open(filename, O_RDONLY)) < 0) {
+            fprintf(stderr, "ifile: could not open %s: %s\n",
+                    filename, strerror(errno));
+            continue;
+        }
+        if (ifile.filenameCount > 1 && !Modes.quiet)
+            fprintf(stderr, "ifile: processing %s\n", filename);
+
+        struct stat st;
+        if (fstat(ifile.fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, ifile.fd, 0);
+            if (map != MAP_FAILED) {
+                ifile.map = map;
+                ifile.mapSize = st.st_size;
+                ifile.mapOffset = 0;
+                ifile.mapReleased = 0;
+                // hints only, failure is harmless
+                madvise(map, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+                madvise(map, st.st_size, MADV_HUGEPAGE);
+#endif
+            }
+        }
+        return true;
     }
+    return false;
+}
 
-    if (!strcmp(ifile.filename, "-")) {
-        ifile.fd = STDIN_FILENO;
-    } else if ((ifile.fd = open(ifile.filename, O_RDONLY)) < 0) {
-        fprintf(stderr, "ifile: could not open %s: %s\n",
-                ifile.filename, strerror(errno));
+// Drop converted pages from the mapping so large files don't pile up in our RSS
+static void ifileReleaseMapped(void) {
+    if (ifile.mapOffset - ifile.mapReleased < IFILE_MAP_RELEASE)
+        return;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t end = ifile.mapOffset & ~(page - 1);
+    madvise(ifile.map + ifile.mapReleased, end - ifile.mapReleased, MADV_DONTNEED);
+    ifile.mapReleased = end;
+}
+
+// Copy up to len bytes into buf, continuing with the next file on EOF.
+// Returns the number of bytes copied, less than len only after the last file.
+static size_t ifileCopy(uint8_t *buf, size_t len) {
+    size_t done = 0;
+    while (done < len && !Modes.exit) {
+        if (ifile.fd < 0 && !ifileOpenNext())
+            break;
+
+        if (ifile.map) {
+            size_t n = len - done;
+            if (n > ifile.mapSize - ifile.mapOffset)
+                n = ifile.mapSize - ifile.mapOffset;
+            memcpy(buf + done, ifile.map + ifile.mapOffset, n);
+            ifile.mapOffset += n;
+            done += n;
+            if (ifile.mapOffset == ifile.mapSize)
+                ifileCloseFile();
+            continue;
+        }
+
+        ssize_t nread = read(ifile.fd, buf + done, len - done);
+        if (nread <= 0) {
+            if (nread < 0) {
+                if (errno == EINTR)
+                    continue;
+                fprintf(stderr, "ifile: error reading input file: %s\n", strerror(errno));
+            }
+            ifileCloseFile();
+            continue;
+        }
+        done += nread;
+    }
+    return done;
+}
+
+// Return a pointer to the next len bytes of input.
+// When the current file is mapped and has enough data left this points into
+// the mapping, otherwise the data is collected in readbuf.
+static void *ifileNext(size_t len, size_t *got) {
+    if (ifile.fd < 0 && !ifileOpenNext()) {
+        *got = 0;
+        return ifile.readbuf;
+    }
+    if (ifile.map && ifile.mapSize - ifile.mapOffset >= len) {
+        void *data = ifile.map + ifile.mapOffset;
+        ifile.mapOffset += len;
+        *got = len;
+        return data;
+    }
+    *got = ifileCopy(ifile.readbuf, len);
+    return ifile.readbuf;
+}
+
+bool ifileOpen(void) {
+    if (!ifile.filenameCount) {
+        fprintf(stderr, "SDR type 'ifile' requires an --ifile argument\n");
         return false;
     }
 
@@ -141,6 +271,12 @@ bool ifileOpen(void) {
             return false;
     }
 
+    ifile.fileIndex = 0;
+    if (!ifileOpenNext()) {
+        ifileClose();
+        return false;
+    }
+
     if (!(ifile.readbuf = aligned_malloc(MODES_MAG_BUF_SAMPLES * ifile.bytes_per_sample))) {
         fprintf(stderr, "ifile: failed to allocate read buffer\n");
         ifileClose();
@@ -174,28 +310,20 @@ void ifileRun() {
 
     clock_gettime(CLOCK_MONOTONIC, &next_buffer_delivery);
 
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-
-    lockReader();
     while (!Modes.exit && !eof) {
-        ssize_t nread, toread;
-        void *r;
+        size_t toread, got;
+        void *data;
         struct mag_buf *outbuf, *lastbuf;
-        unsigned next_free_buffer;
+        unsigned free_bufs;
         unsigned slen;
 
-        next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-        if (next_free_buffer == Modes.first_filled_buffer) {
+        outbuf = fifoProducerBuf(&lastbuf, &free_bufs);
+        if (free_bufs == 0) {
             // no space for output yet
-            threadTimedWait(&Threads.reader, &ts, 50);
+            fifoProducerWait(50);
             continue;
         }
 
-        outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-        lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-        unlockReader();
-
         // Compute the sample timestamp for the start of the block
         outbuf->sampleTimestamp = sampleCounter * 12e6 / Modes.sample_rate;
 
@@ -210,28 +338,21 @@ void ifileRun() {
         outbuf->sysTimestamp = outbuf->sampleTimestamp / 12000U + Modes.startup_time;
         outbuf->sysMicroseconds = outbuf->sampleTimestamp / 12U + Modes.startup_time * 1000;
 
-
         toread = MODES_MAG_BUF_SAMPLES * ifile.bytes_per_sample;
-        r = ifile.readbuf;
-        while (toread) {
-            nread = read(ifile.fd, r, toread);
-            if (nread <= 0) {
-                if (nread < 0) {
-                    fprintf(stderr, "ifile: error reading input file: %s\n", strerror(errno));
-                }
-                // Done.
-                eof = 1;
-                break;
-            }
-            r += nread;
-            toread -= nread;
+        data = ifileNext(toread, &got);
+        if (got < toread) {
+            // Done.
+            eof = 1;
         }
 
-        slen = outbuf->length = MODES_MAG_BUF_SAMPLES - toread / ifile.bytes_per_sample;
+        slen = outbuf->length = got / ifile.bytes_per_sample;
         sampleCounter += slen;
 
         // Convert the new data
-        ifile.converter(ifile.readbuf, &outbuf->data[Modes.trailing_samples], slen, ifile.converter_state, &outbuf->mean_level, &outbuf->mean_power);
+        ifile.converter(data, &outbuf->data[Modes.trailing_samples], slen, ifile.converter_state, &outbuf->mean_level, &outbuf->mean_power);
+
+        if (ifile.map)
+            ifileReleaseMapped();
 
         if (ifile.throttle || Modes.interactive) {
             // Wait until we are allowed to release this buffer to the main thread
@@ -244,22 +365,16 @@ void ifileRun() {
         }
 
         // Push the new data to the main thread
-        lockReader();
-        Modes.first_free_buffer = next_free_buffer;
-        // accumulate CPU while holding the mutex, and restart measurement
-        end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
-        start_cpu_timing(&thread_cpu);
-        wakeDecode();
+        fifoProducerPublish(&thread_cpu);
     }
 
-    // Wait for the main thread to consume all data (reader still locked here)
-    while (!Modes.exit && Modes.first_filled_buffer != Modes.first_free_buffer) {
+    // Wait for the main thread to consume all data
+    while (!Modes.exit && !fifoEmpty()) {
         wakeDecode();
-        threadTimedWait(&Threads.reader, &ts, 50);
+        fifoProducerWaitEmpty(50);
     }
 
     Modes.exit = 1;
-    unlockReader();
 }
 
 void ifileClose() {
@@ -274,8 +389,11 @@ void ifileClose() {
         ifile.readbuf = NULL;
     }
 
-    if (ifile.fd >= 0 && ifile.fd != STDIN_FILENO) {
-        close(ifile.fd);
-        ifile.fd = -1;
-    }
+    ifileCloseFile();
+
+    for (int i = 0; i < ifile.filenameCount; i++)
+        free(ifile.filenames[i]);
+    free(ifile.filenames);
+    ifile.filenames = NULL;
+    ifile.filenameCount = 0;
 }
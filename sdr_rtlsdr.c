@@ -266,7 +266,6 @@ void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
     struct mag_buf *outbuf;
     struct mag_buf *lastbuf;
     uint32_t slen;
-    unsigned next_free_buffer;
     unsigned free_bufs;
     int64_t block_duration;
 
@@ -287,15 +286,7 @@ void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
 
     MODES_NOTUSED(ctx);
 
-    // Lock the data buffer variables before accessing them
-    lockReader();
-
-    next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-    outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-    lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-    free_bufs = (Modes.first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
-
-    unlockReader();
+    outbuf = fifoProducerBuf(&lastbuf, &free_bufs);
 
     if (len != MODES_RTL_BUF_SIZE) {
         fprintf(stderr, "weirdness: rtlsdr gave us a block with an unusual size (got %u bytes, expected %u bytes)\n",
@@ -310,7 +301,7 @@ void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
     }
     slen = len / 2; // Drops any trailing odd sample, that's OK
 
-    if (free_bufs == 0 || (dropping && free_bufs < MODES_MAG_BUFFERS / 2)) {
+    if (free_bufs == 0 || (dropping && free_bufs < Modes.mag_buffer_count / 2)) {
         // FIFO is full. Drop this block.
         dropping = 1;
         outbuf->dropped += slen;
@@ -361,18 +352,7 @@ void rtlsdrCallback(unsigned char *buf, uint32_t len, void *ctx) {
     RTLSDR.converter(buf, &outbuf->data[Modes.trailing_samples], slen, RTLSDR.converter_state, &outbuf->mean_level, &outbuf->mean_power);
 
     // Push the new data to the demodulation thread
-    lockReader();
-
-    Modes.mag_buffers[next_free_buffer].dropped = 0;
-    Modes.mag_buffers[next_free_buffer].length = 0; // just in case
-    Modes.first_free_buffer = next_free_buffer;
-
-    // accumulate CPU while holding the mutex, and restart measurement
-    end_cpu_timing(&rtlsdr_thread_cpu, &Modes.reader_cpu_accumulator);
-    start_cpu_timing(&rtlsdr_thread_cpu);
-
-    wakeDecode();
-    unlockReader();
+    fifoProducerPublish(&rtlsdr_thread_cpu);
 }
 
 void rtlsdrRun() {
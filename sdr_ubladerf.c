@@ -341,26 +341,21 @@ static void *handle_bladerf_samples(struct bladerf *dev,
     uint64_t microSeconds;
     micro_milli_seconds(entryTimestamp, microSeconds);
 
-    lockReader();
     if (Modes.exit) {
-        unlockReader();
         return BLADERF_STREAM_SHUTDOWN;
     }
 
-    unsigned next_free_buffer = (Modes.first_free_buffer + 1) % MODES_MAG_BUFFERS;
-    struct mag_buf *outbuf = &Modes.mag_buffers[Modes.first_free_buffer];
-    struct mag_buf *lastbuf = &Modes.mag_buffers[(Modes.first_free_buffer + MODES_MAG_BUFFERS - 1) % MODES_MAG_BUFFERS];
-    unsigned free_bufs = (Modes.first_filled_buffer - next_free_buffer + MODES_MAG_BUFFERS) % MODES_MAG_BUFFERS;
+    struct mag_buf *lastbuf;
+    unsigned free_bufs;
+    struct mag_buf *outbuf = fifoProducerBuf(&lastbuf, &free_bufs);
 
-    if (free_bufs == 0 || (dropping && free_bufs < MODES_MAG_BUFFERS / 2)) {
+    if (free_bufs == 0 || (dropping && free_bufs < Modes.mag_buffer_count / 2)) {
         // FIFO is full. Drop this block.
         dropping = true;
-        unlockReader();
         return samples;
     }
 
     dropping = false;
-    unlockReader();
 
     // Copy trailing data from last block (or reset if not valid)
     if (outbuf->dropped == 0) {
@@ -448,18 +443,7 @@ static void *handle_bladerf_samples(struct bladerf *dev,
         outbuf->mean_power /= blocks_processed;
 
         // Push the new data to the demodulation thread
-        lockReader();
-
-        // accumulate CPU while holding the mutex, and restart measurement
-        end_cpu_timing(&thread_cpu, &Modes.reader_cpu_accumulator);
-        start_cpu_timing(&thread_cpu);
-
-        Modes.mag_buffers[next_free_buffer].dropped = 0;
-        Modes.mag_buffers[next_free_buffer].length = 0; // just in case
-        Modes.first_free_buffer = next_free_buffer;
-
-        wakeDecode();
-        unlockReader();
+        fifoProducerPublish(&thread_cpu);
     }
 
     return samples;
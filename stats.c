@@ -53,6 +53,8 @@
 
 #include "readsb.h"
 
+#include <sys/resource.h>
+
 void add_timespecs(const struct timespec *x, const struct timespec *y, struct timespec *z) {
     z->tv_sec = x->tv_sec + y->tv_sec;
     z->tv_nsec = x->tv_nsec + y->tv_nsec;
@@ -133,6 +135,11 @@ void display_stats(struct stats *st) {
         printf("    %u accepted with correct CRC\n", st->remote_accepted[0]);
         for (j = 1; j <= Modes.nfix_crc; ++j)
             printf("    %u accepted with %d-bit error repaired\n", st->remote_accepted[j], j);
+        printf("Network output clients that couldn't keep up:\n");
+        printf("  %u disconnected\n", st->net_slow_disconnected);
+        printf("  %u queued output chunks dropped\n", st->net_slow_dropped);
+        printf("  %u output chunks sent thinned\n", st->net_slow_thinned);
+        printf("  %u output chunks skipped while paused\n", st->net_slow_paused);
     }
 
     printf("%u total usable messages\n",
@@ -337,6 +344,10 @@ void add_stats(const struct stats *st1, const struct stats *st2, struct stats *t
     target->remote_rejected_bad = st1->remote_rejected_bad + st2->remote_rejected_bad;
     target->remote_rejected_delayed = st1->remote_rejected_delayed + st2->remote_rejected_delayed;
     target->remote_malformed_beast = st1->remote_malformed_beast + st2->remote_malformed_beast;
+    target->net_slow_disconnected = st1->net_slow_disconnected + st2->net_slow_disconnected;
+    target->net_slow_dropped = st1->net_slow_dropped + st2->net_slow_dropped;
+    target->net_slow_thinned = st1->net_slow_thinned + st2->net_slow_thinned;
+    target->net_slow_paused = st1->net_slow_paused + st2->net_slow_paused;
 
     if (Modes.ping) {
         for (int i = 0; i < PING_BUCKETS; i++) {
@@ -404,6 +415,53 @@ void display_total_stats(void) {
     display_stats(&added);
 }
 
+// --beast-replay summary: throughput, CPU per stage and peak memory
+void display_replay_stats(double seconds) {
+    struct stats added;
+    lockCurrent();
+    add_stats(&Modes.stats_alltime, &Modes.stats_current, &added);
+    unlockCurrent();
+    struct stats *st = &added;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    uint64_t received = st->remote_received_modes + st->remote_received_modeac;
+    if (seconds <= 0)
+        seconds = 1e-9;
+
+    printf("Replay: %llu messages received, %u usable in %.3f s\n",
+            (unsigned long long) received, st->messages_total, seconds);
+    printf("  %.0f messages/s received\n", received / seconds);
+    printf("  %.0f usable messages/s\n", st->messages_total / seconds);
+
+#define CPU_MILLIS(x) ((unsigned long long) st->x##_cpu.tv_sec * 1000UL + st->x##_cpu.tv_nsec / 1000000UL)
+    printf("CPU per stage:\n"
+            "  %llu ms for network input, decoding and tracking\n"
+            "  %llu ms for feeding the capture and draining outputs\n"
+            "  %llu ms for aircraft json\n"
+            "  %llu ms for globe json\n"
+            "  %llu ms for binCraft\n"
+            "  %llu ms for trace json\n"
+            "  %llu ms for heatmap and state\n"
+            "  %llu ms for removing stale aircraft\n"
+            "  %llu ms for api update\n"
+            "  %llu ms for api workers\n",
+            CPU_MILLIS(background),
+            CPU_MILLIS(reader),
+            CPU_MILLIS(aircraft_json),
+            CPU_MILLIS(globe_json),
+            CPU_MILLIS(bin),
+            CPU_MILLIS(trace_json),
+            CPU_MILLIS(heatmap_and_state),
+            CPU_MILLIS(remove_stale),
+            CPU_MILLIS(api_update),
+            CPU_MILLIS(api_worker));
+#undef CPU_MILLIS
+
+    printf("Peak RSS: %ld kB\n", usage.ru_maxrss);
+    fflush(stdout);
+}
 
 void display_total_short_range_stats() {
     struct stats added;
@@ -582,6 +640,16 @@ static char * appendStatsJson(char *p, char *end, struct stats *st, const char *
         }
 
         p = safe_snprintf(p, end, "]}");
+
+        p = safe_snprintf(p, end,
+                ",\"net_slow_clients\":{\"disconnected\":%u"
+                ",\"dropped\":%u"
+                ",\"thinned\":%u"
+                ",\"paused\":%u}",
+                st->net_slow_disconnected,
+                st->net_slow_dropped,
+                st->net_slow_thinned,
+                st->net_slow_paused);
     }
 
     {
@@ -828,6 +896,10 @@ struct char_buffer generatePromFile(int64_t now) {
     p = safe_snprintf(p, end, "readsb_messages_modeac_valid %u\n", st->remote_received_modeac + st->demod_modeac);
 
     p = safe_snprintf(p, end, "readsb_network_malformed_beast_bytes %u\n", st->remote_malformed_beast);
+    p = safe_snprintf(p, end, "readsb_network_slow_clients_disconnected %u\n", st->net_slow_disconnected);
+    p = safe_snprintf(p, end, "readsb_network_slow_clients_dropped_chunks %u\n", st->net_slow_dropped);
+    p = safe_snprintf(p, end, "readsb_network_slow_clients_thinned_chunks %u\n", st->net_slow_thinned);
+    p = safe_snprintf(p, end, "readsb_network_slow_clients_paused_chunks %u\n", st->net_slow_paused);
 
     if (Modes.ping) {
         float bucketsize = PING_BUCKETBASE;
@@ -102,6 +102,11 @@ struct stats
   uint32_t remote_rejected_delayed;
   uint32_t remote_accepted[MODES_MAX_BITERRORS + 1];
   uint32_t remote_malformed_beast;
+  // output clients that couldn't keep up (--net-slow-client-policy):
+  uint32_t net_slow_disconnected; // clients disconnected
+  uint32_t net_slow_dropped; // queued output chunks dropped
+  uint32_t net_slow_thinned; // output chunks sent thinned
+  uint32_t net_slow_paused; // output chunks skipped while paused
   uint32_t remote_ping_rtt[PING_BUCKETS];
   // total messages:
   uint32_t messages_total;
@@ -176,6 +181,7 @@ void display_stats (struct stats *st);
 void reset_stats (struct stats *st);
 
 void display_total_stats(void);
+void display_replay_stats(double seconds);
 void display_total_short_range_stats();
 
 void add_timespecs (const struct timespec *x, const struct timespec *y, struct timespec *z);
@@ -58,7 +58,30 @@ uint32_t modeAC_lastcount[4096];
 uint32_t modeAC_match[4096];
 uint32_t modeAC_age[4096];
 
+_Thread_local struct trackShard *trackShardCurrent;
+
+// receivers, range statistics and the geomag model are shared between the
+// tracker shards, only lock for them when running on a tracker thread
+static pthread_mutex_t trackSharedMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void trackSharedLock(void) {
+    if (trackShardCurrent)
+        pthread_mutex_lock(&trackSharedMutex);
+}
+static inline void trackSharedUnlock(void) {
+    if (trackShardCurrent)
+        pthread_mutex_unlock(&trackSharedMutex);
+}
+
+static inline int receiverReference(struct modesMessage *mm, double *lat, double *lon, struct aircraft *a, int noDebug, struct receiver **r) {
+    trackSharedLock();
+    *r = receiverGetReference(mm->receiverId, lat, lon, a, noDebug);
+    trackSharedUnlock();
+    return *r != NULL;
+}
+
 static void showPositionDebug(struct aircraft *a, struct modesMessage *mm, int64_t now, double bad_lat, double bad_lon);
+static void trackShardJsonPos(struct modesMessage *mm, struct aircraft *a);
 static void position_bad(struct modesMessage *mm, struct aircraft *a);
 static void calc_wind(struct aircraft *a, int64_t now);
 static void calc_temp(struct aircraft *a, int64_t now);
@@ -370,10 +393,10 @@ static void update_range_histogram(struct aircraft *a, struct modesMessage *mm,
         }
     }
 
-    if (range > Modes.stats_current.distance_max)
-        Modes.stats_current.distance_max = range;
-    if (range < Modes.stats_current.distance_min)
-        Modes.stats_current.distance_min = range;
+    if (range > trackStats()->distance_max)
+        trackStats()->distance_max = range;
+    if (range < trackStats()->distance_min)
+        trackStats()->distance_min = range;
 
     int bucket = round(range / Modes.maxRange * RANGE_BUCKET_COUNT);
 
@@ -382,7 +405,7 @@ static void update_range_histogram(struct aircraft *a, struct modesMessage *mm,
     else if (bucket >= RANGE_BUCKET_COUNT)
         bucket = RANGE_BUCKET_COUNT - 1;
 
-    ++Modes.stats_current.range_histogram[bucket];
+    ++trackStats()->range_histogram[bucket];
 }
 
 static inline int duplicate_check(int64_t now, struct aircraft *a, double new_lat, double new_lon) {
@@ -417,7 +440,9 @@ static int speed_check(struct aircraft *a, datasource_t source, double lat, doub
         mm->pos_ignore = 1;
         // but count it as a received position towards receiver heuristics
         if (!Modes.userLocationValid) {
+            trackSharedLock();
             receiverPositionReceived(a, mm, lat, lon, now);
+            trackSharedUnlock();
         }
         if (elapsed > 200 && a->receiverId == mm->receiverId && (Modes.debug_cpr || Modes.debug_speed_check || a->addr == Modes.cpr_focus)) {
             // let speed_check continue for displaying this duplicate (at least for non-aggregated receivers)
@@ -613,7 +638,10 @@ static int speed_check(struct aircraft *a, datasource_t source, double lat, doub
     }
 
     if (!Modes.userLocationValid && (inrange || override)) {
-        if (receiverPositionReceived(a, mm, lat, lon, now) == -2) {
+        trackSharedLock();
+        int res = receiverPositionReceived(a, mm, lat, lon, now);
+        trackSharedUnlock();
+        if (res == -2) {
             // far outside receiver area
             receiverRangeExceeded = 1;
             inrange = 0;
@@ -627,6 +655,7 @@ static int speed_check(struct aircraft *a, datasource_t source, double lat, doub
                 && a->pos_reliable_even >= Modes.position_persistence * 3 / 4
                 && a->trackUnreliable < 3
            ) {
+            trackSharedLock();
             struct receiver *r = receiverBad(mm->receiverId, a->addr, now);
             if (r && Modes.debug_garbage && r->badCounter > 6) {
                 fprintf(stderr, "hex: %06x id: %016"PRIx64" #good: %6d #bad: %3.0f trackDiff: %3.0f: %7.2fkm/%7.2fkm in %4.1f s, max %4.0f kt\n",
@@ -639,6 +668,7 @@ static int speed_check(struct aircraft *a, datasource_t source, double lat, doub
                        );
 
             }
+            trackSharedUnlock();
         }
 
     }
@@ -748,7 +778,7 @@ static int doGlobalCPR(struct aircraft *a, struct modesMessage *mm, double *lat,
             reflat = Modes.fUserLat;
             reflon = Modes.fUserLon;
             ref = 1;
-        } else if ((receiver = receiverGetReference(mm->receiverId, &reflat, &reflon, a, 0))) {
+        } else if (receiverReference(mm, &reflat, &reflon, a, 0, &receiver)) {
             //function sets reflat and reflon on success, nothing to do here.
             ref = 2;
         } else if (a->seen_pos && a->surfaceCPR_allow_ac_rel) {
@@ -807,7 +837,7 @@ static int doGlobalCPR(struct aircraft *a, struct modesMessage *mm, double *lat,
             }
 
             if (mm->source != SOURCE_MLAT) {
-                Modes.stats_current.cpr_global_range_checks++;
+                trackStats()->cpr_global_range_checks++;
                 if (Modes.debug_maxRange) {
                     showPositionDebug(a, mm, mm->sysTimestampMsg, *lat, *lon);
                 }
@@ -819,7 +849,7 @@ static int doGlobalCPR(struct aircraft *a, struct modesMessage *mm, double *lat,
     // check speed limit
     if (!speed_check(a, mm->source, *lat, *lon, mm, CPR_GLOBAL)) {
         if (mm->source != SOURCE_MLAT)
-            Modes.stats_current.cpr_global_speed_checks++;
+            trackStats()->cpr_global_speed_checks++;
         return -2;
     }
 
@@ -907,7 +937,7 @@ static int doLocalCPR(struct aircraft *a, struct modesMessage *mm, double *lat,
         double range = greatcircle(reflat, reflon, *lat, *lon, 0);
         if (range > range_limit) {
             if (mm->source != SOURCE_MLAT)
-                Modes.stats_current.cpr_local_range_checks++;
+                trackStats()->cpr_local_range_checks++;
             return (-1);
         }
     }
@@ -915,7 +945,7 @@ static int doLocalCPR(struct aircraft *a, struct modesMessage *mm, double *lat,
     // check speed limit
     if (!speed_check(a, mm->source, *lat, *lon, mm, CPR_LOCAL)) {
         if (mm->source != SOURCE_MLAT)
-            Modes.stats_current.cpr_local_speed_checks++;
+            trackStats()->cpr_local_speed_checks++;
         return -2;
     }
 
@@ -958,12 +988,12 @@ static void setPosition(struct aircraft *a, struct modesMessage *mm, int64_t now
         return;
     }
 
-    Modes.stats_current.pos_by_type[mm->addrtype]++;
-    Modes.stats_current.pos_all++;
+    trackStats()->pos_by_type[mm->addrtype]++;
+    trackStats()->pos_all++;
 
     // mm->pos_bad should never arrive here, handle it just in case
     if (mm->cpr_valid && (mm->garbage || mm->pos_bad)) {
-        Modes.stats_current.pos_garbage++;
+        trackStats()->pos_garbage++;
         return;
     }
 
@@ -984,12 +1014,13 @@ static void setPosition(struct aircraft *a, struct modesMessage *mm, int64_t now
     a->receiverId = mm->receiverId;
 
     if (mm->duplicate) {
-        Modes.stats_current.pos_duplicate++;
+        trackStats()->pos_duplicate++;
         return;
     }
 
     if (mm->client) {
-        mm->client->positionCounter++;
+        // clients feed aircraft on all shards
+        __atomic_fetch_add(&mm->client->positionCounter, 1, __ATOMIC_RELAXED);
     }
 
     if (mm->source != SOURCE_JAERO && mm->distance_traveled >= 100) {
@@ -1066,11 +1097,18 @@ static void setPosition(struct aircraft *a, struct modesMessage *mm, int64_t now
         }
     }
 
-    if (mm->jsonPos)
-        jsonPositionOutput(mm, a);
+    if (mm->jsonPos) {
+        // tracker threads render it with the current state, trackShardFlush() writes it in order
+        if (trackShardCurrent)
+            trackShardJsonPos(mm, a);
+        else
+            jsonPositionOutput(mm, a);
+    }
 
     if (posReliable(a) && (mm->source == SOURCE_ADSB || mm->source == SOURCE_ADSR)) {
+        trackSharedLock();
         update_range_histogram(a, mm, now);
+        trackSharedUnlock();
     }
 }
 
@@ -1088,7 +1126,7 @@ static void updatePosition(struct aircraft *a, struct modesMessage *mm, int64_t
 
     if (surface) {
         if (mm->source != SOURCE_MLAT)
-            Modes.stats_current.cpr_surface++;
+            trackStats()->cpr_surface++;
 
         // Surface: 25 seconds if >25kt or speed unknown, 50 seconds otherwise
         if (mm->gs_valid && mm->gs.selected <= 25)
@@ -1097,7 +1135,7 @@ static void updatePosition(struct aircraft *a, struct modesMessage *mm, int64_t
             max_elapsed = 25000;
     } else {
         if (mm->source != SOURCE_MLAT)
-            Modes.stats_current.cpr_airborne++;
+            trackStats()->cpr_airborne++;
 
         // Airborne: 10 seconds
         max_elapsed = 10000;
@@ -1118,7 +1156,7 @@ static void updatePosition(struct aircraft *a, struct modesMessage *mm, int64_t
             // Global CPR failed because the position produced implausible results.
             // This is bad data.
             if (mm->source != SOURCE_MLAT)
-                Modes.stats_current.cpr_global_bad++;
+                trackStats()->cpr_global_bad++;
 
             mm->pos_bad = 1;
 
@@ -1134,16 +1172,16 @@ static void updatePosition(struct aircraft *a, struct modesMessage *mm, int64_t
             // No local reference for surface position available, or the two messages crossed a zone.
             // Nonfatal, try again later.
             if (mm->source != SOURCE_MLAT)
-                Modes.stats_current.cpr_global_skipped++;
+                trackStats()->cpr_global_skipped++;
         } else {
             if (accept_data(&a->position_valid, mm->source, mm, a, 2)) {
                 if (mm->source != SOURCE_MLAT)
-                    Modes.stats_current.cpr_global_ok++;
+                    trackStats()->cpr_global_ok++;
 
                 globalCPR = 1;
             } else {
                 if (mm->source != SOURCE_MLAT)
-                    Modes.stats_current.cpr_global_skipped++;
+                    trackStats()->cpr_global_skipped++;
                 location_result = -2;
             }
         }
@@ -1167,20 +1205,20 @@ static void updatePosition(struct aircraft *a, struct modesMessage *mm, int64_t
             mm->decoded_lon = new_lon;
         } else if (location_result >= 0 && accept_data(&a->position_valid, mm->source, mm, a, 2)) {
             if (mm->source != SOURCE_MLAT)
-                Modes.stats_current.cpr_local_ok++;
+                trackStats()->cpr_local_ok++;
             mm->cpr_relative = 1;
 
             if (location_result == 1) {
                 if (mm->source != SOURCE_MLAT)
-                    Modes.stats_current.cpr_local_aircraft_relative++;
+                    trackStats()->cpr_local_aircraft_relative++;
             }
             if (location_result == 2) {
                 if (mm->source != SOURCE_MLAT)
-                    Modes.stats_current.cpr_local_receiver_relative++;
+                    trackStats()->cpr_local_receiver_relative++;
             }
         } else {
             if (mm->source != SOURCE_MLAT)
-                Modes.stats_current.cpr_local_skipped++;
+                trackStats()->cpr_local_skipped++;
             location_result = -1;
         }
     }
@@ -1699,6 +1737,9 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm) {
         return NULL;
     }
 
+    // the api JSON of this aircraft needs to be printed again
+    a->dirtyEpoch = Modes.apiEpoch;
+
     // only count the aircraft as "seen" for reliable messages with CRC
     if (addressReliable(mm)) {
         a->seen = now;
@@ -1732,7 +1773,7 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm) {
     a->messages++;
 
     if (mm->client && !mm->garbage) {
-        mm->client->messageCounter++;
+        __atomic_fetch_add(&mm->client->messageCounter, 1, __ATOMIC_RELAXED);
     }
 
     // update addrtype
@@ -2215,8 +2256,8 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm) {
     if (mm->msgtype == 11 && mm->IID == 0 && mm->correctedbits == 0) {
         double reflat;
         double reflon;
-        struct receiver *r = receiverGetReference(mm->receiverId, &reflat, &reflon, a, 1);
-        if (r) {
+        struct receiver *r;
+        if (receiverReference(mm, &reflat, &reflon, a, 1, &r)) {
             if (now - a->rr_seen < 600 * SECONDS && fabs(a->lon - reflon) < 5 && fabs(a->lon - reflon) < 5) {
                 a->rr_lat = 0.1 * reflat + 0.9 * a->rr_lat;
                 a->rr_lon = 0.1 * reflon + 0.9 * a->rr_lon;
@@ -2353,9 +2394,188 @@ struct aircraft *trackUpdateFromMessage(struct modesMessage *mm) {
         mm->reduce_forward = 1;
     }
 
+    // with --track-threads the output stage runs after later messages were tracked
+    mm->ac_geom_delta_valid = trackDataValid(&a->geom_delta_valid);
+    mm->ac_geom_delta = a->geom_delta;
+
     return (a);
 }
 
+//
+// Sharded tracking
+//
+
+#define TRACK_SHARD_BATCH (4096)
+// smaller batches are tracked on the calling thread, waking the pool costs more
+#define TRACK_SHARD_MIN_THREADED (256)
+
+struct trackShardEntry {
+    struct modesMessage mm;
+    struct aircraft *a;
+    struct trackShard *shard;
+    uint32_t jsonOffset; // jsonPos object in shard->json
+    uint32_t jsonLen;
+};
+
+static struct {
+    struct trackShardEntry *entries;
+    uint32_t count;
+    struct trackShard *shards;
+    threadpool_task_t *tasks;
+    int shardCount;
+} trackBatch;
+
+void trackShardInit(void) {
+    if (!Modes.trackPool)
+        return;
+
+    trackBatch.shardCount = Modes.trackThreads;
+    trackBatch.entries = calloc(TRACK_SHARD_BATCH, sizeof(struct trackShardEntry));
+    trackBatch.shards = calloc(trackBatch.shardCount, sizeof(struct trackShard));
+    trackBatch.tasks = calloc(trackBatch.shardCount, sizeof(threadpool_task_t));
+    if (!trackBatch.entries || !trackBatch.shards || !trackBatch.tasks) {
+        fprintf(stderr, "Out of memory allocating tracker shards.\n");
+        exit(1);
+    }
+    trackBatch.count = 0;
+
+    for (int i = 0; i < trackBatch.shardCount; i++) {
+        struct trackShard *shard = &trackBatch.shards[i];
+        if (!(shard->index = calloc(TRACK_SHARD_BATCH, sizeof(uint32_t)))) {
+            fprintf(stderr, "Out of memory allocating tracker shards.\n");
+            exit(1);
+        }
+        reset_stats(&shard->stats);
+    }
+}
+
+void trackShardCleanup(void) {
+    if (!trackBatch.shards)
+        return;
+    for (int i = 0; i < trackBatch.shardCount; i++) {
+        sfree(trackBatch.shards[i].index);
+        sfree(trackBatch.shards[i].json);
+    }
+    sfree(trackBatch.shards);
+    sfree(trackBatch.tasks);
+    sfree(trackBatch.entries);
+    trackBatch.shardCount = 0;
+    trackBatch.count = 0;
+}
+
+// jsonPositionOutput on a tracker thread: render the object while the
+// aircraft state matches the message, the flush writes it in message order
+static void trackShardJsonPos(struct modesMessage *mm, struct aircraft *a) {
+    struct trackShard *shard = trackShardCurrent;
+    struct trackShardEntry *e = &trackBatch.entries[shard->current];
+
+    if (!Modes.json_out.connections)
+        return;
+
+    int buflen = 8192;
+    if (shard->jsonLen + buflen > shard->jsonAlloc) {
+        shard->jsonAlloc = 2 * shard->jsonAlloc + buflen;
+        shard->json = realloc(shard->json, shard->jsonAlloc);
+        if (!shard->json) {
+            fprintf(stderr, "trackShardJsonPos: out of memory!\n");
+            exit(1);
+        }
+    }
+    char *start = shard->json + shard->jsonLen;
+    char *end = start + buflen - 1;
+    char *p = sprintAircraftObject(start, end, a, mm->sysTimestampMsg, 2, NULL);
+    if (p >= end) {
+        fprintf(stderr, "buffer insufficient trackShardJsonPos()\n");
+        return;
+    }
+
+    e->jsonOffset = shard->jsonLen;
+    e->jsonLen = p - start;
+    shard->jsonLen += e->jsonLen;
+}
+
+static void trackShardRun(void *arg) {
+    struct trackShard *shard = arg;
+
+    trackShardCurrent = shard;
+    for (uint32_t i = 0; i < shard->count; i++) {
+        shard->current = shard->index[i];
+        struct trackShardEntry *e = &trackBatch.entries[shard->current];
+        e->a = trackUpdateFromMessage(&e->mm);
+    }
+    trackShardCurrent = NULL;
+}
+
+// queue a message for tracking, used instead of trackUpdateFromMessage when Modes.trackPool is set
+void trackShardQueue(struct modesMessage *mm) {
+    if (trackBatch.count == TRACK_SHARD_BATCH)
+        trackShardFlush();
+
+    uint32_t shardIndex = 0;
+    // aircraft hash buckets are owned by exactly one shard, Mode A/C counts all go to shard 0
+    if (mm->msgtype != DFTYPE_MODEAC)
+        shardIndex = addrHash(mm->addr, AIRCRAFT_HASH_BITS) % trackBatch.shardCount;
+
+    struct trackShard *shard = &trackBatch.shards[shardIndex];
+    shard->index[shard->count++] = trackBatch.count;
+
+    struct trackShardEntry *e = &trackBatch.entries[trackBatch.count++];
+    e->mm = *mm;
+    e->shard = shard;
+    e->jsonLen = 0;
+}
+
+// track all queued messages on the tracker threads, then pass them to the
+// output stage on the calling thread in the order they were queued
+void trackShardFlush(void) {
+    if (!trackBatch.count)
+        return;
+
+    int taskCount = 0;
+    for (int i = 0; i < trackBatch.shardCount; i++) {
+        struct trackShard *shard = &trackBatch.shards[i];
+        if (!shard->count)
+            continue;
+        trackBatch.tasks[taskCount].function = trackShardRun;
+        trackBatch.tasks[taskCount].argument = shard;
+        taskCount++;
+    }
+
+    if (trackBatch.count < TRACK_SHARD_MIN_THREADED) {
+        for (int i = 0; i < taskCount; i++)
+            trackShardRun(trackBatch.tasks[i].argument);
+    } else {
+        struct timespec before = threadpool_get_cumulative_thread_time(Modes.trackPool);
+        threadpool_run(Modes.trackPool, trackBatch.tasks, taskCount);
+        struct timespec after = threadpool_get_cumulative_thread_time(Modes.trackPool);
+        // tracking is part of network input in the CPU stats
+        timespec_add_elapsed(&before, &after, &Modes.stats_current.background_cpu);
+    }
+
+    for (int i = 0; i < trackBatch.shardCount; i++) {
+        struct trackShard *shard = &trackBatch.shards[i];
+        if (!shard->count)
+            continue;
+        add_stats(&shard->stats, &Modes.stats_current, &Modes.stats_current);
+        reset_stats(&shard->stats);
+        shard->count = 0;
+    }
+
+    for (uint32_t i = 0; i < trackBatch.count; i++) {
+        struct trackShardEntry *e = &trackBatch.entries[i];
+        if (e->a) {
+            // the quick lookup table is only written from this thread
+            quickAdd(e->a);
+        }
+        if (e->jsonLen)
+            jsonPositionWrite(e->shard->json + e->jsonOffset, e->jsonLen);
+        outputModesMessage(&e->mm, e->a);
+    }
+    trackBatch.count = 0;
+    for (int i = 0; i < trackBatch.shardCount; i++)
+        trackBatch.shards[i].jsonLen = 0;
+}
+
 //
 // Periodic updates of tracking state
 //
@@ -2790,7 +3010,9 @@ static inline int declination(struct aircraft *a, double *dec, int64_t now) {
     double ti;
     double gv;
 
+    trackSharedLock();
     int res = geomag_calc(a->baro_alt * 0.0003048, a->lat, a->lon, year, dec, &dip, &ti, &gv);
+    trackSharedUnlock();
     if (res) {
         *dec = 0.0;
     } else {
@@ -3151,6 +3373,7 @@ static const char *source_string(datasource_t source) {
 }
 
 void updateValidities(struct aircraft *a, int64_t now) {
+    int changed = 0;
 
     int64_t elapsed_seen_global = now - a->seenPosGlobal;
     if (Modes.json_globe_index && elapsed_seen_global < 5 * MINUTES) {
@@ -3161,64 +3384,72 @@ void updateValidities(struct aircraft *a, int64_t now) {
         set_globe_index(a, -5);
     }
 
-    if (a->category != 0 && now > a->category_updated + Modes.trackExpireMax)
+    if (a->category != 0 && now > a->category_updated + Modes.trackExpireMax) {
         a->category = 0;
+        changed = 1;
+    }
 
     // reset position reliability when no position was received for 60 minutes
     if (a->pos_reliable_odd != 0 && a->pos_reliable_even != 0 && elapsed_seen_global > POS_RELIABLE_TIMEOUT) {
         a->pos_reliable_odd = 0;
         a->pos_reliable_even = 0;
+        changed = 1;
     }
     if (a->tracePosBuffered && now > a->seenPosReliable + TRACE_STALE) {
         traceUsePosBuffered(a);
     }
 
-    if (a->alt_reliable != 0 && a->baro_alt_valid.source == SOURCE_INVALID)
+    if (a->alt_reliable != 0 && a->baro_alt_valid.source == SOURCE_INVALID) {
         a->alt_reliable = 0;
-
-    updateValidity(&a->callsign_valid, now, TRACK_EXPIRE_LONG);
-    updateValidity(&a->baro_alt_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->geom_alt_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->geom_delta_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->gs_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->ias_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->tas_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->mach_valid, now, TRACK_EXPIRE);
-
-    updateValidity(&a->track_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->track_rate_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->roll_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->mag_heading_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->true_heading_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->baro_rate_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->geom_rate_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nic_a_valid, now, TRACK_EXPIRE);
-
-    updateValidity(&a->nic_c_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nic_baro_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nac_p_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nac_v_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->sil_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->gva_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->sda_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->squawk_valid, now, TRACK_EXPIRE);
-
-    updateValidity(&a->emergency_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->airground_valid, now, TRACK_EXPIRE_LONG);
-    updateValidity(&a->nav_qnh_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nav_altitude_mcp_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nav_altitude_fms_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nav_altitude_src_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nav_heading_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->nav_modes_valid, now, TRACK_EXPIRE);
-
-    updateValidity(&a->cpr_odd_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->cpr_even_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->position_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->alert_valid, now, TRACK_EXPIRE);
-    updateValidity(&a->spi_valid, now, TRACK_EXPIRE);
-
-    updateValidity(&a->acas_ra_valid, now, TRACK_EXPIRE);
+        changed = 1;
+    }
+
+    changed |= updateValidity(&a->callsign_valid, now, TRACK_EXPIRE_LONG);
+    changed |= updateValidity(&a->baro_alt_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->geom_alt_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->geom_delta_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->gs_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->ias_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->tas_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->mach_valid, now, TRACK_EXPIRE);
+
+    changed |= updateValidity(&a->track_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->track_rate_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->roll_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->mag_heading_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->true_heading_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->baro_rate_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->geom_rate_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nic_a_valid, now, TRACK_EXPIRE);
+
+    changed |= updateValidity(&a->nic_c_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nic_baro_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nac_p_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nac_v_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->sil_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->gva_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->sda_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->squawk_valid, now, TRACK_EXPIRE);
+
+    changed |= updateValidity(&a->emergency_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->airground_valid, now, TRACK_EXPIRE_LONG);
+    changed |= updateValidity(&a->nav_qnh_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nav_altitude_mcp_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nav_altitude_fms_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nav_altitude_src_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nav_heading_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->nav_modes_valid, now, TRACK_EXPIRE);
+
+    changed |= updateValidity(&a->cpr_odd_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->cpr_even_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->position_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->alert_valid, now, TRACK_EXPIRE);
+    changed |= updateValidity(&a->spi_valid, now, TRACK_EXPIRE);
+
+    changed |= updateValidity(&a->acas_ra_valid, now, TRACK_EXPIRE);
+
+    if (changed)
+        a->dirtyEpoch = Modes.apiEpoch;
 }
 
 static void showPositionDebug(struct aircraft *a, struct modesMessage *mm, int64_t now, double bad_lat, double bad_lon) {
@@ -464,6 +464,7 @@ struct aircraft
   uint32_t disc_cache_index;
   struct discarded disc_cache[DISCARD_CACHE];
   int32_t speedUnreliable;
+  uint32_t dirtyEpoch; // Modes.apiEpoch when the aircraft last changed, older JSON can be reused
 };
 
 /* Mode A/C tracking is done separately, not via the aircraft list,
@@ -474,12 +475,12 @@ extern uint32_t modeAC_count[4096];
 extern uint32_t modeAC_match[4096];
 extern uint32_t modeAC_age[4096];
 
-/* is this bit of data valid? */
-static inline void
+/* is this bit of data valid? returns 1 when it just expired */
+static inline int
 updateValidity (data_validity *v, int64_t now, int64_t expiration_timeout)
 {
     if (v->source == SOURCE_INVALID)
-        return;
+        return 0;
     int stale = (now > v->updated + TRACK_STALE);
     if (stale != v->stale)
         v->stale = stale;
@@ -494,6 +495,7 @@ updateValidity (data_validity *v, int64_t now, int64_t expiration_timeout)
         if (now > v->updated + expiration_timeout)
             v->source = SOURCE_INVALID;
     }
+    return v->source == SOURCE_INVALID;
 }
 
 /* is this bit of data valid? */
@@ -582,6 +584,34 @@ void from_state_all(struct state_all *in, struct state *in2, struct aircraft *a
 struct modesMessage;
 struct aircraft *trackUpdateFromMessage (struct modesMessage *mm);
 
+/* Sharded tracking (--track-threads, net-only):
+ * messages are queued and tracked in batches on Modes.trackPool,
+ * aircraft are assigned to shards by address hash so the messages
+ * of one aircraft stay in order on a single thread.
+ */
+struct trackShard {
+    struct stats stats; // merged into Modes.stats_current after each batch
+    uint32_t *index; // batch entries owned by this shard, in arrival order
+    uint32_t count;
+    uint32_t current; // batch entry being tracked
+    char *json; // jsonPositionOutput objects of this batch
+    size_t jsonLen;
+    size_t jsonAlloc;
+};
+
+// set while a tracker thread works on its shard, NULL otherwise
+extern _Thread_local struct trackShard *trackShardCurrent;
+
+// stats the tracking code should count into on the calling thread
+static inline struct stats *trackStats(void) {
+    return trackShardCurrent ? &trackShardCurrent->stats : &Modes.stats_current;
+}
+
+void trackShardInit(void);
+void trackShardCleanup(void);
+void trackShardQueue(struct modesMessage *mm);
+void trackShardFlush(void);
+
 void trackMatchAC(int64_t now);
 void trackRemoveStale(int64_t now);
 
@@ -0,0 +1,181 @@
+#include "readsb.h"
+
+#ifdef HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int uringSetup(unsigned entries, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+int uringInit(struct uring *ring, unsigned entries, unsigned cqEntries) {
+    struct io_uring_params p;
+
+    memset(ring, 0, sizeof(struct uring));
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = cqEntries;
+
+    ring->fd = uringSetup(entries, &p);
+    if (ring->fd < 0)
+        return -errno;
+    ring->features = p.features;
+
+    ring->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sqRingSize = ring->cqRingSize = imax(ring->sqRingSize, ring->cqRingSize);
+    }
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cqRing = ring->sqRing;
+    } else {
+        ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED)
+            goto fail;
+    }
+    ring->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto fail;
+
+    char *sq = ring->sqRing;
+    ring->sqHead = (unsigned *) (sq + p.sq_off.head);
+    ring->sqTail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sqFlags = (unsigned *) (sq + p.sq_off.flags);
+    ring->sqMask = *(unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sqEntries = p.sq_entries;
+    ring->sqArray = (unsigned *) (sq + p.sq_off.array);
+    ring->sqLocalTail = *ring->sqTail;
+
+    char *cq = ring->cqRing;
+    ring->cqHead = (unsigned *) (cq + p.cq_off.head);
+    ring->cqTail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cqMask = *(unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    return 0;
+
+fail:
+    {
+        int err = -errno;
+        uringClose(ring);
+        return err;
+    }
+}
+
+void uringClose(struct uring *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing && ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing)
+        munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing && ring->sqRing != MAP_FAILED)
+        munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(struct uring));
+    ring->fd = -1;
+}
+
+int uringBufRingInit(struct uring *ring, struct uringBufRing *brg, int bgid, unsigned entries, unsigned bufSize) {
+    memset(brg, 0, sizeof(struct uringBufRing));
+
+    brg->brSize = entries * sizeof(struct io_uring_buf);
+    brg->br = mmap(NULL, brg->brSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (brg->br == MAP_FAILED) {
+        brg->br = NULL;
+        return -errno;
+    }
+    brg->bufs = malloc((size_t) entries * bufSize);
+    if (!brg->bufs) {
+        uringBufRingFree(brg);
+        return -ENOMEM;
+    }
+    brg->entries = entries;
+    brg->mask = entries - 1;
+    brg->bufSize = bufSize;
+    brg->bgid = bgid;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) brg->br;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+    if (uringRegister(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int err = -errno;
+        uringBufRingFree(brg);
+        return err;
+    }
+
+    brg->br->tail = 0;
+    for (unsigned bid = 0; bid < entries; bid++)
+        uringBufRecycle(brg, bid);
+
+    return 0;
+}
+
+void uringBufRingFree(struct uringBufRing *brg) {
+    if (brg->br)
+        munmap(brg->br, brg->brSize);
+    sfree(brg->bufs);
+    memset(brg, 0, sizeof(struct uringBufRing));
+}
+
+struct io_uring_sqe *uringGetSqe(struct uring *ring) {
+    if (ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->sqEntries) {
+        uringSubmit(ring);
+        if (ring->sqLocalTail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->sqEntries)
+            return NULL;
+    }
+    unsigned index = ring->sqLocalTail & ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    ring->sqArray[index] = index;
+    ring->sqLocalTail++;
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+int uringSubmit(struct uring *ring) {
+    unsigned toSubmit = ring->sqLocalTail - *ring->sqTail;
+    unsigned flags = 0;
+
+    if (toSubmit)
+        __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+
+    // completions that didn't fit the CQ ring are only moved over when entering the kernel
+    if (__atomic_load_n(ring->sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)
+        flags |= IORING_ENTER_GETEVENTS;
+
+    if (!toSubmit && !flags)
+        return 0;
+
+    int res;
+    while ((res = uringEnter(ring->fd, toSubmit, 0, flags)) < 0 && errno == EINTR)
+        ;
+    return res < 0 ? -errno : res;
+}
+
+int uringWait(struct uring *ring, unsigned minComplete) {
+    unsigned toSubmit = ring->sqLocalTail - *ring->sqTail;
+    if (toSubmit)
+        __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+
+    int res;
+    while ((res = uringEnter(ring->fd, toSubmit, minComplete, IORING_ENTER_GETEVENTS)) < 0 && errno == EINTR)
+        toSubmit = 0;
+    return res < 0 ? -errno : res;
+}
+
+#endif // HAVE_IO_URING
@@ -0,0 +1,92 @@
+#ifndef URING_H
+#define URING_H
+
+// Minimal io_uring plumbing on top of the raw syscalls (no liburing needed),
+// just what the network code uses: one ring, SQE/CQE access and a ring of
+// provided receive buffers.
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+struct uring {
+    int fd;
+    unsigned features;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqFlags;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned sqLocalTail; // SQEs handed out, published to the kernel on submit
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+};
+
+struct uringBufRing {
+    struct io_uring_buf_ring *br;
+    size_t brSize;
+    char *bufs;
+    unsigned entries;
+    unsigned mask;
+    unsigned bufSize;
+    int bgid;
+};
+
+// both return 0 on success, -errno on failure
+int uringInit(struct uring *ring, unsigned entries, unsigned cqEntries);
+int uringBufRingInit(struct uring *ring, struct uringBufRing *brg, int bgid, unsigned entries, unsigned bufSize);
+void uringBufRingFree(struct uringBufRing *brg);
+void uringClose(struct uring *ring);
+
+// returns a zeroed SQE, submits pending SQEs first if the queue is full
+struct io_uring_sqe *uringGetSqe(struct uring *ring);
+// publish the SQEs handed out and tell the kernel, also flushes overflowed CQEs
+int uringSubmit(struct uring *ring);
+// submit and wait for at least minComplete completions
+int uringWait(struct uring *ring, unsigned minComplete);
+
+static inline struct io_uring_cqe *uringPeekCqe(struct uring *ring) {
+    unsigned head = *ring->cqHead;
+    if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &ring->cqes[head & ring->cqMask];
+}
+
+static inline void uringCqeSeen(struct uring *ring) {
+    __atomic_store_n(ring->cqHead, *ring->cqHead + 1, __ATOMIC_RELEASE);
+}
+
+static inline char *uringBuf(struct uringBufRing *brg, unsigned bid) {
+    return brg->bufs + (size_t) bid * brg->bufSize;
+}
+
+// hand a buffer back to the kernel
+static inline void uringBufRecycle(struct uringBufRing *brg, unsigned bid) {
+    unsigned short tail = brg->br->tail;
+    struct io_uring_buf *buf = &brg->br->bufs[tail & brg->mask];
+    buf->addr = (uint64_t) (uintptr_t) uringBuf(brg, bid);
+    buf->len = brg->bufSize;
+    buf->bid = bid;
+    __atomic_store_n(&brg->br->tail, (unsigned short) (tail + 1), __ATOMIC_RELEASE);
+}
+
+#endif // HAVE_IO_URING
+
+#endif
@@ -60,6 +60,10 @@ int64_t mstime(void) {
     if (Modes.synthetic_now)
         return Modes.synthetic_now;
 
+    return msWallTime();
+}
+
+int64_t msWallTime(void) {
     struct timeval tv;
     int64_t mst;
 